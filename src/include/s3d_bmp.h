@@ -29,6 +29,22 @@ bool SaveToBMP(
     const s32   height,
     const f32*  pPixel );
 
+//-------------------------------------------------------------------------------------------------
+//! @brief      8bit/チャンネルのピクセルをBMPファイルに保存します.
+//!
+//! @param [in]     filename        ファイル名.
+//! @param [in]     width           画像の横幅.
+//! @param [in]     height          画像の縦幅.
+//! @param [in]     pPixel          RGB の順に3バイトずつ格納したピクセル.
+//! @retval true    保存に成功.
+//! @retval false   保存に失敗.
+//-------------------------------------------------------------------------------------------------
+bool SaveToBMP(
+    const char* filename,
+    const s32   width,
+    const s32   height,
+    const u8*   pPixel );
+
 //-------------------------------------------------------------------------------------------------
 //! @brief      BMPファイルを読み込みます.
 //!
@@ -45,5 +61,21 @@ bool LoadFromBMP(
     s32&        height,
     f32**       ppPixel );
 
+//-------------------------------------------------------------------------------------------------
+//! @brief      BMPファイルを8bit/チャンネルのまま読み込みます.
+//!
+//! @param [in]     filename        ファイル名.
+//! @param [out]    width           画像の横幅です.
+//! @param [out]    height          画像の縦幅です.
+//! @param [out]    ppPixels        RGB の順に3バイトずつ格納したピクセルデータです.
+//! @retval true    読み込みに成功.
+//! @retval false   読み込みに失敗.
+//-------------------------------------------------------------------------------------------------
+bool LoadFromBMP(
+    const char* filename,
+    s32&        width,
+    s32&        height,
+    u8**        ppPixel );
+
 
 } // namespace s3d
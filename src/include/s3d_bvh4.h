@@ -60,6 +60,16 @@ public:
     //---------------------------------------------------------------------------------------------
     bool IsHit(const RaySet& raySet, HitRecord& record ) const override;
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      遮蔽判定を行います.
+    //---------------------------------------------------------------------------------------------
+    bool IsOccluded(const RaySet& raySet, f32 distance) const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      レイパケットの交差判定を行います.
+    //---------------------------------------------------------------------------------------------
+    u32 IsHitPacket(const RayPacket& packet, u32 active, HitRecord* pRecords) const override;
+
     //---------------------------------------------------------------------------------------------
     //! @brief      バウンディングボックスを取得します.
     //---------------------------------------------------------------------------------------------
@@ -96,16 +106,6 @@ private:
     //---------------------------------------------------------------------------------------------
     ~BVH4();
 
-    //---------------------------------------------------------------------------------------------
-    //! @brief      SAH分割します.
-    //---------------------------------------------------------------------------------------------
-    static bool SplitSAH( size_t count, IShape** ppShapes, size_t& mid );
-
-    //---------------------------------------------------------------------------------------------
-    //! @brief      中間分割します.
-    //---------------------------------------------------------------------------------------------
-    static bool SplitMid( size_t count, IShape** ppShapes, size_t& mid );
-
     //---------------------------------------------------------------------------------------------
     //! @brief      分割します.
     //---------------------------------------------------------------------------------------------
@@ -11,6 +11,7 @@
 #include <s3d_math.h>
 #include <s3d_shape.h>
 #include <atomic>
+#include <vector>
 
 
 namespace s3d {
@@ -26,6 +27,18 @@ class BVH8 : IShape
     /* NOTHING */
 
 public:
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    // CacheNode structure
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    struct CacheNode
+    {
+        f32             mini[8][3];     //!< 子ノードのバウンディングボックスの最小値です.
+        f32             maxi[8][3];     //!< 子ノードのバウンディングボックスの最大値です.
+        s32             child[8];       //!< 内部ノードの場合はノード番号, 葉の場合は形状配列の先頭番号です.
+        u32             count[8];       //!< 葉の形状数です. 0 の場合は内部ノードです.
+        s32             childCount;     //!< 子ノード数です.
+    };
+
     //=============================================================================================
     // public variables.
     //=============================================================================================
@@ -40,6 +53,26 @@ public:
     //---------------------------------------------------------------------------------------------
     static IShape* Create(size_t size, IShape** ppShapes);
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      OBVHを構築し, 構築結果をキャッシュ用のノード配列として取得します.
+    //!
+    //! @param [in]     size        形状数です.
+    //! @param [in]     ppShapes    形状配列です. 葉の範囲順に並び替えられます.
+    //! @param [out]    pCache      構築結果のノード配列です. 並び替え後の形状配列を参照します.
+    //---------------------------------------------------------------------------------------------
+    static IShape* Create(size_t size, IShape** ppShapes, std::vector<CacheNode>* pCache);
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      キャッシュ済みのノード配列からOBVHを生成します.
+    //!
+    //! @param [in]     size        形状数です.
+    //! @param [in]     ppShapes    キャッシュ作成時と同じ葉の範囲順に並んだ形状配列です.
+    //! @param [in]     pNodes      ノード配列です(先頭がルート).
+    //! @param [in]     nodeCount   ノード数です.
+    //! @return     ノード配列が不正な場合は nullptr を返却します.
+    //---------------------------------------------------------------------------------------------
+    static IShape* Create(size_t size, IShape** ppShapes, const CacheNode* pNodes, size_t nodeCount);
+
     //---------------------------------------------------------------------------------------------
     //! @brief      参照カウントを増やします.
     //---------------------------------------------------------------------------------------------
@@ -60,6 +93,16 @@ public:
     //---------------------------------------------------------------------------------------------
     bool IsHit(const RaySet& raySet, HitRecord& record ) const override;
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      遮蔽判定を行います.
+    //---------------------------------------------------------------------------------------------
+    bool IsOccluded(const RaySet& raySet, f32 distance) const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      レイパケットの交差判定を行います.
+    //---------------------------------------------------------------------------------------------
+    u32 IsHitPacket(const RayPacket& packet, u32 active, HitRecord* pRecords) const override;
+
     //---------------------------------------------------------------------------------------------
     //! @brief      バウンディングボックスを取得します.
     //---------------------------------------------------------------------------------------------
@@ -71,12 +114,60 @@ public:
     Vector3 GetCenter() const override;
 
 private:
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    // Node structure
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    S3D_ALIGN(32)
+    struct Node
+    {
+        BoundingBox8    box;            //!< 子ノードのバウンディングボックスです.
+        s32             child[8];       //!< 内部ノードの場合はノード番号, 葉の場合は形状配列の先頭番号です.
+        u32             count[8];       //!< 葉の形状数です. 0 の場合は内部ノードです.
+        s32             mask;           //!< 有効な子ノードのビットマスクです.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    // StackEntry structure
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    struct StackEntry
+    {
+        s32             child;          //!< ノード番号または形状配列の先頭番号です.
+        u32             count;          //!< 葉の形状数です. 0 の場合は内部ノードです.
+        f32             dist;           //!< 入射距離です.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    // PacketEntry structure
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    struct PacketEntry
+    {
+        s32             child;          //!< ノード番号または形状配列の先頭番号です.
+        u32             count;          //!< 葉の形状数です. 0 の場合は内部ノードです.
+        u32             rays;           //!< 交差するレイのビットマスクです.
+        f32             dist;           //!< パケット内の最短の入射距離です.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    // BuildNode structure
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    struct BuildNode
+    {
+        BoundingBox     box[8];         //!< 子ノードのバウンディングボックスです.
+        s32             child[8];       //!< 内部ノードの場合はノード番号, 葉の場合は形状配列の先頭番号です.
+        u32             count[8];       //!< 葉の形状数です. 0 の場合は内部ノードです.
+        s32             childCount;     //!< 子ノード数です.
+    };
+
     //=============================================================================================
     // private varaibles.
     //=============================================================================================
     std::atomic<u32>    m_Count;        //!< 参照カウントです.
-    BoundingBox8        m_Box;          //!< バウンディングボックスです.
-    IShape*             m_pNode[8];     //!< 子ノードです.
+    BoundingBox         m_Box;          //!< バウンディングボックスです.
+    Node*               m_pNodes;       //!< ノード配列です(先頭がルート).
+    u32                 m_NodeCount;    //!< ノード数です.
+    IShape**            m_ppShapes;     //!< 葉から参照する形状配列です.
+    u32                 m_ShapeCount;   //!< 形状数です.
+    u32                 m_StackSize;    //!< 木の深さから求めた走査スタックの必要サイズです.
 
     //=============================================================================================
     // private methods.
@@ -85,55 +176,27 @@ private:
     //---------------------------------------------------------------------------------------------
     //! @brief      コンストラクタです.
     //---------------------------------------------------------------------------------------------
-    BVH8(
-        IShape* pShape0,
-        IShape* pShape1,
-        IShape* pShape2,
-        IShape* pShape3,
-        IShape* pShape4,
-        IShape* pShape5,
-        IShape* pShape6,
-        IShape* pShape7 );
+    BVH8();
 
     //---------------------------------------------------------------------------------------------
     //! @brief      デストラクタです.
     //---------------------------------------------------------------------------------------------
     ~BVH8();
 
-    //---------------------------------------------------------------------------------------------
-    //! @brief      SAH分割します.
-    //---------------------------------------------------------------------------------------------
-    static bool SplitSAH( size_t count, IShape** ppShapes, size_t& mid );
-
-    //---------------------------------------------------------------------------------------------
-    //! @brief      中間分割します.
-    //---------------------------------------------------------------------------------------------
-    static bool SplitMid( size_t count, IShape** ppShapes, size_t& mid );
-
     //---------------------------------------------------------------------------------------------
     //! @brief      分割します.
     //---------------------------------------------------------------------------------------------
     static bool Split( size_t count, IShape** ppShapes, size_t& mid );
 
     //---------------------------------------------------------------------------------------------
-    //! @brief      new 演算子のオーバーロードです.
-    //---------------------------------------------------------------------------------------------
-    void* operator new (size_t size);
-
-    //---------------------------------------------------------------------------------------------
-    //! @brief      new[] 演算子のオーバーロードです.
-    //---------------------------------------------------------------------------------------------
-    void* operator new[] (size_t size);
-
-    //---------------------------------------------------------------------------------------------
-    //! @brief      delete 演算子のオーバーロードです.
+    //! @brief      ノードを再帰的に構築します.
     //---------------------------------------------------------------------------------------------
-    void operator delete (void* ptr);
+    static s32 Build( std::vector<BuildNode>& nodes, IShape** ppShapes, size_t offset, size_t count );
 
     //---------------------------------------------------------------------------------------------
-    //! @brief      delete[] 演算子のオーバーロードです.
+    //! @brief      構築済みのノードから走査用のデータを生成します.
     //---------------------------------------------------------------------------------------------
-    void operator delete[] (void* ptr);
+    static IShape* CreateFromNodes( size_t count, IShape** ppShapes, std::vector<BuildNode>& nodes );
 };
 
 } // namespace s3d
@@ -0,0 +1,115 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_bvhbuilder.h
+// Desc : BVH Builder Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_shape.h>
+#include <functional>
+#include <thread>
+#include <vector>
+
+
+namespace s3d {
+
+//-------------------------------------------------------------------------------------------------
+// Constant Values.
+//-------------------------------------------------------------------------------------------------
+static const u32 BVH_BUILDER_VERSION = 1;   //!< 構築結果が変わる変更をした場合に更新します(キャッシュの照合に使用).
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// BuildTaskGroup class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class BuildTaskGroup
+{
+    //=============================================================================================
+    // list of friend classes and methods.
+    //=============================================================================================
+    /* NOTHING */
+
+public:
+    //=============================================================================================
+    // public variables.
+    //=============================================================================================
+    /* NOTHING */
+
+    //=============================================================================================
+    // public methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      コンストラクタです.
+    //---------------------------------------------------------------------------------------------
+    BuildTaskGroup();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      デストラクタです.
+    //---------------------------------------------------------------------------------------------
+    ~BuildTaskGroup();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タスクを実行します.
+    //!
+    //! @param [in]     count       タスクが処理する形状数です.
+    //! @param [in]     task        実行するタスクです.
+    //! @note       形状数が十分に多く, 空きスレッドがある場合のみ別スレッドで実行します.
+    //!             それ以外の場合は呼び出し元のスレッドで即座に実行します.
+    //---------------------------------------------------------------------------------------------
+    void Run( size_t count, const std::function<void()>& task );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      実行中のタスクの完了を待機します.
+    //---------------------------------------------------------------------------------------------
+    void Wait();
+
+private:
+    //=============================================================================================
+    // private variables.
+    //=============================================================================================
+    std::vector<std::thread>    m_Threads;      //!< 実行中のスレッドです.
+
+    //=============================================================================================
+    // private methods.
+    //=============================================================================================
+    BuildTaskGroup  ( const BuildTaskGroup& ) = delete;     // アクセス禁止.
+    void operator = ( const BuildTaskGroup& ) = delete;     // アクセス禁止.
+};
+
+//-------------------------------------------------------------------------------------------------
+//! @brief      マージしたバウンディングボックスを生成します.
+//-------------------------------------------------------------------------------------------------
+BoundingBox CreateMergedBox( size_t count, IShape** ppShapes );
+
+//-------------------------------------------------------------------------------------------------
+//! @brief      中心座標をもとにバウンディングボックスを生成します.
+//-------------------------------------------------------------------------------------------------
+BoundingBox CreateCentroidBox( size_t count, IShape** ppShapes );
+
+//-------------------------------------------------------------------------------------------------
+//! @brief      SAH分割します.
+//!
+//! @param [in]     count       形状数です.
+//! @param [in]     ppShapes    形状配列です. 分割位置の前後に並び替えられます.
+//! @param [out]    mid         分割位置です.
+//! @retval true    分割に成功しました.
+//! @retval false   分割するよりも葉とした方がコストが低いか, 分割できませんでした.
+//! @note       3軸すべてについてビン分割を行い, 最小コストとなる軸と位置を選択します.
+//-------------------------------------------------------------------------------------------------
+bool SplitSAH( size_t count, IShape** ppShapes, size_t& mid );
+
+//-------------------------------------------------------------------------------------------------
+//! @brief      中間分割します.
+//!
+//! @param [in]     count       形状数です.
+//! @param [in]     ppShapes    形状配列です. 分割位置の前後に並び替えられます.
+//! @param [out]    mid         分割位置です.
+//! @retval true    分割に成功しました.
+//! @retval false   分割できませんでした.
+//-------------------------------------------------------------------------------------------------
+bool SplitMid( size_t count, IShape** ppShapes, size_t& mid );
+
+} // namespace s3d
@@ -21,7 +21,14 @@ struct ICamera
     //---------------------------------------------------------------------------------------------
     //! @brief      レイを取得します.
     //---------------------------------------------------------------------------------------------
-    virtual Ray GetRay( const f32 x, const f32 y ) = 0;
+    virtual Ray GetRay( const f32 x, const f32 y, Random& random ) = 0;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      1ピクセルあたりのレイの広がり角を取得します.
+    //!
+    //! @param [in]     pixelHeight     GetRay() に渡すスクリーン座標での1ピクセルの縦幅です.
+    //---------------------------------------------------------------------------------------------
+    virtual f32 GetSpreadAngle( const f32 pixelHeight ) const = 0;
 };
 
 
@@ -92,13 +99,19 @@ public:
     //---------------------------------------------------------------------------------------------
     //! @brief      スクリーンまでへのレイを取得します.
     //---------------------------------------------------------------------------------------------
-    Ray GetRay( const f32 x, const f32 y ) override
+    Ray GetRay( const f32 x, const f32 y, Random& ) override
     {
         Vector3 pos = ( m_CX * x ) + ( m_CY * y ) + m_CZ;
         Vector3 dir = Vector3::UnitVector( pos - m_Position );
         return MakeRay( m_Position, dir );
     }
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      1ピクセルあたりのレイの広がり角を取得します.
+    //---------------------------------------------------------------------------------------------
+    f32 GetSpreadAngle( const f32 pixelHeight ) const override
+    { return atanf( m_Fov * pixelHeight / m_NearClip ); }
+
 protected:
     //=============================================================================================
     // protected variables.
@@ -204,7 +217,7 @@ public:
     //---------------------------------------------------------------------------------------------
     //! @brief      スクリーンまでへのレイを取得します.
     //---------------------------------------------------------------------------------------------
-    Ray GetRay( const f32 x, const f32 y ) override
+    Ray GetRay( const f32 x, const f32 y, Random& random ) override
     {
         Vector3 pos = ( m_CX * x ) + ( m_CY * y ) + m_CZ;
         Vector3 dir = Vector3::UnitVector( pos - m_Position );
@@ -212,7 +225,7 @@ public:
 
         if ( m_LensRadius > 0.0f )
         {
-            auto diff = Vector3( SampleLens(), 0.0f );
+            auto diff = Vector3( SampleLens( random ), 0.0f );
 
             auto hitDist  = m_FocalDistance / fabs(dir.z);
             auto focusPos = m_Position + dir * hitDist;
@@ -224,6 +237,12 @@ public:
         return ray;
     }
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      1ピクセルあたりのレイの広がり角を取得します.
+    //---------------------------------------------------------------------------------------------
+    f32 GetSpreadAngle( const f32 pixelHeight ) const override
+    { return atanf( m_Fov * pixelHeight / m_NearClip ); }
+
 protected:
     //=============================================================================================
     // protected variables.
@@ -252,17 +271,16 @@ private:
     Vector3 m_CY;           //!< スクリーンY方向を構成するベクトルです.
     Vector3 m_CZ;           //!< カメラ位置とスクリーン中心を結ぶベクトルです.
 
-    Random  m_Random;
     f32     m_LensRadius;       //!< レンズ半径.
     f32     m_FocalDistance;    //!< 焦点距離.
 
     //=============================================================================================
     // private methods.
     //=============================================================================================
-    Vector2 SampleLens()
+    Vector2 SampleLens( Random& random )
     {
-        auto theta = F_2PI * m_Random.GetAsF32();
-        auto r = m_LensRadius * SafeSqrt(m_Random.GetAsF32());
+        auto theta = F_2PI * random.GetAsF32();
+        auto r = m_LensRadius * SafeSqrt(random.GetAsF32());
         return Vector2( r * cosf(theta), r * sinf(theta) );
     }
 };
@@ -0,0 +1,150 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_checkpoint.h
+// Desc : Render Checkpoint Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_math.h>
+#include <s3d_scheduler.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Checkpoint class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class Checkpoint
+{
+    //=============================================================================================
+    // list of friend classes and methods.
+    //=============================================================================================
+    /* NOTHING */
+
+public:
+    //=============================================================================================
+    // public variables.
+    //=============================================================================================
+    /* NOTHING */
+
+    //=============================================================================================
+    // public methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      コンストラクタです.
+    //---------------------------------------------------------------------------------------------
+    Checkpoint();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      デストラクタです.
+    //---------------------------------------------------------------------------------------------
+    ~Checkpoint();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      初期化処理を行います.
+    //!
+    //! @param [in]     width           レンダーターゲットの横幅です.
+    //! @param [in]     height          レンダーターゲットの縦幅です.
+    //! @param [in]     tileSize        タイルの縦横サイズです.
+    //! @param [in]     tileSampleCount 1パスあたりの1ピクセルのサンプリング数です.
+    //! @param [in]     subSampleCount  1ピクセルあたりのサブサンプリング数です.
+    //! @param [in]     contentHash     シーンと積分器の設定のハッシュ値です. 読み込み時に一致しない場合は再開しません.
+    //---------------------------------------------------------------------------------------------
+    bool Init( s32 width, s32 height, s32 tileSize, s32 tileSampleCount, s32 subSampleCount, u64 contentHash );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      終了処理を行います. 保存中の場合は完了を待ちます.
+    //---------------------------------------------------------------------------------------------
+    void Term();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイルの1パス分の累積結果を反映します.
+    //!
+    //! @param [in]     tile            反映するタイルです.
+    //! @param [in]     tileIndex       タイル番号です.
+    //! @param [in]     pass            処理済みのパス数です.
+    //! @param [in]     pAccum          累積バッファです.
+    //! @param [in]     pMoment         輝度の2乗の総和です.
+    //---------------------------------------------------------------------------------------------
+    void Commit( const Tile& tile, u32 tileIndex, s32 pass, const Color4* pAccum, const f32* pMoment );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      反映済みの状態を複製し, 別スレッドでファイルに保存します.
+    //!
+    //! @param [in]     filename        ファイル名です.
+    //! @note       前回の保存が終わっていない場合は完了を待ちます.
+    //---------------------------------------------------------------------------------------------
+    void SaveAsync( const char* filename );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      保存の完了を待ちます.
+    //!
+    //! @retval true    保存に成功したか, 保存中のものがありません.
+    //! @retval false   保存に失敗しました.
+    //---------------------------------------------------------------------------------------------
+    bool Wait();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      ファイルから読み込みます.
+    //!
+    //! @param [in]     filename        ファイル名です.
+    //! @param [out]    pAccum          累積バッファの格納先です.
+    //! @param [out]    pMoment         輝度の2乗の総和の格納先です.
+    //---------------------------------------------------------------------------------------------
+    bool Load( const char* filename, Color4* pAccum, f32* pMoment );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイルごとの処理済みパス数を取得します.
+    //---------------------------------------------------------------------------------------------
+    const s32* GetPasses() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイル数を取得します.
+    //---------------------------------------------------------------------------------------------
+    u32 GetTileCount() const;
+
+private:
+    //=============================================================================================
+    // private variables.
+    //=============================================================================================
+    s32                 m_Width;            //!< 横幅です.
+    s32                 m_Height;           //!< 縦幅です.
+    s32                 m_TileSize;         //!< タイルの縦横サイズです.
+    s32                 m_TileSampleCount;  //!< 1パスあたりのサンプリング数です.
+    s32                 m_SubSampleCount;   //!< サブサンプリング数です.
+    u32                 m_TileCount;        //!< タイル数です.
+    u64                 m_ContentHash;      //!< シーンと積分器の設定のハッシュ値です.
+    std::mutex          m_Mutex;            //!< 反映済みの状態の排他制御用ミューテックスです.
+    Color4*             m_pAccum;           //!< 反映済みの累積バッファです.
+    f32*                m_pMoment;          //!< 反映済みの輝度の2乗の総和です.
+    std::vector<s32>    m_Passes;           //!< 反映済みのタイルごとのパス数です.
+    Color4*             m_pWriteAccum;      //!< 保存用に複製した累積バッファです.
+    f32*                m_pWriteMoment;     //!< 保存用に複製した輝度の2乗の総和です.
+    std::vector<s32>    m_WritePasses;      //!< 保存用に複製したパス数です.
+    std::string         m_WriteFile;        //!< 保存先のファイル名です.
+    std::thread         m_Writer;           //!< 保存用スレッドです.
+    std::atomic<bool>   m_WriteResult;      //!< 保存に成功したかどうかです.
+
+    //=============================================================================================
+    // private methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      複製した状態をファイルに書き出します.
+    //---------------------------------------------------------------------------------------------
+    bool Write() const;
+
+    Checkpoint      ( const Checkpoint& ) = delete;     // アクセス禁止.
+    void operator = ( const Checkpoint& ) = delete;     // アクセス禁止.
+};
+
+} // namespace s3d
@@ -11,6 +11,7 @@
 #include <s3d_typedef.h>
 #include <s3d_math.h>
 #include <s3d_texture.h>
+#include <vector>
 
 namespace s3d {
 
@@ -60,6 +61,30 @@ public:
     //---------------------------------------------------------------------------------------
     Color4 Sample( const Vector3& dir, const TEXTURE_FILTER_MODE filter );
 
+    //---------------------------------------------------------------------------------------
+    //! @brief      複数方向をまとめてフェッチします.
+    //!
+    //! @param [in]     pDirs       方向ベクトルの配列です.
+    //! @param [in]     count       方向ベクトルの数です.
+    //! @param [in]     filter      フィルタモードです.
+    //! @param [out]    pResults    フェッチ結果を格納する配列です(count 個).
+    //---------------------------------------------------------------------------------------
+    void SampleBatch( const Vector3* pDirs, u32 count, const TEXTURE_FILTER_MODE filter, Color4* pResults ) const;
+
+    //---------------------------------------------------------------------------------------
+    //! @brief      輝度に比例した確率で方向をサンプリングします.
+    //!
+    //! @param [in]     random      [0, 1) の一様乱数です.
+    //! @param [out]    pdf         立体角あたりの確率密度です. 選べなかった場合は0になります.
+    //! @return     ワールド空間での方向ベクトルを返却します.
+    //---------------------------------------------------------------------------------------
+    Vector3 SampleDir( const Vector2& random, f32& pdf ) const;
+
+    //---------------------------------------------------------------------------------------
+    //! @brief      SampleDir() で指定方向が選ばれる立体角あたりの確率密度を求めます.
+    //---------------------------------------------------------------------------------------
+    f32 GetPdf( const Vector3& dir ) const;
+
 protected:
     //=======================================================================================
     // protected variables.
@@ -81,6 +106,15 @@ private:
     f32         m_Exposure;     //!< 露光値です.
     f32*        m_pPixels;      //!< ピクセルデータ.
 
+    std::vector<f32>    m_Func;             //!< 輝度に sinθ を乗じた区分定数分布です(行優先).
+    std::vector<f32>    m_ConditionalCdf;   //!< 行ごとの条件付き累積分布です((横幅 + 1) x 縦幅).
+    std::vector<f32>    m_RowIntegral;      //!< 行ごとの分布の平均値です.
+    std::vector<f32>    m_MarginalCdf;      //!< 行を選ぶ周辺累積分布です(縦幅 + 1).
+    f32                 m_Integral;         //!< 分布全体の平均値です.
+
+    s32         m_OctSize;      //!< 八面体マップの1辺のテクセル数です.
+    f32*        m_pOctPixels;   //!< 八面体マップに再投影したピクセルデータです.
+
     //=======================================================================================
     // privvate methods.
     //=======================================================================================
@@ -90,6 +124,33 @@ private:
     //---------------------------------------------------------------------------------------
     Color4      GetPixel( s32 x, s32 y ) const;
 
+    //---------------------------------------------------------------------------------------
+    //! @brief      方向ベクトルをテクスチャ座標に変換します.
+    //---------------------------------------------------------------------------------------
+    Vector2     ToTexCoord( const Vector3& dir ) const;
+
+    //---------------------------------------------------------------------------------------
+    //! @brief      重点的サンプリング用の輝度分布を構築します.
+    //---------------------------------------------------------------------------------------
+    void        BuildDistribution();
+
+    //---------------------------------------------------------------------------------------
+    //! @brief      緯度経度マップを八面体マップに再投影します.
+    //---------------------------------------------------------------------------------------
+    void        BuildOctahedralMap();
+
+    //---------------------------------------------------------------------------------------
+    //! @brief      八面体マップの指定されたピクセルを取得します.
+    //!
+    //! @note       範囲外の座標は1テクセルまで八面体の折り返しを適用します.
+    //---------------------------------------------------------------------------------------
+    Color4      GetOctPixel( s32 x, s32 y ) const;
+
+    //---------------------------------------------------------------------------------------
+    //! @brief      八面体マップをサンプリングします.
+    //---------------------------------------------------------------------------------------
+    Color4      SampleOctahedral( f32 u, f32 v, const TEXTURE_FILTER_MODE filter ) const;
+
     //---------------------------------------------------------------------------------------
     //! @brief      最近傍フィルタを適用してサンプリングします.
     //---------------------------------------------------------------------------------------
@@ -0,0 +1,83 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_mappedfile.h
+// Desc : Memory Mapped File Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_typedef.h>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// MappedFile class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class MappedFile
+{
+    //=============================================================================================
+    // list of friend classes and methods.
+    //=============================================================================================
+    /* NOTHING */
+
+public:
+    //=============================================================================================
+    // public variables.
+    //=============================================================================================
+    /* NOTHING */
+
+    //=============================================================================================
+    // public methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      コンストラクタです.
+    //---------------------------------------------------------------------------------------------
+    MappedFile();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      デストラクタです.
+    //---------------------------------------------------------------------------------------------
+    ~MappedFile();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      ファイルを読み取り専用でメモリにマップします.
+    //! @note       ファイルが存在しない場合もあるため, ログ出力は呼び出し側で行います.
+    //---------------------------------------------------------------------------------------------
+    bool Open( const char* filename );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      マップを解除してファイルを閉じます.
+    //---------------------------------------------------------------------------------------------
+    void Close();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      マップされた先頭アドレスを取得します.
+    //---------------------------------------------------------------------------------------------
+    const u8* GetData() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      ファイルサイズを取得します.
+    //---------------------------------------------------------------------------------------------
+    u64 GetSize() const;
+
+private:
+    //=============================================================================================
+    // private variables.
+    //=============================================================================================
+    void*       m_hFile;        //!< ファイルハンドルです.
+    void*       m_hMapping;     //!< ファイルマッピングハンドルです.
+    const u8*   m_pData;        //!< マップされた先頭アドレスです.
+    u64         m_Size;         //!< ファイルサイズです.
+
+    //=============================================================================================
+    // private methods.
+    //=============================================================================================
+    MappedFile      ( const MappedFile& ) = delete;     // アクセス禁止.
+    void operator = ( const MappedFile& ) = delete;     // アクセス禁止.
+};
+
+} // namespace s3d
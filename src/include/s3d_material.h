@@ -15,6 +15,20 @@
 
 namespace s3d {
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// MATERIAL_TYPE enum
+///////////////////////////////////////////////////////////////////////////////////////////////////
+enum MATERIAL_TYPE
+{
+    MATERIAL_TYPE_LAMBERT = 0,      //!< Lambert です.
+    MATERIAL_TYPE_PHONG,            //!< Phong です.
+    MATERIAL_TYPE_PLASTIC,          //!< Plastic です.
+    MATERIAL_TYPE_MIRROR,           //!< Mirror です.
+    MATERIAL_TYPE_GLASS,            //!< Glass です.
+    MATERIAL_TYPE_TEXTURED,         //!< TexturedMaterial です.
+    MATERIAL_TYPE_COUNT,            //!< 種類数です.
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // ShadingArg structure
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -24,6 +38,8 @@ struct ShadingArg
     Vector3     output;         //!< 出射方向.
     Vector3     normal;         //!< 法線ベクトル.
     Vector2     texcoord;       //!< テクスチャ座標.
+    f32         footprint;      //!< 1ピクセルがテクスチャ座標上で覆う幅.
+    f32         pdf;            //!< 出射方向が選ばれた立体角あたりの確率密度(デルタ関数の場合は0).
     Random      random;         //!< 乱数.
     bool        dice;           //!< 打ち切りかどうか?
 };
@@ -36,8 +52,10 @@ struct IMaterial : IReference
 {
     virtual ~IMaterial() {}
     virtual Color4  Shade      ( ShadingArg& ) const = 0;
+    virtual Color4  Evaluate   ( const ShadingArg&, const Vector3& dir, f32& pdf ) const = 0;
     virtual Color4  GetEmissive() const = 0;
     virtual bool    HasDelta   () const = 0;
+    virtual MATERIAL_TYPE GetType() const = 0;
 };
 
 } // namespace s3d
@@ -43,6 +43,7 @@ typedef Vector4 Color4;
 //-------------------------------------------------------------------------------------------------
 const f32   F_HIT_MAX   = 1e12f;                                  //!< 交差判定上限値.
 const f32   F_HIT_MIN   = 1e-3f;                                  //!< 交差判定下限値.
+const u32   RAY_PACKET_SIZE = 8;                                  //!< レイパケットの最大レイ数.
 const f32   F_PI        = 3.1415926535897932384626433832795f;     //!< πです.
 const f32   F_2PI       = 6.283185307179586476925286766559f;      //!< 2πです.
 const f32   F_1DIVPI    = 0.31830988618379067153776752674503f;    //!< 1/πです.
@@ -149,6 +150,19 @@ f64 SafeSqrt( const f64 value )
     return 0.0;
 }
 
+//-------------------------------------------------------------------------------------------------
+//! @brief      安全に逆数を求めます. ゼロ近傍は符号を保ったまま十分小さな値に置き換えます.
+//-------------------------------------------------------------------------------------------------
+S3D_INLINE
+f32 SafeInverse( const f32 value )
+{
+    const f32 eps = 1e-20f;
+    if ( fabsf( value ) < eps )
+    { return ( value < 0.0f ) ? -1.0f / eps : 1.0f / eps; }
+
+    return 1.0f / value;
+}
+
 //-------------------------------------------------------------------------------------------------
 //! @brief      入力のうち下位16ビットを1つのビットごとに分離します
 //-------------------------------------------------------------------------------------------------
@@ -220,6 +234,18 @@ u32 Morton3( u32 x, u32 y, u32 z )
          + ( Part1By2( x ) << 0 );
 }
 
+//-------------------------------------------------------------------------------------------------
+//! @brief      PCGハッシュを求めます.
+//-------------------------------------------------------------------------------------------------
+S3D_INLINE
+u32 PcgHash( u32 value )
+{
+    /* Jarzynski and Olano, "Hash Functions for GPU Rendering", JCGT 2020 参照 */
+    auto state = value * 747796405u + 2891336453u;
+    auto word  = ( ( state >> ( ( state >> 28u ) + 4u ) ) ^ state ) * 277803737u;
+    return ( word >> 22u ) ^ word;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // Vector2 structure
@@ -1494,17 +1520,17 @@ struct Ray
 ////////////////////////////////////////////////////////////////////////////////////////////
 struct Ray4
 {
-    b128    pos[3];     //!< 位置座標です.
-    b128    dir[3];     //!< 方向ベクトルの逆数です.
+    b128    invDir   [3];   //!< 方向ベクトルの逆数です.
+    b128    posInvDir[3];   //!< 位置座標に方向ベクトルの逆数を掛けたものです.
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-// Ray4 structure
+// Ray8 structure
 ////////////////////////////////////////////////////////////////////////////////////////////
 struct Ray8
 {
-    b256    pos[3];     //!< 位置座標です.
-    b256    dir[3];     //!< 方向ベクトルの逆数です.
+    b256    invDir   [3];   //!< 方向ベクトルの逆数です.
+    b256    posInvDir[3];   //!< 位置座標に方向ベクトルの逆数を掛けたものです.
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1513,10 +1539,36 @@ struct Ray8
 struct RaySet
 {
     Ray     ray;
-    Ray4    ray4;
-    Ray8    ray8;
+    Vector3 invDir;         //!< 方向ベクトルの逆数です.
+    Vector3 posInvDir;      //!< 位置座標に方向ベクトルの逆数を掛けたものです.
 };
 
+//-------------------------------------------------------------------------------------------------
+//      a * b - c を求めます.
+//-------------------------------------------------------------------------------------------------
+S3D_INLINE
+b128 MulSub( const b128& a, const b128& b, const b128& c )
+{
+#if defined(__AVX2__) // AVX2 対応CPUは FMA3 も持つ.
+    return _mm_fmsub_ps( a, b, c );
+#else
+    return _mm_sub_ps( _mm_mul_ps( a, b ), c );
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------
+//      a * b - c を求めます.
+//-------------------------------------------------------------------------------------------------
+S3D_INLINE
+b256 MulSub( const b256& a, const b256& b, const b256& c )
+{
+#if defined(__AVX2__) // AVX2 対応CPUは FMA3 も持つ.
+    return _mm256_fmsub_ps( a, b, c );
+#else
+    return _mm256_sub_ps( _mm256_mul_ps( a, b ), c );
+#endif
+}
+
 //-------------------------------------------------------------------------------------------------
 //      レイを生成します.
 //-------------------------------------------------------------------------------------------------
@@ -1535,14 +1587,18 @@ Ray MakeRay(const Vector3& position, const Vector3& direction)
 S3D_INLINE
 Ray4 MakeRay4(const Vector3& position, const Vector3& direction)
 {
+    const auto invX = SafeInverse( direction.x );
+    const auto invY = SafeInverse( direction.y );
+    const auto invZ = SafeInverse( direction.z );
+
     Ray4 result = {};
-    result.pos[0] = _mm_set1_ps( position.x );
-    result.pos[1] = _mm_set1_ps( position.y );
-    result.pos[2] = _mm_set1_ps( position.z );
+    result.invDir[0] = _mm_set1_ps( invX );
+    result.invDir[1] = _mm_set1_ps( invY );
+    result.invDir[2] = _mm_set1_ps( invZ );
 
-    result.dir[0] = _mm_set1_ps( direction.x );
-    result.dir[1] = _mm_set1_ps( direction.y );
-    result.dir[2] = _mm_set1_ps( direction.z );
+    result.posInvDir[0] = _mm_set1_ps( position.x * invX );
+    result.posInvDir[1] = _mm_set1_ps( position.y * invY );
+    result.posInvDir[2] = _mm_set1_ps( position.z * invZ );
 
     return result;
 }
@@ -1553,14 +1609,19 @@ Ray4 MakeRay4(const Vector3& position, const Vector3& direction)
 S3D_INLINE
 Ray8 MakeRay8(const Vector3& position, const Vector3& direction)
 {
+    const auto invX = SafeInverse( direction.x );
+    const auto invY = SafeInverse( direction.y );
+    const auto invZ = SafeInverse( direction.z );
+
     Ray8 result = {};
-    result.pos[0] = _mm256_set1_ps( position.x );
-    result.pos[1] = _mm256_set1_ps( position.y );
-    result.pos[2] = _mm256_set1_ps( position.z );
+    result.invDir[0] = _mm256_set1_ps( invX );
+    result.invDir[1] = _mm256_set1_ps( invY );
+    result.invDir[2] = _mm256_set1_ps( invZ );
+
+    result.posInvDir[0] = _mm256_set1_ps( position.x * invX );
+    result.posInvDir[1] = _mm256_set1_ps( position.y * invY );
+    result.posInvDir[2] = _mm256_set1_ps( position.z * invZ );
 
-    result.dir[0] = _mm256_set1_ps( direction.x );
-    result.dir[1] = _mm256_set1_ps( direction.y );
-    result.dir[2] = _mm256_set1_ps( direction.z );
     return result;
 }
 
@@ -1574,21 +1635,102 @@ RaySet MakeRaySet(const Vector3& position, const Vector3& direction)
     result.ray.pos = position;
     result.ray.dir = direction;
 
-    result.ray4.pos[0] = _mm_set1_ps( position.x );
-    result.ray4.pos[1] = _mm_set1_ps( position.y );
-    result.ray4.pos[2] = _mm_set1_ps( position.z );
+    // 除算はここで1度だけ行い, スラブ判定は乗算のみにする.
+    result.invDir = Vector3(
+        SafeInverse( direction.x ),
+        SafeInverse( direction.y ),
+        SafeInverse( direction.z ) );
 
-    result.ray4.dir[0] = _mm_set1_ps( direction.x );
-    result.ray4.dir[1] = _mm_set1_ps( direction.y );
-    result.ray4.dir[2] = _mm_set1_ps( direction.z );
+    result.posInvDir = Vector3(
+        position.x * result.invDir.x,
+        position.y * result.invDir.y,
+        position.z * result.invDir.z );
 
-    result.ray8.pos[0] = _mm256_set1_ps( position.x );
-    result.ray8.pos[1] = _mm256_set1_ps( position.y );
-    result.ray8.pos[2] = _mm256_set1_ps( position.z );
+    // SIMD用のブロードキャストは使用するBVHの幅に合わせて MakeRay4() / MakeRay8() で行う.
+    return result;
+}
 
-    result.ray8.dir[0] = _mm256_set1_ps( direction.x );
-    result.ray8.dir[1] = _mm256_set1_ps( direction.y );
-    result.ray8.dir[2] = _mm256_set1_ps( direction.z );
+//-------------------------------------------------------------------------------------------------
+//      レイセットから4つにパッキングされたレイを生成します.
+//-------------------------------------------------------------------------------------------------
+S3D_INLINE
+Ray4 MakeRay4(const RaySet& raySet)
+{
+    Ray4 result;
+    result.invDir[0] = _mm_set1_ps( raySet.invDir.x );
+    result.invDir[1] = _mm_set1_ps( raySet.invDir.y );
+    result.invDir[2] = _mm_set1_ps( raySet.invDir.z );
+
+    result.posInvDir[0] = _mm_set1_ps( raySet.posInvDir.x );
+    result.posInvDir[1] = _mm_set1_ps( raySet.posInvDir.y );
+    result.posInvDir[2] = _mm_set1_ps( raySet.posInvDir.z );
+
+    return result;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      レイセットから8つにパッキングされたレイを生成します.
+//-------------------------------------------------------------------------------------------------
+S3D_INLINE
+Ray8 MakeRay8(const RaySet& raySet)
+{
+    Ray8 result;
+    result.invDir[0] = _mm256_set1_ps( raySet.invDir.x );
+    result.invDir[1] = _mm256_set1_ps( raySet.invDir.y );
+    result.invDir[2] = _mm256_set1_ps( raySet.invDir.z );
+
+    result.posInvDir[0] = _mm256_set1_ps( raySet.posInvDir.x );
+    result.posInvDir[1] = _mm256_set1_ps( raySet.posInvDir.y );
+    result.posInvDir[2] = _mm256_set1_ps( raySet.posInvDir.z );
+
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// RayPacket structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct RayPacket
+{
+    RaySet  rays[RAY_PACKET_SIZE];  //!< 各レイです.
+    u32     count;                  //!< 有効なレイ数です.
+    bool    coherent;               //!< 方向ベクトルの符号が軸ごとに全レイで揃っているかどうか.
+    s32     sign[3];                //!< 軸ごとのレイが入射する面です(0:最小値, 1:最大値).
+    Vector3 minPos;                 //!< 位置座標の最小値です.
+    Vector3 maxPos;                 //!< 位置座標の最大値です.
+    Vector3 minInvDir;              //!< 方向ベクトルの逆数の最小値です.
+    Vector3 maxInvDir;              //!< 方向ベクトルの逆数の最大値です.
+};
+
+//-------------------------------------------------------------------------------------------------
+//      レイパケットを生成します.
+//-------------------------------------------------------------------------------------------------
+S3D_INLINE
+RayPacket MakeRayPacket(const RaySet* pRays, u32 count)
+{
+    assert( count > 0 && count <= RAY_PACKET_SIZE );
+
+    RayPacket result;
+    result.count     = count;
+    result.minPos    = result.maxPos    = pRays[0].ray.pos;
+    result.minInvDir = result.maxInvDir = pRays[0].invDir;
+
+    for( auto i=0u; i<count; ++i )
+    {
+        result.rays[i] = pRays[i];
+
+        result.minPos    = Vector3::Min( result.minPos,    pRays[i].ray.pos );
+        result.maxPos    = Vector3::Max( result.maxPos,    pRays[i].ray.pos );
+        result.minInvDir = Vector3::Min( result.minInvDir, pRays[i].invDir );
+        result.maxInvDir = Vector3::Max( result.maxInvDir, pRays[i].invDir );
+    }
+
+    // 符号が混在すると区間演算で範囲を絞れないため, レイごとの判定のみ行う.
+    result.coherent = true;
+    for( auto i=0; i<3; ++i )
+    {
+        result.sign[i]   = ( result.maxInvDir.a[i] < 0.0f ) ? 1 : 0;
+        result.coherent &= ( result.minInvDir.a[i] >= 0.0f ) || ( result.maxInvDir.a[i] < 0.0f );
+    }
 
     return result;
 }
@@ -2272,6 +2414,36 @@ public:
         return true;
     }
 
+    //-------------------------------------------------------------------------------
+    //! @brief      逆数を用いて交差判定を行います.
+    //-------------------------------------------------------------------------------
+    S3D_INLINE
+    bool IsHit( const RaySet& raySet ) const
+    {
+        if ( empty )
+        { return false; }
+
+        const Vector3* v[ 2 ] = { &mini, &maxi };
+        auto tmin = 0.0f;
+        auto tmax = F_HIT_MAX;
+
+        for( auto i=0; i<3; ++i )
+        {
+            auto t0 = v[0]->a[i] * raySet.invDir.a[i] - raySet.posInvDir.a[i];
+            auto t1 = v[1]->a[i] * raySet.invDir.a[i] - raySet.posInvDir.a[i];
+
+            auto n = s3d::Min( t0, t1 );
+            auto f = s3d::Max( t0, t1 );
+
+            tmin = s3d::Max( tmin, n );
+            tmax = s3d::Min( tmax, f );
+
+            if ( tmin > tmax ) 
+            { return false; }
+        }
+
+        return true;
+    }
 
     //-------------------------------------------------------------------------------
     //! @brief      2つのバウンディングボックスをマージします.
@@ -2410,12 +2582,22 @@ public:
     S3D_INLINE
     bool IsHit( const Ray4& ray, s32& mask ) const
     {
-        auto tmin = _mm_set1_ps( -F_HIT_MAX );
-        auto tmax = _mm_set1_ps(  F_HIT_MAX );
+        b128 tnear;
+        return IsHit( ray, F_HIT_MAX, mask, tnear );
+    }
+
+    //--------------------------------------------------------------------------------
+    //! @brief      交差判定を行い, 各ボックスへの入射距離を求めます.
+    //--------------------------------------------------------------------------------
+    S3D_INLINE
+    bool IsHit( const Ray4& ray, const f32 distance, s32& mask, b128& tnear ) const
+    {
+        auto tmin = _mm_setzero_ps();
+        auto tmax = _mm_set1_ps( distance );
 
         //-- x
-        auto t0 = _mm_div_ps( _mm_sub_ps( value[ 0 ][ 0 ], ray.pos[ 0 ] ), ray.dir[ 0 ] );
-        auto t1 = _mm_div_ps( _mm_sub_ps( value[ 1 ][ 0 ], ray.pos[ 0 ] ), ray.dir[ 0 ] );
+        auto t0 = MulSub( value[ 0 ][ 0 ], ray.invDir[ 0 ], ray.posInvDir[ 0 ] );
+        auto t1 = MulSub( value[ 1 ][ 0 ], ray.invDir[ 0 ], ray.posInvDir[ 0 ] );
 
         auto n = _mm_min_ps( t0, t1 );
         auto f = _mm_max_ps( t0, t1 );
@@ -2424,8 +2606,8 @@ public:
         tmax = _mm_min_ps( tmax, f );
 
         //-- y
-        t0 = _mm_div_ps( _mm_sub_ps( value[ 0 ][ 1 ], ray.pos[ 1 ] ), ray.dir[ 1 ] );
-        t1 = _mm_div_ps( _mm_sub_ps( value[ 1 ][ 1 ], ray.pos[ 1 ] ), ray.dir[ 1 ] );
+        t0 = MulSub( value[ 0 ][ 1 ], ray.invDir[ 1 ], ray.posInvDir[ 1 ] );
+        t1 = MulSub( value[ 1 ][ 1 ], ray.invDir[ 1 ], ray.posInvDir[ 1 ] );
 
         n = _mm_min_ps( t0, t1 );
         f = _mm_max_ps( t0, t1 );
@@ -2434,8 +2616,8 @@ public:
         tmax = _mm_min_ps( tmax, f );
 
         //-- z
-        t0 = _mm_div_ps( _mm_sub_ps( value[ 0 ][ 2 ], ray.pos[ 2 ] ), ray.dir[ 2 ] );
-        t1 = _mm_div_ps( _mm_sub_ps( value[ 1 ][ 2 ], ray.pos[ 2 ] ), ray.dir[ 2 ] );
+        t0 = MulSub( value[ 0 ][ 2 ], ray.invDir[ 2 ], ray.posInvDir[ 2 ] );
+        t1 = MulSub( value[ 1 ][ 2 ], ray.invDir[ 2 ], ray.posInvDir[ 2 ] );
 
         n = _mm_min_ps( t0, t1 );
         f = _mm_max_ps( t0, t1 );
@@ -2443,6 +2625,50 @@ public:
         tmin = _mm_max_ps( tmin, n );
         tmax = _mm_min_ps( tmax, f );
 
+        tnear = tmin;
+        mask  = _mm_movemask_ps( _mm_cmpge_ps( tmax, tmin ) );
+        return ( mask > 0 );
+    }
+
+    //--------------------------------------------------------------------------------
+    //! @brief      レイパケット全体との交差判定を区間演算で保守的に行います.
+    //!
+    //! @note       mask のビットが立っていないボックスにはパケット内のどのレイも交差しません.
+    //!             方向ベクトルの符号が揃ったパケット(RayPacket::coherent)にのみ使用できます.
+    //--------------------------------------------------------------------------------
+    S3D_INLINE
+    bool IsHit( const RayPacket& packet, const f32 distance, s32& mask ) const
+    {
+        auto tmin = _mm_setzero_ps();
+        auto tmax = _mm_set1_ps( distance );
+
+        for( auto i=0; i<3; ++i )
+        {
+            const auto& near = value[ packet.sign[i] ][ i ];
+            const auto& far  = value[ 1 - packet.sign[i] ][ i ];
+
+            auto minPos    = _mm_set1_ps( packet.minPos.a[i] );
+            auto maxPos    = _mm_set1_ps( packet.maxPos.a[i] );
+            auto minInvDir = _mm_set1_ps( packet.minInvDir.a[i] );
+            auto maxInvDir = _mm_set1_ps( packet.maxInvDir.a[i] );
+
+            // 入射距離の下限と出射距離の上限を求める.
+            auto n0 = _mm_sub_ps( near, maxPos );
+            auto n1 = _mm_sub_ps( near, minPos );
+            auto f0 = _mm_sub_ps( far,  maxPos );
+            auto f1 = _mm_sub_ps( far,  minPos );
+
+            auto n = _mm_min_ps(
+                _mm_min_ps( _mm_mul_ps( n0, minInvDir ), _mm_mul_ps( n0, maxInvDir ) ),
+                _mm_min_ps( _mm_mul_ps( n1, minInvDir ), _mm_mul_ps( n1, maxInvDir ) ) );
+            auto f = _mm_max_ps(
+                _mm_max_ps( _mm_mul_ps( f0, minInvDir ), _mm_mul_ps( f0, maxInvDir ) ),
+                _mm_max_ps( _mm_mul_ps( f1, minInvDir ), _mm_mul_ps( f1, maxInvDir ) ) );
+
+            tmin = _mm_max_ps( tmin, n );
+            tmax = _mm_min_ps( tmax, f );
+        }
+
         mask = _mm_movemask_ps( _mm_cmpge_ps( tmax, tmin ) );
         return ( mask > 0 );
     }
@@ -2593,14 +2819,25 @@ public:
     //---------------------------------------------------------------------------------------------
     //! @brief      交差判定を行います.
     //---------------------------------------------------------------------------------------------
+    S3D_INLINE
     bool IsHit( const Ray8& ray, s32& mask ) const
     {
-        auto tmin = _mm256_set1_ps( -F_HIT_MAX );
-        auto tmax = _mm256_set1_ps(  F_HIT_MAX );
+        b256 tnear;
+        return IsHit( ray, F_HIT_MAX, mask, tnear );
+    }
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      交差判定を行い, 各ボックスへの入射距離を求めます.
+    //---------------------------------------------------------------------------------------------
+    S3D_INLINE
+    bool IsHit( const Ray8& ray, const f32 distance, s32& mask, b256& tnear ) const
+    {
+        auto tmin = _mm256_setzero_ps();
+        auto tmax = _mm256_set1_ps( distance );
 
         //-- x
-        auto t0 = _mm256_div_ps( _mm256_sub_ps( value[ 0 ][ 0 ], ray.pos[ 0 ] ), ray.dir[ 0 ] );
-        auto t1 = _mm256_div_ps( _mm256_sub_ps( value[ 1 ][ 0 ], ray.pos[ 0 ] ), ray.dir[ 0 ] );
+        auto t0 = MulSub( value[ 0 ][ 0 ], ray.invDir[ 0 ], ray.posInvDir[ 0 ] );
+        auto t1 = MulSub( value[ 1 ][ 0 ], ray.invDir[ 0 ], ray.posInvDir[ 0 ] );
 
         auto n = _mm256_min_ps( t0, t1 );
         auto f = _mm256_max_ps( t0, t1 );
@@ -2609,8 +2846,8 @@ public:
         tmax = _mm256_min_ps( tmax, f );
 
         //-- y
-        t0 = _mm256_div_ps( _mm256_sub_ps( value[ 0 ][ 1 ], ray.pos[ 1 ] ), ray.dir[ 1 ] );
-        t1 = _mm256_div_ps( _mm256_sub_ps( value[ 1 ][ 1 ], ray.pos[ 1 ] ), ray.dir[ 1 ] );
+        t0 = MulSub( value[ 0 ][ 1 ], ray.invDir[ 1 ], ray.posInvDir[ 1 ] );
+        t1 = MulSub( value[ 1 ][ 1 ], ray.invDir[ 1 ], ray.posInvDir[ 1 ] );
 
         n = _mm256_min_ps( t0, t1 );
         f = _mm256_max_ps( t0, t1 );
@@ -2619,8 +2856,8 @@ public:
         tmax = _mm256_min_ps( tmax, f );
 
         //-- z
-        t0 = _mm256_div_ps( _mm256_sub_ps( value[ 0 ][ 2 ], ray.pos[ 2 ] ), ray.dir[ 2 ] );
-        t1 = _mm256_div_ps( _mm256_sub_ps( value[ 1 ][ 2 ], ray.pos[ 2 ] ), ray.dir[ 2 ] );
+        t0 = MulSub( value[ 0 ][ 2 ], ray.invDir[ 2 ], ray.posInvDir[ 2 ] );
+        t1 = MulSub( value[ 1 ][ 2 ], ray.invDir[ 2 ], ray.posInvDir[ 2 ] );
 
         n = _mm256_min_ps( t0, t1 );
         f = _mm256_max_ps( t0, t1 );
@@ -2628,6 +2865,50 @@ public:
         tmin = _mm256_max_ps( tmin, n );
         tmax = _mm256_min_ps( tmax, f );
 
+        tnear = tmin;
+        mask  = _mm256_movemask_ps( _mm256_cmp_ps( tmax, tmin, _CMP_GE_OS ) );
+        return ( mask > 0 );
+    }
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      レイパケット全体との交差判定を区間演算で保守的に行います.
+    //!
+    //! @note       mask のビットが立っていないボックスにはパケット内のどのレイも交差しません.
+    //!             方向ベクトルの符号が揃ったパケット(RayPacket::coherent)にのみ使用できます.
+    //---------------------------------------------------------------------------------------------
+    S3D_INLINE
+    bool IsHit( const RayPacket& packet, const f32 distance, s32& mask ) const
+    {
+        auto tmin = _mm256_setzero_ps();
+        auto tmax = _mm256_set1_ps( distance );
+
+        for( auto i=0; i<3; ++i )
+        {
+            const auto& near = value[ packet.sign[i] ][ i ];
+            const auto& far  = value[ 1 - packet.sign[i] ][ i ];
+
+            auto minPos    = _mm256_set1_ps( packet.minPos.a[i] );
+            auto maxPos    = _mm256_set1_ps( packet.maxPos.a[i] );
+            auto minInvDir = _mm256_set1_ps( packet.minInvDir.a[i] );
+            auto maxInvDir = _mm256_set1_ps( packet.maxInvDir.a[i] );
+
+            // 入射距離の下限と出射距離の上限を求める.
+            auto n0 = _mm256_sub_ps( near, maxPos );
+            auto n1 = _mm256_sub_ps( near, minPos );
+            auto f0 = _mm256_sub_ps( far,  maxPos );
+            auto f1 = _mm256_sub_ps( far,  minPos );
+
+            auto n = _mm256_min_ps(
+                _mm256_min_ps( _mm256_mul_ps( n0, minInvDir ), _mm256_mul_ps( n0, maxInvDir ) ),
+                _mm256_min_ps( _mm256_mul_ps( n1, minInvDir ), _mm256_mul_ps( n1, maxInvDir ) ) );
+            auto f = _mm256_max_ps(
+                _mm256_max_ps( _mm256_mul_ps( f0, minInvDir ), _mm256_mul_ps( f0, maxInvDir ) ),
+                _mm256_max_ps( _mm256_mul_ps( f1, minInvDir ), _mm256_mul_ps( f1, maxInvDir ) ) );
+
+            tmin = _mm256_max_ps( tmin, n );
+            tmax = _mm256_min_ps( tmax, f );
+        }
+
         mask = _mm256_movemask_ps( _mm256_cmp_ps( tmax, tmin, _CMP_GE_OS ) );
         return ( mask > 0 );
     }
@@ -2743,6 +3024,23 @@ public:
         m_W = ( seed <= 0 ) ? 88675123 : seed;
     }
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      キーとカウンターから独立した乱数列を設定します.
+    //---------------------------------------------------------------------------------------------
+    S3D_INLINE
+    void SetSeed( const u32 key, const u32 counter )
+    {
+        // 状態をすべてハッシュで埋めて, 隣接するキー同士の相関をなくす.
+        m_X = PcgHash( key ^ PcgHash( counter ) );
+        m_Y = PcgHash( m_X + 0x9e3779b9 );
+        m_Z = PcgHash( m_Y + 0x9e3779b9 );
+        m_W = PcgHash( m_Z + 0x9e3779b9 );
+
+        // 全ビットゼロの状態は周期が 1 になるため避ける.
+        if ( m_W == 0 )
+        { m_W = 88675123; }
+    }
+
     //---------------------------------------------------------------------------------------------
     //! @brief      u32型として乱数を取得します.
     //---------------------------------------------------------------------------------------------
@@ -10,6 +10,9 @@
 //-------------------------------------------------------------------------------------------------
 #include <s3d_shape.h>
 #include <s3d_material.h>
+#include <s3d_meshtriangle.h>
+#include <s3d_smd.h>
+#include <s3d_bvh8.h>
 #include <atomic>
 #include <vector>
 
@@ -66,6 +69,16 @@ public:
     //---------------------------------------------------------------------------------------------
     bool IsHit(const RaySet&, HitRecord&) const override;
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      遮蔽判定を行います.
+    //---------------------------------------------------------------------------------------------
+    bool IsOccluded(const RaySet&, f32)  const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      レイパケットの交差判定を行います.
+    //---------------------------------------------------------------------------------------------
+    u32 IsHitPacket(const RayPacket&, u32, HitRecord*) const override;
+
     //---------------------------------------------------------------------------------------------
     //! @brief      バウンディングボックスを取得します.
     //---------------------------------------------------------------------------------------------
@@ -81,8 +94,9 @@ private:
     // private variables.
     //=============================================================================================
     std::atomic<u32>            m_Count;            //!< 参照カウントです.
-    std::vector<IShape*>        m_Triangles;        //!< 三角形です.
-    std::vector<IMaterial*>     m_Materials;        //!< マテリアルです.
+    SmdFile                     m_File;             //!< 頂点・インデックス配列を保持するファイルデータです.
+    MeshBuffer                  m_Buffer;           //!< 頂点・インデックス・マテリアルのバッファです.
+    std::vector<MeshTriangle>   m_Triangles;        //!< バッファを参照する三角形です.
     std::vector<Texture2D>      m_Textures;         //!< テクスチャです.
     TextureSampler              m_DiffuseSmp;       //!< ディフューズマップのサンプラーです.
     TextureSampler              m_SpecularSmp;      //!< スペキュラーマップのサンプラーです.
@@ -111,6 +125,47 @@ private:
     //! @brief      初期化処理を行います.
     //---------------------------------------------------------------------------------------------
     bool Init(u32 vertexCount, Vertex* pVertices, IMaterial* pMaterial);
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      マテリアルを生成します.
+    //---------------------------------------------------------------------------------------------
+    IMaterial* CreateMaterial(const SMD_MATERIAL& material);
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      バッファを参照する三角形とBVHを構築します.
+    //!
+    //! @param [in]     cacheFile       BVHキャッシュのファイル名です. nullptr の場合はキャッシュしません.
+    //---------------------------------------------------------------------------------------------
+    bool BuildBVH(const char* cacheFile);
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      キャッシュの照合に使用する位置座標とインデックスのハッシュ値を計算します.
+    //---------------------------------------------------------------------------------------------
+    u64 CalcContentHash() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      BVHキャッシュを読み込みます.
+    //!
+    //! @param [in]     filename        ファイル名です.
+    //! @param [in]     hash            照合するハッシュ値です.
+    //! @retval true    読み込みに成功.
+    //! @retval false   キャッシュが存在しないか一致しません.
+    //---------------------------------------------------------------------------------------------
+    bool LoadBVHCache(const char* filename, u64 hash);
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      BVHキャッシュを保存します.
+    //!
+    //! @param [in]     filename        ファイル名です.
+    //! @param [in]     hash            照合用のハッシュ値です.
+    //! @param [in]     shapes          葉の範囲順に並び替えられた形状配列です.
+    //! @param [in]     nodes           構築結果のノード配列です.
+    //---------------------------------------------------------------------------------------------
+    bool SaveBVHCache(
+        const char*                         filename,
+        u64                                 hash,
+        const std::vector<IShape*>&         shapes,
+        const std::vector<BVH8::CacheNode>& nodes) const;
 };
 
 
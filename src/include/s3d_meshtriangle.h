@@ -0,0 +1,145 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_meshtriangle.h
+// Desc : Indexed Mesh Triangle Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_shape.h>
+#include <vector>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// MeshBuffer structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct MeshBuffer
+{
+    const Vector3*              Positions;      //!< 位置座標です.
+    const Vector3*              Normals;        //!< 法線ベクトルです.
+    const Vector2*              TexCoords;      //!< テクスチャ座標です.
+    const u32*                  Indices;        //!< 頂点インデックスです(1面につき3つ).
+    const s32*                  MaterialIds;    //!< 面ごとのマテリアル番号です. 負の値はマテリアル無しです.
+    u32                         FaceCount;      //!< 面数です.
+    std::vector<IMaterial*>     Materials;      //!< マテリアルです.
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      コンストラクタです.
+    //! @note       配列は所有せず, 読み込み済みのファイルデータを参照します.
+    //---------------------------------------------------------------------------------------------
+    MeshBuffer()
+    : Positions  ( nullptr )
+    , Normals    ( nullptr )
+    , TexCoords  ( nullptr )
+    , Indices    ( nullptr )
+    , MaterialIds( nullptr )
+    , FaceCount  ( 0 )
+    { /* DO_NOTHING */ }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// MeshTriangle class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class MeshTriangle : public ITriangle
+{
+    //=============================================================================================
+    // list of friend classes and methods.
+    //=============================================================================================
+    /* NOTHING */
+
+public:
+    //=============================================================================================
+    // public variables.
+    //=============================================================================================
+    /* NOTHING */
+
+    //=============================================================================================
+    // public methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      コンストラクタです.
+    //! @note       メッシュが配列でまとめて確保するため, 個別の生成処理は持ちません.
+    //---------------------------------------------------------------------------------------------
+    MeshTriangle();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      デストラクタです.
+    //---------------------------------------------------------------------------------------------
+    ~MeshTriangle();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      参照するバッファと面番号を設定します.
+    //---------------------------------------------------------------------------------------------
+    void Init(const MeshBuffer* pBuffer, u32 faceIndex);
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      参照カウントを増やします.
+    //! @note       寿命はメッシュが管理するため何もしません.
+    //---------------------------------------------------------------------------------------------
+    void AddRef() override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      解放処理を行います.
+    //! @note       寿命はメッシュが管理するため何もしません.
+    //---------------------------------------------------------------------------------------------
+    void Release() override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      参照カウントを取得します.
+    //---------------------------------------------------------------------------------------------
+    u32 GetCount() const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      交差判定を行います.
+    //---------------------------------------------------------------------------------------------
+    bool IsHit(const RaySet& raySet, HitRecord& record) const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      遮蔽判定を行います.
+    //---------------------------------------------------------------------------------------------
+    bool IsOccluded(const RaySet& raySet, f32 distance) const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      バウンディングボックスを取得します.
+    //---------------------------------------------------------------------------------------------
+    BoundingBox GetBox() const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      中心座標を取得します.
+    //---------------------------------------------------------------------------------------------
+    Vector3 GetCenter() const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      頂点の位置座標を取得します.
+    //---------------------------------------------------------------------------------------------
+    Vector3 GetPosition(u32 index) const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      交差位置の重心座標から属性を補間して交差記録を設定します.
+    //---------------------------------------------------------------------------------------------
+    void SetHitRecord(const RaySet& raySet, f32 dist, f32 beta, f32 gamma, HitRecord& record) const override;
+
+private:
+    //=============================================================================================
+    // private variables.
+    //=============================================================================================
+    const MeshBuffer*   m_pBuffer;      //!< 参照するバッファです.
+    u32                 m_FaceIndex;    //!< 面番号です.
+
+    //=============================================================================================
+    // private methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      交差距離と重心座標を求めます.
+    //---------------------------------------------------------------------------------------------
+    bool Intersect(const RaySet& raySet, f32& dist, f32& beta, f32& gamma) const;
+};
+
+} // namespace s3d
@@ -46,10 +46,17 @@ public:
 
     Color4 Shade( ShadingArg& arg ) const override;
 
+    Color4 Evaluate( const ShadingArg& arg, const Vector3& dir, f32& pdf ) const override;
+
     Color4 GetEmissive() const override;
 
     bool HasDelta() const override;
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      マテリアルの種類を取得します.
+    //---------------------------------------------------------------------------------------------
+    MATERIAL_TYPE GetType() const override;
+
 private:
     //=============================================================================================
     // private variables.
@@ -67,6 +74,10 @@ private:
     Plastic(const Color4& diffuse, const Color4& specular, f32 power, const Color4& emissive);
 
     ~Plastic();
+
+    void ComputeReflectance( const ShadingArg& arg, Vector3& normalMod, f32& R, f32& P ) const;
+
+    f32 ComputePdf( const Vector3& dir, const Vector3& normalMod, const Vector3& reflect, f32 P ) const;
 };
 
 } // namespace s3d
@@ -10,6 +10,12 @@
 //-------------------------------------------------------------------------------------------------
 #include <s3d_math.h>
 #include <s3d_scene.h>
+#include <s3d_material.h>
+#include <s3d_scheduler.h>
+#include <s3d_checkpoint.h>
+#include <vector>
+#include <chrono>
+#include <atomic>
 
 namespace s3d {
 
@@ -37,6 +43,13 @@ public:
         f32     MaxRenderingMin;    //!< 最大レンダリング可能時間(分単位)です.
         f32     CaptureIntervalSec; //!< キャプチャー間隔です(秒単位).
         s32     CpuCoreCount;       //!< CPUコア数です.
+        s32     TileSize;           //!< タイルの縦横サイズです(ピクセル単位).
+        s32     TileSampleCount;    //!< タイルを1回処理する際の1ピクセルあたりのサンプリング数です.
+        bool    Wavefront;          //!< ウェーブフロント方式で経路を追跡するかどうか.
+        f32     AdaptiveThreshold;  //!< タイルを収束とみなす相対標準誤差です. 0以下の場合は適応サンプリングを行いません.
+        s32     MaxSampleCount;     //!< 適応サンプリング時に1ピクセルあたりに割り当てる最大サンプリング数です.
+        f32     CheckpointIntervalSec;  //!< チェックポイントの保存間隔です(秒単位). 0以下の場合は保存しません.
+        bool    Resume;             //!< チェックポイントから再開するかどうか.
     };
 
     //=============================================================================================
@@ -64,16 +77,61 @@ public:
     bool Run( const Config& config );
 
 private:
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    // PathState structure
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    struct PathState
+    {
+        RaySet      raySet;         //!< 追跡中のレイです.
+        Color4      W;              //!< 経路の重みです.
+        Color4      L;              //!< 経路が運ぶ放射輝度です.
+        Random      random;         //!< 乱数です.
+        f32         coneWidth;      //!< レイコーンの幅です.
+        f32         bsdfPdf;        //!< 直前の反射で出射方向を選んだ確率密度です.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    // ShadowQuery structure
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    struct ShadowQuery
+    {
+        RaySet      raySet;         //!< シャドウレイです.
+        Color4      weight;         //!< 遮られなかった場合にIBLの輝度に乗じる重みです.
+        u32         path;           //!< 経路番号です.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    // Wavefront structure
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    struct Wavefront
+    {
+        std::vector<PathState>      paths;                          //!< 経路です.
+        std::vector<HitRecord>      records;                        //!< 経路ごとの交差情報です.
+        std::vector<u32>            active;                         //!< 追跡中の経路番号です.
+        std::vector<u32>            next;                           //!< 次のバウンスで追跡する経路番号です.
+        std::vector<u32>            missed;                         //!< 何にも当たらなかった経路番号です.
+        std::vector<u32>            queues[MATERIAL_TYPE_COUNT];    //!< マテリアルの種類ごとの経路番号です.
+        std::vector<ShadowQuery>    shadows;                        //!< シャドウレイです.
+        std::vector<Vector3>        dirs;                           //!< IBLをフェッチする方向です.
+        std::vector<Color4>         radiances;                      //!< フェッチしたIBLの輝度です.
+    };
+
     //=============================================================================================
     // private variables.
     //=============================================================================================
     Config          m_Config;           //!< コンフィグです.
-    Color4*         m_RenderTarget;     //!< レンダーターゲットです.
-    Color4*         m_Intermediate;     //!< 中間出力用ターゲット.
-    Random          m_Random;           //!< 乱数.
+    Color4*         m_RenderTarget;     //!< 累積バッファです(xyz:放射輝度の総和, w:サンプル数).
+    f32*            m_Moment;           //!< 輝度の2乗の総和です(分散推定用).
+    Color4*         m_Resolved;         //!< サンプル数で正規化したレンダーターゲットです.
+    u8*             m_Intermediate;     //!< 中間出力用ターゲット(8bit RGB)です.
     Scene*          m_pScene;           //!< シーンデータ.
+    TileScheduler   m_Scheduler;        //!< タイルスケジューラ.
+    Checkpoint      m_Checkpoint;       //!< チェックポイント.
+    bool            m_Resumed;          //!< チェックポイントから再開したかどうか.
+    std::atomic<bool>   m_CheckpointReady;  //!< チェックポイントを保存できる状態かどうか.
     volatile bool   m_IsFinish;         //!< 正常終了したかどうか？
     volatile bool   m_WatcherEnd;       //!< 時間監視を終了したかどうか.
+    std::chrono::steady_clock::time_point   m_Deadline;     //!< レンダリングの締め切り時刻です.
 
     //=============================================================================================
     // private methods.
@@ -81,28 +139,92 @@ private:
 
     //---------------------------------------------------------------------------------------------
     //! @brief      指定方向からの放射輝度を求めます.
+    //!
+    //! @param [in]     input           カメラからのレイです.
+    //! @param [in]     spreadAngle     1ピクセルあたりのレイの広がり角です(テクスチャのミップレベル選択に使います).
+    //! @param [in,out] random          乱数です.
+    //! @param [in]     pPrimary        カメラレイの交差情報です. nullptr の場合は交差判定から行います.
     //---------------------------------------------------------------------------------------------
-    Color4 Radiance( const Ray& input );
+    Color4 Radiance( const Ray& input, f32 spreadAngle, Random& random, const HitRecord* pPrimary = nullptr );
 
     //---------------------------------------------------------------------------------------------
     //! @brief      直接光ライティングをします.
+    //!
+    //! @param [in]     position        衝突点です.
+    //! @param [in]     pMaterial       衝突点のマテリアルです.
+    //! @param [in,out] arg             入射方向, 法線等を設定済みのシェーディング引数です.
+    //---------------------------------------------------------------------------------------------
+    Color4 NextEventEstimation( const Vector3& position, const IMaterial* pMaterial, ShadingArg& arg );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      直接光ライティング用のシャドウレイと, 遮られなかった場合の重みを求めます.
+    //!
+    //! @param [in]     position        衝突点です.
+    //! @param [in]     pMaterial       衝突点のマテリアルです.
+    //! @param [in,out] arg             入射方向, 法線等を設定済みのシェーディング引数です.
+    //! @param [out]    shadowRay       シャドウレイです.
+    //! @param [out]    weight          IBLの輝度に乗じる重みです.
+    //! @retval true    寄与がありうるのでシャドウレイを追跡する必要があります.
+    //! @retval false   寄与がありません.
     //---------------------------------------------------------------------------------------------
-    Color4 NextEventEstimation( const Vector3& position, Random& random );
+    bool SampleLight( const Vector3& position, const IMaterial* pMaterial, ShadingArg& arg, RaySet& shadowRay, Color4& weight );
 
     //---------------------------------------------------------------------------------------------
-    //! @brief      シャドウレイを生成します.
+    //! @brief      IBLの輝度分布に従ってシャドウレイを生成します.
     //---------------------------------------------------------------------------------------------
-    RaySet MakeShadowRaySet( const Vector3& position, Random& random );
+    RaySet MakeShadowRaySet( const Vector3& position, Random& random, f32& pdf );
 
     //---------------------------------------------------------------------------------------------
     //! @brief      経路を追跡します.
     //---------------------------------------------------------------------------------------------
     void  TracePath();
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      スケジューラから取得したタイルを処理します.
+    //---------------------------------------------------------------------------------------------
+    void  TraceTile( s32 threadId );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      チェックポイントを準備します. 再開する場合は累積結果を読み込みます.
+    //!
+    //! @param [in]     pScene          レンダリングするシーンです.
+    //---------------------------------------------------------------------------------------------
+    void  PrepareCheckpoint( Scene* pScene );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      シーンと積分器の設定からチェックポイント照合用のハッシュ値を求めます.
+    //!
+    //! @param [in]     pScene          レンダリングするシーンです.
+    //---------------------------------------------------------------------------------------------
+    u64   ComputeCheckpointHash( Scene* pScene ) const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイル内の全ピクセルの推定誤差が閾値を下回ったかどうかを判定します.
+    //---------------------------------------------------------------------------------------------
+    bool  IsConverged( const Tile& tile ) const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      ピクセル位置とサンプル番号からカメラレイを生成します.
+    //---------------------------------------------------------------------------------------------
+    Ray   MakeCameraRay( s32 x, s32 y, s32 sample, Random& random );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイル内の経路をまとめて生成し, バウンスごとに一括で追跡します.
+    //!
+    //! @param [in]     tile            処理するタイルです.
+    //! @param [in]     begin           開始サンプル番号です.
+    //! @param [in]     end             終了サンプル番号です.
+    //! @param [in]     spreadAngle     1ピクセルあたりのレイの広がり角です.
+    //! @param [in,out] wavefront       作業用のキューです. スレッドごとに使い回します.
+    //---------------------------------------------------------------------------------------------
+    void  TraceWavefront( const Tile& tile, s32 begin, s32 end, f32 spreadAngle, Wavefront& wavefront );
+
     //---------------------------------------------------------------------------------------------
     //! @brief      レンダリング時間を監視します.
+    //!
+    //! @param [in]     captureIntervalSec  キャプチャー間隔です(秒単位).
     //---------------------------------------------------------------------------------------------
-    void  Watcher(f32 maxRenderingTime, f32 captureInterval);
+    void  Watcher( f32 captureIntervalSec );
 
     //---------------------------------------------------------------------------------------------
     //! @brief      レンダリング結果をキャプチャーします.
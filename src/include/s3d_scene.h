@@ -54,8 +54,15 @@ public:
     //! @brief      カメラからレイを取得します.
     //---------------------------------------------------------------------------------------------
     S3D_INLINE
-    Ray GetRay( const f32 x, const f32 y )
-    { return m_pCamera->GetRay( x, y ); }
+    Ray GetRay( const f32 x, const f32 y, Random& random )
+    { return m_pCamera->GetRay( x, y, random ); }
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      カメラの1ピクセルあたりのレイの広がり角を取得します.
+    //---------------------------------------------------------------------------------------------
+    S3D_INLINE
+    f32 GetSpreadAngle( const f32 pixelHeight ) const
+    { return m_pCamera->GetSpreadAngle( pixelHeight ); }
 
     //---------------------------------------------------------------------------------------------
     //! @brief      交差判定を行います.
@@ -64,6 +71,20 @@ public:
     bool Intersect( const RaySet& raySet, HitRecord& record )
     { return m_pBVH->IsHit( raySet, record ); }
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      レイパケットの交差判定を行います. 交差したレイのビットマスクを返却します.
+    //---------------------------------------------------------------------------------------------
+    S3D_INLINE
+    u32 IntersectPacket( const RayPacket& packet, HitRecord* pRecords )
+    { return m_pBVH->IsHitPacket( packet, ( 0x1u << packet.count ) - 1, pRecords ); }
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      指定距離までに遮蔽物があるかどうか判定します.
+    //---------------------------------------------------------------------------------------------
+    S3D_INLINE
+    bool IsOccluded( const RaySet& raySet, f32 distance )
+    { return m_pBVH->IsOccluded( raySet, distance ); }
+
     //---------------------------------------------------------------------------------------------
     //! @brief      IBLテクスチャをフェッチします.
     //---------------------------------------------------------------------------------------------
@@ -71,6 +92,31 @@ public:
     Color4 SampleIBL( const Vector3& dir )
     { return m_IBL.Sample( dir, m_Filter ) * Color4( 10.0f, 10.0f, 10.0f, 1.0f ); }
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      IBLテクスチャを複数方向まとめてフェッチします.
+    //---------------------------------------------------------------------------------------------
+    S3D_INLINE
+    void SampleIBLBatch( const Vector3* pDirs, u32 count, Color4* pResults )
+    {
+        m_IBL.SampleBatch( pDirs, count, m_Filter, pResults );
+        for( auto i=0u; i<count; ++i )
+        { pResults[i] = pResults[i] * Color4( 10.0f, 10.0f, 10.0f, 1.0f ); }
+    }
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      IBLの輝度分布に従って方向をサンプリングします.
+    //---------------------------------------------------------------------------------------------
+    S3D_INLINE
+    Vector3 SampleIBLDir( const Vector2& random, f32& pdf ) const
+    { return m_IBL.SampleDir( random, pdf ); }
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      SampleIBLDir() で指定方向が選ばれる確率密度を求めます.
+    //---------------------------------------------------------------------------------------------
+    S3D_INLINE
+    f32 GetIBLPdf( const Vector3& dir ) const
+    { return m_IBL.GetPdf( dir ); }
+
 protected:
     //=============================================================================================
     // protected variables.
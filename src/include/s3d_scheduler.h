@@ -0,0 +1,192 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_scheduler.h
+// Desc : Tile Scheduler Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_typedef.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Tile structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct Tile
+{
+    s32     x;          //!< 左上のX座標です.
+    s32     y;          //!< 左上のY座標です.
+    s32     w;          //!< 横幅です.
+    s32     h;          //!< 縦幅です.
+    s32     pass;       //!< 次に処理するパス番号です.
+    f64     cost;       //!< 直前のパスの処理時間です(秒単位). 未計測の場合は0です.
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// TileScheduler class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class TileScheduler
+{
+    //=============================================================================================
+    // list of friend classes and methods.
+    //=============================================================================================
+    /* NOTHING */
+
+public:
+    //=============================================================================================
+    // public variables.
+    //=============================================================================================
+    /* NOTHING */
+
+    //=============================================================================================
+    // public methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      コンストラクタです.
+    //---------------------------------------------------------------------------------------------
+    TileScheduler();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      デストラクタです.
+    //---------------------------------------------------------------------------------------------
+    ~TileScheduler();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      初期化処理を行います.
+    //---------------------------------------------------------------------------------------------
+    bool Init( s32 width, s32 height, s32 tileSize, s32 passCount, s32 threadCount );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      終了処理を行います.
+    //---------------------------------------------------------------------------------------------
+    void Term();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイルごとの処理済みパス数を復元します. Init() の直後に呼び出します.
+    //!
+    //! @param [in]     pPasses         タイルごとの処理済みパス数です.
+    //! @param [in]     tileCount       タイル数です.
+    //---------------------------------------------------------------------------------------------
+    bool Restore( const s32* pPasses, u32 tileCount );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイルを取得します. 全タスクが完了した場合は false を返却します.
+    //---------------------------------------------------------------------------------------------
+    bool Pop( s32 threadId, u32& tileIndex );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイルの1パス分の処理完了を通知します.
+    //!
+    //! @param [in]     threadId        スレッド番号です.
+    //! @param [in]     tileIndex       タイル番号です.
+    //! @param [in]     converged       収束したかどうか. true の場合は残りのパスを打ち切ります.
+    //---------------------------------------------------------------------------------------------
+    void Complete( s32 threadId, u32 tileIndex, bool converged );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      処理を中断します.
+    //---------------------------------------------------------------------------------------------
+    void Cancel();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      締め切り時刻を設定します.
+    //!
+    //! @param [in]     deadline        締め切り時刻です. 推定処理時間内に終わらないパスは開始せずに打ち切ります.
+    //---------------------------------------------------------------------------------------------
+    void SetDeadline( const std::chrono::steady_clock::time_point& deadline );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      締め切りによって打ち切ったパスがあるかどうかを取得します.
+    //---------------------------------------------------------------------------------------------
+    bool IsExpired() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイルを取得します.
+    //---------------------------------------------------------------------------------------------
+    Tile& GetTile( u32 tileIndex );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイル数を取得します.
+    //---------------------------------------------------------------------------------------------
+    u32 GetTileCount() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      パス数を取得します.
+    //---------------------------------------------------------------------------------------------
+    s32 GetPassCount() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      進捗率[0, 1]を取得します.
+    //---------------------------------------------------------------------------------------------
+    f32 GetProgress() const;
+
+private:
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    // WorkQueue structure
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+    struct WorkQueue
+    {
+        std::mutex                              mutex;  //!< 排他制御用ミューテックスです.
+        std::deque<u32>                         items;  //!< タイル番号のキューです.
+        std::chrono::steady_clock::time_point   start;  //!< 処理中のタイルの開始時刻です.
+    };
+
+    //=============================================================================================
+    // private variables.
+    //=============================================================================================
+    std::vector<Tile>       m_Tiles;            //!< タイルです.
+    WorkQueue*              m_pQueues;          //!< スレッドごとのキューです.
+    s32                     m_QueueCount;       //!< キュー数です.
+    s32                     m_PassCount;        //!< パス数です.
+    u64                     m_TaskCount;        //!< 総タスク数です.
+    std::atomic<u64>        m_RemainCount;      //!< 未完了タスク数です.
+    std::atomic<bool>       m_Cancel;           //!< 中断フラグです.
+    std::atomic<bool>       m_Expired;          //!< 締め切りでパスを打ち切ったかどうかです.
+    std::atomic<u64>        m_CostSum;          //!< 計測したパスの処理時間の総和です(マイクロ秒単位).
+    std::atomic<u64>        m_CostCount;        //!< 計測したパス数です.
+    std::chrono::steady_clock::time_point   m_Deadline;     //!< 締め切り時刻です.
+    std::mutex              m_WaitMutex;        //!< 待機用ミューテックスです.
+    std::condition_variable m_WaitCond;         //!< タイルの再投入や完了を待つ条件変数です.
+    u64                     m_Signal;           //!< 通知のたびに増える値です. m_WaitMutex で保護します.
+
+    //=============================================================================================
+    // private methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      他スレッドのキューからタイルを盗みます.
+    //---------------------------------------------------------------------------------------------
+    bool Steal( s32 threadId, u32& tileIndex );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイルの次のパスが締め切りまでに終わるかどうかを推定します.
+    //---------------------------------------------------------------------------------------------
+    bool CanFinish( const Tile& tile ) const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      タイルの残りのパスをまとめて完了扱いにします.
+    //---------------------------------------------------------------------------------------------
+    void Retire( Tile& tile );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      待機中のスレッドに状態の変化を通知します.
+    //---------------------------------------------------------------------------------------------
+    void Notify();
+
+    TileScheduler   ( const TileScheduler& ) = delete;      // アクセス禁止.
+    void operator = ( const TileScheduler& ) = delete;      // アクセス禁止.
+};
+
+} // namespace s3d
@@ -41,8 +41,12 @@ struct HitRecord
     Vector3             position;       //!< 衝突点の位置座標.
     Vector3             normal;         //!< 法線ベクトル.
     Vector2             texcoord;       //!< 衝突点のテクスチャ座標です.
+    f32                 uvDensity;      //!< 衝突面上の単位長さあたりのテクスチャ座標の変化量です(ミップレベル選択に使います).
     const IShape*       pShape;         //!< オブジェクトへのポインタ.
     const IMaterial*    pMaterial;      //!< マテリアルへのポインタ.
+#if S3D_TRAVERSAL_STATS
+    u32                 visitCount;     //!< 走査したBVHノード数です.
+#endif
 
     //---------------------------------------------------------------------------------------------
     //! @brief      コンストラクタです.
@@ -52,8 +56,12 @@ struct HitRecord
     , position   ( 0.0f, 0.0f, 0.0f )
     , normal     ( 0.0f, 0.0f, 0.0f )
     , texcoord   ( 0.0f, 0.0f )
+    , uvDensity  ( 0.0f )
     , pShape     ( nullptr )
     , pMaterial  ( nullptr )
+#if S3D_TRAVERSAL_STATS
+    , visitCount ( 0 )
+#endif
     { /* DO_NOTHING */ }
 };
 
@@ -65,10 +73,47 @@ struct IShape : IReference
 {
     virtual ~IShape() {}
     virtual bool        IsHit    ( const RaySet&, HitRecord& ) const = 0;
+    virtual bool        IsOccluded( const RaySet&, f32 distance ) const = 0;
     virtual BoundingBox GetBox   () const = 0;
     virtual Vector3     GetCenter() const = 0;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      レイパケットの交差判定を行います. 既定ではレイごとに IsHit() を呼び出します.
+    //!
+    //! @param [in]     packet      レイパケットです.
+    //! @param [in]     active      判定するレイのビットマスクです.
+    //! @param [in,out] pRecords    レイごとの交差情報です.
+    //! @return     交差したレイのビットマスクを返却します.
+    //---------------------------------------------------------------------------------------------
+    virtual u32 IsHitPacket( const RayPacket& packet, u32 active, HitRecord* pRecords ) const;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// ITriangle interface
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct ITriangle : IShape
+{
+    virtual ~ITriangle() {}
+    virtual Vector3     GetPosition ( u32 index ) const = 0;
+    virtual void        SetHitRecord( const RaySet&, f32 dist, f32 beta, f32 gamma, HitRecord& ) const = 0;
 };
 
+
+//-------------------------------------------------------------------------------------------------
+//! @brief      三角形の面積とテクスチャ座標上の面積の比から, 単位長さあたりのテクスチャ座標の変化量を求めます.
+//!
+//! @param [in]     e1, e2      位置座標の辺ベクトルです.
+//! @param [in]     t1, t2      テクスチャ座標の辺ベクトルです.
+//-------------------------------------------------------------------------------------------------
+S3D_INLINE
+f32 ComputeUVDensity( const Vector3& e1, const Vector3& e2, const Vector2& t1, const Vector2& t2 )
+{
+    auto worldArea = Vector3::Cross( e1, e2 ).Length();
+    auto uvArea    = fabs( t1.x * t2.y - t1.y * t2.x );
+    return ( worldArea > F_MIN ) ? sqrtf( uvArea / worldArea ) : 0.0f;
+}
+
 } // namespace s3d
 
 
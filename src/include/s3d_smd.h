@@ -0,0 +1,375 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_smd.h
+// Desc : SMD Mesh File Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_typedef.h>
+#include <s3d_math.h>
+#include <s3d_mappedfile.h>
+#include <vector>
+
+
+namespace s3d {
+
+//-------------------------------------------------------------------------------------------------
+// Forward Declarations.
+//-------------------------------------------------------------------------------------------------
+struct Vertex;
+
+//-------------------------------------------------------------------------------------------------
+// Constant Values.
+//-------------------------------------------------------------------------------------------------
+static const u32 SMD_VERSION_2      = 0x00000002;       //!< 三角形ごとに頂点を持つ旧形式です.
+static const u32 SMD_VERSION_3      = 0x00000003;       //!< 配列をまとめて持つインデックス形式です.
+static const u32 SMD_ARRAY_ALIGN    = 16;               //!< バージョン3の配列アライメントです.
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_MATERIAL_TYPE
+///////////////////////////////////////////////////////////////////////////////////////////////////
+enum SMD_MATERIAL_TYPE
+{
+    SMD_MATERIAL_TYPE_MATTE = 0,        //!< Lambert
+    SMD_MATERIAL_TYPE_MIRROR,           //!< Perfect Specular
+    SMD_MATERIAL_TYPE_DIELECTRIC,       //!< Dielectric
+    SMD_MATERIAL_TYPE_GLOSSY,           //!< Phong
+    SMD_MATERIAL_TYPE_PLASTIC,          //!< Lambert + Phong
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_DATA_HEADER structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_DATA_HEADER
+{
+    u32     NumTriangles;           //!< 三角形数です.
+    u32     NumMaterials;           //!< マテリアル数です.
+    u32     NumTextures;            //!< テクスチャ数です.
+
+    u32     TriangleStructSize;     //!< 三角形構造体のサイズです.
+    u32     MaterialStructSize;     //!< マテリアル構造体のサイズです.
+    u32     TextureStructSize;      //!< テクスチャ構造体のサイズです.
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_FILE_HEADER structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_FILE_HEADER
+{
+    u8              Magic[ 4 ];         //!< ファイルマジック "SMD0"です.
+    u32             Version;            //!< ファイルバージョンです.
+    u32             DataHeaderSize;     //!< データヘッダ構造体のサイズです.
+    SMD_DATA_HEADER DataHeader;         //!< データヘッダです.
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_DATA_HEADER_V3 structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_DATA_HEADER_V3
+{
+    u32     NumVertices;            //!< 頂点数です.
+    u32     NumTriangles;           //!< 三角形数です.
+    u32     NumMaterials;           //!< マテリアル数です.
+    u32     NumTextures;            //!< テクスチャ数です.
+
+    u64     PositionOffset;         //!< 位置座標配列のファイル先頭からのオフセットです.
+    u64     NormalOffset;           //!< 法線ベクトル配列のオフセットです.
+    u64     TexCoordOffset;         //!< テクスチャ座標配列のオフセットです.
+    u64     IndexOffset;            //!< 頂点インデックス配列のオフセットです.
+    u64     MaterialIdOffset;       //!< マテリアル番号配列のオフセットです.
+    u64     MaterialOffset;         //!< マテリアル配列のオフセットです.
+    u64     TextureOffset;          //!< テクスチャ配列のオフセットです.
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_FILE_HEADER_V3 structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_FILE_HEADER_V3
+{
+    u8                  Magic[ 4 ];         //!< ファイルマジック "SMD0"です.
+    u32                 Version;            //!< ファイルバージョンです.
+    u32                 DataHeaderSize;     //!< データヘッダ構造体のサイズです.
+    u32                 Reserved;           //!< 予約領域です.
+    SMD_DATA_HEADER_V3  DataHeader;         //!< データヘッダです.
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_VECTOR2 structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_VECTOR2
+{
+    f32 x;  //!< X成分です.
+    f32 y;  //!< Y成分です.
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_VECTOR3 structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_VECTOR3
+{
+    f32 x;  //!< X成分です.
+    f32 y;  //!< Y成分です.
+    f32 z;  //!< Z成分です.
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_VERTEX structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_VERTEX
+{
+    SMD_VECTOR3    Position;       //!< 位置座標です.
+    SMD_VECTOR3    Normal;         //!< 法線ベクトルです.
+    SMD_VECTOR2    TexCoord;       //!< テクスチャ座標です.
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_TRIANGLE structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_TRIANGLE
+{
+    SMD_VERTEX      Vertex[3];      //!< 頂点データです.
+    s32             MaterialId;     //!< マテリアルインデックスです.
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_MATTE structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_MATTE
+{
+    SMD_VECTOR3    Color;
+    SMD_VECTOR3    Emissive;
+    s32            ColorMap;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_MIRROR structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_MIRROR
+{
+    SMD_VECTOR3    Color;
+    SMD_VECTOR3    Emissive;
+    s32            ColorMap;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_DIELECTRIC structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_DIELECTRIC
+{
+    SMD_VECTOR3     Color;
+    f32             Ior;
+    SMD_VECTOR3     Emissive;
+    s32             ColorMap;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_GLOSSY structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_GLOSSY
+{
+    SMD_VECTOR3     Color;
+    f32             Power;
+    SMD_VECTOR3     Emissive;
+    s32             ColorMap;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_PLASTIC structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_PLASTIC
+{
+    SMD_VECTOR3     Diffuse;
+    SMD_VECTOR3     Specular;
+    f32             Power;
+    SMD_VECTOR3     Emissive;
+    s32             DiffuseMap;
+    s32             SpecularMap;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_MATERIAL structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_MATERIAL
+{
+    s32                 Type;           //!< マテリアルタイプです.
+    union
+    {
+        SMD_MATTE       Matte;          //!< SMD_MATERIAL_TYPE_MATTE のパラメータです.
+        SMD_MIRROR      Mirror;         //!< SMD_MATERIAL_TYPE_MIRROR のパラメータです.
+        SMD_DIELECTRIC  Dielectric;     //!< SMD_MATERIAL_TYPE_DIELECTRIC のパラメータです.
+        SMD_GLOSSY      Glossy;         //!< SMD_MATERIAL_TYPE_GLOSSY のパラメータです.
+        SMD_PLASTIC     Plastic;        //!< SMD_MATERIAL_TYPE_PLASTIC のパラメータです.
+    };
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SMD_TEXTURE structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct SMD_TEXTURE
+{
+    char            FileName[ 256 ];    //!< ファイル名です.
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SmdFile class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class SmdFile
+{
+    //=============================================================================================
+    // list of friend classes and methods.
+    //=============================================================================================
+    /* NOTHING */
+
+public:
+    //=============================================================================================
+    // public variables.
+    //=============================================================================================
+    /* NOTHING */
+
+    //=============================================================================================
+    // public methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      コンストラクタです.
+    //---------------------------------------------------------------------------------------------
+    SmdFile();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      デストラクタです.
+    //---------------------------------------------------------------------------------------------
+    ~SmdFile();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      ファイルから読み込みます.
+    //!
+    //! @param [in]     filename        ファイル名です.
+    //! @retval true    読み込みに成功.
+    //! @retval false   読み込みに失敗.
+    //! @note       バージョン3はファイルをマップしたまま配列をそのまま参照します.
+    //!             バージョン2はインデックス形式に展開して保持します.
+    //---------------------------------------------------------------------------------------------
+    bool Load( const char* filename );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      頂点配列から初期化します.
+    //!
+    //! @param [in]     vertexCount     頂点数です. 3の倍数である必要があります.
+    //! @param [in]     pVertices       頂点配列です.
+    //! @retval true    初期化に成功.
+    //! @retval false   初期化に失敗.
+    //---------------------------------------------------------------------------------------------
+    bool Init( u32 vertexCount, const Vertex* pVertices );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      終了処理を行います.
+    //---------------------------------------------------------------------------------------------
+    void Term();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      頂点数を取得します.
+    //---------------------------------------------------------------------------------------------
+    u32 GetVertexCount() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      三角形数を取得します.
+    //---------------------------------------------------------------------------------------------
+    u32 GetTriangleCount() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      マテリアル数を取得します.
+    //---------------------------------------------------------------------------------------------
+    u32 GetMaterialCount() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      テクスチャ数を取得します.
+    //---------------------------------------------------------------------------------------------
+    u32 GetTextureCount() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      位置座標配列を取得します.
+    //---------------------------------------------------------------------------------------------
+    const Vector3* GetPositions() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      法線ベクトル配列を取得します.
+    //---------------------------------------------------------------------------------------------
+    const Vector3* GetNormals() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      テクスチャ座標配列を取得します.
+    //---------------------------------------------------------------------------------------------
+    const Vector2* GetTexCoords() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      頂点インデックス配列を取得します(1面につき3つ).
+    //---------------------------------------------------------------------------------------------
+    const u32* GetIndices() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      面ごとのマテリアル番号配列を取得します.
+    //---------------------------------------------------------------------------------------------
+    const s32* GetMaterialIds() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      マテリアル配列を取得します.
+    //---------------------------------------------------------------------------------------------
+    const SMD_MATERIAL* GetMaterials() const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      テクスチャ配列を取得します.
+    //---------------------------------------------------------------------------------------------
+    const SMD_TEXTURE* GetTextures() const;
+
+private:
+    //=============================================================================================
+    // private variables.
+    //=============================================================================================
+    MappedFile                  m_File;             //!< バージョン3のマップ済みファイルです.
+    u32                         m_VertexCount;      //!< 頂点数です.
+    u32                         m_TriangleCount;    //!< 三角形数です.
+    u32                         m_MaterialCount;    //!< マテリアル数です.
+    u32                         m_TextureCount;     //!< テクスチャ数です.
+    const Vector3*              m_pPositions;       //!< 位置座標配列です.
+    const Vector3*              m_pNormals;         //!< 法線ベクトル配列です.
+    const Vector2*              m_pTexCoords;       //!< テクスチャ座標配列です.
+    const u32*                  m_pIndices;         //!< 頂点インデックス配列です.
+    const s32*                  m_pMaterialIds;     //!< マテリアル番号配列です.
+    const SMD_MATERIAL*         m_pMaterials;       //!< マテリアル配列です.
+    const SMD_TEXTURE*          m_pTextures;        //!< テクスチャ配列です.
+    std::vector<Vector3>        m_Positions;        //!< 展開した位置座標です.
+    std::vector<Vector3>        m_Normals;          //!< 展開した法線ベクトルです.
+    std::vector<Vector2>        m_TexCoords;        //!< 展開したテクスチャ座標です.
+    std::vector<u32>            m_Indices;          //!< 展開した頂点インデックスです.
+    std::vector<s32>            m_MaterialIds;      //!< 展開したマテリアル番号です.
+    std::vector<SMD_MATERIAL>   m_Materials;        //!< 展開したマテリアルです.
+    std::vector<SMD_TEXTURE>    m_Textures;         //!< 展開したテクスチャです.
+
+    //=============================================================================================
+    // private methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      バージョン2のデータを展開します.
+    //---------------------------------------------------------------------------------------------
+    bool ParseV2( const u8* pData, u64 size );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      バージョン3のデータを検証して配列を参照します.
+    //---------------------------------------------------------------------------------------------
+    bool ParseV3( const u8* pData, u64 size );
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      展開済みの配列を参照するようにポインタを設定します.
+    //---------------------------------------------------------------------------------------------
+    void BindOwnedArrays();
+
+    SmdFile         ( const SmdFile& ) = delete;    // アクセス禁止.
+    void operator = ( const SmdFile& ) = delete;    // アクセス禁止.
+};
+
+} // namespace s3d
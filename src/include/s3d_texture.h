@@ -13,6 +13,51 @@
 
 namespace s3d {
 
+//----------------------------------------------------------------------------------
+// Constant Values
+//----------------------------------------------------------------------------------
+static const u32 TEXTURE_MAX_MIP_COUNT = 16;    //!< ミップレベルの最大数です(65536x65536まで).
+static const u32 TEXTURE_TILE_SHIFT    = 2;     //!< タイル配置の場合の1辺のテクセル数(log2)です.
+static const u32 TEXTURE_TILE_MASK     = ( 1u << TEXTURE_TILE_SHIFT ) - 1;  //!< タイル内の座標を求めるマスクです.
+
+//----------------------------------------------------------------------------------
+//! @brief      テクセル座標からピクセル配列中の要素番号を求めます.
+//!
+//! @param [in]     x, y        テクセル座標です(範囲内であること).
+//! @param [in]     width       画像の横幅です.
+//! @note       S3D_TILED_TEXTURE が有効な場合は4x4テクセルのタイルを行優先で並べ,
+//!             バイリニアフィルタの4テクセルが同じタイル(キャッシュライン)に収まりやすくします.
+//----------------------------------------------------------------------------------
+S3D_INLINE
+u32 GetTexelIndex( u32 x, u32 y, u32 width )
+{
+#if S3D_TILED_TEXTURE
+    auto tileCountX = ( width + TEXTURE_TILE_MASK ) >> TEXTURE_TILE_SHIFT;
+    auto tile       = ( y >> TEXTURE_TILE_SHIFT ) * tileCountX + ( x >> TEXTURE_TILE_SHIFT );
+    return ( tile << ( TEXTURE_TILE_SHIFT * 2 ) )
+         + ( ( y & TEXTURE_TILE_MASK ) << TEXTURE_TILE_SHIFT )
+         + ( x & TEXTURE_TILE_MASK );
+#else
+    return y * width + x;
+#endif
+}
+
+//----------------------------------------------------------------------------------
+//! @brief      GetTexelIndex() で参照する場合に必要な要素数を求めます.
+//----------------------------------------------------------------------------------
+S3D_INLINE
+u32 GetTexelCount( u32 width, u32 height )
+{
+#if S3D_TILED_TEXTURE
+    // 端のタイルは埋まっていなくても領域を確保する.
+    auto tileCountX = ( width  + TEXTURE_TILE_MASK ) >> TEXTURE_TILE_SHIFT;
+    auto tileCountY = ( height + TEXTURE_TILE_MASK ) >> TEXTURE_TILE_SHIFT;
+    return ( tileCountX * tileCountY ) << ( TEXTURE_TILE_SHIFT * 2 );
+#else
+    return width * height;
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // TEXTURE_ADDRESS_MODE enum
 ////////////////////////////////////////////////////////////////////////////////////
@@ -24,6 +69,17 @@ enum TEXTURE_ADDRESS_MODE
     //TEXTURE_ADDRESS_MIRROR
 };
 
+/////////////////////////////////////////////////////////////////////////////////////
+// TEXTURE_FORMAT enum
+/////////////////////////////////////////////////////////////////////////////////////
+enum TEXTURE_FORMAT
+{
+    TEXTURE_FORMAT_R8 = 0,      //!< 8bit グレースケールです(RGBに展開して参照します).
+    TEXTURE_FORMAT_RG8,         //!< 8bit グレースケール + アルファです.
+    TEXTURE_FORMAT_RGB8,        //!< 8bit RGBです.
+    TEXTURE_FORMAT_RGBA8,       //!< 8bit RGBAです.
+};
+
 /////////////////////////////////////////////////////////////////////////////////////
 // TEXTURE_FILTER_MODE enum
 /////////////////////////////////////////////////////////////////////////////////////
@@ -31,6 +87,7 @@ enum TEXTURE_FILTER_MODE
 {
     TEXTURE_FILTER_NEAREST,     //!< 最近傍法.
     TEXTURE_FILTER_BILINEAR,    //!< バイリニア補間.
+    TEXTURE_FILTER_TRILINEAR,   //!< トライリニア補間(フットプリントからミップレベルを選択).
 };
 
 ////////////////////////////////////////////////////////////////////////////////////
@@ -47,7 +104,7 @@ struct TextureSampler
     //------------------------------------------------------------------------------
     TextureSampler()
     : address       ( TEXTURE_ADDRESS_WRAP )
-    , filter        ( TEXTURE_FILTER_BILINEAR )
+    , filter        ( TEXTURE_FILTER_TRILINEAR )
     , boarderColor  ( 0.0f, 0.0f, 0.0f, 1.0f )
     { /* DO_NOTHING */ }
 
@@ -66,6 +123,16 @@ struct TextureSampler
     { /* DO_NOTHING */ }
 };
 
+////////////////////////////////////////////////////////////////////////////////////
+// MipLevel structure
+////////////////////////////////////////////////////////////////////////////////////
+struct MipLevel
+{
+    u32     width;      //!< 横幅です.
+    u32     height;     //!< 縦幅です.
+    u32     offset;     //!< ピクセルデータ先頭からのバイトオフセットです.
+};
+
 
 ////////////////////////////////////////////////////////////////////////////////////
 // Texture2D class
@@ -109,8 +176,11 @@ public:
 
     //------------------------------------------------------------------------------
     //! @brief      ファイルからロードします.
+    //!
+    //! @param [in]     filename        ファイル名です.
+    //! @param [in]     isSRGB          true の場合, RGB成分をsRGBとしてリニアに変換して参照します.
     //------------------------------------------------------------------------------
-    bool LoadFromFile( const char* );
+    bool LoadFromFile( const char* filename, bool isSRGB = false );
 
     //------------------------------------------------------------------------------
     //! @brief      メモリ解放処理を行います.
@@ -119,14 +189,28 @@ public:
 
     //------------------------------------------------------------------------------
     //! @brief      テクスチャフェッチします.
+    //!
+    //! @param [in]     sampler         サンプラーです.
+    //! @param [in]     texcoord        テクスチャ座標です.
+    //! @param [in]     footprint       1ピクセルがテクスチャ座標上で覆う幅です. TEXTURE_FILTER_TRILINEAR の場合にミップレベルの選択に使います.
     //------------------------------------------------------------------------------
-    Color4 Sample( const TextureSampler&, const Vector2& ) const;
+    Color4 Sample( const TextureSampler& sampler, const Vector2& texcoord, f32 footprint = 0.0f ) const;
 
     //------------------------------------------------------------------------------
     //! @brief      アルファテストを行います.
     //------------------------------------------------------------------------------
     bool AlphaTest( const TextureSampler&, const Vector2&, const f32 value ) const;
 
+    //------------------------------------------------------------------------------
+    //! @brief      ピクセルフォーマットを取得します.
+    //------------------------------------------------------------------------------
+    TEXTURE_FORMAT GetFormat() const;
+
+    //------------------------------------------------------------------------------
+    //! @brief      ミップレベル数を取得します.
+    //------------------------------------------------------------------------------
+    u32 GetMipCount() const;
+
 protected:
     //==============================================================================
     // protected variables.
@@ -142,30 +226,49 @@ private:
     //==============================================================================
     // private variables.
     //==============================================================================
-    u32     m_Width;            //!< 画像の横幅です.
-    u32     m_Height;           //!< 画像の縦幅です.
-    u32     m_Size;             //!< データサイズです.
-    u32     m_ComponentCount;   //!< チャンネル数です(RGB=3, RGBA=4)
-    f32*    m_pPixels;          //!< ピクセルデータです.
+    u32             m_Width;            //!< 画像の横幅です.
+    u32             m_Height;           //!< 画像の縦幅です.
+    u32             m_Size;             //!< 全ミップレベルを合わせたデータサイズ(バイト数)です.
+    u32             m_ComponentCount;   //!< 1ピクセルあたりのバイト数です(R=1, RG=2, RGB=3, RGBA=4).
+    TEXTURE_FORMAT  m_Format;           //!< ピクセルフォーマットです.
+    bool            m_IsSRGB;           //!< RGB成分がsRGBかどうかです.
+    u8*             m_pPixels;          //!< 読み込み元の形式のままのピクセルデータです(ミップレベル0から順に格納).
+    u32             m_MipCount;         //!< ミップレベル数です.
+    MipLevel        m_Mips[ TEXTURE_MAX_MIP_COUNT ];    //!< ミップレベルごとのサイズとオフセットです.
 
     //==============================================================================
     // private methods.
     //==============================================================================
 
+    //------------------------------------------------------------------------------
+    //! @brief      ピクセルデータを設定し, フォーマットを決定してミップマップを生成します.
+    //------------------------------------------------------------------------------
+    void SetPixels( u32 width, u32 height, u32 componentCount, u8* pPixels, bool isSRGB );
+
+    //------------------------------------------------------------------------------
+    //! @brief      1つ上のミップレベルを2x2のボックスフィルタで縮小して生成します.
+    //------------------------------------------------------------------------------
+    void Downsample( u32 level );
+
     //------------------------------------------------------------------------------
     //! @brief      指定されたピクセルを取得します.
     //------------------------------------------------------------------------------
-    Color4 GetPixel( s32 x, s32 y, const TextureSampler& sampler ) const;
+    Color4 GetPixel( s32 x, s32 y, u32 level, const TextureSampler& sampler ) const;
 
     //------------------------------------------------------------------------------
     //! @brief      最近傍フィルタを適用してサンプリングします.
     //------------------------------------------------------------------------------
-    Color4 NearestSample ( const TextureSampler&, const Vector2& ) const;
+    Color4 NearestSample ( const TextureSampler&, const Vector2&, u32 level ) const;
 
     //------------------------------------------------------------------------------
     //! @brief      バイリニアフィルタを適用してサンプリングします.
     //------------------------------------------------------------------------------
-    Color4 BilinearSample( const TextureSampler&, const Vector2& ) const;
+    Color4 BilinearSample( const TextureSampler&, const Vector2&, u32 level ) const;
+
+    //------------------------------------------------------------------------------
+    //! @brief      トライリニアフィルタを適用してサンプリングします.
+    //------------------------------------------------------------------------------
+    Color4 TrilinearSample( const TextureSampler&, const Vector2&, f32 footprint ) const;
 };
 
 
@@ -63,6 +63,11 @@ public:
     //---------------------------------------------------------------------------------------------
     Color4 Shade( ShadingArg& arg ) const override;
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      指定方向へのBSDFに余弦項を乗じた値と, Shade() でその方向が選ばれる確率密度を求めます.
+    //---------------------------------------------------------------------------------------------
+    Color4 Evaluate( const ShadingArg& arg, const Vector3& dir, f32& pdf ) const override;
+
     //---------------------------------------------------------------------------------------------
     //! @brief      エミッシブカラーを取得します.
     //---------------------------------------------------------------------------------------------
@@ -73,6 +78,11 @@ public:
     //---------------------------------------------------------------------------------------------
     bool HasDelta() const override;
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      マテリアルの種類を取得します.
+    //---------------------------------------------------------------------------------------------
+    MATERIAL_TYPE GetType() const override;
+
 private:
     //=============================================================================================
     // private variables.
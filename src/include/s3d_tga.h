@@ -19,6 +19,24 @@ namespace s3d {
 //! @param [in]     filename        ファイル名.
 //! @param [out]    width           画像の横幅です.
 //! @param [out]    height          画像の縦幅です.
+//! @param [out]    component       コンポーネント数(Gray=1, Gray+Alpha=2, RGB=3, RGBA=4)
+//! @param [out]    ppPixel         8bit/チャンネルのピクセルデータです(component 個ずつ格納).
+//! @retval true    読み込みに成功.
+//! @retval false   読み込みに失敗.
+//-------------------------------------------------------------------------------------------------
+bool LoadFromTGA(
+    const char* filename,
+    s32&        width,
+    s32&        height,
+    s32&        component,
+    u8**        ppPixel );
+
+//-------------------------------------------------------------------------------------------------
+//! @brief      TGAファイルを読み込み, RGBA の f32 形式に変換します.
+//!
+//! @param [in]     filename        ファイル名.
+//! @param [out]    width           画像の横幅です.
+//! @param [out]    height          画像の縦幅です.
 //! @param [out]    component       コンポーネント数(RGB=3, RGBA=4)
 //! @param [out]    ppPixels        ピクセルデータです.
 //! @retval true    読み込みに成功.
@@ -30,12 +30,27 @@ enum TONE_MAPPING_TYPE
 class ToneMapper
 {
 public:
+    //--------------------------------------------------------------------------------------------
+    //! @brief      トーンマッピングとガンマ補正を行います.
+    //!
+    //! @param [in]     type        トーンマッピングの方式.
+    //! @param [in]     width       画像の横幅.
+    //! @param [in]     height      画像の縦幅.
+    //! @param [in]     pPixels     HDRピクセル.
+    //! @param [out]    pResult     出力ピクセル. width * height 個のカラーを格納します.
+    //--------------------------------------------------------------------------------------------
     static void Map( TONE_MAPPING_TYPE type, const s32 width, const s32 height, const Color4* pPixels, Color4* pResult );
 
-private:
-    static void ReinhardToneMapping         ( const s32 width, const s32 height, const Color4* pPixels, Color4* pResult );
-    static void Uncharted2FilmicToneMapping ( const s32 width, const s32 height, const Color4* pPixels, Color4* pResult );
-    static void ACESFilmicToneMapping       ( const s32 width, const s32 height, const Color4* pPixels, Color4* pResult );
+    //--------------------------------------------------------------------------------------------
+    //! @brief      トーンマッピングとガンマ補正を行い, 8bit に量子化します.
+    //!
+    //! @param [in]     type        トーンマッピングの方式.
+    //! @param [in]     width       画像の横幅.
+    //! @param [in]     height      画像の縦幅.
+    //! @param [in]     pPixels     HDRピクセル.
+    //! @param [out]    pResult     出力ピクセル. RGB の順に3バイトずつ width * height 個格納します.
+    //--------------------------------------------------------------------------------------------
+    static void Map( TONE_MAPPING_TYPE type, const s32 width, const s32 height, const Color4* pPixels, u8* pResult );
 };
 
 
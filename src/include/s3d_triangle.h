@@ -17,7 +17,7 @@ namespace s3d {
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // Triangle class
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-class Triangle : IShape
+class Triangle : public ITriangle
 {
     //=============================================================================================
     // list of friend classes and methods.
@@ -59,6 +59,11 @@ public:
     //---------------------------------------------------------------------------------------------
     bool IsHit(const RaySet& raySet, HitRecord& record) const override;
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      遮蔽判定を行います.
+    //---------------------------------------------------------------------------------------------
+    bool IsOccluded(const RaySet& raySet, f32 distance) const override;
+
     //---------------------------------------------------------------------------------------------
     //! @brief      バウンディングボックスを取得します.
     //---------------------------------------------------------------------------------------------
@@ -69,6 +74,16 @@ public:
     //---------------------------------------------------------------------------------------------
     Vector3 GetCenter() const override;
 
+    //---------------------------------------------------------------------------------------------
+    //! @brief      頂点の位置座標を取得します.
+    //---------------------------------------------------------------------------------------------
+    Vector3 GetPosition(u32 index) const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      交差位置の重心座標から属性を補間して交差記録を設定します.
+    //---------------------------------------------------------------------------------------------
+    void SetHitRecord(const RaySet& raySet, f32 dist, f32 beta, f32 gamma, HitRecord& record) const override;
+
 private:
     //=============================================================================================
     // private variables.
@@ -78,6 +93,7 @@ private:
     BoundingBox         m_BoundingBox;
     IMaterial*          m_pMaterial;
     Vector3             m_Edge[2];
+    f32                 m_UVDensity;
 
     //=============================================================================================
     // private methods.
@@ -0,0 +1,123 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_triangle4.h
+// Desc : Packed Triangle x4 Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_shape.h>
+#include <atomic>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Triangle4 class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class Triangle4 : IShape
+{
+    //=============================================================================================
+    // list of friend classes and methods.
+    //=============================================================================================
+    /* NOTHING */
+
+public:
+    //=============================================================================================
+    // public variables.
+    //=============================================================================================
+    /* NOTHING */
+
+    //=============================================================================================
+    // public methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      生成処理を行います.
+    //!
+    //! @param [in]     count       形状数です. 4以下である必要があります.
+    //! @param [in]     ppShapes    形状配列です.
+    //! @return     全ての形状が三角形でない場合は nullptr を返却します.
+    //---------------------------------------------------------------------------------------------
+    static IShape* Create(size_t count, IShape** ppShapes);
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      参照カウントを増やします
+    //---------------------------------------------------------------------------------------------
+    void AddRef() override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      解放処理を行います.
+    //---------------------------------------------------------------------------------------------
+    void Release() override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      参照カウントを取得します.
+    //---------------------------------------------------------------------------------------------
+    u32 GetCount() const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      交差判定を行います.
+    //---------------------------------------------------------------------------------------------
+    bool IsHit(const RaySet& raySet, HitRecord& record) const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      遮蔽判定を行います.
+    //---------------------------------------------------------------------------------------------
+    bool IsOccluded(const RaySet& raySet, f32 distance) const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      バウンディングボックスを取得します.
+    //---------------------------------------------------------------------------------------------
+    BoundingBox GetBox() const override;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      中心座標を取得します.
+    //---------------------------------------------------------------------------------------------
+    Vector3 GetCenter() const override;
+
+private:
+    //=============================================================================================
+    // private variables.
+    //=============================================================================================
+    b128                m_Vertex[3];        //!< 頂点0の位置座標です(SoA).
+    b128                m_Edge0[3];         //!< 頂点0から頂点1へのエッジです(SoA).
+    b128                m_Edge1[3];         //!< 頂点0から頂点2へのエッジです(SoA).
+    std::atomic<u32>    m_Count;            //!< 参照カウントです.
+    ITriangle*          m_pTriangles[4];    //!< 属性補間に使用する三角形です.
+    u32                 m_TriangleCount;    //!< 三角形数です.
+    BoundingBox         m_Box;              //!< バウンディングボックスです.
+
+    //=============================================================================================
+    // private methods.
+    //=============================================================================================
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      コンストラクタです.
+    //---------------------------------------------------------------------------------------------
+    Triangle4(size_t count, ITriangle** ppTriangles);
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      デストラクタです.
+    //---------------------------------------------------------------------------------------------
+    ~Triangle4();
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      4つの三角形との交差判定をまとめて行い, 交差したレーンのビットマスクを返却します.
+    //---------------------------------------------------------------------------------------------
+    s32 Intersect(const RaySet& raySet, f32 distance, b128& dist, b128& beta, b128& gamma) const;
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      new 演算子のオーバーロードです.
+    //---------------------------------------------------------------------------------------------
+    void* operator new   (size_t size);
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      delete 演算子のオーバーロードです.
+    //---------------------------------------------------------------------------------------------
+    void operator delete (void* ptr);
+};
+
+} // namespace s3d
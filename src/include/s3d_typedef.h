@@ -86,6 +86,34 @@ typedef double              f64;
     #define S3D_IS_SIMD   (0)     // SIMD演算無効.
 #endif// defined(S3D_USE_SIMD)
 
+#ifndef S3D_ORDERED_TRAVERSAL
+    #define S3D_ORDERED_TRAVERSAL   (1)     // BVHの子ノードを近い順に走査.
+#endif//S3D_ORDERED_TRAVERSAL
+
+#ifndef S3D_PACKED_TRIANGLE
+    #define S3D_PACKED_TRIANGLE     (1)     // 葉の三角形を4/8個まとめてSIMDで交差判定.
+#endif//S3D_PACKED_TRIANGLE
+
+#ifndef S3D_BVH_CACHE
+    #define S3D_BVH_CACHE           (1)     // メッシュのBVHをファイル(*.bvh)にキャッシュ.
+#endif//S3D_BVH_CACHE
+
+#ifndef S3D_TILED_TEXTURE
+    #define S3D_TILED_TEXTURE       (1)     // テクスチャとIBLを4x4テクセルのタイル単位で格納.
+#endif//S3D_TILED_TEXTURE
+
+#ifndef S3D_OCTAHEDRAL_IBL
+    #define S3D_OCTAHEDRAL_IBL      (1)     // IBLを八面体マップに再投影して三角関数なしで参照.
+#endif//S3D_OCTAHEDRAL_IBL
+
+#ifndef S3D_PACKET_TRAVERSAL
+    #define S3D_PACKET_TRAVERSAL    (0)     // カメラレイをパケット単位でBVH走査.
+#endif//S3D_PACKET_TRAVERSAL
+
+#ifndef S3D_TRAVERSAL_STATS
+    #define S3D_TRAVERSAL_STATS     (0)     // BVHの走査ノード数を計測してレイあたりの平均を出力.
+#endif//S3D_TRAVERSAL_STATS
+
 
 //-------------------------------------------------------------------------
 //! @def        S8_MIN
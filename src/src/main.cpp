@@ -19,6 +19,7 @@
 #include <s3d_pt.h>
 #include <s3d_hdr.h>
 #include <Windows.h>
+#include <cstring>
 
 //-------------------------------------------------------------------------------------------------
 //! @brief      CPUコアの数を取得します.
@@ -60,6 +61,22 @@ int main( int argc, char **argv )
     _CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
   #endif
     {
+        // "-adaptive" が指定された場合は適応サンプリングを行う.
+        // "-checkpoint" が指定された場合はチェックポイントを定期的に保存する.
+        // "-resume" が指定された場合はチェックポイントから再開する.
+        auto adaptive   = false;
+        auto checkpoint = false;
+        auto resume     = false;
+        for( auto i=1; i<argc; ++i )
+        {
+            if ( strcmp( argv[i], "-adaptive" ) == 0 )
+            { adaptive = true; }
+            else if ( strcmp( argv[i], "-checkpoint" ) == 0 )
+            { checkpoint = true; }
+            else if ( strcmp( argv[i], "-resume" ) == 0 )
+            { resume = true; }
+        }
+
         // アプリケーションの構成設定.
         s3d::PathTracer::Config config;
 
@@ -74,6 +91,13 @@ int main( int argc, char **argv )
         config.SubSampleCount = 2;
         config.MaxBounceCount = 16;
         config.CpuCoreCount   = GetCPUCoreCount();
+        config.TileSize        = 32;
+        config.TileSampleCount = 16;
+        config.Wavefront       = false;
+        config.AdaptiveThreshold = ( adaptive ) ? 0.05f : 0.0f;
+        config.MaxSampleCount    = 4096;
+        config.CheckpointIntervalSec = ( checkpoint ) ? 60.0f : 0.0f;
+        config.Resume            = resume;
     #else
         // デバッグ用.
         config.Width          = 256;
@@ -82,6 +106,13 @@ int main( int argc, char **argv )
         config.SubSampleCount = 1;
         config.MaxBounceCount = 4;
         config.CpuCoreCount   = GetCPUCoreCount();
+        config.TileSize        = 16;
+        config.TileSampleCount = 4;
+        config.Wavefront       = false;
+        config.AdaptiveThreshold = ( adaptive ) ? 0.05f : 0.0f;
+        config.MaxSampleCount    = 1024;
+        config.CheckpointIntervalSec = ( checkpoint ) ? 10.0f : 0.0f;
+        config.Resume            = resume;
     #endif
 
         s3d::PathTracer renderer;
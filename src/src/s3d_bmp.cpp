@@ -12,6 +12,7 @@
 #include <cstdio>
 #include <cmath>
 #include <cassert>
+#include <vector>
 
 
 namespace s3d {
@@ -94,15 +95,15 @@ void WriteBmpInfoHeader( BMP_INFO_HEADER& header, FILE* pFile )
 }
 
 //-------------------------------------------------------------------------------------------------
-//      BMPファイルに書き出します.
+//      24bit BMPのヘッダを書き込みます.
 //-------------------------------------------------------------------------------------------------
-void WriteBmp( FILE* pFile, const s32 width, const s32 height, const f32* pPixel )
+void WriteBmpHeader( FILE* pFile, const s32 width, const s32 height, const s32 imageSize )
 {
     BMP_FILE_HEADER fileHeader;
     BMP_INFO_HEADER infoHeader;
 
     fileHeader.Type      = 'MB';
-    fileHeader.Size      = sizeof(BMP_FILE_HEADER) + sizeof(BMP_INFO_HEADER) + ( width * height * 3 );
+    fileHeader.Size      = sizeof(BMP_FILE_HEADER) + sizeof(BMP_INFO_HEADER) + imageSize;
     fileHeader.Reserved1 = 0;
     fileHeader.Reserved2 = 0;
     fileHeader.OffBits   = sizeof(BMP_FILE_HEADER) + sizeof(BMP_INFO_HEADER);
@@ -121,6 +122,14 @@ void WriteBmp( FILE* pFile, const s32 width, const s32 height, const f32* pPixel
 
     WriteBmpFileHeader( fileHeader, pFile );
     WriteBmpInfoHeader( infoHeader, pFile );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      BMPファイルに書き出します.
+//-------------------------------------------------------------------------------------------------
+void WriteBmp( FILE* pFile, const s32 width, const s32 height, const f32* pPixel )
+{
+    WriteBmpHeader( pFile, width, height, width * height * 3 );
 
     for ( int i=0; i<height; ++i )
     {
@@ -153,6 +162,30 @@ void WriteBmp( FILE* pFile, const s32 width, const s32 height, const f32* pPixel
     }
 }
 
+//-------------------------------------------------------------------------------------------------
+//      8bit/チャンネルのピクセルをBMPファイルに書き出します.
+//-------------------------------------------------------------------------------------------------
+void WriteBmp( FILE* pFile, const s32 width, const s32 height, const u8* pPixel )
+{
+    // 各行は4バイト境界に揃える.
+    const auto pitch = ( width * 3 + 3 ) & ~3;
+    WriteBmpHeader( pFile, width, height, pitch * height );
+
+    std::vector<u8> row( pitch, 0 );
+    for ( int i=0; i<height; ++i )
+    {
+        auto pSrc = pPixel + ( i * width * 3 );
+        for( int j=0; j<width; ++j )
+        {
+            row[j * 3 + 0] = pSrc[j * 3 + 2];
+            row[j * 3 + 1] = pSrc[j * 3 + 1];
+            row[j * 3 + 2] = pSrc[j * 3 + 0];
+        }
+
+        fwrite( row.data(), sizeof(u8), pitch, pFile );
+    }
+}
+
 //-------------------------------------------------------------------------------------------------
 //      BMPファイルに保存します.
 //-------------------------------------------------------------------------------------------------
@@ -169,6 +202,22 @@ bool SaveToBMP( const char* filename, const s32 width, const s32 height, const f
     return true;
 }
 
+//-------------------------------------------------------------------------------------------------
+//      8bit/チャンネルのピクセルをBMPファイルに保存します.
+//-------------------------------------------------------------------------------------------------
+bool SaveToBMP( const char* filename, const s32 width, const s32 height, const u8* pPixel )
+{
+    FILE* pFile;
+    errno_t err = fopen_s( &pFile, filename, "wb" );
+    if ( err != 0 )
+    { return false; }
+
+    WriteBmp( pFile, width, height, pPixel );
+
+    fclose( pFile );
+    return true;
+}
+
 //-------------------------------------------------------------------------------------------------
 //      BMPファイルから読み込みます.
 //-------------------------------------------------------------------------------------------------
@@ -223,4 +272,63 @@ bool LoadFromBMP( const char* filename, s32& width, s32& height, f32** ppPixels
     return true;
 }
 
+//-------------------------------------------------------------------------------------------------
+//      BMPファイルを8bit/チャンネルのまま読み込みます.
+//-------------------------------------------------------------------------------------------------
+bool LoadFromBMP( const char* filename, s32& width, s32& height, u8** ppPixels )
+{
+    FILE* pFile;
+    errno_t err = fopen_s( &pFile, filename, "rb" );
+    if ( err != 0 )
+    { return false; }
+
+    BMP_FILE_HEADER fileHeader;
+    
+    fread( &fileHeader, sizeof(fileHeader), 1, pFile );
+    if ( fileHeader.Type != 'MB' )
+    {
+        fclose( pFile );
+        return false;
+    }
+
+    BMP_INFO_HEADER infoHeader;
+    fread( &infoHeader, sizeof(infoHeader), 1, pFile );
+
+    if ( infoHeader.BitCount != 24 || infoHeader.Width <= 0 || infoHeader.Height <= 0 )
+    {
+        fclose( pFile );
+        return false;
+    }
+
+    width  = static_cast<s32>( infoHeader.Width );
+    height = static_cast<s32>( infoHeader.Height );
+
+    // 各行は4バイト境界にパディングされている.
+    s32 stride = ( width * 3 + 3 ) & ~3;
+    u8* pRow   = new u8 [ stride ];
+    assert( pRow != nullptr );
+
+    (*ppPixels) = new u8 [ width * height * 3 ];
+    for( s32 y=0; y<height; ++y )
+    {
+        fread( pRow, sizeof(u8), stride, pFile );
+
+        // BGR を RGB に並び替え.
+        u8* pDst = (*ppPixels) + y * width * 3;
+        for( s32 x=0; x<width; ++x )
+        {
+            pDst[ x * 3 + 0 ] = pRow[ x * 3 + 2 ];
+            pDst[ x * 3 + 1 ] = pRow[ x * 3 + 1 ];
+            pDst[ x * 3 + 2 ] = pRow[ x * 3 + 0 ];
+        }
+    }
+
+    fclose( pFile );
+
+    delete [] pRow;
+    pRow = nullptr;
+
+    return true;
+}
+
 } // namespace s3d
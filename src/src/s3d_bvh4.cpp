@@ -9,85 +9,13 @@
 //-------------------------------------------------------------------------------------------------
 #include <s3d_bvh2.h>
 #include <s3d_bvh4.h>
-#include <s3d_bucket.h>
+#include <s3d_bvhbuilder.h>
 #include <s3d_leaf.h>
-#include <algorithm>
 
 
 
 namespace /* anonymous */ {
 
-//-------------------------------------------------------------------------------------------------
-// Constant Values.
-//-------------------------------------------------------------------------------------------------
-constexpr int BucketCount = 16;     //!< バケット数です.
-
-//-------------------------------------------------------------------------------------------------
-//      マージしたバウンディングボックスを生成します.
-//-------------------------------------------------------------------------------------------------
-s3d::BoundingBox CreateMergedBox( size_t count, s3d::IShape** ppShapes )
-{
-    if ( count == 0 || ppShapes == nullptr )
-    { return s3d::BoundingBox(); }
-
-    s3d::BoundingBox box = ppShapes[0]->GetBox();
-
-    for( size_t i=1; i<count; ++i )
-    { box = s3d::BoundingBox::Merge( box, ppShapes[i]->GetBox() ); }
-
-    return box;
-}
-
-//-------------------------------------------------------------------------------------------------
-//      中心座標をもとにバウンディングボックスを生成します.
-//-------------------------------------------------------------------------------------------------
-s3d::BoundingBox CreateCentroidBox( size_t count, s3d::IShape** ppShapes )
-{
-    if ( count == 0 || ppShapes == nullptr )
-    { return s3d::BoundingBox(); }
-
-    s3d::BoundingBox box( ppShapes[0]->GetCenter() );
-
-    for( size_t i=1; i<count; ++i )
-    { box = s3d::BoundingBox::Merge( box, ppShapes[i]->GetCenter() ); }
-
-    return box;
-}
-
-//-------------------------------------------------------------------------------------------------
-//      最長軸を取得します.
-//-------------------------------------------------------------------------------------------------
-int GetLongestAxis( const s3d::BoundingBox& box )
-{
-    auto vec = box.maxi - box.mini;
-
-    if (vec.x > vec.y && vec.x > vec.z)
-    { return 0; }
-    else if (vec.y > vec.z)
-    { return 1; }
-    else
-    { return 2; }
-}
-
-//-------------------------------------------------------------------------------------------------
-//      オフセットを求めます.
-//-------------------------------------------------------------------------------------------------
-s3d::Vector3 CalcOffset( const s3d::BoundingBox& box, const s3d::Vector3& p )
-{
-    auto offset = p - box.mini;
-
-    if (box.maxi.x > box.mini.x)
-    { offset.x /= box.maxi.x - box.mini.x; }
-
-    if (box.maxi.y > box.mini.y)
-    { offset.y /= box.maxi.y - box.mini.y; }
-
-    if (box.maxi.z > box.mini.z)
-    { offset.z /= box.maxi.z - box.mini.z; }
-
-    return offset;
-}
-
 //-------------------------------------------------------------------------------------------------
 //      葉ノードを生成します.
 //-------------------------------------------------------------------------------------------------
@@ -173,8 +101,52 @@ u32 BVH4::GetCount() const
 //-------------------------------------------------------------------------------------------------
 bool BVH4::IsHit( const RaySet& raySet, HitRecord& record ) const
 {
+#if S3D_TRAVERSAL_STATS
+    record.visitCount++;
+#endif
+
+#if S3D_ORDERED_TRAVERSAL
+    const auto ray4 = MakeRay4( raySet );
+
+    s32  mask = 0;
+    b128 tnear;
+    if ( !m_Box.IsHit( ray4, record.distance, mask, tnear ) )
+    { return false; }
+
+    S3D_ALIGN(16) f32 dist[4];
+    _mm_store_ps( dist, tnear );
+
+    // 交差した子ノードを入射距離の近い順に並べる.
+    s32 order[4];
+    auto count = 0;
+    for ( auto i=0; i<4; ++i )
+    {
+        auto bit = 0x1 << i;
+        if ( (mask & bit) != bit )
+        { continue; }
+
+        auto j = count++;
+        for( ; j > 0 && dist[ order[j - 1] ] > dist[i]; --j )
+        { order[j] = order[j - 1]; }
+        order[j] = i;
+    }
+
+    auto hit = false;
+    for ( auto i=0; i<count; ++i )
+    {
+        // より近い交差が見つかっていれば打ち切る.
+        if ( dist[ order[i] ] > record.distance )
+        { break; }
+
+        hit |= m_pNode[ order[i] ]->IsHit( raySet, record );
+    }
+
+    return hit;
+#else
+    const auto ray4 = MakeRay4( raySet );
+
     s32 mask = 0;
-    if ( !m_Box.IsHit( raySet.ray4, mask ) )
+    if ( !m_Box.IsHit( ray4, mask ) )
     { return false; }
 
     auto hit = false;
@@ -186,196 +158,180 @@ bool BVH4::IsHit( const RaySet& raySet, HitRecord& record ) const
     }
 
     return hit;
+#endif
 }
 
 //-------------------------------------------------------------------------------------------------
-//      バウンディングボックスを取得します.
-//-------------------------------------------------------------------------------------------------
-BoundingBox BVH4::GetBox() const
-{ return m_Box.GetBox(); }
-
-//-------------------------------------------------------------------------------------------------
-//      中心座標を取得します
+//      遮蔽判定を行います.
 //-------------------------------------------------------------------------------------------------
-Vector3 BVH4::GetCenter() const
+bool BVH4::IsOccluded( const RaySet& raySet, f32 distance ) const
 {
-    auto result = m_pNode[0]->GetCenter();
-    for( auto i=1; i<4; ++i )
-    { result += m_pNode[i]->GetCenter(); }
-    result /= 4.0f;
+    const auto ray4 = MakeRay4( raySet );
 
-    return result;
-}
-
-//-------------------------------------------------------------------------------------------------
-//      new 演算子のオーバーロードです.
-//-------------------------------------------------------------------------------------------------
-void* BVH4::operator new (size_t size)
-{ return _aligned_malloc(size, 16); }
+    s32  mask = 0;
+    b128 tnear;
+    if ( !m_Box.IsHit( ray4, distance, mask, tnear ) )
+    { return false; }
 
-//-------------------------------------------------------------------------------------------------
-//      new[] 演算子のオーバーロードです.
-//-------------------------------------------------------------------------------------------------
-void* BVH4::operator new[] (size_t size)
-{ return _aligned_malloc(size, 16); }
+    // 遮蔽物が1つでも見つかれば終了するので, 順序付けはしない.
+    for ( auto i=0; i<4; ++i )
+    {
+        auto bit = 0x1 << i;
+        if ( (mask & bit) != bit )
+        { continue; }
 
-//-------------------------------------------------------------------------------------------------
-//      delete 演算子のオーバーロードです.
-//-------------------------------------------------------------------------------------------------
-void BVH4::operator delete (void* ptr)
-{ _aligned_free(ptr); }
+        if ( m_pNode[i]->IsOccluded( raySet, distance ) )
+        { return true; }
+    }
 
-//-------------------------------------------------------------------------------------------------
-//      delete[] 演算子のオーバーロードです.
-//-------------------------------------------------------------------------------------------------
-void BVH4::operator delete[] (void* ptr)
-{ _aligned_free(ptr); }
+    return false;
+}
 
 //-------------------------------------------------------------------------------------------------
-//      SAH分割します.
+//      レイパケットの交差判定を行います.
 //-------------------------------------------------------------------------------------------------
-bool BVH4::SplitSAH( size_t count, IShape** ppShapes, size_t& mid )
+u32 BVH4::IsHitPacket( const RayPacket& packet, u32 active, HitRecord* pRecords ) const
 {
-    // 最小要素に満たないものは葉ノードとして生成.  2つのノードがそれぞれ子供をもつので 2 * 2 = 4 が最小.
-    if ( count <= 4 )
-    { return false; }
-
-    auto bound = CreateMergedBox( count, ppShapes );
+    // パケット全体で最も遠い交差距離.
+    auto distance = 0.0f;
+    for( auto i=0u; i<packet.count; ++i )
+    {
+        if ( ( active & ( 0x1u << i ) ) == 0 )
+        { continue; }
 
-    // バウンディングボックスを生成.
-    auto centroid = CreateCentroidBox( count, ppShapes );
+    #if S3D_TRAVERSAL_STATS
+        pRecords[i].visitCount++;
+    #endif
+        distance = Max( distance, pRecords[i].distance );
+    }
 
-    // 分割軸を決めるためバウンディングボックスの最長軸を取得.
-    auto axis = GetLongestAxis( centroid );
+    // どのレイも交差しない子ノードを区間演算でまとめて除外する.
+    s32 packetMask = 0xf;
+    if ( packet.coherent && !m_Box.IsHit( packet, distance, packetMask ) )
+    { return 0; }
 
-    if (centroid.maxi.a[axis] == centroid.mini.a[axis])
-    { return false; }
+    // 残った子ノードについて, 交差するレイのマスクと入射距離を求める.
+    u32 rays[4] = { 0, 0, 0, 0 };
+    f32 nearest[4] = { F_MAX, F_MAX, F_MAX, F_MAX };
+    S3D_ALIGN(16) f32 dist[RAY_PACKET_SIZE][4];
 
-    // SAH分割バケットの初期化処理.
-    Bucket bucket[BucketCount];
-    for (size_t i=0; i<count; ++i)
+    for( auto i=0u; i<packet.count; ++i )
     {
-        auto idx = static_cast<int>(BucketCount * CalcOffset( centroid, ppShapes[i]->GetCenter() ).a[axis]);
+        if ( ( active & ( 0x1u << i ) ) == 0 )
+        { continue; }
 
-        if ( idx == BucketCount ) 
-        { idx = BucketCount - 1; }
-        assert( 0 <= idx && idx < BucketCount );
+        const auto ray4 = MakeRay4( packet.rays[i] );
 
-        bucket[idx].count++;
-        bucket[idx].box = BoundingBox::Merge( bucket[idx].box, ppShapes[i]->GetBox() );
-    }
+        s32  mask = 0;
+        b128 tnear;
+        if ( !m_Box.IsHit( ray4, pRecords[i].distance, mask, tnear ) )
+        { continue; }
 
-    // 分割後の各バケットに対するコストを計算する.
-    f32 cost[BucketCount - 1];
-    for (auto i=0; i<BucketCount - 1; ++i)
-    {
-        BoundingBox b0, b1;
-        int count0 = 0, count1 = 0;
+        mask &= packetMask;
+        _mm_store_ps( dist[i], tnear );
 
-        for(auto j=0; j<=i; ++j)
+        for( auto j=0; j<4; ++j )
         {
-            b0 = BoundingBox::Merge(b0, bucket[j].box);
-            count0 += bucket[j].count;
-        }
+            if ( ( mask & ( 0x1 << j ) ) == 0 )
+            { continue; }
 
-        for(auto j=i+1; j<BucketCount; ++j)
-        {
-            b1 = BoundingBox::Merge(b1, bucket[j].box);
-            count1 += bucket[j].count;
+            rays[j]   |= 0x1u << i;
+            nearest[j] = Min( nearest[j], dist[i][j] );
         }
+    }
 
-        cost[i] = 1 + (count0 * SurfaceArea(b0) + count1 * SurfaceArea(b1)) / SurfaceArea(bound);
+    // 交差した子ノードをパケット内の最短の入射距離が近い順に並べる.
+    s32 order[4];
+    auto count = 0;
+    for( auto i=0; i<4; ++i )
+    {
+        if ( rays[i] == 0 )
+        { continue; }
+
+        auto j = count++;
+    #if S3D_ORDERED_TRAVERSAL
+        for( ; j > 0 && nearest[ order[j - 1] ] > nearest[i]; --j )
+        { order[j] = order[j - 1]; }
+    #endif
+        order[j] = i;
     }
 
-    // 最小SAHで分割のためのバケットを求める.
-    f32 minCost = cost[0];
-    int minCostSplitBucket = 0;
-    for(auto i=1; i<BucketCount - 1; ++i)
+    u32 hit = 0;
+    for( auto i=0; i<count; ++i )
     {
-        if (cost[i] < minCost)
+        const auto lane = order[i];
+        auto mask = rays[lane];
+
+    #if S3D_ORDERED_TRAVERSAL
+        // より近い交差が見つかったレイは除外する.
+        for( auto j=0u; j<packet.count; ++j )
         {
-            minCost = cost[i];
-            minCostSplitBucket = i;
+            if ( ( mask & ( 0x1u << j ) ) != 0 && dist[j][lane] > pRecords[j].distance )
+            { mask &= ~( 0x1u << j ); }
         }
-    }
+    #endif
 
-    // 選択されたSAHバケットにおいて葉ノードを生成するか，分割するかどうかを決定する.
-    f32 leafCost = static_cast<f32>(count);
-    if (minCost < leafCost)
-    {
-        auto pMid = std::partition(
-            &ppShapes[0],
-            &ppShapes[count - 1] + 1,
-            [=](const IShape* pShape)
-            {
-                auto idx = BucketCount * CalcOffset(centroid, pShape->GetCenter()).a[axis];
-                if ( idx == BucketCount )
-                { idx = BucketCount - 1; }
-                assert( 0 <= idx && idx < BucketCount );
-
-                return idx <= minCostSplitBucket;
-            });
-
-        mid = pMid - &ppShapes[0];
+        if ( mask != 0 )
+        { hit |= m_pNode[lane]->IsHitPacket( packet, mask, pRecords ); }
     }
-    else
-    { return false; }
 
-    return true;
+    return hit;
 }
 
 //-------------------------------------------------------------------------------------------------
-//      中間分割します.
+//      バウンディングボックスを取得します.
 //-------------------------------------------------------------------------------------------------
-bool BVH4::SplitMid( size_t count, IShape** ppShapes, size_t& mid )
-{
-    // 最小要素に満たないものは葉ノードとして生成.  2つのノードがそれぞれ子供をもつので 2 * 2 = 4 が最小.
-    if ( count <= 2 )
-    { return false; }
-
-    auto bound = CreateMergedBox( count, ppShapes );
-
-    // バウンディングボックスを生成.
-    auto centroid = CreateCentroidBox( count, ppShapes );
+BoundingBox BVH4::GetBox() const
+{ return m_Box.GetBox(); }
 
-    // 分割軸を決めるためバウンディングボックスの最長軸を取得.
-    auto axis = GetLongestAxis( centroid );
+//-------------------------------------------------------------------------------------------------
+//      中心座標を取得します
+//-------------------------------------------------------------------------------------------------
+Vector3 BVH4::GetCenter() const
+{
+    auto result = m_pNode[0]->GetCenter();
+    for( auto i=1; i<4; ++i )
+    { result += m_pNode[i]->GetCenter(); }
+    result /= 4.0f;
 
-    if (centroid.maxi.a[axis] == centroid.mini.a[axis])
-    { return false; }
+    return result;
+}
 
-    mid = 0;
-    for (size_t i=0; i<count; ++i)
-    {
-        auto center = ppShapes[i]->GetBox().center;
+//-------------------------------------------------------------------------------------------------
+//      new 演算子のオーバーロードです.
+//-------------------------------------------------------------------------------------------------
+void* BVH4::operator new (size_t size)
+{ return _aligned_malloc(size, 16); }
 
-        if (center.a[axis] < centroid.center.a[axis])
-        {
-            auto pTemp = ppShapes[i];
-            ppShapes[i] = ppShapes[mid];
-            ppShapes[mid] = pTemp;
-            mid++;
-        }
-    }
+//-------------------------------------------------------------------------------------------------
+//      new[] 演算子のオーバーロードです.
+//-------------------------------------------------------------------------------------------------
+void* BVH4::operator new[] (size_t size)
+{ return _aligned_malloc(size, 16); }
 
-    if ( mid == 0 || mid == count )
-    { mid = count / 2; }
+//-------------------------------------------------------------------------------------------------
+//      delete 演算子のオーバーロードです.
+//-------------------------------------------------------------------------------------------------
+void BVH4::operator delete (void* ptr)
+{ _aligned_free(ptr); }
 
-    return true;
-}
+//-------------------------------------------------------------------------------------------------
+//      delete[] 演算子のオーバーロードです.
+//-------------------------------------------------------------------------------------------------
+void BVH4::operator delete[] (void* ptr)
+{ _aligned_free(ptr); }
 
 //-------------------------------------------------------------------------------------------------
 //      分割します.
 //-------------------------------------------------------------------------------------------------
 bool BVH4::Split(size_t count, IShape** ppShapes, size_t& mid)
 {
-#if 0
     // SAHによる分割.
-    return SplitSAH(count, ppShapes, mid);
-#else
-    // 中間値による分割.
+    if ( SplitSAH(count, ppShapes, mid) )
+    { return true; }
+
+    // 4分木を構成するため, SAHで葉と判定された場合も中間値で分割する.
     return SplitMid(count, ppShapes, mid);
-#endif
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -415,11 +371,18 @@ IShape* BVH4::Create(size_t count, IShape** ppShapes)
     auto count2 = idx3  - idx2;
     auto count3 = count - idx3;
 
-    return new BVH4(
-        BVH4::Create(count0, &ppShapes[idx0]),
-        BVH4::Create(count1, &ppShapes[idx1]),
-        BVH4::Create(count2, &ppShapes[idx2]),
-        BVH4::Create(count3, &ppShapes[idx3]) );
+    // 大きな部分木は別スレッドで構築する.
+    IShape* pNode[4] = { nullptr, nullptr, nullptr, nullptr };
+    {
+        BuildTaskGroup group;
+        group.Run( count0, [&]() { pNode[0] = BVH4::Create(count0, &ppShapes[idx0]); } );
+        group.Run( count1, [&]() { pNode[1] = BVH4::Create(count1, &ppShapes[idx1]); } );
+        group.Run( count2, [&]() { pNode[2] = BVH4::Create(count2, &ppShapes[idx2]); } );
+        pNode[3] = BVH4::Create(count3, &ppShapes[idx3]);
+        group.Wait();
+    }
+
+    return new BVH4( pNode[0], pNode[1], pNode[2], pNode[3] );
 }
 
 
@@ -8,11 +8,11 @@
 // Includes
 //-------------------------------------------------------------------------------------------------
 #include <s3d_bvh8.h>
-#include <s3d_bvh4.h>
-#include <s3d_bvh2.h>
-#include <s3d_bucket.h>
-#include <s3d_leaf.h>
-#include <algorithm>
+#include <s3d_bvhbuilder.h>
+#include <s3d_triangle4.h>
+#include <s3d_triangle8.h>
+#include <new>
+#include <cstring>
 
 
 namespace /* anonymous */ {
@@ -20,94 +20,8 @@ namespace /* anonymous */ {
 //-------------------------------------------------------------------------------------------------
 // Constant Values.
 //-------------------------------------------------------------------------------------------------
-constexpr int BucketCount = 16;     //!< バケット数です.
-
-//-------------------------------------------------------------------------------------------------
-//      マージしたバウンディングボックスを生成します.
-//-------------------------------------------------------------------------------------------------
-s3d::BoundingBox CreateMergedBox( size_t count, s3d::IShape** ppShapes )
-{
-    if ( count == 0 || ppShapes == nullptr )
-    { return s3d::BoundingBox(); }
-
-    s3d::BoundingBox box = ppShapes[0]->GetBox();
-
-    for( size_t i=1; i<count; ++i )
-    { box = s3d::BoundingBox::Merge( box, ppShapes[i]->GetBox() ); }
-
-    return box;
-}
-
-//-------------------------------------------------------------------------------------------------
-//      中心座標をもとにバウンディングボックスを生成します.
-//-------------------------------------------------------------------------------------------------
-s3d::BoundingBox CreateCentroidBox( size_t count, s3d::IShape** ppShapes )
-{
-    if ( count == 0 || ppShapes == nullptr )
-    { return s3d::BoundingBox(); }
-
-    s3d::BoundingBox box( ppShapes[0]->GetCenter() );
-
-    for( size_t i=1; i<count; ++i )
-    { box = s3d::BoundingBox::Merge( box, ppShapes[i]->GetCenter() ); }
-
-    return box;
-}
-
-//-------------------------------------------------------------------------------------------------
-//      最長軸を取得します.
-//-------------------------------------------------------------------------------------------------
-int GetLongestAxis( const s3d::BoundingBox& box )
-{
-    auto vec = box.maxi - box.mini;
-
-    if (vec.x > vec.y && vec.x > vec.z)
-    { return 0; }
-    else if (vec.y > vec.z)
-    { return 1; }
-    else
-    { return 2; }
-}
-
-//-------------------------------------------------------------------------------------------------
-//      オフセットを求めます.
-//-------------------------------------------------------------------------------------------------
-s3d::Vector3 CalcOffset( const s3d::BoundingBox& box, const s3d::Vector3& p )
-{
-    auto offset = p - box.mini;
-
-    if (box.maxi.x > box.mini.x)
-    { offset.x /= box.maxi.x - box.mini.x; }
-
-    if (box.maxi.y > box.mini.y)
-    { offset.y /= box.maxi.y - box.mini.y; }
-
-    if (box.maxi.z > box.mini.z)
-    { offset.z /= box.maxi.z - box.mini.z; }
-
-    return offset;
-}
-
-//-------------------------------------------------------------------------------------------------
-//      葉ノードを生成します.
-//-------------------------------------------------------------------------------------------------
-s3d::IShape* CreateNode( size_t count, s3d::IShape** ppShapes )
-{
-#if 0 // 細かすぎると遅くなるので BVH は作らない.
-    if ( count <= 4 )
-    { return s3d::Leaf::Create(count, ppShapes); }
-
-    if ( count <= 16 )
-    { return s3d::BVH2::Create(count, ppShapes); }
-
-    return s3d::BVH4::Create(count, ppShapes);
-#else
-    if ( count <= 8 )
-    { return s3d::Leaf::Create(count, ppShapes); }
-
-    return s3d::BVH4::Create(count, ppShapes);
-#endif
-}
+constexpr int MaxLeafCount  = 8;      //!< 葉に格納する最大形状数です.
+constexpr int StackSize     = 256;    //!< 関数内に確保する走査スタックのサイズです.
 
 } // namespace /* anonymous */
 
@@ -121,46 +35,35 @@ namespace s3d {
 //-------------------------------------------------------------------------------------------------
 //      コンストラクタです.
 //-------------------------------------------------------------------------------------------------
-BVH8::BVH8
-(
-    IShape* pShape0,
-    IShape* pShape1,
-    IShape* pShape2,
-    IShape* pShape3,
-    IShape* pShape4,
-    IShape* pShape5,
-    IShape* pShape6,
-    IShape* pShape7
-)
-: m_Count(1)
-{
-    m_pNode[0] = pShape0;
-    m_pNode[1] = pShape1;
-    m_pNode[2] = pShape2;
-    m_pNode[3] = pShape3;
-    m_pNode[4] = pShape4;
-    m_pNode[5] = pShape5;
-    m_pNode[6] = pShape6;
-    m_pNode[7] = pShape7;
-
-    m_Box = BoundingBox8(
-        pShape0->GetBox(),
-        pShape1->GetBox(),
-        pShape2->GetBox(),
-        pShape3->GetBox(),
-        pShape4->GetBox(),
-        pShape5->GetBox(),
-        pShape6->GetBox(),
-        pShape7->GetBox());
-}
+BVH8::BVH8()
+: m_Count     ( 1 )
+, m_Box       ()
+, m_pNodes    ( nullptr )
+, m_NodeCount ( 0 )
+, m_ppShapes  ( nullptr )
+, m_ShapeCount( 0 )
+, m_StackSize ( 0 )
+{ /* DO_NOTHING */ }
 
 //-------------------------------------------------------------------------------------------------
 //      デストラクタです.
 //-------------------------------------------------------------------------------------------------
 BVH8::~BVH8()
 {
-    for(auto i=0; i<8; ++i)
-    { SafeRelease( m_pNode[i] ); }
+    for( u32 i=0; i<m_ShapeCount; ++i )
+    { SafeRelease( m_ppShapes[i] ); }
+
+    SafeDeleteArray( m_ppShapes );
+
+    if ( m_pNodes != nullptr )
+    {
+        _aligned_free( m_pNodes );
+        m_pNodes = nullptr;
+    }
+
+    m_NodeCount  = 0;
+    m_ShapeCount = 0;
+    m_StackSize  = 0;
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -190,292 +93,626 @@ u32 BVH8::GetCount() const
 //-------------------------------------------------------------------------------------------------
 bool BVH8::IsHit( const RaySet& raySet, HitRecord& record ) const
 {
-    s32 mask = 0;
-    if ( !m_Box.IsHit( raySet.ray8, mask ) )
-    { return false; }
+    // ブロードキャストは走査前に1度だけ行う.
+    const auto ray8 = MakeRay8( raySet );
+
+    // 内部ノードと葉の両方を距離付きで積む.
+    // 木が深い場合は構築時に求めたサイズでヒープに確保する.
+    StackEntry local[StackSize];
+    std::vector<StackEntry> heap;
+    auto stack = local;
+    if ( m_StackSize > u32( StackSize ) )
+    {
+        heap.resize( m_StackSize );
+        stack = heap.data();
+    }
+
+    s32 top = 0;
+    stack[top].child = 0;
+    stack[top].count = 0;
+    stack[top].dist  = 0.0f;
+    top++;
 
     auto hit = false;
-    for (auto i=0; i<8; ++i)
+    while( top > 0 )
     {
-        auto bit = 0x1 << i;
-        if ( (mask & bit) == bit )
-        { hit |= m_pNode[i]->IsHit( raySet, record ); }
+        const auto entry = stack[--top];
+
+    #if S3D_ORDERED_TRAVERSAL
+        // より近い交差が見つかっていれば打ち切る.
+        if ( entry.dist > record.distance )
+        { continue; }
+    #endif
+
+        // 葉の場合は形状と交差判定.
+        if ( entry.count > 0 )
+        {
+            const auto end = entry.child + static_cast<s32>( entry.count );
+            for( auto j=entry.child; j<end; ++j )
+            { hit |= m_ppShapes[j]->IsHit( raySet, record ); }
+            continue;
+        }
+
+        const auto& node = m_pNodes[ entry.child ];
+    #if S3D_TRAVERSAL_STATS
+        record.visitCount++;
+    #endif
+
+        s32  mask = 0;
+        b256 tnear;
+        if ( !node.box.IsHit( ray8, record.distance, mask, tnear ) )
+        { continue; }
+
+        mask &= node.mask;
+
+        S3D_ALIGN(32) f32 dist[8];
+        _mm256_store_ps( dist, tnear );
+
+        // 交差した子ノードを入射距離の遠い順に並べる.
+        s32 order[8];
+        auto count = 0;
+        for( auto i=0; i<8; ++i )
+        {
+            auto bit = 0x1 << i;
+            if ( (mask & bit) != bit )
+            { continue; }
+
+            auto j = count++;
+        #if S3D_ORDERED_TRAVERSAL
+            for( ; j > 0 && dist[ order[j - 1] ] < dist[i]; --j )
+            { order[j] = order[j - 1]; }
+        #endif
+            order[j] = i;
+        }
+
+        // 遠いものから積むので, 近いものから取り出される.
+        if ( u32( top + count ) > m_StackSize )
+        { break; }
+
+        for( auto i=0; i<count; ++i )
+        {
+            const auto lane = order[i];
+            stack[top].child = node.child[lane];
+            stack[top].count = node.count[lane];
+            stack[top].dist  = dist[lane];
+            top++;
+        }
     }
 
     return hit;
 }
 
 //-------------------------------------------------------------------------------------------------
-//      バウンディングボックスを取得します.
+//      遮蔽判定を行います.
 //-------------------------------------------------------------------------------------------------
-BoundingBox BVH8::GetBox() const
-{ return m_Box.GetBox(); }
+bool BVH8::IsOccluded( const RaySet& raySet, f32 distance ) const
+{
+    const auto ray8 = MakeRay8( raySet );
+
+    s32 local[StackSize];
+    std::vector<s32> heap;
+    auto stack = local;
+    if ( m_StackSize > u32( StackSize ) )
+    {
+        heap.resize( m_StackSize );
+        stack = heap.data();
+    }
+
+    s32 top = 0;
+    stack[top++] = 0;
+
+    // 遮蔽物が1つでも見つかれば終了するので, 順序付けはしない.
+    while( top > 0 )
+    {
+        const auto& node = m_pNodes[ stack[--top] ];
+
+        s32  mask = 0;
+        b256 tnear;
+        if ( !node.box.IsHit( ray8, distance, mask, tnear ) )
+        { continue; }
+
+        mask &= node.mask;
+        for( auto i=0; i<8; ++i )
+        {
+            auto bit = 0x1 << i;
+            if ( (mask & bit) != bit )
+            { continue; }
+
+            if ( node.count[i] == 0 )
+            {
+                if ( u32( top ) >= m_StackSize )
+                { return false; }
+
+                stack[top++] = node.child[i];
+                continue;
+            }
+
+            const auto end = node.child[i] + static_cast<s32>( node.count[i] );
+            for( auto j=node.child[i]; j<end; ++j )
+            {
+                if ( m_ppShapes[j]->IsOccluded( raySet, distance ) )
+                { return true; }
+            }
+        }
+    }
+
+    return false;
+}
 
 //-------------------------------------------------------------------------------------------------
-//      中心座標を取得します.
+//      レイパケットの交差判定を行います.
 //-------------------------------------------------------------------------------------------------
-Vector3 BVH8::GetCenter() const
+u32 BVH8::IsHitPacket( const RayPacket& packet, u32 active, HitRecord* pRecords ) const
 {
-    auto result = m_pNode[0]->GetCenter();
-    for (auto i=0; i<8; ++i)
-    { result += m_pNode[i]->GetCenter(); }
-    result /= 8.0f;
+    // ブロードキャストは走査前に1度だけ行う.
+    Ray8 ray8[RAY_PACKET_SIZE];
+    for( auto i=0u; i<packet.count; ++i )
+    { ray8[i] = MakeRay8( packet.rays[i] ); }
+
+    PacketEntry local[StackSize];
+    std::vector<PacketEntry> heap;
+    auto stack = local;
+    if ( m_StackSize > u32( StackSize ) )
+    {
+        heap.resize( m_StackSize );
+        stack = heap.data();
+    }
+
+    s32 top = 0;
+    stack[top].child = 0;
+    stack[top].count = 0;
+    stack[top].rays  = active;
+    stack[top].dist  = 0.0f;
+    top++;
+
+    u32 hit = 0;
+    while( top > 0 )
+    {
+        const auto entry = stack[--top];
+
+        // パケット全体で最も遠い交差距離.
+        auto rays     = entry.rays;
+        auto distance = 0.0f;
+        for( auto i=0u; i<packet.count; ++i )
+        {
+            if ( ( rays & ( 0x1u << i ) ) == 0 )
+            { continue; }
+
+        #if S3D_ORDERED_TRAVERSAL
+            // より近い交差が見つかったレイは除外する.
+            if ( entry.dist > pRecords[i].distance )
+            {
+                rays &= ~( 0x1u << i );
+                continue;
+            }
+        #endif
+            distance = Max( distance, pRecords[i].distance );
+        }
+
+        if ( rays == 0 )
+        { continue; }
+
+        // 葉の場合は形状と交差判定.
+        if ( entry.count > 0 )
+        {
+            const auto end = entry.child + static_cast<s32>( entry.count );
+            for( auto j=entry.child; j<end; ++j )
+            { hit |= m_ppShapes[j]->IsHitPacket( packet, rays, pRecords ); }
+            continue;
+        }
+
+        const auto& node = m_pNodes[ entry.child ];
+
+        // どのレイも交差しない子ノードを区間演算でまとめて除外する.
+        s32 packetMask = node.mask;
+        if ( packet.coherent )
+        {
+            s32 mask = 0;
+            if ( !node.box.IsHit( packet, distance, mask ) )
+            { continue; }
+
+            packetMask &= mask;
+        }
+
+        // 残った子ノードについて, 交差するレイのマスクと入射距離を求める.
+        u32 childRays[8] = {};
+        f32 nearest[8] = { F_MAX, F_MAX, F_MAX, F_MAX, F_MAX, F_MAX, F_MAX, F_MAX };
+
+        for( auto i=0u; i<packet.count; ++i )
+        {
+            if ( ( rays & ( 0x1u << i ) ) == 0 )
+            { continue; }
+
+        #if S3D_TRAVERSAL_STATS
+            pRecords[i].visitCount++;
+        #endif
 
-    return result;
+            s32  mask = 0;
+            b256 tnear;
+            if ( !node.box.IsHit( ray8[i], pRecords[i].distance, mask, tnear ) )
+            { continue; }
+
+            mask &= packetMask;
+
+            S3D_ALIGN(32) f32 dist[8];
+            _mm256_store_ps( dist, tnear );
+
+            for( auto j=0; j<8; ++j )
+            {
+                if ( ( mask & ( 0x1 << j ) ) == 0 )
+                { continue; }
+
+                childRays[j] |= 0x1u << i;
+                nearest[j]    = Min( nearest[j], dist[j] );
+            }
+        }
+
+        // 交差した子ノードを入射距離の遠い順に並べる.
+        s32 order[8];
+        auto count = 0;
+        for( auto i=0; i<8; ++i )
+        {
+            if ( childRays[i] == 0 )
+            { continue; }
+
+            auto j = count++;
+        #if S3D_ORDERED_TRAVERSAL
+            for( ; j > 0 && nearest[ order[j - 1] ] < nearest[i]; --j )
+            { order[j] = order[j - 1]; }
+        #endif
+            order[j] = i;
+        }
+
+        // 遠いものから積むので, 近いものから取り出される.
+        if ( u32( top + count ) > m_StackSize )
+        { break; }
+
+        for( auto i=0; i<count; ++i )
+        {
+            const auto lane = order[i];
+            stack[top].child = node.child[lane];
+            stack[top].count = node.count[lane];
+            stack[top].rays  = childRays[lane];
+            stack[top].dist  = nearest[lane];
+            top++;
+        }
+    }
+
+    return hit;
 }
 
 //-------------------------------------------------------------------------------------------------
-//      new 演算子のオーバーロードです.
+//      バウンディングボックスを取得します.
 //-------------------------------------------------------------------------------------------------
-void* BVH8::operator new (size_t size)
-{ return _aligned_malloc(size, 32); }
+BoundingBox BVH8::GetBox() const
+{ return m_Box; }
 
 //-------------------------------------------------------------------------------------------------
-//      new[] 演算子のオーバーロードです.
+//      中心座標を取得します.
 //-------------------------------------------------------------------------------------------------
-void* BVH8::operator new[] (size_t size)
-{ return _aligned_malloc(size, 32); }
+Vector3 BVH8::GetCenter() const
+{ return m_Box.center; }
 
-//-------------------------------------------------------------------------------------------------
-//      delete 演算子のオーバーロードです.
-//-------------------------------------------------------------------------------------------------
-void BVH8::operator delete (void* ptr)
-{ _aligned_free(ptr); }
+//------------------------------------------------------------------------------------------------
+//      分割します.
+//------------------------------------------------------------------------------------------------
+bool BVH8::Split( size_t count, IShape** ppShapes, size_t& mid )
+{
+    // SAHによる分割.
+    if ( SplitSAH( count, ppShapes, mid ) )
+    { return true; }
 
-//-------------------------------------------------------------------------------------------------
-//      delete[] 演算子のオーバーロードです.
-//-------------------------------------------------------------------------------------------------
-void BVH8::operator delete[] (void* ptr)
-{ _aligned_free(ptr); }
+    // 葉の形状数を抑えるため, SAHで葉と判定された場合も中間値で分割する.
+    return SplitMid( count, ppShapes, mid );
+}
 
 //-------------------------------------------------------------------------------------------------
-//      SAH分割します.
+//      ノードを再帰的に構築します.
 //-------------------------------------------------------------------------------------------------
-bool BVH8::SplitSAH( size_t count, IShape** ppShapes, size_t& mid )
+s32 BVH8::Build( std::vector<BuildNode>& nodes, IShape** ppShapes, size_t offset, size_t count )
 {
-    // 最小要素に満たないものは葉ノードとして生成
-    if ( count <= 8 )
-    { return false; }
+    // 2分割を繰り返して最大8つの範囲に分ける.
+    size_t rangeOffset[8] = { offset };
+    size_t rangeCount [8] = { count };
+    bool   splittable [8] = { true };
+    auto   rangeNum = 1;
+
+    while( rangeNum < 8 )
+    {
+        // 分割可能な最大の範囲を選ぶ.
+        auto target = -1;
+        for( auto i=0; i<rangeNum; ++i )
+        {
+            if ( !splittable[i] || rangeCount[i] <= MaxLeafCount )
+            { continue; }
 
-    auto bound = CreateMergedBox( count, ppShapes );
+            if ( target < 0 || rangeCount[i] > rangeCount[target] )
+            { target = i; }
+        }
 
-    // バウンディングボックスを生成.
-    auto centroid = CreateCentroidBox( count, ppShapes );
+        if ( target < 0 )
+        { break; }
 
-    // 分割軸を決めるためバウンディングボックスの最長軸を取得.
-    auto axis = GetLongestAxis( centroid );
+        size_t mid = 0;
+        if ( !Split( rangeCount[target], &ppShapes[ rangeOffset[target] ], mid ) )
+        {
+            splittable[target] = false;
+            continue;
+        }
 
-    if (centroid.maxi.a[axis] == centroid.mini.a[axis])
-    { return false; }
+        rangeOffset[rangeNum] = rangeOffset[target] + mid;
+        rangeCount [rangeNum] = rangeCount [target] - mid;
+        splittable [rangeNum] = true;
+        rangeCount [target]   = mid;
+        rangeNum++;
+    }
 
-    // SAH分割バケットの初期化処理.
-    Bucket bucket[BucketCount];
-    for (size_t i=0; i<count; ++i)
+    // 大きな部分木は別スレッドで一時的なノード配列に構築する.
+    std::vector<BuildNode> subNodes[8];
     {
-        auto idx = static_cast<int>(BucketCount * CalcOffset( centroid, ppShapes[i]->GetCenter() ).a[axis]);
-
-        if ( idx == BucketCount ) 
-        { idx = BucketCount - 1; }
-        assert( 0 <= idx && idx < BucketCount );
+        BuildTaskGroup group;
+        for( auto i=0; i<rangeNum; ++i )
+        {
+            if ( rangeCount[i] <= MaxLeafCount || !splittable[i] || rangeNum == 1 )
+            { continue; }
 
-        bucket[idx].count++;
-        bucket[idx].box = BoundingBox::Merge( bucket[idx].box, ppShapes[i]->GetBox() );
+            group.Run( rangeCount[i], [&, i]()
+            { Build( subNodes[i], ppShapes, rangeOffset[i], rangeCount[i] ); });
+        }
+        group.Wait();
     }
 
-    // 分割後の各バケットに対するコストを計算する.
-    f32 cost[BucketCount - 1];
-    for (auto i=0; i<BucketCount - 1; ++i)
+    // 親を先に確保して, 子が後ろに連続して並ぶようにする.
+    const auto index = static_cast<s32>( nodes.size() );
+    nodes.push_back( BuildNode() );
+    nodes[index].childCount = rangeNum;
+
+    for( auto i=0; i<rangeNum; ++i )
     {
-        BoundingBox b0, b1;
-        int count0 = 0, count1 = 0;
+        auto box = CreateMergedBox( rangeCount[i], &ppShapes[ rangeOffset[i] ] );
 
-        for(auto j=0; j<=i; ++j)
+        s32 child = 0;
+        u32 leafCount = 0;
+        if ( subNodes[i].empty() )
         {
-            b0 = BoundingBox::Merge(b0, bucket[j].box);
-            count0 += bucket[j].count;
+            child     = static_cast<s32>( rangeOffset[i] );
+            leafCount = static_cast<u32>( rangeCount[i] );
         }
-
-        for(auto j=i+1; j<BucketCount; ++j)
+        else
         {
-            b1 = BoundingBox::Merge(b1, bucket[j].box);
-            count1 += bucket[j].count;
+            // 部分木のノード番号を連結後の位置に付け替える.
+            child = static_cast<s32>( nodes.size() );
+            for( auto& node : subNodes[i] )
+            {
+                for( auto j=0; j<node.childCount; ++j )
+                {
+                    if ( node.count[j] == 0 )
+                    { node.child[j] += child; }
+                }
+                nodes.push_back( node );
+            }
         }
 
-        cost[i] = 1 + (count0 * SurfaceArea(b0) + count1 * SurfaceArea(b1)) / SurfaceArea(bound);
+        // push_back で再確保されるため, 子の構築後にアクセスする.
+        nodes[index].box  [i] = box;
+        nodes[index].child[i] = child;
+        nodes[index].count[i] = leafCount;
     }
 
-    // 最小SAHで分割のためのバケットを求める.
-    f32 minCost = cost[0];
-    int minCostSplitBucket = 0;
-    for(auto i=1; i<BucketCount - 1; ++i)
+    return index;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      構築済みのノードから走査用のデータを生成します.
+//-------------------------------------------------------------------------------------------------
+IShape* BVH8::CreateFromNodes( size_t count, IShape** ppShapes, std::vector<BuildNode>& nodes )
+{
+    auto instance = new(std::nothrow) BVH8();
+    if ( instance == nullptr )
+    { return nullptr; }
+
+    // 連続したアライメント済みの配列に詰め直す.
+    instance->m_NodeCount = static_cast<u32>( nodes.size() );
+    instance->m_pNodes    = static_cast<Node*>( _aligned_malloc( sizeof(Node) * nodes.size(), 32 ) );
+    if ( instance->m_pNodes == nullptr )
     {
-        if (cost[i] < minCost)
-        {
-            minCost = cost[i];
-            minCostSplitBucket = i;
-        }
+        SafeRelease( instance );
+        return nullptr;
     }
 
-    // 選択されたSAHバケットにおいて葉ノードを生成するか，分割するかどうかを決定する.
-    f32 leafCost = static_cast<f32>(count);
-    if (minCost < leafCost)
+    // 葉の形状配列を生成する. 三角形のみの葉はまとめてSIMDで判定できる形式にする.
+    std::vector<IShape*> shapes;
+    shapes.reserve( count );
+
+    for( size_t i=0; i<nodes.size(); ++i )
     {
-        auto pMid = std::partition(
-            &ppShapes[0],
-            &ppShapes[count - 1] + 1,
-            [=](const IShape* pShape)
-            {
-                auto idx = BucketCount * CalcOffset(centroid, pShape->GetCenter()).a[axis];
-                if ( idx == BucketCount )
-                { idx = BucketCount - 1; }
-                assert( 0 <= idx && idx < BucketCount );
+        auto& src = nodes[i];
+        for( auto j=0; j<src.childCount; ++j )
+        {
+            if ( src.count[j] == 0 )
+            { continue; }
 
-                return idx <= minCostSplitBucket;
-            });
+            auto ppLeaf = &ppShapes[ src.child[j] ];
+            auto offset = static_cast<s32>( shapes.size() );
 
-        mid = pMid - &ppShapes[0];
+            IShape* pPacked = nullptr;
+        #if S3D_PACKED_TRIANGLE
+            if ( src.count[j] <= 4 )
+            { pPacked = Triangle4::Create( src.count[j], ppLeaf ); }
+            else if ( src.count[j] <= 8 )
+            { pPacked = Triangle8::Create( src.count[j], ppLeaf ); }
+        #endif
+
+            if ( pPacked != nullptr )
+            {
+                shapes.push_back( pPacked );
+                src.count[j] = 1;
+            }
+            else
+            {
+                for( u32 k=0; k<src.count[j]; ++k )
+                {
+                    ppLeaf[k]->AddRef();
+                    shapes.push_back( ppLeaf[k] );
+                }
+            }
+
+            src.child[j] = offset;
+        }
     }
-    else
-    { return false; }
 
-    return true;
-}
+    instance->m_ppShapes = new(std::nothrow) IShape* [shapes.size()];
+    if ( instance->m_ppShapes == nullptr )
+    {
+        for( auto& pShape : shapes )
+        { SafeRelease( pShape ); }
 
-//-------------------------------------------------------------------------------------------------
-//      中間分割します.
-//-------------------------------------------------------------------------------------------------
-bool BVH8::SplitMid( size_t count, IShape** ppShapes, size_t& mid )
-{
-    // 最小要素に満たないものは葉ノードとして生成.  2つのノードがそれぞれ子供をもつので 2 * 2 = 4 が最小.
-    if ( count <= 2 )
-    { return false; }
+        SafeRelease( instance );
+        return nullptr;
+    }
 
-    auto bound = CreateMergedBox( count, ppShapes );
+    for( size_t i=0; i<shapes.size(); ++i )
+    { instance->m_ppShapes[i] = shapes[i]; }
+    instance->m_ShapeCount = static_cast<u32>( shapes.size() );
 
-    // バウンディングボックスを生成.
-    auto centroid = CreateCentroidBox( count, ppShapes );
+    for( size_t i=0; i<nodes.size(); ++i )
+    {
+        const auto& src = nodes[i];
+        auto&       dst = instance->m_pNodes[i];
 
-    // 分割軸を決めるためバウンディングボックスの最長軸を取得.
-    auto axis = GetLongestAxis( centroid );
+        BoundingBox box[8];
+        for( auto j=0; j<src.childCount; ++j )
+        { box[j] = src.box[j]; }
 
-    if (centroid.maxi.a[axis] == centroid.mini.a[axis])
-    { return false; }
+        dst.box  = BoundingBox8( box );
+        dst.mask = ( 0x1 << src.childCount ) - 1;
+        for( auto j=0; j<8; ++j )
+        {
+            dst.child[j] = ( j < src.childCount ) ? src.child[j] : 0;
+            dst.count[j] = ( j < src.childCount ) ? src.count[j] : 0;
+        }
+    }
 
-    mid = 0;
-    for (size_t i=0; i<count; ++i)
+    // 子は必ず親より後ろにあるので, 前から順に深さが確定する.
+    // 1段降りるごとに取り出した1つを除く最大7つが残るため, 必要なスタックサイズは 7 * 深さ + 1 となる.
+    std::vector<u32> depth( nodes.size(), 1 );
+    u32 maxDepth = 1;
+    for( size_t i=0; i<nodes.size(); ++i )
     {
-        auto center = ppShapes[i]->GetBox().center;
-
-        if (center.a[axis] < centroid.center.a[axis])
+        const auto& src = nodes[i];
+        for( auto j=0; j<src.childCount; ++j )
         {
-            auto pTemp = ppShapes[i];
-            ppShapes[i] = ppShapes[mid];
-            ppShapes[mid] = pTemp;
-            mid++;
+            if ( src.count[j] != 0 )
+            { continue; }
+
+            depth[ src.child[j] ] = depth[i] + 1;
+            maxDepth = ( maxDepth > depth[i] + 1 ) ? maxDepth : depth[i] + 1;
         }
     }
+    instance->m_StackSize = 7 * maxDepth + 1;
 
-    if ( mid == 0 || mid == count )
-    { mid = count / 2; }
+    instance->m_Box = CreateMergedBox( count, ppShapes );
 
-    return true;
+    return instance;
 }
 
-//------------------------------------------------------------------------------------------------
-//      分割します.
-//------------------------------------------------------------------------------------------------
-bool BVH8::Split( size_t count, IShape** ppShapes, size_t& mid )
+//-------------------------------------------------------------------------------------------------
+//      生成処理を行います.
+//-------------------------------------------------------------------------------------------------
+IShape* BVH8::Create(size_t count, IShape** ppShapes)
+{ return Create( count, ppShapes, nullptr ); }
+
+//-------------------------------------------------------------------------------------------------
+//      生成処理を行い, 構築結果をキャッシュ用のノード配列として取得します.
+//-------------------------------------------------------------------------------------------------
+IShape* BVH8::Create(size_t count, IShape** ppShapes, std::vector<CacheNode>* pCache)
 {
-#if 0
-    // SAHによる分割.
-    return SplitSAH( count, ppShapes, mid );
-#else
-    // 中間値による分割.
-    return SplitMid( count, ppShapes, mid );
-#endif
+    if ( count == 0 || ppShapes == nullptr )
+    { return nullptr; }
+
+    // 一時的なノードで構築する. 形状配列は葉の範囲順に並び替えられる.
+    std::vector<BuildNode> nodes;
+    nodes.reserve( count / 4 + 1 );
+    Build( nodes, ppShapes, 0, count );
+
+    // 三角形をまとめる前の構築結果を保存する.
+    if ( pCache != nullptr )
+    {
+        pCache->resize( nodes.size() );
+        for( size_t i=0; i<nodes.size(); ++i )
+        {
+            const auto& src = nodes[i];
+            auto&       dst = (*pCache)[i];
+            memset( &dst, 0, sizeof(dst) );
+
+            dst.childCount = src.childCount;
+            for( auto j=0; j<src.childCount; ++j )
+            {
+                dst.mini[j][0] = src.box[j].mini.x;
+                dst.mini[j][1] = src.box[j].mini.y;
+                dst.mini[j][2] = src.box[j].mini.z;
+                dst.maxi[j][0] = src.box[j].maxi.x;
+                dst.maxi[j][1] = src.box[j].maxi.y;
+                dst.maxi[j][2] = src.box[j].maxi.z;
+                dst.child[j]   = src.child[j];
+                dst.count[j]   = src.count[j];
+            }
+        }
+    }
+
+    return CreateFromNodes( count, ppShapes, nodes );
 }
 
 //-------------------------------------------------------------------------------------------------
-//      生成処理を行います.
+//      キャッシュ済みのノード配列から生成します.
 //-------------------------------------------------------------------------------------------------
-IShape* BVH8::Create(size_t count, IShape** ppShapes)
+IShape* BVH8::Create(size_t count, IShape** ppShapes, const CacheNode* pNodes, size_t nodeCount)
 {
-    if ( count <= 8 )
-    { return CreateNode( count, ppShapes ); }
-
-    size_t mid = 0;
-    if ( !Split( count, ppShapes, mid ) )
-    { return CreateNode( count, ppShapes ); }
-
-    auto idxL = 0;
-    auto idxR = mid;
-
-    auto countL = mid;
-    auto countR = count - mid;
-
-    size_t midL = 0;
-    size_t midR = 0;
-
-    if ( !Split( countL, &ppShapes[idxL], midL ) )
-    { return CreateNode( count, ppShapes ); }
-
-    if ( !Split( countR, &ppShapes[idxR], midR ) )
-    { return CreateNode( count, ppShapes ); }
-
-    auto idxA = 0;
-    auto idxB = midL;
-    auto idxC = mid;
-    auto idxD = mid + midR;
-
-    auto countA = idxB  - idxA;
-    auto countB = idxC  - idxB;
-    auto countC = idxD  - idxC;
-    auto countD = count - idxD;
-
-    size_t mid0 = 0;
-    size_t mid1 = 0;
-    size_t mid2 = 0;
-    size_t mid3 = 0;
-
-    if ( !Split( countA, &ppShapes[idxA], mid0 ) )
-    { return CreateNode( count, ppShapes ); }
-
-    if ( !Split( countB, &ppShapes[idxB], mid1 ) )
-    { return CreateNode( count, ppShapes ); }
-
-    if ( !Split( countC, &ppShapes[idxC], mid2 ) )
-    { return CreateNode( count, ppShapes ); }
-
-    if ( !Split( countD, &ppShapes[idxD], mid3 ) )
-    { return CreateNode( count, ppShapes ); }
-
-    auto idx0 = 0;
-    auto idx1 = mid0;
-    auto idx2 = midL;
-    auto idx3 = midL + mid1;
-    auto idx4 = mid;
-    auto idx5 = mid + mid2;
-    auto idx6 = mid + midR;
-    auto idx7 = mid + midR + mid3;
-
-    auto count0 = idx1  - idx0;
-    auto count1 = idx2  - idx1;
-    auto count2 = idx3  - idx2;
-    auto count3 = idx4  - idx3;
-    auto count4 = idx5  - idx4;
-    auto count5 = idx6  - idx5;
-    auto count6 = idx7  - idx6;
-    auto count7 = count - idx7;
-
-    return new BVH8(
-        BVH8::Create(count0, &ppShapes[idx0]),
-        BVH8::Create(count1, &ppShapes[idx1]),
-        BVH8::Create(count2, &ppShapes[idx2]),
-        BVH8::Create(count3, &ppShapes[idx3]),
-        BVH8::Create(count4, &ppShapes[idx4]),
-        BVH8::Create(count5, &ppShapes[idx5]),
-        BVH8::Create(count6, &ppShapes[idx6]),
-        BVH8::Create(count7, &ppShapes[idx7]));
+    if ( count == 0 || ppShapes == nullptr || pNodes == nullptr || nodeCount == 0 )
+    { return nullptr; }
+
+    std::vector<BuildNode> nodes( nodeCount );
+
+    // 範囲外参照や循環が無いことを確認しながら変換する.
+    size_t leafTotal = 0;
+    for( size_t i=0; i<nodeCount; ++i )
+    {
+        const auto& src = pNodes[i];
+        auto&       dst = nodes[i];
+
+        if ( src.childCount <= 0 || src.childCount > 8 )
+        { return nullptr; }
+
+        dst.childCount = src.childCount;
+        for( auto j=0; j<src.childCount; ++j )
+        {
+            if ( src.count[j] == 0 )
+            {
+                // 子ノードは必ず親より後ろに配置されている.
+                if ( src.child[j] <= static_cast<s32>( i ) || size_t( src.child[j] ) >= nodeCount )
+                { return nullptr; }
+            }
+            else
+            {
+                if ( src.child[j] < 0 || size_t( src.child[j] ) + src.count[j] > count )
+                { return nullptr; }
+
+                leafTotal += src.count[j];
+            }
+
+            dst.box[j]   = BoundingBox(
+                Vector3( src.mini[j][0], src.mini[j][1], src.mini[j][2] ),
+                Vector3( src.maxi[j][0], src.maxi[j][1], src.maxi[j][2] ) );
+            dst.child[j] = src.child[j];
+            dst.count[j] = src.count[j];
+        }
+    }
+
+    // 全ての形状がちょうど1回ずつ葉に含まれている必要がある.
+    if ( leafTotal != count )
+    { return nullptr; }
+
+    return CreateFromNodes( count, ppShapes, nodes );
 }
 
 } // namespace s3d
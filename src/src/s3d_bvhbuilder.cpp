@@ -0,0 +1,383 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_bvhbuilder.cpp
+// Desc : BVH Builder Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_bvhbuilder.h>
+#include <s3d_bucket.h>
+#include <algorithm>
+#include <atomic>
+
+
+namespace /* anonymous */ {
+
+//-------------------------------------------------------------------------------------------------
+// Constant Values.
+//-------------------------------------------------------------------------------------------------
+constexpr int       BucketCount       = 16;         //!< 1軸あたりのバケット数です.
+constexpr size_t    ParallelTaskCount = 4096;       //!< 部分木を別スレッドで構築する最小形状数です.
+constexpr size_t    ParallelBinCount  = 65536;      //!< ビン分割を並列化する最小形状数です.
+constexpr size_t    MinChunkCount     = 16384;      //!< 並列ビン分割時の1スレッドあたりの最小形状数です.
+
+//-------------------------------------------------------------------------------------------------
+// Global Varaibles.
+//-------------------------------------------------------------------------------------------------
+std::atomic<s32>   g_WorkerCount( 0 );         //!< 構築に使用中の追加スレッド数です.
+
+//-------------------------------------------------------------------------------------------------
+//      追加スレッドの最大数を取得します.
+//-------------------------------------------------------------------------------------------------
+s32 GetMaxWorkerCount()
+{
+    static const s32 count = s3d::Max( static_cast<s32>( std::thread::hardware_concurrency() ) - 1, 0 );
+    return count;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      空きスレッドを最大 request 個確保し, 確保できた数を返却します.
+//-------------------------------------------------------------------------------------------------
+s32 AcquireWorker( s32 request )
+{
+    const auto maxCount = GetMaxWorkerCount();
+    auto current = g_WorkerCount.load();
+
+    for(;;)
+    {
+        auto count = s3d::Min( request, maxCount - current );
+        if ( count <= 0 )
+        { return 0; }
+
+        if ( g_WorkerCount.compare_exchange_weak( current, current + count ) )
+        { return count; }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+//      確保したスレッドを返却します.
+//-------------------------------------------------------------------------------------------------
+void ReleaseWorker( s32 count )
+{ g_WorkerCount -= count; }
+
+//-------------------------------------------------------------------------------------------------
+//      形状配列を分割して並列に処理します.
+//-------------------------------------------------------------------------------------------------
+template<typename Func>
+void ParallelChunk( size_t count, s32 chunkCount, Func func )
+{
+    std::vector<std::thread> threads;
+    threads.reserve( chunkCount - 1 );
+
+    const auto chunkSize = ( count + chunkCount - 1 ) / chunkCount;
+    for( auto i=1; i<chunkCount; ++i )
+    {
+        auto begin = s3d::Min( chunkSize * i, count );
+        auto end   = s3d::Min( begin + chunkSize, count );
+        threads.emplace_back( func, i, begin, end );
+    }
+
+    // 先頭のチャンクは呼び出し元のスレッドで処理する.
+    func( 0, size_t(0), s3d::Min( chunkSize, count ) );
+
+    for( auto& thread : threads )
+    { thread.join(); }
+}
+
+//-------------------------------------------------------------------------------------------------
+//      並列処理に使用するチャンク数を求めます.
+//-------------------------------------------------------------------------------------------------
+s32 CalcChunkCount( size_t count )
+{
+    if ( count < ParallelBinCount )
+    { return 1; }
+
+    auto request = static_cast<s32>( count / MinChunkCount ) - 1;
+    return AcquireWorker( request ) + 1;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      バケット番号を求めます.
+//-------------------------------------------------------------------------------------------------
+S3D_INLINE
+int GetBucketIndex( f32 value, f32 mini, f32 scale )
+{
+    auto idx = static_cast<int>( ( value - mini ) * scale );
+    return s3d::Clamp( idx, 0, BucketCount - 1 );
+}
+
+} // namespace /* anonymous */
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// BuildTaskGroup class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------------------
+//      コンストラクタです.
+//-------------------------------------------------------------------------------------------------
+BuildTaskGroup::BuildTaskGroup()
+: m_Threads()
+{ /* DO_NOTHING */ }
+
+//-------------------------------------------------------------------------------------------------
+//      デストラクタです.
+//-------------------------------------------------------------------------------------------------
+BuildTaskGroup::~BuildTaskGroup()
+{ Wait(); }
+
+//-------------------------------------------------------------------------------------------------
+//      タスクを実行します.
+//-------------------------------------------------------------------------------------------------
+void BuildTaskGroup::Run( size_t count, const std::function<void()>& task )
+{
+    if ( count < ParallelTaskCount || AcquireWorker( 1 ) == 0 )
+    {
+        task();
+        return;
+    }
+
+    m_Threads.emplace_back( [task]()
+    {
+        task();
+        ReleaseWorker( 1 );
+    });
+}
+
+//-------------------------------------------------------------------------------------------------
+//      実行中のタスクの完了を待機します.
+//-------------------------------------------------------------------------------------------------
+void BuildTaskGroup::Wait()
+{
+    for( auto& thread : m_Threads )
+    { thread.join(); }
+
+    m_Threads.clear();
+}
+
+//-------------------------------------------------------------------------------------------------
+//      マージしたバウンディングボックスを生成します.
+//-------------------------------------------------------------------------------------------------
+BoundingBox CreateMergedBox( size_t count, IShape** ppShapes )
+{
+    if ( count == 0 || ppShapes == nullptr )
+    { return BoundingBox(); }
+
+    BoundingBox box = ppShapes[0]->GetBox();
+
+    for( size_t i=1; i<count; ++i )
+    { box = BoundingBox::Merge( box, ppShapes[i]->GetBox() ); }
+
+    return box;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      中心座標をもとにバウンディングボックスを生成します.
+//-------------------------------------------------------------------------------------------------
+BoundingBox CreateCentroidBox( size_t count, IShape** ppShapes )
+{
+    if ( count == 0 || ppShapes == nullptr )
+    { return BoundingBox(); }
+
+    BoundingBox box( ppShapes[0]->GetCenter() );
+
+    for( size_t i=1; i<count; ++i )
+    { box = BoundingBox::Merge( box, ppShapes[i]->GetCenter() ); }
+
+    return box;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      SAH分割します.
+//-------------------------------------------------------------------------------------------------
+bool SplitSAH( size_t count, IShape** ppShapes, size_t& mid )
+{
+    if ( count < 2 || ppShapes == nullptr )
+    { return false; }
+
+    // 上位階層は形状数が多いので, バウンディングボックスの計算とビン分割を並列に行う.
+    const auto chunkCount = CalcChunkCount( count );
+
+    // バウンディングボックスを生成.
+    std::vector<BoundingBox> bounds   ( chunkCount );
+    std::vector<BoundingBox> centroids( chunkCount );
+    ParallelChunk( count, chunkCount, [&]( s32 chunk, size_t begin, size_t end )
+    {
+        bounds   [chunk] = CreateMergedBox  ( end - begin, &ppShapes[begin] );
+        centroids[chunk] = CreateCentroidBox( end - begin, &ppShapes[begin] );
+    });
+
+    auto bound    = bounds   [0];
+    auto centroid = centroids[0];
+    for( auto i=1; i<chunkCount; ++i )
+    {
+        bound    = BoundingBox::Merge( bound,    bounds   [i] );
+        centroid = BoundingBox::Merge( centroid, centroids[i] );
+    }
+
+    f32  scale[3];
+    bool valid[3];
+    auto validAxis = false;
+    for( auto axis=0; axis<3; ++axis )
+    {
+        auto extent = centroid.maxi.a[axis] - centroid.mini.a[axis];
+        valid[axis] = ( extent > 0.0f );
+        scale[axis] = ( valid[axis] ) ? BucketCount / extent : 0.0f;
+        validAxis  |= valid[axis];
+    }
+
+    if ( !validAxis )
+    {
+        ReleaseWorker( chunkCount - 1 );
+        return false;
+    }
+
+    // SAH分割バケットの初期化処理. 3軸分をまとめて1回の走査で求める.
+    std::vector<Bucket> buckets( chunkCount * 3 * BucketCount );
+    ParallelChunk( count, chunkCount, [&]( s32 chunk, size_t begin, size_t end )
+    {
+        auto pBucket = &buckets[ chunk * 3 * BucketCount ];
+        for( auto i=begin; i<end; ++i )
+        {
+            auto center = ppShapes[i]->GetCenter();
+            auto box    = ppShapes[i]->GetBox();
+
+            for( auto axis=0; axis<3; ++axis )
+            {
+                if ( !valid[axis] )
+                { continue; }
+
+                auto idx = GetBucketIndex( center.a[axis], centroid.mini.a[axis], scale[axis] );
+                auto& bucket = pBucket[ axis * BucketCount + idx ];
+                bucket.count++;
+                bucket.box = BoundingBox::Merge( bucket.box, box );
+            }
+        }
+    });
+
+    ReleaseWorker( chunkCount - 1 );
+
+    for( auto chunk=1; chunk<chunkCount; ++chunk )
+    {
+        for( auto i=0; i<3 * BucketCount; ++i )
+        {
+            auto& src = buckets[ chunk * 3 * BucketCount + i ];
+            buckets[i].count += src.count;
+            buckets[i].box    = BoundingBox::Merge( buckets[i].box, src.box );
+        }
+    }
+
+    // 分割後の各バケットに対するコストを前後からの累積で求める.
+    auto invArea       = 1.0f / Max( SurfaceArea( bound ), F_MIN );
+    auto minCost       = F_MAX;
+    auto minCostAxis   = -1;
+    auto minCostBucket = 0;
+
+    for( auto axis=0; axis<3; ++axis )
+    {
+        if ( !valid[axis] )
+        { continue; }
+
+        const auto pBucket = &buckets[ axis * BucketCount ];
+
+        // 右側の累積面積を求める.
+        f32 rightArea[BucketCount];
+        u32 rightCount[BucketCount];
+        {
+            BoundingBox box;
+            u32 sum = 0;
+            for( auto i=BucketCount - 1; i>0; --i )
+            {
+                box  = BoundingBox::Merge( box, pBucket[i].box );
+                sum += pBucket[i].count;
+
+                rightArea [i] = ( sum > 0 ) ? SurfaceArea( box ) : 0.0f;
+                rightCount[i] = sum;
+            }
+        }
+
+        // 左側から累積しながらコストを評価する.
+        BoundingBox box;
+        u32 sum = 0;
+        for( auto i=0; i<BucketCount - 1; ++i )
+        {
+            box  = BoundingBox::Merge( box, pBucket[i].box );
+            sum += pBucket[i].count;
+
+            if ( sum == 0 || rightCount[i + 1] == 0 )
+            { continue; }
+
+            auto cost = 1.0f + ( sum * SurfaceArea( box ) + rightCount[i + 1] * rightArea[i + 1] ) * invArea;
+            if ( cost < minCost )
+            {
+                minCost       = cost;
+                minCostAxis   = axis;
+                minCostBucket = i;
+            }
+        }
+    }
+
+    // 最小コスト満たすものがなかったら葉ノードとする.
+    f32 leafCost = static_cast<f32>( count );
+    if ( minCostAxis < 0 || minCost >= leafCost )
+    { return false; }
+
+    const auto axis = minCostAxis;
+    auto pMid = std::partition(
+        &ppShapes[0],
+        &ppShapes[count - 1] + 1,
+        [&](const IShape* pShape)
+        {
+            auto idx = GetBucketIndex( pShape->GetCenter().a[axis], centroid.mini.a[axis], scale[axis] );
+            return idx <= minCostBucket;
+        });
+
+    mid = pMid - &ppShapes[0];
+    assert( 0 < mid && mid < count );
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      中間分割します.
+//-------------------------------------------------------------------------------------------------
+bool SplitMid( size_t count, IShape** ppShapes, size_t& mid )
+{
+    if ( count <= 2 || ppShapes == nullptr )
+    { return false; }
+
+    // バウンディングボックスを生成.
+    auto centroid = CreateCentroidBox( count, ppShapes );
+
+    // 分割軸を決めるためバウンディングボックスの最長軸を取得.
+    auto vec  = centroid.maxi - centroid.mini;
+    auto axis = ( vec.x > vec.y && vec.x > vec.z ) ? 0 : ( vec.y > vec.z ) ? 1 : 2;
+
+    if (centroid.maxi.a[axis] == centroid.mini.a[axis])
+    { return false; }
+
+    mid = 0;
+    for (size_t i=0; i<count; ++i)
+    {
+        auto center = ppShapes[i]->GetBox().center;
+
+        if (center.a[axis] < centroid.center.a[axis])
+        {
+            auto pTemp = ppShapes[i];
+            ppShapes[i] = ppShapes[mid];
+            ppShapes[mid] = pTemp;
+            mid++;
+        }
+    }
+
+    if ( mid == 0 || mid == count )
+    { mid = count / 2; }
+
+    return true;
+}
+
+} // namespace s3d
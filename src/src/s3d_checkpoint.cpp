@@ -0,0 +1,340 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_checkpoint.cpp
+// Desc : Render Checkpoint Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <cstdio>
+#include <cstring>
+#include <s3d_checkpoint.h>
+#include <s3d_mappedfile.h>
+#include <s3d_logger.h>
+#include <Windows.h>
+
+
+namespace /* anonymous */ {
+
+//-------------------------------------------------------------------------------------------------
+// Constant Values.
+//-------------------------------------------------------------------------------------------------
+static const u32 CHECKPOINT_VERSION = 0x00000002;
+static const u8  CHECKPOINT_TAG[4]  = { 'C', 'K', 'P', '\0' };
+static const u32 CHECKPOINT_ALIGN   = 16;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// CHECKPOINT_HEADER structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct CHECKPOINT_HEADER
+{
+    u8      Magic[ 4 ];         //!< ファイルマジック "CKP\0"です.
+    u32     Version;            //!< ファイルバージョンです.
+    s32     Width;              //!< 横幅です.
+    s32     Height;             //!< 縦幅です.
+    s32     TileSize;           //!< タイルの縦横サイズです.
+    s32     TileSampleCount;    //!< 1パスあたりのサンプリング数です.
+    s32     SubSampleCount;     //!< サブサンプリング数です.
+    u32     TileCount;          //!< タイル数です.
+    u64     ContentHash;        //!< シーンと積分器の設定のハッシュ値です.
+    u64     AccumOffset;        //!< 累積バッファのオフセットです.
+    u64     MomentOffset;       //!< 輝度の2乗の総和のオフセットです.
+    u64     PassOffset;         //!< タイルごとのパス数のオフセットです.
+};
+
+//-------------------------------------------------------------------------------------------------
+//      アライメントに合わせてオフセットを切り上げます.
+//-------------------------------------------------------------------------------------------------
+u64 AlignOffset( u64 offset )
+{ return ( offset + CHECKPOINT_ALIGN - 1 ) & ~u64( CHECKPOINT_ALIGN - 1 ); }
+
+} // namespace /* anonymous */
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Checkpoint class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------------------
+//      コンストラクタです.
+//-------------------------------------------------------------------------------------------------
+Checkpoint::Checkpoint()
+: m_Width           ( 0 )
+, m_Height          ( 0 )
+, m_TileSize        ( 0 )
+, m_TileSampleCount ( 0 )
+, m_SubSampleCount  ( 0 )
+, m_TileCount       ( 0 )
+, m_ContentHash     ( 0 )
+, m_pAccum          ( nullptr )
+, m_pMoment         ( nullptr )
+, m_pWriteAccum     ( nullptr )
+, m_pWriteMoment    ( nullptr )
+, m_WriteResult     ( true )
+{ /* DO_NOTHING */ }
+
+//-------------------------------------------------------------------------------------------------
+//      デストラクタです.
+//-------------------------------------------------------------------------------------------------
+Checkpoint::~Checkpoint()
+{ Term(); }
+
+//-------------------------------------------------------------------------------------------------
+//      初期化処理を行います.
+//-------------------------------------------------------------------------------------------------
+bool Checkpoint::Init( s32 width, s32 height, s32 tileSize, s32 tileSampleCount, s32 subSampleCount, u64 contentHash )
+{
+    Term();
+
+    if ( width <= 0 || height <= 0 || tileSize <= 0 || tileSampleCount <= 0 || subSampleCount <= 0 )
+    {
+        ELOG( "Error : Invalid Argument." );
+        return false;
+    }
+
+    m_Width           = width;
+    m_Height          = height;
+    m_TileSize        = tileSize;
+    m_TileSampleCount = tileSampleCount;
+    m_SubSampleCount  = subSampleCount;
+    m_ContentHash     = contentHash;
+
+    // タイルの並びは TileScheduler と同じ.
+    m_TileCount = static_cast<u32>( ( ( width  + tileSize - 1 ) / tileSize )
+                                  * ( ( height + tileSize - 1 ) / tileSize ) );
+
+    const auto pixelCount = width * height;
+    m_pAccum       = new Color4 [pixelCount];
+    m_pMoment      = new f32    [pixelCount];
+    m_pWriteAccum  = new Color4 [pixelCount];
+    m_pWriteMoment = new f32    [pixelCount];
+
+    for( auto i=0; i<pixelCount; ++i )
+    { m_pAccum[i] = Color4( 0.0f, 0.0f, 0.0f, 0.0f ); }
+    memset( m_pMoment, 0, sizeof(f32) * pixelCount );
+
+    m_Passes     .assign( m_TileCount, 0 );
+    m_WritePasses.assign( m_TileCount, 0 );
+    m_WriteResult = true;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      終了処理を行います.
+//-------------------------------------------------------------------------------------------------
+void Checkpoint::Term()
+{
+    Wait();
+
+    SafeDeleteArray( m_pAccum );
+    SafeDeleteArray( m_pMoment );
+    SafeDeleteArray( m_pWriteAccum );
+    SafeDeleteArray( m_pWriteMoment );
+
+    m_Passes     .clear();
+    m_WritePasses.clear();
+
+    m_Width     = 0;
+    m_Height    = 0;
+    m_TileCount = 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      タイルの1パス分の累積結果を反映します.
+//-------------------------------------------------------------------------------------------------
+void Checkpoint::Commit( const Tile& tile, u32 tileIndex, s32 pass, const Color4* pAccum, const f32* pMoment )
+{
+    if ( m_pAccum == nullptr || tileIndex >= m_TileCount )
+    { return; }
+
+    // タイル内の値とパス数が揃った状態で保存されるよう, まとめて反映する.
+    std::lock_guard<std::mutex> locker( m_Mutex );
+
+    for( auto y=tile.y; y<tile.y + tile.h; ++y )
+    {
+        const auto idx = y * m_Width + tile.x;
+        memcpy( &m_pAccum [idx], &pAccum [idx], sizeof(Color4) * tile.w );
+        memcpy( &m_pMoment[idx], &pMoment[idx], sizeof(f32)    * tile.w );
+    }
+
+    m_Passes[tileIndex] = pass;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      反映済みの状態を別スレッドでファイルに保存します.
+//-------------------------------------------------------------------------------------------------
+void Checkpoint::SaveAsync( const char* filename )
+{
+    if ( m_pAccum == nullptr )
+    { return; }
+
+    // 複製先のバッファを使い回すので, 前回の保存が終わるのを待つ.
+    Wait();
+
+    {
+        const auto pixelCount = m_Width * m_Height;
+
+        std::lock_guard<std::mutex> locker( m_Mutex );
+        memcpy( m_pWriteAccum,  m_pAccum,  sizeof(Color4) * pixelCount );
+        memcpy( m_pWriteMoment, m_pMoment, sizeof(f32)    * pixelCount );
+        m_WritePasses = m_Passes;
+    }
+
+    m_WriteFile = filename;
+    m_Writer    = std::thread( [this]{ m_WriteResult = Write(); } );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      保存の完了を待ちます.
+//-------------------------------------------------------------------------------------------------
+bool Checkpoint::Wait()
+{
+    if ( m_Writer.joinable() )
+    { m_Writer.join(); }
+
+    return m_WriteResult;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      複製した状態をファイルに書き出します.
+//-------------------------------------------------------------------------------------------------
+bool Checkpoint::Write() const
+{
+    const u64 pixelCount = u64( m_Width ) * u64( m_Height );
+
+    CHECKPOINT_HEADER header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.Magic, CHECKPOINT_TAG, sizeof(u8) * 4 );
+    header.Version         = CHECKPOINT_VERSION;
+    header.Width           = m_Width;
+    header.Height          = m_Height;
+    header.TileSize        = m_TileSize;
+    header.TileSampleCount = m_TileSampleCount;
+    header.SubSampleCount  = m_SubSampleCount;
+    header.TileCount       = m_TileCount;
+    header.ContentHash     = m_ContentHash;
+    header.AccumOffset     = AlignOffset( sizeof(header) );
+    header.MomentOffset    = AlignOffset( header.AccumOffset  + sizeof(Color4) * pixelCount );
+    header.PassOffset      = AlignOffset( header.MomentOffset + sizeof(f32)    * pixelCount );
+
+    // 書き込み途中で落ちても前回のファイルが残るよう, 一時ファイルに書いてから置き換える.
+    const auto tempFile = m_WriteFile + ".tmp";
+
+    FILE* pFile;
+    errno_t err = fopen_s( &pFile, tempFile.c_str(), "wb" );
+    if ( err != 0 )
+    {
+        ELOG( "Error : File Open Failed. filename = %s", tempFile.c_str() );
+        return false;
+    }
+
+    static const u8 padding[ CHECKPOINT_ALIGN ] = {};
+    const auto accumEnd  = header.AccumOffset  + sizeof(Color4) * pixelCount;
+    const auto momentEnd = header.MomentOffset + sizeof(f32)    * pixelCount;
+
+    fwrite( &header, sizeof(header), 1, pFile );
+    fwrite( padding, size_t( header.AccumOffset - sizeof(header) ), 1, pFile );
+    fwrite( m_pWriteAccum, size_t( sizeof(Color4) * pixelCount ), 1, pFile );
+    fwrite( padding, size_t( header.MomentOffset - accumEnd ), 1, pFile );
+    fwrite( m_pWriteMoment, size_t( sizeof(f32) * pixelCount ), 1, pFile );
+    fwrite( padding, size_t( header.PassOffset - momentEnd ), 1, pFile );
+    fwrite( m_WritePasses.data(), sizeof(s32) * m_WritePasses.size(), 1, pFile );
+
+    auto result = ( ferror( pFile ) == 0 );
+    result &= ( fclose( pFile ) == 0 );
+
+    if ( !result )
+    {
+        ELOG( "Error : File Write Failed. filename = %s", tempFile.c_str() );
+        return false;
+    }
+
+    if ( MoveFileExA( tempFile.c_str(), m_WriteFile.c_str(), MOVEFILE_REPLACE_EXISTING ) == FALSE )
+    {
+        ELOG( "Error : File Replace Failed. filename = %s", m_WriteFile.c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      ファイルから読み込みます.
+//-------------------------------------------------------------------------------------------------
+bool Checkpoint::Load( const char* filename, Color4* pAccum, f32* pMoment )
+{
+    if ( m_pAccum == nullptr || pAccum == nullptr || pMoment == nullptr )
+    { return false; }
+
+    MappedFile file;
+    if ( !file.Open( filename ) )
+    {
+        ILOG( "Info : Checkpoint Not Found. filename = %s", filename );
+        return false;
+    }
+
+    auto pData = file.GetData();
+    auto size  = file.GetSize();
+
+    CHECKPOINT_HEADER header;
+    if ( size < sizeof(header) )
+    { return false; }
+
+    memcpy( &header, pData, sizeof(header) );
+
+    // サンプル番号の割り当てやシーン, 積分器の設定が変わった場合は続きから再開できない.
+    if ( memcmp( header.Magic, CHECKPOINT_TAG, sizeof(u8) * 4 ) != 0
+      || header.Version         != CHECKPOINT_VERSION
+      || header.Width           != m_Width
+      || header.Height          != m_Height
+      || header.TileSize        != m_TileSize
+      || header.TileSampleCount != m_TileSampleCount
+      || header.SubSampleCount  != m_SubSampleCount
+      || header.TileCount       != m_TileCount
+      || header.ContentHash     != m_ContentHash )
+    {
+        ELOG( "Error : Checkpoint Mismatch. filename = %s", filename );
+        return false;
+    }
+
+    const u64 pixelCount = u64( m_Width ) * u64( m_Height );
+    const u64 accumSize  = u64( sizeof(Color4) ) * pixelCount;
+    const u64 momentSize = u64( sizeof(f32) )    * pixelCount;
+    const u64 passSize   = u64( sizeof(s32) )    * m_TileCount;
+    if ( header.AccumOffset  % CHECKPOINT_ALIGN != 0 || header.AccumOffset  > size || accumSize  > size - header.AccumOffset
+      || header.MomentOffset % CHECKPOINT_ALIGN != 0 || header.MomentOffset > size || momentSize > size - header.MomentOffset
+      || header.PassOffset   % CHECKPOINT_ALIGN != 0 || header.PassOffset   > size || passSize   > size - header.PassOffset )
+    {
+        ELOG( "Error : Invalid Checkpoint. filename = %s", filename );
+        return false;
+    }
+
+    std::lock_guard<std::mutex> locker( m_Mutex );
+
+    memcpy( m_pAccum,        pData + header.AccumOffset,  size_t( accumSize ) );
+    memcpy( m_pMoment,       pData + header.MomentOffset, size_t( momentSize ) );
+    memcpy( m_Passes.data(), pData + header.PassOffset,   size_t( passSize ) );
+
+    memcpy( pAccum,  m_pAccum,  size_t( accumSize ) );
+    memcpy( pMoment, m_pMoment, size_t( momentSize ) );
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      タイルごとの処理済みパス数を取得します.
+//-------------------------------------------------------------------------------------------------
+const s32* Checkpoint::GetPasses() const
+{ return m_Passes.data(); }
+
+//-------------------------------------------------------------------------------------------------
+//      タイル数を取得します.
+//-------------------------------------------------------------------------------------------------
+u32 Checkpoint::GetTileCount() const
+{ return m_TileCount; }
+
+} // namespace s3d
@@ -69,6 +69,7 @@ Color4 Glass::Shade( ShadingArg& arg ) const
     const bool into = ( Vector3::Dot( arg.normal, normalMod ) > 0.0 );
 
     arg.dice = false;
+    arg.pdf  = 0.0f;
 
     // ===============
     // Snellの法則
@@ -127,6 +128,16 @@ Color4 Glass::Shade( ShadingArg& arg ) const
     }
 }
 
+//-------------------------------------------------------------------------------------------------
+//      指定方向へのBSDFに余弦項を乗じた値と確率密度を求めます.
+//-------------------------------------------------------------------------------------------------
+Color4 Glass::Evaluate( const ShadingArg&, const Vector3&, f32& pdf ) const
+{
+    // デルタ関数なので任意の方向に対する値は0.
+    pdf = 0.0f;
+    return Color4( 0.0f, 0.0f, 0.0f, 0.0f );
+}
+
 //-------------------------------------------------------------------------------------------------
 //      エミッシブカラーを取得します.
 //-------------------------------------------------------------------------------------------------
@@ -139,6 +150,12 @@ Color4 Glass::GetEmissive() const
 bool Glass::HasDelta() const
 { return true; }
 
+//-------------------------------------------------------------------------------------------------
+//      マテリアルの種類を取得します.
+//-------------------------------------------------------------------------------------------------
+MATERIAL_TYPE Glass::GetType() const
+{ return MATERIAL_TYPE_GLASS; }
+
 //-------------------------------------------------------------------------------------------------
 //      生成処理.
 //-------------------------------------------------------------------------------------------------
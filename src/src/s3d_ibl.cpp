@@ -9,6 +9,56 @@
 //-------------------------------------------------------------------------------------------
 #include <s3d_ibl.h>
 #include <s3d_hdr.h>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+
+namespace /* anonymous */ {
+
+//-------------------------------------------------------------------------------------------
+//      方向ベクトルを八面体マップのテクスチャ座標に変換します.
+//-------------------------------------------------------------------------------------------
+inline void ToOctahedral( const s3d::Vector3& dir, f32& u, f32& v )
+{
+    auto inv = 1.0f / ( fabsf( dir.x ) + fabsf( dir.y ) + fabsf( dir.z ) );
+    auto x   = dir.x * inv;
+    auto z   = dir.z * inv;
+
+    // 下半球は四隅に折り返す.
+    if ( dir.y < 0.0f )
+    {
+        auto fx = ( 1.0f - fabsf( z ) ) * ( ( x < 0.0f ) ? -1.0f : 1.0f );
+        auto fz = ( 1.0f - fabsf( x ) ) * ( ( z < 0.0f ) ? -1.0f : 1.0f );
+        x = fx;
+        z = fz;
+    }
+
+    u = x * 0.5f + 0.5f;
+    v = z * 0.5f + 0.5f;
+}
+
+//-------------------------------------------------------------------------------------------
+//      八面体マップのテクスチャ座標を方向ベクトルに変換します.
+//-------------------------------------------------------------------------------------------
+inline s3d::Vector3 FromOctahedral( f32 u, f32 v )
+{
+    auto x = u * 2.0f - 1.0f;
+    auto z = v * 2.0f - 1.0f;
+    auto y = 1.0f - fabsf( x ) - fabsf( z );
+
+    if ( y < 0.0f )
+    {
+        auto fx = ( 1.0f - fabsf( z ) ) * ( ( x < 0.0f ) ? -1.0f : 1.0f );
+        auto fz = ( 1.0f - fabsf( x ) ) * ( ( z < 0.0f ) ? -1.0f : 1.0f );
+        x = fx;
+        z = fz;
+    }
+
+    return s3d::Vector3::UnitVector( s3d::Vector3( x, y, z ) );
+}
+
+} // namespace /* anonymous */
 
 
 namespace s3d {
@@ -26,6 +76,9 @@ IBL::IBL()
 , m_Gamma   ( 0.0f )
 , m_Exposure( 0.0f )
 , m_pPixels ( nullptr )
+, m_Integral( 0.0f )
+, m_OctSize ( 0 )
+, m_pOctPixels( nullptr )
 { /* DO_NOTHING */ }
 
 //-------------------------------------------------------------------------------------------
@@ -39,7 +92,35 @@ IBL::~IBL()
 //-------------------------------------------------------------------------------------------
 bool IBL::Init( const char* filename )
 {
-    return LoadFromHDR( filename, m_Width, m_Height, m_Gamma, m_Exposure, &m_pPixels );
+    f32* pPixels = nullptr;
+    if ( !LoadFromHDR( filename, m_Width, m_Height, m_Gamma, m_Exposure, &pPixels ) )
+    { return false; }
+
+    // テクスチャと同じ配置に並べ替える.
+    auto w = static_cast<u32>( m_Width );
+    auto h = static_cast<u32>( m_Height );
+    m_pPixels = new f32 [ GetTexelCount( w, h ) * 3 ];
+    assert( m_pPixels != nullptr );
+
+    for( auto y=0u; y<h; ++y )
+    for( auto x=0u; x<w; ++x )
+    {
+        memcpy(
+            m_pPixels + GetTexelIndex( x, y, w ) * 3,
+            pPixels   + ( y * w + x ) * 3,
+            sizeof(f32) * 3 );
+    }
+    SafeDeleteArray( pPixels );
+
+    // 重点的サンプリング用の分布を作っておく.
+    BuildDistribution();
+
+#if S3D_OCTAHEDRAL_IBL
+    // 参照用の八面体マップを作っておく.
+    BuildOctahedralMap();
+#endif
+
+    return true;
 }
 
 //-------------------------------------------------------------------------------------------
@@ -48,10 +129,167 @@ bool IBL::Init( const char* filename )
 void IBL::Term()
 {
     SafeDeleteArray( m_pPixels );
+    SafeDeleteArray( m_pOctPixels );
+    m_OctSize  = 0;
     m_Width    = 0;
     m_Height   = 0;
     m_Gamma    = 0.0f;
     m_Exposure = 0.0f;
+    m_Integral = 0.0f;
+
+    m_Func          .clear();
+    m_ConditionalCdf.clear();
+    m_RowIntegral   .clear();
+    m_MarginalCdf   .clear();
+    m_Func          .shrink_to_fit();
+    m_ConditionalCdf.shrink_to_fit();
+    m_RowIntegral   .shrink_to_fit();
+    m_MarginalCdf   .shrink_to_fit();
+}
+
+//-------------------------------------------------------------------------------------------
+//      重点的サンプリング用の輝度分布を構築します.
+//-------------------------------------------------------------------------------------------
+void IBL::BuildDistribution()
+{
+    const auto w = m_Width;
+    const auto h = m_Height;
+
+    m_Func          .resize( w * h );
+    m_ConditionalCdf.resize( ( w + 1 ) * h );
+    m_RowIntegral   .resize( h );
+    m_MarginalCdf   .resize( h + 1 );
+
+    // セル(x, y)は BilinearSample() で texel(x, y) ～ texel(x + 1, y + 1) を補間する範囲なので, 4隅の平均を使う.
+    // 緯度経度マップは極に近いほど立体角が小さいので sinθ で重み付けする.
+    for( auto y=0; y<h; ++y )
+    {
+        const auto sinTheta = sinf( F_PI * ( static_cast<f32>( y ) + 0.5f ) / static_cast<f32>( h ) );
+
+        for( auto x=0; x<w; ++x )
+        {
+            auto c = ( GetPixel( x, y     ) + GetPixel( x + 1, y     )
+                     + GetPixel( x, y + 1 ) + GetPixel( x + 1, y + 1 ) ) * 0.25f;
+            auto luminance = 0.2126f * c.GetX() + 0.7152f * c.GetY() + 0.0722f * c.GetZ();
+            m_Func[ y * w + x ] = Max( luminance, 0.0f ) * sinTheta;
+        }
+    }
+
+    // 行ごとの条件付き累積分布. 全て0の行は一様分布にする.
+    for( auto y=0; y<h; ++y )
+    {
+        const auto* func = &m_Func[ y * w ];
+        auto*       cdf  = &m_ConditionalCdf[ y * ( w + 1 ) ];
+
+        cdf[0] = 0.0f;
+        for( auto x=0; x<w; ++x )
+        { cdf[x + 1] = cdf[x] + func[x] / static_cast<f32>( w ); }
+
+        m_RowIntegral[y] = cdf[w];
+        for( auto x=1; x<=w; ++x )
+        {
+            cdf[x] = ( m_RowIntegral[y] > 0.0f )
+                   ? cdf[x] / m_RowIntegral[y]
+                   : static_cast<f32>( x ) / static_cast<f32>( w );
+        }
+    }
+
+    // 行を選ぶ周辺累積分布.
+    m_MarginalCdf[0] = 0.0f;
+    for( auto y=0; y<h; ++y )
+    { m_MarginalCdf[y + 1] = m_MarginalCdf[y] + m_RowIntegral[y] / static_cast<f32>( h ); }
+
+    m_Integral = m_MarginalCdf[h];
+    for( auto y=1; y<=h; ++y )
+    {
+        m_MarginalCdf[y] = ( m_Integral > 0.0f )
+                         ? m_MarginalCdf[y] / m_Integral
+                         : static_cast<f32>( y ) / static_cast<f32>( h );
+    }
+}
+
+//-------------------------------------------------------------------------------------------
+//      緯度経度マップを八面体マップに再投影します.
+//-------------------------------------------------------------------------------------------
+void IBL::BuildOctahedralMap()
+{
+    // テクセル数が元の画像と同程度になるサイズにする.
+    m_OctSize = Max( static_cast<s32>( ceilf( sqrtf( static_cast<f32>( m_Width ) * static_cast<f32>( m_Height ) ) ) ), 1 );
+
+    const auto size = static_cast<u32>( m_OctSize );
+    m_pOctPixels = new f32 [ GetTexelCount( size, size ) * 3 ];
+    assert( m_pOctPixels != nullptr );
+
+    const auto invSize = 1.0f / static_cast<f32>( size );
+    for( auto y=0u; y<size; ++y )
+    for( auto x=0u; x<size; ++x )
+    {
+        // テクセル中心の方向で緯度経度マップを参照.
+        auto dir = FromOctahedral(
+            ( static_cast<f32>( x ) + 0.5f ) * invSize,
+            ( static_cast<f32>( y ) + 0.5f ) * invSize );
+        auto color = BilinearSample( ToTexCoord( dir ) );
+
+        auto idx = GetTexelIndex( x, y, size ) * 3;
+        m_pOctPixels[ idx + 0 ] = color.GetX();
+        m_pOctPixels[ idx + 1 ] = color.GetY();
+        m_pOctPixels[ idx + 2 ] = color.GetZ();
+    }
+}
+
+//-------------------------------------------------------------------------------------------
+//      八面体マップの指定されたピクセルを取得します.
+//-------------------------------------------------------------------------------------------
+Color4 IBL::GetOctPixel( s32 x, s32 y ) const
+{
+    // 1テクセル外側は辺の中点で折り返した反対側に連続している.
+    const auto last = m_OctSize - 1;
+    if ( x < 0 )    { x = 0;    y = last - y; }
+    if ( x > last ) { x = last; y = last - y; }
+    if ( y < 0 )    { y = 0;    x = last - x; }
+    if ( y > last ) { y = last; x = last - x; }
+
+    auto idx = GetTexelIndex( x, y, m_OctSize ) * 3;
+    return Color4(
+        m_pOctPixels[idx + 0],
+        m_pOctPixels[idx + 1],
+        m_pOctPixels[idx + 2],
+        1.0f );
+}
+
+//-------------------------------------------------------------------------------------------
+//      八面体マップをサンプリングします.
+//-------------------------------------------------------------------------------------------
+Color4 IBL::SampleOctahedral( f32 u, f32 v, const TEXTURE_FILTER_MODE filter ) const
+{
+    const auto size = static_cast<f32>( m_OctSize );
+
+    if ( filter == TEXTURE_FILTER_NEAREST )
+    {
+        auto x = Min( static_cast<s32>( u * size ), m_OctSize - 1 );
+        auto y = Min( static_cast<s32>( v * size ), m_OctSize - 1 );
+        return GetOctPixel( x, y );
+    }
+
+    // 縁をまたぐテクセルは GetOctPixel() で八面体の折り返しを適用する.
+    auto fx = Clamp( u * size - 0.5f, -0.5f, size - 0.5f );
+    auto fy = Clamp( v * size - 0.5f, -0.5f, size - 0.5f );
+
+    auto x0 = static_cast<s32>( floorf( fx ) );
+    auto y0 = static_cast<s32>( floorf( fy ) );
+    auto x1 = x0 + 1;
+    auto y1 = y0 + 1;
+
+    auto tx = fx - static_cast<f32>( x0 );
+    auto ty = fy - static_cast<f32>( y0 );
+    auto w00 = _mm_set1_ps( ( 1.0f - tx ) * ( 1.0f - ty ) );
+    auto w01 = _mm_set1_ps( ( 1.0f - tx ) * ty );
+    auto w10 = _mm_set1_ps( tx * ( 1.0f - ty ) );
+    auto w11 = _mm_set1_ps( tx * ty );
+
+    auto c0 = _mm_add_ps( _mm_mul_ps( w00, GetOctPixel( x0, y0 ).v ), _mm_mul_ps( w01, GetOctPixel( x0, y1 ).v ) );
+    auto c1 = _mm_add_ps( _mm_mul_ps( w10, GetOctPixel( x1, y0 ).v ), _mm_mul_ps( w11, GetOctPixel( x1, y1 ).v ) );
+    return Color4( _mm_add_ps( c0, c1 ) );
 }
 
 //--------------------------------------------------------------------------------------------
@@ -62,7 +300,7 @@ Color4 IBL::GetPixel(s32 x, s32 y) const
     x = abs(x % m_Width);
     y = abs(y % m_Height);
 
-    auto idx = y * m_Width * 3 + x * 3;
+    auto idx = GetTexelIndex( x, y, m_Width ) * 3;
     return Color4(
         m_pPixels[idx + 0],
         m_pPixels[idx + 1],
@@ -102,9 +340,9 @@ Color4 IBL::BilinearSample(const Vector2& uv) const
 }
 
 //-------------------------------------------------------------------------------------------
-//      フェッチします.
+//      方向ベクトルをテクスチャ座標に変換します.
 //-------------------------------------------------------------------------------------------
-Color4 IBL::Sample( const Vector3& dir, const TEXTURE_FILTER_MODE filter )
+Vector2 IBL::ToTexCoord( const Vector3& dir ) const
 {
     Vector2 uv;
     uv.x = 0.0f;
@@ -119,7 +357,27 @@ Color4 IBL::Sample( const Vector3& dir, const TEXTURE_FILTER_MODE filter )
         uv.x = phi / F_2PI;
     }
 
-    if ( filter == TEXTURE_FILTER_BILINEAR )
+    return uv;
+}
+
+//-------------------------------------------------------------------------------------------
+//      フェッチします.
+//-------------------------------------------------------------------------------------------
+Color4 IBL::Sample( const Vector3& dir, const TEXTURE_FILTER_MODE filter )
+{
+#if S3D_OCTAHEDRAL_IBL
+    if ( m_pOctPixels != nullptr )
+    {
+        f32 u, v;
+        ToOctahedral( dir, u, v );
+        return SampleOctahedral( u, v, filter );
+    }
+#endif
+
+    auto uv = ToTexCoord( dir );
+
+    // IBLはミップマップを持たないので, トライリニアもバイリニアとして扱う.
+    if ( filter != TEXTURE_FILTER_NEAREST )
     {
         return BilinearSample( uv );
     }
@@ -127,4 +385,130 @@ Color4 IBL::Sample( const Vector3& dir, const TEXTURE_FILTER_MODE filter )
     return NearestSample( uv );
 }
 
+//-------------------------------------------------------------------------------------------
+//      複数方向をまとめてフェッチします.
+//-------------------------------------------------------------------------------------------
+void IBL::SampleBatch( const Vector3* pDirs, u32 count, const TEXTURE_FILTER_MODE filter, Color4* pResults ) const
+{
+#if S3D_OCTAHEDRAL_IBL
+    if ( m_pOctPixels != nullptr )
+    {
+        const auto absMask  = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+        const auto zero     = _mm_setzero_ps();
+        const auto one      = _mm_set1_ps( 1.0f );
+        const auto half     = _mm_set1_ps( 0.5f );
+        const auto minusTwo = _mm_set1_ps( -2.0f );
+
+        S3D_ALIGN(16) f32 u[4];
+        S3D_ALIGN(16) f32 v[4];
+
+        // 4方向ずつ八面体マップの座標をSIMDで求める.
+        auto i = 0u;
+        for( ; i + 4 <= count; i += 4 )
+        {
+            const auto* d = pDirs + i;
+            auto x = _mm_set_ps( d[3].x, d[2].x, d[1].x, d[0].x );
+            auto y = _mm_set_ps( d[3].y, d[2].y, d[1].y, d[0].y );
+            auto z = _mm_set_ps( d[3].z, d[2].z, d[1].z, d[0].z );
+
+            auto ax  = _mm_and_ps( x, absMask );
+            auto ay  = _mm_and_ps( y, absMask );
+            auto az  = _mm_and_ps( z, absMask );
+            auto inv = _mm_div_ps( one, _mm_add_ps( _mm_add_ps( ax, ay ), az ) );
+            x  = _mm_mul_ps( x, inv );
+            z  = _mm_mul_ps( z, inv );
+            ax = _mm_mul_ps( ax, inv );
+            az = _mm_mul_ps( az, inv );
+
+            // 下半球は四隅に折り返す.
+            auto signX = _mm_add_ps( one, _mm_and_ps( _mm_cmplt_ps( x, zero ), minusTwo ) );
+            auto signZ = _mm_add_ps( one, _mm_and_ps( _mm_cmplt_ps( z, zero ), minusTwo ) );
+            auto fx = _mm_mul_ps( _mm_sub_ps( one, az ), signX );
+            auto fz = _mm_mul_ps( _mm_sub_ps( one, ax ), signZ );
+
+            auto lower = _mm_cmplt_ps( y, zero );
+            x = _mm_or_ps( _mm_and_ps( lower, fx ), _mm_andnot_ps( lower, x ) );
+            z = _mm_or_ps( _mm_and_ps( lower, fz ), _mm_andnot_ps( lower, z ) );
+
+            _mm_store_ps( u, _mm_add_ps( _mm_mul_ps( x, half ), half ) );
+            _mm_store_ps( v, _mm_add_ps( _mm_mul_ps( z, half ), half ) );
+
+            for( auto j=0; j<4; ++j )
+            { pResults[i + j] = SampleOctahedral( u[j], v[j], filter ); }
+        }
+
+        // 端数.
+        for( ; i<count; ++i )
+        {
+            ToOctahedral( pDirs[i], u[0], v[0] );
+            pResults[i] = SampleOctahedral( u[0], v[0], filter );
+        }
+        return;
+    }
+#endif
+
+    for( auto i=0u; i<count; ++i )
+    {
+        auto uv = ToTexCoord( pDirs[i] );
+        pResults[i] = ( filter != TEXTURE_FILTER_NEAREST ) ? BilinearSample( uv ) : NearestSample( uv );
+    }
+}
+
+//-------------------------------------------------------------------------------------------
+//      輝度に比例した確率で方向をサンプリングします.
+//-------------------------------------------------------------------------------------------
+Vector3 IBL::SampleDir( const Vector2& random, f32& pdf ) const
+{
+    pdf = 0.0f;
+    if ( m_Integral <= 0.0f )
+    { return Vector3( 0.0f, 1.0f, 0.0f ); }
+
+    const auto w = m_Width;
+    const auto h = m_Height;
+
+    // 周辺分布から行を選ぶ.
+    auto itrY = std::upper_bound( m_MarginalCdf.begin(), m_MarginalCdf.end(), random.y );
+    auto y    = Clamp( static_cast<s32>( itrY - m_MarginalCdf.begin() ) - 1, 0, h - 1 );
+    auto dy   = m_MarginalCdf[y + 1] - m_MarginalCdf[y];
+    auto v    = ( static_cast<f32>( y ) + ( ( dy > 0.0f ) ? ( random.y - m_MarginalCdf[y] ) / dy : 0.0f ) ) / static_cast<f32>( h );
+
+    // 条件付き分布から列を選ぶ.
+    auto cdf  = m_ConditionalCdf.begin() + y * ( w + 1 );
+    auto itrX = std::upper_bound( cdf, cdf + w + 1, random.x );
+    auto x    = Clamp( static_cast<s32>( itrX - cdf ) - 1, 0, w - 1 );
+    auto dx   = cdf[x + 1] - cdf[x];
+    auto u    = ( static_cast<f32>( x ) + ( ( dx > 0.0f ) ? ( random.x - cdf[x] ) / dx : 0.0f ) ) / static_cast<f32>( w );
+
+    // ToTexCoord() の逆変換.
+    auto theta    = v * F_PI;
+    auto phi      = u * F_2PI;
+    auto sinTheta = sinf( theta );
+    if ( sinTheta <= 0.0f )
+    { return Vector3( 0.0f, 1.0f, 0.0f ); }
+
+    // テクスチャ座標あたりの密度を立体角あたりに変換 (dω = 2π^2 sinθ du dv).
+    pdf = m_Func[ y * w + x ] / ( m_Integral * 2.0f * F_PI * F_PI * sinTheta );
+
+    return Vector3( sinTheta * cosf( phi ), cosf( theta ), sinTheta * sinf( phi ) );
+}
+
+//-------------------------------------------------------------------------------------------
+//      SampleDir() で指定方向が選ばれる立体角あたりの確率密度を求めます.
+//-------------------------------------------------------------------------------------------
+f32 IBL::GetPdf( const Vector3& dir ) const
+{
+    if ( m_Integral <= 0.0f )
+    { return 0.0f; }
+
+    auto uv       = ToTexCoord( dir );
+    auto sinTheta = sinf( uv.y * F_PI );
+    if ( sinTheta <= 0.0f )
+    { return 0.0f; }
+
+    auto x = Clamp( static_cast<s32>( uv.x * m_Width  ), 0, m_Width  - 1 );
+    auto y = Clamp( static_cast<s32>( uv.y * m_Height ), 0, m_Height - 1 );
+
+    return m_Func[ y * m_Width + x ] / ( m_Integral * 2.0f * F_PI * F_PI * sinTheta );
+}
+
 } // namespace s3d
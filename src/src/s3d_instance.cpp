@@ -72,12 +72,34 @@ bool Instance::IsHit( const RaySet& raySet, HitRecord& record ) const
     {
         record.position = Vector3::Transform( record.position, m_World );
         record.normal   = Vector3::TransformNormal( record.normal, Matrix::Transpose( m_InvWorld ) );
+
+        // ローカル空間の長さをワールド空間の長さに換算する(レイ方向のスケールで近似).
+        record.uvDensity *= dir.Length();
         return true;
     }
 
     return false;
 }
 
+//-------------------------------------------------------------------------------------------------
+//      遮蔽判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool Instance::IsOccluded( const RaySet& raySet, f32 distance ) const
+{
+    auto pos = Vector3::TransformCoord ( raySet.ray.pos, m_InvWorld );
+    auto dir = Vector3::TransformNormal( raySet.ray.dir, m_InvWorld );
+
+    // ローカル空間では方向ベクトルを正規化するため, 距離もスケールに合わせる.
+    auto scale = dir.Length();
+    if ( scale <= FLT_EPSILON )
+    { return false; }
+
+    auto localRaySet  = MakeRaySet( pos, dir / scale );
+    auto localDistance = ( distance >= F_HIT_MAX ) ? F_HIT_MAX : distance * scale;
+
+    return m_pShape->IsOccluded( localRaySet, localDistance );
+}
+
 //-------------------------------------------------------------------------------------------------
 //      バウンディングボックスを取得します.
 //-------------------------------------------------------------------------------------------------
@@ -77,6 +77,7 @@ Color4 Lambert::Shade( ShadingArg& arg ) const
 
     arg.output = Vector3::SafeUnitVector( onb.u * x + onb.v * y + onb.w * z );
     arg.dice   = ( arg.random.GetAsF32() >= m_Threshold );
+    arg.pdf    = z * F_1DIVPI;
 
     // 以下の処理の省略.
     //      pdf = cosine * F_1DIVPI;
@@ -86,6 +87,22 @@ Color4 Lambert::Shade( ShadingArg& arg ) const
     return m_Diffuse;
 }
 
+//-------------------------------------------------------------------------------------------------
+//      指定方向へのBSDFに余弦項を乗じた値と確率密度を求めます.
+//-------------------------------------------------------------------------------------------------
+Color4 Lambert::Evaluate( const ShadingArg& arg, const Vector3& dir, f32& pdf ) const
+{
+    auto cosine = Vector3::Dot( dir, arg.normal );
+    if ( cosine <= 0.0f )
+    {
+        pdf = 0.0f;
+        return Color4( 0.0f, 0.0f, 0.0f, 0.0f );
+    }
+
+    pdf = cosine * F_1DIVPI;
+    return m_Diffuse * pdf;
+}
+
 //-------------------------------------------------------------------------------------------------
 //      エミッシブカラーを取得します.
 //-------------------------------------------------------------------------------------------------
@@ -98,6 +115,12 @@ Color4 Lambert::GetEmissive() const
 bool Lambert::HasDelta() const
 { return false; }
 
+//-------------------------------------------------------------------------------------------------
+//      マテリアルの種類を取得します.
+//-------------------------------------------------------------------------------------------------
+MATERIAL_TYPE Lambert::GetType() const
+{ return MATERIAL_TYPE_LAMBERT; }
+
 //-------------------------------------------------------------------------------------------------
 //      生成処理です.
 //-------------------------------------------------------------------------------------------------
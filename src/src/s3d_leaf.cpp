@@ -8,6 +8,8 @@
 // Includes
 //-------------------------------------------------------------------------------------------------
 #include <s3d_leaf.h>
+#include <s3d_triangle4.h>
+#include <s3d_triangle8.h>
 
 
 namespace s3d {
@@ -76,7 +78,7 @@ bool Leaf::IsHit( const RaySet& raySet, HitRecord& record ) const
     auto hit = false;
 
 #if 0 // 判定しない方が速くなる.
-    if (!m_Box.IsHit(raySet.ray))
+    if (!m_Box.IsHit(raySet))
     { return false; }
 #endif
 
@@ -86,6 +88,20 @@ bool Leaf::IsHit( const RaySet& raySet, HitRecord& record ) const
     return hit;
 }
 
+//-------------------------------------------------------------------------------------------------
+//      遮蔽判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool Leaf::IsOccluded( const RaySet& raySet, f32 distance ) const
+{
+    for( size_t i=0; i<m_pShapes.size(); ++i )
+    {
+        if ( m_pShapes[ i ]->IsOccluded( raySet, distance ) )
+        { return true; }
+    }
+
+    return false;
+}
+
 //-------------------------------------------------------------------------------------------------
 //      バウンディングボックスを取得します.
 //-------------------------------------------------------------------------------------------------
@@ -102,6 +118,20 @@ Vector3 Leaf::GetCenter() const
 //      生成処理を行います.
 //-------------------------------------------------------------------------------------------------
 IShape* Leaf::Create( size_t count, IShape** ppShape )
-{ return new(std::nothrow) Leaf( count, ppShape ); }
+{
+#if S3D_PACKED_TRIANGLE
+    // 全て三角形であればまとめてSIMDで判定できる形式にする.
+    IShape* pPacked = nullptr;
+    if ( count <= 4 )
+    { pPacked = Triangle4::Create( count, ppShape ); }
+    else if ( count <= 8 )
+    { pPacked = Triangle8::Create( count, ppShape ); }
+
+    if ( pPacked != nullptr )
+    { return pPacked; }
+#endif
+
+    return new(std::nothrow) Leaf( count, ppShape );
+}
 
 } // namespace s3d
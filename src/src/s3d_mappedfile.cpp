@@ -0,0 +1,117 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_mappedfile.cpp
+// Desc : Memory Mapped File Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_mappedfile.h>
+#include <Windows.h>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// MappedFile class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------------------
+//      コンストラクタです.
+//-------------------------------------------------------------------------------------------------
+MappedFile::MappedFile()
+: m_hFile   ( INVALID_HANDLE_VALUE )
+, m_hMapping( nullptr )
+, m_pData   ( nullptr )
+, m_Size    ( 0 )
+{ /* DO_NOTHING */ }
+
+//-------------------------------------------------------------------------------------------------
+//      デストラクタです.
+//-------------------------------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{ Close(); }
+
+//-------------------------------------------------------------------------------------------------
+//      ファイルを読み取り専用でメモリにマップします.
+//-------------------------------------------------------------------------------------------------
+bool MappedFile::Open( const char* filename )
+{
+    Close();
+
+    m_hFile = CreateFileA(
+        filename,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr );
+    if ( m_hFile == INVALID_HANDLE_VALUE )
+    { return false; }
+
+    LARGE_INTEGER size;
+    if ( !GetFileSizeEx( m_hFile, &size ) || size.QuadPart == 0 )
+    {
+        Close();
+        return false;
+    }
+    m_Size = static_cast<u64>( size.QuadPart );
+
+    m_hMapping = CreateFileMappingA( m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    if ( m_hMapping == nullptr )
+    {
+        Close();
+        return false;
+    }
+
+    m_pData = static_cast<const u8*>( MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 ) );
+    if ( m_pData == nullptr )
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      マップを解除してファイルを閉じます.
+//-------------------------------------------------------------------------------------------------
+void MappedFile::Close()
+{
+    if ( m_pData != nullptr )
+    {
+        UnmapViewOfFile( m_pData );
+        m_pData = nullptr;
+    }
+
+    if ( m_hMapping != nullptr )
+    {
+        CloseHandle( m_hMapping );
+        m_hMapping = nullptr;
+    }
+
+    if ( m_hFile != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( m_hFile );
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+
+    m_Size = 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      マップされた先頭アドレスを取得します.
+//-------------------------------------------------------------------------------------------------
+const u8* MappedFile::GetData() const
+{ return m_pData; }
+
+//-------------------------------------------------------------------------------------------------
+//      ファイルサイズを取得します.
+//-------------------------------------------------------------------------------------------------
+u64 MappedFile::GetSize() const
+{ return m_Size; }
+
+} // namespace s3d
@@ -14,179 +14,65 @@
 #include <s3d_bvh2.h>
 #include <s3d_bvh4.h>
 #include <s3d_bvh8.h>
+#include <s3d_bvhbuilder.h>
+#include <s3d_mappedfile.h>
 #include <s3d_logger.h>
-#include <s3d_triangle.h>
 #include <s3d_materialfactory.h>
 
 
 namespace /* anonymous */ {
 
-//--------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------
 // Constant Values.
-//--------------------------------------------------------------------------------------------------
-static const u32 SMD_CURRENT_VERSION = 0x00000002;
-static const u8  SMD_FILE_TAG[4]     = { 'S', 'M', 'D', '\0' };
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_MATERIAL_TYPE
-///////////////////////////////////////////////////////////////////////////////////////////////////
-enum SMD_MATERIAL_TYPE
-{
-    SMD_MATERIAL_TYPE_MATTE = 0,        //!< Lambert
-    SMD_MATERIAL_TYPE_MIRROR,           //!< Perfect Specular
-    SMD_MATERIAL_TYPE_DIELECTRIC,       //!< Dielectric
-    SMD_MATERIAL_TYPE_GLOSSY,           //!< Phong
-    SMD_MATERIAL_TYPE_PLASTIC,          //!< Lambert + Phong
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_DATA_HEADER structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_DATA_HEADER
-{
-    u32     NumTriangles;           //!< 三角形数です.
-    u32     NumMaterials;           //!< マテリアル数です.
-    u32     NumTextures;            //!< テクスチャ数です.
-
-    u32     TriangleStructSize;     //!< 三角形構造体のサイズです.
-    u32     MaterialStructSize;     //!< マテリアル構造体のサイズです.
-    u32     TextureStructSize;      //!< テクスチャ構造体のサイズです.
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_FILE_HEADER structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_FILE_HEADER
-{
-    u8              Magic[ 4 ];         //!< ファイルマジック "SMD0"です.
-    u32             Version;            //!< ファイルバージョンです.
-    u32             DataHeaderSize;     //!< データヘッダ構造体のサイズです.
-    SMD_DATA_HEADER DataHeader;         //!< データヘッダです.
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_VECTOR2 structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_VECTOR2
-{
-    f32 x;  //!< X成分です.
-    f32 y;  //!< Y成分です.
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_VECTOR3 structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_VECTOR3
-{
-    f32 x;  //!< X成分です.
-    f32 y;  //!< Y成分です.
-    f32 z;  //!< Z成分です.
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_VECTOR4 structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_VECTOR4
-{
-    f32 x;  //!< X成分です.
-    f32 y;  //!< Y成分です.
-    f32 z;  //!< Z成分です.
-    f32 w;  //!< W成分です.
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_VERTEX structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_VERTEX
-{
-    SMD_VECTOR3    Position;       //!< 位置座標です.
-    SMD_VECTOR3    Normal;         //!< 法線ベクトルです.
-    SMD_VECTOR2    TexCoord;       //!< テクスチャ座標です.
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_TRIANGLE structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_TRIANGLE
-{
-    SMD_VERTEX      Vertex[3];      //!< 頂点データです.
-    s32             MaterialId;     //!< マテリアルインデックスです.
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_MATTE structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_MATTE
-{
-    SMD_VECTOR3    Color;
-    SMD_VECTOR3    Emissive;
-    s32            ColorMap;
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_MIRROR structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_MIRROR
-{
-    SMD_VECTOR3    Color;
-    SMD_VECTOR3    Emissive;
-    s32            ColorMap;
-};
+//-------------------------------------------------------------------------------------------------
+static const u32 BVH_CACHE_VERSION  = 0x00000001;
+static const u8  BVH_CACHE_TAG[4]   = { 'B', 'V', 'H', '\0' };
+static const u32 BVH_CACHE_ALIGN    = 16;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_DIELECTRIC structure
+// BVH_CACHE_HEADER structure
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_DIELECTRIC
+struct BVH_CACHE_HEADER
 {
-    SMD_VECTOR3     Color;
-    f32             Ior;
-    SMD_VECTOR3     Emissive;
-    s32             ColorMap;
+    u8      Magic[ 4 ];         //!< ファイルマジック "BVH\0"です.
+    u32     Version;            //!< ファイルバージョンです.
+    u32     BuilderVersion;     //!< 構築時のビルダーバージョンです.
+    u32     NodeStructSize;     //!< ノード構造体のサイズです.
+    u64     ContentHash;        //!< 位置座標とインデックスのハッシュ値です.
+    u32     FaceCount;          //!< 面数です.
+    u32     NodeCount;          //!< ノード数です.
+    u64     OrderOffset;        //!< 葉の範囲順に並べた面番号配列のオフセットです.
+    u64     NodeOffset;         //!< ノード配列のオフセットです.
 };
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_GLOSSY structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_GLOSSY
+//-------------------------------------------------------------------------------------------------
+//      FNV-1a でハッシュ値を更新します.
+//-------------------------------------------------------------------------------------------------
+u64 HashBytes( u64 hash, const void* pData, size_t size )
 {
-    SMD_VECTOR3     Color;
-    f32             Power;
-    SMD_VECTOR3     Emissive;
-    s32             ColorMap;
-};
+    static const u64 FnvPrime = 0x100000001b3ull;
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_PLASTIC structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_PLASTIC
-{
-    SMD_VECTOR3     Diffuse;
-    SMD_VECTOR3     Specular;
-    f32             Power;
-    SMD_VECTOR3     Emissive;
-    s32             DiffuseMap;
-    s32             SpecularMap;
-};
+    // 大きな配列を扱うため, 8バイト単位でまとめて処理する.
+    auto pBytes = static_cast<const u8*>( pData );
+    auto words  = size / sizeof(u64);
+    for( size_t i=0; i<words; ++i )
+    {
+        u64 value;
+        memcpy( &value, pBytes + i * sizeof(u64), sizeof(u64) );
+        hash = ( hash ^ value ) * FnvPrime;
+    }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// SMD_TEXTURE structure
-///////////////////////////////////////////////////////////////////////////////////////////////////
-struct SMD_TEXTURE
-{
-    char            FileName[ 256 ];    //!< ファイル名です.
-};
+    for( size_t i=words * sizeof(u64); i<size; ++i )
+    { hash = ( hash ^ pBytes[i] ) * FnvPrime; }
 
-//-------------------------------------------------------------------------------------------------
-//      s3d::Vector2 に変換します.
-//-------------------------------------------------------------------------------------------------
-s3d::Vector2 Convert( SMD_VECTOR2& value )
-{ return s3d::Vector2( value.x, value.y ); }
+    return hash;
+}
 
 //-------------------------------------------------------------------------------------------------
-//      s3d::Vector3 に変換します.
+//      アライメントに合わせてオフセットを切り上げます.
 //-------------------------------------------------------------------------------------------------
-s3d::Vector3 Convert( SMD_VECTOR3& value )
-{ return s3d::Vector3( value.x, value.y, value.z ); }
+u64 AlignOffset( u64 offset )
+{ return ( offset + BVH_CACHE_ALIGN - 1 ) & ~u64( BVH_CACHE_ALIGN - 1 ); }
 
 } // namespace /* anonymous */
 
@@ -212,14 +98,12 @@ Mesh::~Mesh()
 {
     SafeRelease( m_pBVH );
 
-    for(size_t i=0; i<m_Triangles.size(); ++i)
-    { SafeRelease(m_Triangles[i]); }
-    
-    for(size_t i=0; i<m_Materials.size(); ++i)
-    { SafeRelease(m_Materials[i]); }
+    for(size_t i=0; i<m_Buffer.Materials.size(); ++i)
+    { SafeRelease(m_Buffer.Materials[i]); }
 
     m_Triangles.clear();
-    m_Materials.clear();
+    m_Buffer.Materials.clear();
+    m_File.Term();
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -249,8 +133,6 @@ u32 Mesh::GetCount() const
 //-------------------------------------------------------------------------------------------------
 bool Mesh::LoadFromFile( const char* filename )
 {
-    FILE* pFile;
-
     std::string dirPath;
     {
         std::string temp( filename );
@@ -262,66 +144,21 @@ bool Mesh::LoadFromFile( const char* filename )
         }
     }
 
-    // ファイルを開きします.
-    errno_t err = fopen_s( &pFile, filename, "rb" );
-    if ( err != 0 )
+    // ファイルをマップして配列を取得します.
+    if ( !m_File.Load( filename ) )
     {
         ELOG( "Error : Load Faile Failed. filename = %s", filename );
         return false;
     }
 
-    // ファイルヘッダーを読み込みます.
-    SMD_FILE_HEADER fileHeader;
-    fread( &fileHeader, sizeof( SMD_FILE_HEADER ), 1, pFile );
-
-    // ファイルマジックを取得します.
-    if ( memcmp( fileHeader.Magic, SMD_FILE_TAG, sizeof(u8) * 4 ) != 0 )
-    {
-        fclose( pFile );
-        return false;
-    }
-
-    // ファイルバージョンをチェックします.
-    if ( fileHeader.Version != SMD_CURRENT_VERSION )
-    {
-        fclose( pFile );
-        return false;
-    }
-
-    // データヘッダーのサイズをチェックをします.
-    if ( fileHeader.DataHeaderSize != sizeof( SMD_DATA_HEADER ) )
-    {
-        fclose( pFile );
-        return false;
-    }
-
-    // 三角形数を取得します.
-    if ( fileHeader.DataHeader.NumTriangles == 0 )
-    {
-        fclose( pFile );
-        return false;
-    }
-
-    // マテリアル数を取得します.
-    if ( fileHeader.DataHeader.NumMaterials == 0 )
-    {
-        fclose( pFile );
-        return false;
-    }
-
-    m_Triangles.resize( fileHeader.DataHeader.NumTriangles );
-    m_Materials.resize( fileHeader.DataHeader.NumMaterials );
-    m_Textures .resize( fileHeader.DataHeader.NumTextures );
-
     // テクスチャデータを読み込みます.
+    m_Textures.resize( m_File.GetTextureCount() );
     if ( !m_Textures.empty() )
     {
+        auto pTextures = m_File.GetTextures();
         for ( size_t i = 0; i < m_Textures.size(); ++i )
         {
-            SMD_TEXTURE texture;
-            fread( &texture, sizeof( SMD_TEXTURE ), 1, pFile );
-
-            std::string path = dirPath + "/" + texture.FileName;
+            std::string path = dirPath + "/" + pTextures[ i ].FileName;
             if ( !m_Textures[ i ].LoadFromFile( path.c_str() ) )
             {
                 ILOG( "Warning : Texture Load Failed. filename = %s", path.c_str() );
@@ -329,147 +166,188 @@ bool Mesh::LoadFromFile( const char* filename )
         }
     }
 
-    // マテリアルデータを読み込みます.
-    for ( size_t i = 0; i < m_Materials.size(); ++i )
+    // マテリアルを生成します.
+    m_Buffer.Materials.resize( m_File.GetMaterialCount(), nullptr );
+    auto pMaterials = m_File.GetMaterials();
+    for ( size_t i = 0; i < m_Buffer.Materials.size(); ++i )
     {
-        // マテリアルタイプ読み込み.
-        s32 materialType = -1;
-        fread( &materialType, sizeof(s32), 1, pFile );
+        m_Buffer.Materials[i] = CreateMaterial( pMaterials[i] );
+        if ( m_Buffer.Materials[i] == nullptr )
+        {
+            ELOG( "Error : Invalid Material. filename = %s, index = %u", filename, static_cast<u32>( i ) );
+            return false;
+        }
+    }
 
-        switch( materialType )
+    // BVHを構築します.
+#if S3D_BVH_CACHE
+    std::string cacheFile = std::string( filename ) + ".bvh";
+    return BuildBVH( cacheFile.c_str() );
+#else
+    return BuildBVH( nullptr );
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------
+//      マテリアルを生成します.
+//-------------------------------------------------------------------------------------------------
+IMaterial* Mesh::CreateMaterial( const SMD_MATERIAL& material )
+{
+    auto textureCount = static_cast<s32>( m_Textures.size() );
+
+    switch( material.Type )
+    {
+    case SMD_MATERIAL_TYPE_MATTE:
         {
-        case SMD_MATERIAL_TYPE_MATTE:
+            const auto& value = material.Matte;
+
+            auto diffuse  = Color4(value.Color.x, value.Color.y, value.Color.z, 1.0f);
+            auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
+            Texture2D*      pTexture = nullptr;
+            TextureSampler* pSampler = nullptr;
+
+            if ( value.ColorMap >= 0 && value.ColorMap < textureCount )
             {
-                SMD_MATTE value;
-                fread( &value, sizeof(value), 1, pFile );
+                pTexture = &m_Textures[value.ColorMap];
+                pSampler = &m_DiffuseSmp;
+            }
 
-                auto diffuse  = Color4(value.Color.x, value.Color.y, value.Color.z, 1.0f);
-                auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
-                Texture2D*      pTexture = nullptr;
-                TextureSampler* pSampler = nullptr;
+            return MaterialFactory::CreateLambert( diffuse, pTexture, pSampler, emissive );
+        }
 
-                if ( value.ColorMap >= 0 )
-                {
-                    pTexture = &m_Textures[value.ColorMap];
-                    pSampler = &m_DiffuseSmp;
-                }
+    case SMD_MATERIAL_TYPE_MIRROR:
+        {
+            const auto& value = material.Mirror;
 
-                m_Materials[i] = MaterialFactory::CreateLambert( diffuse, pTexture, pSampler, emissive );
-            }
-            break;
+            auto specular = Color4(value.Color.x, value.Color.y, value.Color.z, 1.0f);
+            auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
+            Texture2D*      pTexture = nullptr;
+            TextureSampler* pSampler = nullptr;
 
-        case SMD_MATERIAL_TYPE_MIRROR:
+            if ( value.ColorMap >= 0 && value.ColorMap < textureCount )
             {
-                SMD_MIRROR value;
-                fread( &value, sizeof(value), 1, pFile );
+                pTexture = &m_Textures[value.ColorMap];
+                pSampler = &m_SpecularSmp;
+            }
 
-                auto specular = Color4(value.Color.x, value.Color.y, value.Color.z, 1.0f);
-                auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
-                Texture2D*      pTexture = nullptr;
-                TextureSampler* pSampler = nullptr;
+            return MaterialFactory::CreateMirror( specular, pTexture, pSampler, emissive );
+        }
 
-                if ( value.ColorMap >= 0 )
-                {
-                    pTexture = &m_Textures[value.ColorMap];
-                    pSampler = &m_SpecularSmp;
-                }
+    case SMD_MATERIAL_TYPE_DIELECTRIC:
+        {
+            const auto& value = material.Dielectric;
 
-                m_Materials[i] = MaterialFactory::CreateMirror( specular, pTexture, pSampler, emissive );
-            }
-            break;
+            auto specular = Color4(value.Color.x, value.Color.y, value.Color.z, 1.0f);
+            auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
+            auto ior      = value.Ior;
+            Texture2D*      pTexture = nullptr;
+            TextureSampler* pSampler = nullptr;
 
-        case SMD_MATERIAL_TYPE_DIELECTRIC:
+            if ( value.ColorMap >= 0 && value.ColorMap < textureCount )
             {
-                SMD_DIELECTRIC value;
-                fread( &value, sizeof(value), 1, pFile );
-
-                auto specular = Color4(value.Color.x, value.Color.y, value.Color.z, 1.0f);
-                auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
-                auto ior      = value.Ior;
-                Texture2D*      pTexture = nullptr;
-                TextureSampler* pSampler = nullptr;
-
-                if ( value.ColorMap >= 0 )
-                {
-                    pTexture = &m_Textures[value.ColorMap];
-                    pSampler = &m_SpecularSmp;
-                }
-
-                m_Materials[i] = MaterialFactory::CreateGlass( specular, ior, pTexture, pSampler, emissive );
+                pTexture = &m_Textures[value.ColorMap];
+                pSampler = &m_SpecularSmp;
             }
-            break;
 
-        case SMD_MATERIAL_TYPE_GLOSSY:
+            return MaterialFactory::CreateGlass( specular, ior, pTexture, pSampler, emissive );
+        }
+
+    case SMD_MATERIAL_TYPE_GLOSSY:
+        {
+            const auto& value = material.Glossy;
+
+            auto specular = Color4(value.Color.x, value.Color.y, value.Color.z, 1.0f);
+            auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
+            auto power    = value.Power;
+            Texture2D*      pTexture = nullptr;
+            TextureSampler* pSampler = nullptr;
+
+            if ( value.ColorMap >= 0 && value.ColorMap < textureCount )
             {
-                SMD_GLOSSY value;
-                fread( &value, sizeof(value), 1, pFile );
-
-                auto specular = Color4(value.Color.x, value.Color.y, value.Color.z, 1.0f);
-                auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
-                auto power    = value.Power;
-                Texture2D*      pTexture = nullptr;
-                TextureSampler* pSampler = nullptr;
-
-                if ( value.ColorMap >= 0 )
-                {
-                    pTexture = &m_Textures[value.ColorMap];
-                    pSampler = &m_SpecularSmp;
-                }
-
-                m_Materials[i] = MaterialFactory::CreatePhong( specular, power, pTexture, pSampler, emissive );
+                pTexture = &m_Textures[value.ColorMap];
+                pSampler = &m_SpecularSmp;
             }
-            break;
 
-        case SMD_MATERIAL_TYPE_PLASTIC:
-            {
-                SMD_PLASTIC value;
-                fread( &value, sizeof(value), 1, pFile);
+            return MaterialFactory::CreatePhong( specular, power, pTexture, pSampler, emissive );
+        }
 
-                auto diffuse  = Color4(value.Diffuse.x, value.Diffuse.y, value.Diffuse.z, 1.0f);
-                auto specular = Color4(value.Specular.x, value.Specular.y, value.Specular.z, 1.0f);
-                auto power    = value.Power;
-                auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
+    case SMD_MATERIAL_TYPE_PLASTIC:
+        {
+            const auto& value = material.Plastic;
 
-                Texture2D*      pTexture = nullptr;
-                TextureSampler* pSampler = nullptr;
+            auto diffuse  = Color4(value.Diffuse.x, value.Diffuse.y, value.Diffuse.z, 1.0f);
+            auto specular = Color4(value.Specular.x, value.Specular.y, value.Specular.z, 1.0f);
+            auto power    = value.Power;
+            auto emissive = Color4(value.Emissive.x, value.Emissive.y, value.Emissive.z, 1.0f);
 
-                if ( value.DiffuseMap >= 0 )
-                {
-                    pTexture = &m_Textures[value.DiffuseMap];
-                    pSampler = &m_SpecularSmp;
-                }
+            Texture2D*      pTexture = nullptr;
+            TextureSampler* pSampler = nullptr;
 
-                m_Materials[i] = MaterialFactory::CreatePlastic( diffuse, specular, power, pTexture, pSampler, emissive );
+            if ( value.DiffuseMap >= 0 && value.DiffuseMap < textureCount )
+            {
+                pTexture = &m_Textures[value.DiffuseMap];
+                pSampler = &m_SpecularSmp;
             }
-            break;
 
-        default:
-            assert(false);
-            break;
+            return MaterialFactory::CreatePlastic( diffuse, specular, power, pTexture, pSampler, emissive );
         }
+
+    default:
+        break;
     }
 
-    // 三角形データを読み込みます.
-    for ( size_t i = 0; i < m_Triangles.size(); ++i )
-    {
-        SMD_TRIANGLE triangle;
-        fread( &triangle, sizeof( SMD_TRIANGLE ), 1, pFile );
+    return nullptr;
+}
 
-        Vertex vertex[3];
-        for(auto idx=0; idx<3; ++idx)
-        {
-            vertex[idx].Position = Convert(triangle.Vertex[idx].Position);
-            vertex[idx].Normal   = Convert(triangle.Vertex[idx].Normal);
-            vertex[idx].TexCoord = Convert(triangle.Vertex[idx].TexCoord);
-        }
+//-------------------------------------------------------------------------------------------------
+//      バッファを参照する三角形とBVHを構築します.
+//-------------------------------------------------------------------------------------------------
+bool Mesh::BuildBVH( const char* cacheFile )
+{
+    // 配列はコピーせずにファイルデータを参照します.
+    m_Buffer.Positions   = m_File.GetPositions();
+    m_Buffer.Normals     = m_File.GetNormals();
+    m_Buffer.TexCoords   = m_File.GetTexCoords();
+    m_Buffer.Indices     = m_File.GetIndices();
+    m_Buffer.MaterialIds = m_File.GetMaterialIds();
+    m_Buffer.FaceCount   = m_File.GetTriangleCount();
+
+    const auto faceCount = m_Buffer.FaceCount;
+    if ( faceCount == 0 )
+    { return false; }
 
-        auto material = (triangle.MaterialId >= 0 ) ? m_Materials[triangle.MaterialId] : nullptr;
+    // 三角形はまとめて確保し, 頂点データはバッファを参照する.
+    m_Triangles.resize( faceCount );
 
-        m_Triangles[i] = Triangle::Create(vertex, material);
+    std::vector<IShape*> shapes( faceCount );
+    for( u32 i=0; i<faceCount; ++i )
+    {
+        m_Triangles[i].Init( &m_Buffer, i );
+        shapes[i] = &m_Triangles[i];
     }
 
-    // BVHを構築します.
-    m_pBVH = BVH8::Create( m_Triangles.size(), m_Triangles.data() );
+    if ( cacheFile != nullptr )
+    {
+        // 内容が一致するキャッシュがあれば構築を省略する.
+        const auto hash = CalcContentHash();
+        if ( LoadBVHCache( cacheFile, hash ) )
+        { return true; }
+
+        std::vector<BVH8::CacheNode> nodes;
+        m_pBVH = BVH8::Create( shapes.size(), shapes.data(), &nodes );
+        if ( m_pBVH != nullptr && !SaveBVHCache( cacheFile, hash, shapes, nodes ) )
+        { ILOG( "Warning : BVH Cache Save Failed. filename = %s", cacheFile ); }
+    }
+    else
+    {
+        m_pBVH = BVH8::Create( shapes.size(), shapes.data() );
+    }
+
+    if ( m_pBVH == nullptr )
+    {
+        ELOG( "Error : BVH Create Failed." );
+        return false;
+    }
 
     return true;
 }
@@ -479,32 +357,140 @@ bool Mesh::LoadFromFile( const char* filename )
 //-------------------------------------------------------------------------------------------------
 bool Mesh::Init(u32 vertexCount, Vertex* pVertices, IMaterial* pMaterial)
 {
-    if (vertexCount % 3 != 0)
+    if ( !m_File.Init(vertexCount, pVertices) )
+    { return false; }
+
+    m_Buffer.Materials.resize(1);
+    m_Buffer.Materials[0] = pMaterial;
+    m_Buffer.Materials[0]->AddRef();
+
+    // BVHを構築します.
+    return BuildBVH( nullptr );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      キャッシュの照合に使用する位置座標とインデックスのハッシュ値を計算します.
+//-------------------------------------------------------------------------------------------------
+u64 Mesh::CalcContentHash() const
+{
+    const auto vertexCount = m_File.GetVertexCount();
+    const auto faceCount   = m_Buffer.FaceCount;
+
+    u64 hash = 0xcbf29ce484222325ull;
+    hash = HashBytes( hash, &vertexCount,       sizeof(vertexCount) );
+    hash = HashBytes( hash, &faceCount,         sizeof(faceCount) );
+    hash = HashBytes( hash, m_Buffer.Positions, sizeof(Vector3) * vertexCount );
+    hash = HashBytes( hash, m_Buffer.Indices,   sizeof(u32) * faceCount * 3 );
+
+    return hash;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      BVHキャッシュを読み込みます.
+//-------------------------------------------------------------------------------------------------
+bool Mesh::LoadBVHCache( const char* filename, u64 hash )
+{
+    MappedFile file;
+    if ( !file.Open( filename ) )
     { return false; }
 
-    m_Materials.resize(1);
-    m_Materials[0] = pMaterial;
-    m_Materials[0]->AddRef();
+    auto pData = file.GetData();
+    auto size  = file.GetSize();
 
-    auto triangleCount = vertexCount / 3;
+    BVH_CACHE_HEADER header;
+    if ( size < sizeof(header) )
+    { return false; }
 
-    bool failed = false;
-    m_Triangles.resize(triangleCount);
+    memcpy( &header, pData, sizeof(header) );
 
-    for(u32 i=0; i<triangleCount; ++i)
+    // ビルダーや入力が変わっている場合は再構築する.
+    if ( memcmp( header.Magic, BVH_CACHE_TAG, sizeof(u8) * 4 ) != 0
+      || header.Version        != BVH_CACHE_VERSION
+      || header.BuilderVersion != BVH_BUILDER_VERSION
+      || header.NodeStructSize != sizeof(BVH8::CacheNode)
+      || header.ContentHash    != hash
+      || header.FaceCount      != m_Buffer.FaceCount
+      || header.NodeCount      == 0 )
     {
-       m_Triangles[i] = Triangle::Create(&pVertices[i * 3], pMaterial);
-       if (m_Triangles[i] == nullptr)
-       { failed = true; }
+        ILOG( "Info : BVH Cache Mismatch. Rebuild BVH. filename = %s", filename );
+        return false;
     }
 
-    if (failed)
+    const u64 orderSize = u64( sizeof(u32) )             * header.FaceCount;
+    const u64 nodeSize  = u64( sizeof(BVH8::CacheNode) ) * header.NodeCount;
+    if ( header.OrderOffset % BVH_CACHE_ALIGN != 0 || header.OrderOffset > size || orderSize > size - header.OrderOffset
+      || header.NodeOffset  % BVH_CACHE_ALIGN != 0 || header.NodeOffset  > size || nodeSize  > size - header.NodeOffset )
     { return false; }
 
-    // BVHを構築します.
-    m_pBVH = BVH8::Create( m_Triangles.size(), m_Triangles.data() );
+    // 面番号が重複なく全ての面を指していることを確認して並べる.
+    auto pOrder = reinterpret_cast<const u32*>( pData + header.OrderOffset );
+    std::vector<bool>    used  ( header.FaceCount, false );
+    std::vector<IShape*> shapes( header.FaceCount );
+    for( u32 i=0; i<header.FaceCount; ++i )
+    {
+        const auto face = pOrder[i];
+        if ( face >= header.FaceCount || used[face] )
+        { return false; }
 
-    return true;
+        used[face] = true;
+        shapes[i]  = &m_Triangles[face];
+    }
+
+    auto pNodes = reinterpret_cast<const BVH8::CacheNode*>( pData + header.NodeOffset );
+    m_pBVH = BVH8::Create( shapes.size(), shapes.data(), pNodes, header.NodeCount );
+
+    return ( m_pBVH != nullptr );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      BVHキャッシュを保存します.
+//-------------------------------------------------------------------------------------------------
+bool Mesh::SaveBVHCache
+(
+    const char*                         filename,
+    u64                                 hash,
+    const std::vector<IShape*>&         shapes,
+    const std::vector<BVH8::CacheNode>& nodes
+) const
+{
+    // 並び替え後の形状から面番号を求める.
+    std::vector<u32> order( shapes.size() );
+    for( size_t i=0; i<shapes.size(); ++i )
+    {
+        auto pTriangle = static_cast<const MeshTriangle*>( shapes[i] );
+        order[i] = static_cast<u32>( pTriangle - m_Triangles.data() );
+    }
+
+    BVH_CACHE_HEADER header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.Magic, BVH_CACHE_TAG, sizeof(u8) * 4 );
+    header.Version        = BVH_CACHE_VERSION;
+    header.BuilderVersion = BVH_BUILDER_VERSION;
+    header.NodeStructSize = sizeof(BVH8::CacheNode);
+    header.ContentHash    = hash;
+    header.FaceCount      = static_cast<u32>( order.size() );
+    header.NodeCount      = static_cast<u32>( nodes.size() );
+    header.OrderOffset    = AlignOffset( sizeof(header) );
+    header.NodeOffset     = AlignOffset( header.OrderOffset + sizeof(u32) * order.size() );
+
+    FILE* pFile;
+    errno_t err = fopen_s( &pFile, filename, "wb" );
+    if ( err != 0 )
+    { return false; }
+
+    static const u8 padding[ BVH_CACHE_ALIGN ] = {};
+    const auto orderEnd = header.OrderOffset + sizeof(u32) * order.size();
+
+    fwrite( &header, sizeof(header), 1, pFile );
+    fwrite( padding, size_t( header.OrderOffset - sizeof(header) ), 1, pFile );
+    fwrite( order.data(), sizeof(u32) * order.size(), 1, pFile );
+    fwrite( padding, size_t( header.NodeOffset - orderEnd ), 1, pFile );
+    fwrite( nodes.data(), sizeof(BVH8::CacheNode) * nodes.size(), 1, pFile );
+
+    auto result = ( ferror( pFile ) == 0 );
+    fclose( pFile );
+
+    return result;
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -543,6 +529,18 @@ IShape* Mesh::Create(const char* filename)
     return instance;
 }
 
+//-------------------------------------------------------------------------------------------------
+//      遮蔽判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool Mesh::IsOccluded( const RaySet& raySet, f32 distance ) const
+{ return m_pBVH->IsOccluded( raySet, distance ); }
+
+//-------------------------------------------------------------------------------------------------
+//      レイパケットの交差判定を行います.
+//-------------------------------------------------------------------------------------------------
+u32 Mesh::IsHitPacket( const RayPacket& packet, u32 active, HitRecord* pRecords ) const
+{ return m_pBVH->IsHitPacket( packet, active, pRecords ); }
+
 //-------------------------------------------------------------------------------------------------
 //      生成処理を行います.
 //-------------------------------------------------------------------------------------------------
@@ -0,0 +1,187 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_meshtriangle.cpp
+// Desc : Indexed Mesh Triangle Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_meshtriangle.h>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// MeshTriangle class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------------------
+//      コンストラクタです.
+//-------------------------------------------------------------------------------------------------
+MeshTriangle::MeshTriangle()
+: m_pBuffer  ( nullptr )
+, m_FaceIndex( 0 )
+{ /* DO_NOTHING */ }
+
+//-------------------------------------------------------------------------------------------------
+//      デストラクタです.
+//-------------------------------------------------------------------------------------------------
+MeshTriangle::~MeshTriangle()
+{ /* DO_NOTHING */ }
+
+//-------------------------------------------------------------------------------------------------
+//      参照するバッファと面番号を設定します.
+//-------------------------------------------------------------------------------------------------
+void MeshTriangle::Init(const MeshBuffer* pBuffer, u32 faceIndex)
+{
+    m_pBuffer   = pBuffer;
+    m_FaceIndex = faceIndex;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      参照カウントを増やします.
+//-------------------------------------------------------------------------------------------------
+void MeshTriangle::AddRef()
+{ /* DO_NOTHING */ }
+
+//-------------------------------------------------------------------------------------------------
+//      解放処理を行います.
+//-------------------------------------------------------------------------------------------------
+void MeshTriangle::Release()
+{ /* DO_NOTHING */ }
+
+//-------------------------------------------------------------------------------------------------
+//      参照カウントを取得します.
+//-------------------------------------------------------------------------------------------------
+u32 MeshTriangle::GetCount() const
+{ return 1; }
+
+//-------------------------------------------------------------------------------------------------
+//      交差距離と重心座標を求めます.
+//-------------------------------------------------------------------------------------------------
+bool MeshTriangle::Intersect(const RaySet& raySet, f32& dist, f32& beta, f32& gamma) const
+{
+    auto p0 = GetPosition(0);
+    auto e0 = GetPosition(1) - p0;
+    auto e1 = GetPosition(2) - p0;
+
+    auto s1  = Vector3::Cross( raySet.ray.dir, e1 );
+    auto div = Vector3::Dot( s1, e0 );
+
+    if ( abs(div) <= FLT_EPSILON )
+    { return false; }
+
+    auto d = raySet.ray.pos - p0;
+    beta = Vector3::Dot( d, s1 ) / div;
+    if ( beta <= 0.0 || beta >= 1.0 )
+    { return false; }
+
+    auto s2 = Vector3::Cross( d, e0 );
+    gamma = Vector3::Dot( raySet.ray.dir, s2 ) / div;
+    if ( gamma <= 0.0 || ( beta + gamma ) >= 1.0 )
+    { return false; }
+
+    dist = Vector3::Dot( e1, s2 ) / div;
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      交差判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool MeshTriangle::IsHit(const RaySet& raySet, HitRecord& record) const
+{
+    f32 dist, beta, gamma;
+    if ( !Intersect( raySet, dist, beta, gamma ) )
+    { return false; }
+
+    if ( dist < F_HIT_MIN || dist > F_HIT_MAX )
+    { return false; }
+
+    if ( dist >= record.distance )
+    { return false; }
+
+    SetHitRecord( raySet, dist, beta, gamma, record );
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      遮蔽判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool MeshTriangle::IsOccluded(const RaySet& raySet, f32 distance) const
+{
+    f32 dist, beta, gamma;
+    if ( !Intersect( raySet, dist, beta, gamma ) )
+    { return false; }
+
+    return ( F_HIT_MIN <= dist && dist < distance );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      バウンディングボックスを取得します.
+//-------------------------------------------------------------------------------------------------
+BoundingBox MeshTriangle::GetBox() const
+{
+    auto p0 = GetPosition(0);
+    auto p1 = GetPosition(1);
+    auto p2 = GetPosition(2);
+
+    auto mini = Vector3::Min( Vector3::Min( p0, p1 ), p2 );
+    auto maxi = Vector3::Max( Vector3::Max( p0, p1 ), p2 );
+    return BoundingBox( mini, maxi );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      中心座標を取得します.
+//-------------------------------------------------------------------------------------------------
+Vector3 MeshTriangle::GetCenter() const
+{ return GetBox().center; }
+
+//-------------------------------------------------------------------------------------------------
+//      頂点の位置座標を取得します.
+//-------------------------------------------------------------------------------------------------
+Vector3 MeshTriangle::GetPosition(u32 index) const
+{
+    assert( index < 3 );
+    return m_pBuffer->Positions[ m_pBuffer->Indices[ m_FaceIndex * 3 + index ] ];
+}
+
+//-------------------------------------------------------------------------------------------------
+//      交差位置の重心座標から属性を補間して交差記録を設定します.
+//-------------------------------------------------------------------------------------------------
+void MeshTriangle::SetHitRecord(const RaySet& raySet, f32 dist, f32 beta, f32 gamma, HitRecord& record) const
+{
+    const auto i0 = m_pBuffer->Indices[ m_FaceIndex * 3 + 0 ];
+    const auto i1 = m_pBuffer->Indices[ m_FaceIndex * 3 + 1 ];
+    const auto i2 = m_pBuffer->Indices[ m_FaceIndex * 3 + 2 ];
+
+    const auto materialId = m_pBuffer->MaterialIds[ m_FaceIndex ];
+
+    record.position  = raySet.ray.pos + raySet.ray.dir * dist;
+    record.distance  = dist;
+    record.pShape    = this;
+    record.pMaterial = ( materialId >= 0 ) ? m_pBuffer->Materials[ materialId ] : nullptr;
+
+    auto alpha = 1.0f - beta - gamma;
+
+    const auto& n0 = m_pBuffer->Normals[ i0 ];
+    const auto& n1 = m_pBuffer->Normals[ i1 ];
+    const auto& n2 = m_pBuffer->Normals[ i2 ];
+    record.normal = n0 * alpha + n1 * beta + n2 * gamma;
+    record.normal.SafeNormalize();
+
+    const auto& t0 = m_pBuffer->TexCoords[ i0 ];
+    const auto& t1 = m_pBuffer->TexCoords[ i1 ];
+    const auto& t2 = m_pBuffer->TexCoords[ i2 ];
+    record.texcoord = t0 * alpha + t1 * beta + t2 * gamma;
+
+    const auto& p0 = m_pBuffer->Positions[ i0 ];
+    record.uvDensity = ComputeUVDensity(
+        m_pBuffer->Positions[ i1 ] - p0,
+        m_pBuffer->Positions[ i2 ] - p0,
+        t1 - t0,
+        t2 - t0 );
+}
+
+} // namespace s3d
@@ -66,10 +66,21 @@ Color4 Mirror::Shade( ShadingArg& arg ) const
 
     arg.output = reflect;
     arg.dice   = false;
+    arg.pdf    = 0.0f;
 
     return m_Specular;
 }
 
+//-------------------------------------------------------------------------------------------------
+//      指定方向へのBSDFに余弦項を乗じた値と確率密度を求めます.
+//-------------------------------------------------------------------------------------------------
+Color4 Mirror::Evaluate( const ShadingArg&, const Vector3&, f32& pdf ) const
+{
+    // デルタ関数なので任意の方向に対する値は0.
+    pdf = 0.0f;
+    return Color4( 0.0f, 0.0f, 0.0f, 0.0f );
+}
+
 //-------------------------------------------------------------------------------------------------
 //      エミッシブカラーを取得します.
 //-------------------------------------------------------------------------------------------------
@@ -82,6 +93,12 @@ Color4 Mirror::GetEmissive() const
 bool Mirror::HasDelta() const
 { return true; }
 
+//-------------------------------------------------------------------------------------------------
+//      マテリアルの種類を取得します.
+//-------------------------------------------------------------------------------------------------
+MATERIAL_TYPE Mirror::GetType() const
+{ return MATERIAL_TYPE_MIRROR; }
+
 //-------------------------------------------------------------------------------------------------
 //      生成処理を行います.
 //-------------------------------------------------------------------------------------------------
@@ -86,10 +86,31 @@ Color4 Phong::Shade( ShadingArg& arg ) const
 
     arg.output = dir;
     arg.dice = (arg.random.GetAsF32() >= m_Threshold);
+    arg.pdf  = ( m_Power + 1.0f ) * F_1DIV2PI * powf( z, m_Power );
 
     return m_Specular * cosine * ((m_Power + 2.0f) / (m_Power + 1.0f));
 }
 
+//-------------------------------------------------------------------------------------------------
+//      指定方向へのBSDFに余弦項を乗じた値と確率密度を求めます.
+//-------------------------------------------------------------------------------------------------
+Color4 Phong::Evaluate( const ShadingArg& arg, const Vector3& dir, f32& pdf ) const
+{
+    auto reflect = Vector3::SafeUnitVector( Vector3::Reflect( arg.input, arg.normal ) );
+    auto cosAlpha = Vector3::Dot( dir, reflect );
+    auto cosine   = Vector3::Dot( dir, arg.normal );
+    if ( cosAlpha <= 0.0f || cosine <= 0.0f )
+    {
+        pdf = 0.0f;
+        return Color4( 0.0f, 0.0f, 0.0f, 0.0f );
+    }
+
+    // Shade() と同じ正規化Phongローブ.
+    auto lobe = powf( cosAlpha, m_Power ) * F_1DIV2PI;
+    pdf = ( m_Power + 1.0f ) * lobe;
+    return m_Specular * ( ( m_Power + 2.0f ) * lobe * cosine );
+}
+
 //-------------------------------------------------------------------------------------------------
 //      エミッシブカラーを取得します.
 //-------------------------------------------------------------------------------------------------
@@ -102,6 +123,12 @@ Color4 Phong::GetEmissive() const
 bool Phong::HasDelta() const
 { return false; }
 
+//-------------------------------------------------------------------------------------------------
+//      マテリアルの種類を取得します.
+//-------------------------------------------------------------------------------------------------
+MATERIAL_TYPE Phong::GetType() const
+{ return MATERIAL_TYPE_PHONG; }
+
 //-------------------------------------------------------------------------------------------------
 //      生成処理です.
 //-------------------------------------------------------------------------------------------------
@@ -44,17 +44,9 @@ u32 Plastic::GetCount() const
 
 Color4 Plastic::Shade( ShadingArg& arg ) const
 {
-    // 補正済み法線データ (レイの入出を考慮済み).
-    auto cosine = Vector3::Dot( arg.normal, arg.input );
-    const Vector3 normalMod = ( cosine < 0.0 ) ? arg.normal : -arg.normal;
-
-    if ( cosine < 0.0f )
-    { cosine = -cosine; }
-
-    auto temp1 = 1.0f - cosine;
-    const auto R0 = 0.5f;
-    auto R = R0 + ( 1.0f - R0 ) * temp1 * temp1 * temp1 * temp1 * temp1;
-    auto P = ( R + 0.5f ) / 2.0f;
+    Vector3 normalMod;
+    f32 R, P;
+    ComputeReflectance( arg, normalMod, R, P );
 
     if ( arg.random.GetAsF32() <= P )
     {
@@ -77,6 +69,7 @@ Color4 Plastic::Shade( ShadingArg& arg ) const
         // 重み更新 (飛ぶ方向が不定なので確率で割る必要あり).
         auto result = m_Diffuse  * R / P;
         arg.dice = ( arg.random.GetAsF32() >= m_Threshold[0] );
+        arg.pdf  = ComputePdf( dir, normalMod, Vector3::SafeUnitVector( Vector3::Reflect( arg.input, normalMod ) ), P );
 
         return result;
     }
@@ -106,17 +99,71 @@ Color4 Plastic::Shade( ShadingArg& arg ) const
 
         arg.output = dir;
         arg.dice = ( arg.random.GetAsF32() >= m_Threshold[1] );
+        arg.pdf  = ComputePdf( dir, normalMod, w, P );
 
         return m_Specular * dots * ( 1.0f - R ) / ( 1.0f - P );
     }
 }
 
+Color4 Plastic::Evaluate( const ShadingArg& arg, const Vector3& dir, f32& pdf ) const
+{
+    Vector3 normalMod;
+    f32 R, P;
+    ComputeReflectance( arg, normalMod, R, P );
+
+    auto cosine = Vector3::Dot( dir, normalMod );
+    if ( cosine <= 0.0f )
+    {
+        pdf = 0.0f;
+        return Color4( 0.0f, 0.0f, 0.0f, 0.0f );
+    }
+
+    auto reflect  = Vector3::SafeUnitVector( Vector3::Reflect( arg.input, normalMod ) );
+    auto cosAlpha = Max( Vector3::Dot( dir, reflect ), 0.0f );
+    auto lobe     = ( m_Power + 1.0f ) * F_1DIV2PI * powf( cosAlpha, m_Power );
+
+    // Shade() の2つの重みに対応するBSDFの和.
+    pdf = ComputePdf( dir, normalMod, reflect, P );
+    return m_Diffuse  * ( R * cosine * F_1DIVPI )
+         + m_Specular * ( ( 1.0f - R ) * lobe * cosine );
+}
+
+void Plastic::ComputeReflectance( const ShadingArg& arg, Vector3& normalMod, f32& R, f32& P ) const
+{
+    // 補正済み法線データ (レイの入出を考慮済み).
+    auto cosine = Vector3::Dot( arg.normal, arg.input );
+    normalMod = ( cosine < 0.0 ) ? arg.normal : -arg.normal;
+
+    if ( cosine < 0.0f )
+    { cosine = -cosine; }
+
+    auto temp1 = 1.0f - cosine;
+    const auto R0 = 0.5f;
+    R = R0 + ( 1.0f - R0 ) * temp1 * temp1 * temp1 * temp1 * temp1;
+    P = ( R + 0.5f ) / 2.0f;
+}
+
+f32 Plastic::ComputePdf( const Vector3& dir, const Vector3& normalMod, const Vector3& reflect, f32 P ) const
+{
+    // 拡散と鏡面のどちらからも選ばれうるので, 混合分布の確率密度を返す.
+    auto cosine   = Max( Vector3::Dot( dir, normalMod ), 0.0f );
+    auto cosAlpha = Max( Vector3::Dot( dir, reflect ), 0.0f );
+    return P * cosine * F_1DIVPI
+         + ( 1.0f - P ) * ( m_Power + 1.0f ) * F_1DIV2PI * powf( cosAlpha, m_Power );
+}
+
 Color4 Plastic::GetEmissive() const
 { return m_Emissive; }
 
 bool Plastic::HasDelta() const
 { return false; }
 
+//-------------------------------------------------------------------------------------------------
+//      マテリアルの種類を取得します.
+//-------------------------------------------------------------------------------------------------
+MATERIAL_TYPE Plastic::GetType() const
+{ return MATERIAL_TYPE_PLASTIC; }
+
 IMaterial* Plastic::Create(const Color4& diffuse, const Color4& specular, f32 power)
 { return Plastic::Create(diffuse, specular, power, Color4(0.0f, 0.0f, 0.0f, 1.0f)); }
 
@@ -8,8 +8,13 @@
 // Includes
 //-------------------------------------------------------------------------------------------------
 #include <cstdio>
+#include <cstring>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <vector>
 #include <direct.h>
 
 #include <s3d_pt.h>
@@ -33,7 +38,98 @@ namespace /* anonymous */ {
 // Global Variables.
 //-------------------------------------------------------------------------------------------------
 std::mutex      g_Mutex;
+std::condition_variable       g_FinishCond;               // 経路追跡の終了通知.
 const s3d::TONE_MAPPING_TYPE  ToneMappingType = s3d::TONE_MAPPING_ACES_FILMIC;
+const u32                     RandomSeed      = 3141592;
+const s32                     AdaptiveMinSampleCount = 64;      // 収束判定を始める最小サンプル数.
+const f32                     AdaptiveEpsilon        = 1e-2f;   // 暗いピクセルの相対誤差が発散しないようにするための値.
+const f64                     FinishMarginSec        = 1.0;     // 最終キャプチャー用に締め切り前に空けておく時間.
+const char*                   CheckpointFile         = "img/checkpoint.bin";    // チェックポイントのファイル名.
+const s32                     CheckpointProbeCount   = 32;      // チェックポイント照合用に1辺あたりに飛ばすプローブレイの数.
+const u64                     FnvOffsetBasis         = 0xcbf29ce484222325ull;
+const u64                     FnvPrime               = 0x100000001b3ull;
+
+#if S3D_TRAVERSAL_STATS
+std::atomic<u64>              g_RayCount      ( 0 );      // 交差判定したレイの総数.
+std::atomic<u64>              g_VisitCount    ( 0 );      // 走査したBVHノードの総数.
+thread_local u64              t_RayCount      = 0;        // スレッドごとのレイ数.
+thread_local u64              t_VisitCount    = 0;        // スレッドごとの走査ノード数.
+
+//-------------------------------------------------------------------------------------------------
+//      走査統計を記録します.
+//-------------------------------------------------------------------------------------------------
+inline void CountTraversal( const s3d::HitRecord& record )
+{
+    t_RayCount++;
+    t_VisitCount += record.visitCount;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      スレッドごとの走査統計を集計します.
+//-------------------------------------------------------------------------------------------------
+inline void FlushTraversal()
+{
+    g_RayCount   += t_RayCount;
+    g_VisitCount += t_VisitCount;
+    t_RayCount   = 0;
+    t_VisitCount = 0;
+}
+#endif//S3D_TRAVERSAL_STATS
+
+//-------------------------------------------------------------------------------------------------
+//      FNV-1a でハッシュ値を更新します.
+//-------------------------------------------------------------------------------------------------
+inline u64 HashBytes( u64 hash, const void* pData, size_t size )
+{
+    auto pBytes = static_cast<const u8*>( pData );
+    for( size_t i=0; i<size; ++i )
+    { hash = ( hash ^ pBytes[i] ) * FnvPrime; }
+
+    return hash;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      値でハッシュ値を更新します.
+//-------------------------------------------------------------------------------------------------
+template<typename T>
+inline u64 HashValue( u64 hash, const T& value )
+{ return HashBytes( hash, &value, sizeof(T) ); }
+
+//-------------------------------------------------------------------------------------------------
+//      ベクトルでハッシュ値を更新します. パディングを含めないよう成分ごとに処理します.
+//-------------------------------------------------------------------------------------------------
+inline u64 HashValue( u64 hash, const s3d::Vector3& value )
+{
+    hash = HashValue( hash, value.x );
+    hash = HashValue( hash, value.y );
+    return HashValue( hash, value.z );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      色でハッシュ値を更新します. W成分は使わないので含めません.
+//-------------------------------------------------------------------------------------------------
+inline u64 HashValue( u64 hash, const s3d::Color4& value )
+{
+    hash = HashValue( hash, value.GetX() );
+    hash = HashValue( hash, value.GetY() );
+    return HashValue( hash, value.GetZ() );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      輝度を求めます.
+//-------------------------------------------------------------------------------------------------
+inline f32 Luminance( const s3d::Color4& value )
+{ return 0.2126f * value.GetX() + 0.7152f * value.GetY() + 0.0722f * value.GetZ(); }
+
+//-------------------------------------------------------------------------------------------------
+//      多重重点的サンプリングの重みをパワーヒューリスティックで求めます.
+//-------------------------------------------------------------------------------------------------
+inline f32 PowerHeuristic( f32 pdf, f32 otherPdf )
+{
+    auto a = pdf * pdf;
+    auto b = otherPdf * otherPdf;
+    return ( a + b > 0.0f ) ? a / ( a + b ) : 0.0f;
+}
 
 } // namespace /* anonymous */
 
@@ -49,10 +145,15 @@ namespace s3d {
 //-------------------------------------------------------------------------------------------------
 PathTracer::PathTracer()
 : m_RenderTarget( nullptr )
+, m_Moment      ( nullptr )
+, m_Resolved    ( nullptr )
 , m_Intermediate( nullptr )
 , m_pScene      ( nullptr )
+, m_Resumed     ( false )
+, m_CheckpointReady( false )
 , m_IsFinish    ( false )
 , m_WatcherEnd  ( false )
+, m_Deadline    ( std::chrono::steady_clock::time_point::max() )
 { /* DO_NOTHING */ }
 
 //-------------------------------------------------------------------------------------------------
@@ -61,6 +162,8 @@ PathTracer::PathTracer()
 PathTracer::~PathTracer()
 {
     SafeDeleteArray( m_RenderTarget );
+    SafeDeleteArray( m_Moment );
+    SafeDeleteArray( m_Resolved );
     SafeDeleteArray( m_Intermediate );
     SafeDelete( m_pScene );
 }
@@ -83,6 +186,12 @@ bool PathTracer::Run( const Config& config )
     ILOG( "     subsample  = %d", config.SubSampleCount );
     ILOG( "     max bounce = %d", config.MaxBounceCount );
     ILOG( "     CPU Core   = %d", config.CpuCoreCount );
+    ILOG( "     tile size  = %d", config.TileSize );
+    ILOG( "     tile sample= %d", config.TileSampleCount );
+    ILOG( "     adaptive   = %f", config.AdaptiveThreshold );
+    ILOG( "     max sample = %d", config.MaxSampleCount );
+    ILOG( "     checkpoint = %f", config.CheckpointIntervalSec );
+    ILOG( "     resume     = %s", ( config.Resume ) ? "true" : "false" );
     ILOG( "--------------------------------------------------------------------" );
 
     // コンフィグ設定.
@@ -94,22 +203,36 @@ bool PathTracer::Run( const Config& config )
 
     // レンダーターゲットを生成.
     m_RenderTarget = new Color4 [m_Config.Width * m_Config.Height];
-    m_Intermediate = new Color4 [m_Config.Width * m_Config.Height];
+    m_Moment       = new f32 [m_Config.Width * m_Config.Height];
+    m_Resolved     = new Color4 [m_Config.Width * m_Config.Height];
+    m_Intermediate = new u8 [m_Config.Width * m_Config.Height * 3];
 
     for( auto i=0; i<m_Config.Width * m_Config.Height; ++i )
     {
         m_RenderTarget[i] = Color4(0.0f, 0.0f, 0.0f, 0.0f);
-        m_Intermediate[i] = Color4(0.0f, 0.0f, 0.0f, 0.0f);
+        m_Resolved    [i] = Color4(0.0f, 0.0f, 0.0f, 0.0f);
     }
+    memset( m_Moment,       0, sizeof(f32) * m_Config.Width * m_Config.Height );
+    memset( m_Intermediate, 0, sizeof(u8) * m_Config.Width * m_Config.Height * 3 );
+
+    // 締め切り時刻を決定.
+    m_Deadline = std::chrono::steady_clock::now()
+               + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<f64>( m_Config.MaxRenderingMin * 60.0 ) );
 
     // 時間監視スレッドを起動.
-    std::thread thd( &PathTracer::Watcher, this, m_Config.MaxRenderingMin, m_Config.CaptureIntervalSec );
+    std::thread thd( &PathTracer::Watcher, this, m_Config.CaptureIntervalSec );
 
     // 画像出力用ディレクトリ作成.
     _mkdir( "./img" );
 
     // シーン生成.
-    m_pScene = new TestScene( m_Config.Width, m_Config.Height );
+    auto pScene = new TestScene( m_Config.Width, m_Config.Height );
+
+    // チェックポイントはシーンの内容と照合するので, シーン生成後に準備する.
+    PrepareCheckpoint( pScene );
+
+    m_pScene = pScene;
 
     // 経路追跡を実行.
     TracePath();
@@ -117,11 +240,22 @@ bool PathTracer::Run( const Config& config )
     // 時間監視スレッドを終了.
     thd.join();
 
+    // 打ち切られた場合でも続きから再開できるよう, 最終状態を保存する.
+    if ( m_CheckpointReady )
+    {
+        m_Checkpoint.SaveAsync( CheckpointFile );
+        m_Checkpoint.Wait();
+    }
+    m_CheckpointReady = false;
+    m_Checkpoint.Term();
+
     // シーンを破棄.
     SafeDelete( m_pScene );
 
     // レンダーターゲット解放.
     SafeDeleteArray(m_RenderTarget);
+    SafeDeleteArray(m_Moment);
+    SafeDeleteArray(m_Resolved);
     SafeDeleteArray(m_Intermediate);
 
     return m_IsFinish;
@@ -133,11 +267,21 @@ bool PathTracer::Run( const Config& config )
 void PathTracer::Capture( const char* filename )
 {
 #if 1
-    // トーンマッピングを実行.
-    ToneMapper::Map( ToneMappingType, m_Config.Width, m_Config.Height, m_RenderTarget, m_Intermediate );
+    // ピクセルごとにサンプル数が異なるので, 累積値をサンプル数で割って正規化する.
+    for( auto i=0; i<m_Config.Width * m_Config.Height; ++i )
+    {
+        const auto& pixel = m_RenderTarget[i];
+        const auto  count = pixel.GetW();
+        m_Resolved[i] = ( count > 0.0f )
+            ? Color4( pixel.GetX() / count, pixel.GetY() / count, pixel.GetZ() / count, 1.0f )
+            : Color4( 0.0f, 0.0f, 0.0f, 0.0f );
+    }
+
+    // トーンマッピング, ガンマ補正, 量子化をまとめて実行.
+    ToneMapper::Map( ToneMappingType, m_Config.Width, m_Config.Height, m_Resolved, m_Intermediate );
 
     // BMPに出力する.
-    SaveToBMP( filename, m_Config.Width, m_Config.Height, &m_Intermediate[0].x );
+    SaveToBMP( filename, m_Config.Width, m_Config.Height, m_Intermediate );
 #else
     SaveToBMP( filename, m_Config.Width, m_Config.Height, &m_RenderTarget[0].x);
 #endif
@@ -146,7 +290,7 @@ void PathTracer::Capture( const char* filename )
 //-------------------------------------------------------------------------------------------------
 //      レンダリング時間を監視します.
 //-------------------------------------------------------------------------------------------------
-void PathTracer::Watcher(f32 maxRenderingTimeMin, f32 captureIntervalSec)
+void PathTracer::Watcher( f32 captureIntervalSec )
 {
     auto counter = 0;
     char filename[256];
@@ -155,22 +299,61 @@ void PathTracer::Watcher(f32 maxRenderingTimeMin, f32 captureIntervalSec)
     Timer renderingTimer;
     renderingTimer.Start();
 
-    Timer captureTimer;
-    captureTimer.Start();
+    const auto captureInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<f64>( captureIntervalSec ) );
+    auto nextCapture = std::chrono::steady_clock::now() + captureInterval;
+
+    const auto checkpointEnabled  = ( m_Config.CheckpointIntervalSec > 0.0f );
+    const auto checkpointInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<f64>( m_Config.CheckpointIntervalSec ) );
+    auto nextCheckpoint = ( checkpointEnabled )
+        ? std::chrono::steady_clock::now() + checkpointInterval
+        : std::chrono::steady_clock::time_point::max();
+
+    // シーン生成待ちの表示間隔.
+    const auto waitInterval = std::chrono::seconds( 1 );
 
     while( true )
     {
-        captureTimer.Stop();
-        auto sec = captureTimer.GetElapsedTimeSec();
+        // 次のキャプチャー時刻か締め切りまで, 経路追跡の終了通知を待つ.
+        {
+            auto wakeup = ( nextCapture < m_Deadline ) ? nextCapture : m_Deadline;
+            wakeup = std::min( wakeup, nextCheckpoint );
+            if ( m_pScene == nullptr )
+            { wakeup = std::min( wakeup, std::chrono::steady_clock::now() + waitInterval ); }
+
+            std::unique_lock<std::mutex> locker( g_Mutex );
+            g_FinishCond.wait_until( locker, wakeup, [this]{ return m_IsFinish; } );
+        }
+
+        const auto now = std::chrono::steady_clock::now();
 
         renderingTimer.Stop();
         auto min = renderingTimer.GetElapsedTimeMin();
 
+        // レンダリングが正常終了した場合.
+        if ( m_IsFinish )
+        {
+            ILOG( "Rendering Completed !!!" );
+            ILOG( "Rendering Time %lf min", min );
+            break;
+        }
+
+        // 規定時間に達した場合. 処理中の経路を打ち切らせて, 加算が終わるのを少しだけ待つ.
+        if ( now >= m_Deadline )
+        {
+            ILOG( "Rendering Imcompleted..." );
+            m_WatcherEnd = true;
+
+            std::unique_lock<std::mutex> locker( g_Mutex );
+            g_FinishCond.wait_for( locker, std::chrono::duration<f64>( FinishMarginSec ), [this]{ return m_IsFinish; } );
+            break;
+        }
+
         // レンダリング結果をキャプチャ.
-        if ( sec >= captureIntervalSec )
+        if ( now >= nextCapture )
         {
-            // タイマー再スタート.
-            captureTimer.Start();
+            nextCapture += captureInterval;
 
             // ファイル保存.
             sprintf_s( filename, "img/%03d.bmp", counter );
@@ -181,31 +364,19 @@ void PathTracer::Watcher(f32 maxRenderingTimeMin, f32 captureIntervalSec)
             ILOG( "Captured. %5.2lf min", min );
         }
 
-        // シーン生成待ち.
-        if (m_pScene == nullptr)
-        {
-            printf_s( "\rWaiting for create scene. min = %5.2lf min", min );
-        }
-
-        // 規定時間に達した場合.
-        if ( min >= maxRenderingTimeMin )
+        // 累積結果を非同期でチェックポイントに保存. 準備が終わるまでは保存しない.
+        if ( now >= nextCheckpoint )
         {
-            sprintf_s( filename, "img/%03d.bmp", counter );
-            ILOG( "Rendering Imcompleted..." );
-            break;
+            nextCheckpoint += checkpointInterval;
+            if ( m_CheckpointReady )
+            { m_Checkpoint.SaveAsync( CheckpointFile ); }
         }
 
-        // レンダリングが正常終了した場合.
-        if ( m_IsFinish )
+        // シーン生成待ち.
+        if (m_pScene == nullptr)
         {
-            sprintf_s( filename, "img/%03d.bmp", counter );
-            ILOG( "Rendering Completed !!!" );
-            ILOG( "Rendering Time %lf min", min );
-            break;
+            printf_s( "\rWaiting for create scene. min = %5.2lf min", min );
         }
-
-        // 1 sec 寝かせる.
-        Sleep( 1000 );
     }
 
     Capture( "img/final.bmp" );
@@ -216,25 +387,49 @@ void PathTracer::Watcher(f32 maxRenderingTimeMin, f32 captureIntervalSec)
 //-------------------------------------------------------------------------------------------------
 //      指定方向からの放射輝度推定を行います.
 //-------------------------------------------------------------------------------------------------
-Color4 PathTracer::Radiance( const Ray& input )
+Color4 PathTracer::Radiance( const Ray& input, f32 spreadAngle, Random& random, const HitRecord* pPrimary )
 {
     auto arg    = ShadingArg();
     auto raySet = MakeRaySet( input.pos, input.dir );
 
+    // レイコーンの幅. 反射面の曲率は無視して, 広がり角は一定のまま経路長に応じて広げる.
+    auto coneWidth = 0.0f;
+
+    // 直前の反射で出射方向を選んだ確率密度. カメラレイやデルタ関数の後は0として扱う.
+    auto bsdfPdf = 0.0f;
+
     Color4 W( 1.0f, 1.0f, 1.0f, 1.0f );
     Color4 L( 0.0f, 0.0f, 0.0f, 0.0f );
 
     // 乱数設定.
-    arg.random = m_Random;
+    arg.random = random;
 
     for( auto depth=0; depth < m_Config.MaxBounceCount && !m_WatcherEnd ;++depth)
     {
         auto record = HitRecord();
+        auto hit    = false;
+
+        // 交差判定. カメラレイはパケット走査済みの結果があればそれを使う.
+        if ( depth == 0 && pPrimary != nullptr )
+        {
+            record = *pPrimary;
+            hit    = ( record.pShape != nullptr );
+        }
+        else
+        { hit = m_pScene->Intersect( raySet, record ); }
 
-        // 交差判定.
-        if ( !m_pScene->Intersect( raySet, record ) )
+    #if S3D_TRAVERSAL_STATS
+        CountTraversal( record );
+    #endif
+
+        if ( !hit )
         {
-            L += Color4::Mul( W, m_pScene->SampleIBL( raySet.ray.dir ) );
+            // 直接光ライティングでも選ばれうる方向なので, 重みを付けて足し合わせる.
+            auto weight = 1.0f;
+            if ( bsdfPdf > 0.0f )
+            { weight = PowerHeuristic( bsdfPdf, m_pScene->GetIBLPdf( raySet.ray.dir ) ); }
+
+            L += Color4::Mul( W, m_pScene->SampleIBL( raySet.ray.dir ) ) * weight;
             break;
         }
 
@@ -246,17 +441,23 @@ Color4 PathTracer::Radiance( const Ray& input )
         // 自己発光による放射輝度.
         L += Color4::Mul( W, material->GetEmissive() );
 
-        // 直接光をサンプリング.
-        if ( !record.pMaterial->HasDelta() )
-        { L += Color4::Mul( W, NextEventEstimation( record.position, arg.random ) ); }
+        // 衝突点でのコーン幅をテクスチャ座標上の幅に換算する.
+        coneWidth += spreadAngle * record.distance;
+        auto cosine = Max( abs( Vector3::Dot( raySet.ray.dir, record.normal ) ), 0.01f );
 
         // シェーディング引数を設定.
-        arg.input    = raySet.ray.dir;
-        arg.normal   = record.normal;
-        arg.texcoord = record.texcoord;
+        arg.input     = raySet.ray.dir;
+        arg.normal    = record.normal;
+        arg.texcoord  = record.texcoord;
+        arg.footprint = coneWidth * record.uvDensity / cosine;
+
+        // 直接光をサンプリング.
+        if ( !material->HasDelta() )
+        { L += Color4::Mul( W, NextEventEstimation( record.position, material, arg ) ); }
 
         // 色を求める.
         W = Color4::Mul( W, material->Shade( arg ) );
+        bsdfPdf = ( material->HasDelta() ) ? 0.0f : arg.pdf;
 
         // ロシアンルーレットで打ち切るかどうか?
         if ( arg.dice )
@@ -273,7 +474,7 @@ Color4 PathTracer::Radiance( const Ray& input )
     }
 
     // 乱数を更新.
-    m_Random = arg.random;
+    random = arg.random;
 
     // 計算結果を返却.
     return L;
@@ -282,14 +483,11 @@ Color4 PathTracer::Radiance( const Ray& input )
 //-------------------------------------------------------------------------------------------------
 //      シャドウレイを生成します.
 //-------------------------------------------------------------------------------------------------
-RaySet PathTracer::MakeShadowRaySet( const Vector3& position, Random& random )
+RaySet PathTracer::MakeShadowRaySet( const Vector3& position, Random& random, f32& pdf )
 {
-    auto phi = F_2PI * random.GetAsF32();
-    auto r  = random.GetAsF32();
-    auto x = r * std::cos( phi );
-    auto y = r * std::sin( phi );
-    auto dir = Vector3( x, y, SafeSqrt( 1.0f - (x * x) - (y * y) ) );
-    dir = Vector3::SafeUnitVector( dir );
+    auto u = random.GetAsF32();
+    auto v = random.GetAsF32();
+    auto dir = m_pScene->SampleIBLDir( Vector2( u, v ), pdf );
 
     return MakeRaySet( position, dir );
 }
@@ -297,15 +495,45 @@ RaySet PathTracer::MakeShadowRaySet( const Vector3& position, Random& random )
 //-------------------------------------------------------------------------------------------------
 //      直接光ライティングを行います.
 //-------------------------------------------------------------------------------------------------
-Color4 PathTracer::NextEventEstimation( const Vector3& position, Random& random )
+Color4 PathTracer::NextEventEstimation( const Vector3& position, const IMaterial* pMaterial, ShadingArg& arg )
 {
-    auto shadowRay = MakeShadowRaySet( position, random );
+    RaySet shadowRay;
+    Color4 weight;
+    if ( !SampleLight( position, pMaterial, arg, shadowRay, weight ) )
+    { return Color4(0.0f, 0.0f, 0.0f, 0.0f); }
 
-    HitRecord shadowRecord;
-    if ( m_pScene->Intersect(shadowRay, shadowRecord) )
+    // 遮られているかどうかだけ分かればよいので, 最近接交差は求めない.
+    if ( m_pScene->IsOccluded( shadowRay, F_HIT_MAX ) )
     { return Color4(0.0f, 0.0f, 0.0f, 0.0f); }
 
-    return m_pScene->SampleIBL( shadowRay.ray.dir );
+    return Color4::Mul( weight, m_pScene->SampleIBL( shadowRay.ray.dir ) );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      直接光ライティング用のシャドウレイと重みを求めます.
+//-------------------------------------------------------------------------------------------------
+bool PathTracer::SampleLight
+(
+    const Vector3&      position,
+    const IMaterial*    pMaterial,
+    ShadingArg&         arg,
+    RaySet&             shadowRay,
+    Color4&             weight
+)
+{
+    auto lightPdf = 0.0f;
+    shadowRay = MakeShadowRaySet( position, arg.random, lightPdf );
+    if ( lightPdf <= 0.0f )
+    { return false; }
+
+    // 裏側など, BSDFが0になる方向ならシャドウレイは不要.
+    auto bsdfPdf = 0.0f;
+    auto bsdf    = pMaterial->Evaluate( arg, shadowRay.ray.dir, bsdfPdf );
+    if ( bsdf.GetX() <= 0.0f && bsdf.GetY() <= 0.0f && bsdf.GetZ() <= 0.0f )
+    { return false; }
+
+    weight = bsdf * ( PowerHeuristic( lightPdf, bsdfPdf ) / lightPdf );
+    return true;
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -315,47 +543,562 @@ void PathTracer::TracePath()
 {
     ILOG( "\nPathTrace Start.");
 
-    const auto sampleCount    = m_Config.SampleCount * m_Config.SubSampleCount  * m_Config.SubSampleCount;
-    const auto invSampleCount = 1.0f / static_cast<f32>( sampleCount );
+    const auto sampleCount     = m_Config.SampleCount * m_Config.SubSampleCount  * m_Config.SubSampleCount;
+    const auto tileSampleCount = Clamp( m_Config.TileSampleCount, 1, sampleCount );
+    const auto threadCount     = Max( m_Config.CpuCoreCount, 1 );
+
+    // 適応サンプリング時は, 収束したタイルで浮いた分をノイズの多いタイルに回せるよう上限を広げる.
+    const auto maxSampleCount  = ( m_Config.AdaptiveThreshold > 0.0f ) ? Max( m_Config.MaxSampleCount, sampleCount ) : sampleCount;
+    const auto passCount       = ( maxSampleCount + tileSampleCount - 1 ) / tileSampleCount;
+
+    // タイルスケジューラを初期化.
+    if ( !m_Scheduler.Init( m_Config.Width, m_Config.Height, m_Config.TileSize, passCount, threadCount ) )
+    {
+        ELOG( "Error : TileScheduler::Init() Failed." );
+        return;
+    }
+
+    // 締め切りに間に合わないパスは開始しない. 最終キャプチャーの時間を残しておく.
+    m_Scheduler.SetDeadline( m_Deadline - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<f64>( FinishMarginSec ) ) );
+
+    // チェックポイントから再開する場合は, 処理済みのパスを飛ばす.
+    if ( m_Resumed && !m_Scheduler.Restore( m_Checkpoint.GetPasses(), m_Checkpoint.GetTileCount() ) )
+    { ELOG( "Error : TileScheduler::Restore() Failed." ); }
+
+#if S3D_TRAVERSAL_STATS
+    g_RayCount   = 0;
+    g_VisitCount = 0;
+#endif
+
+    // ワーカースレッドを起動. 0番目は呼び出し元スレッドで処理する.
+    std::vector<std::thread> workers;
+    workers.reserve( threadCount - 1 );
+    for( auto i=1; i<threadCount; ++i )
+    { workers.push_back( std::thread( &PathTracer::TraceTile, this, i ) ); }
+
+    TraceTile( 0 );
+
+    for( auto& worker : workers )
+    { worker.join(); }
 
-    const auto rate     = 1.0f / static_cast<f32>( m_Config.SubSampleCount );
-    const auto halfRate = rate * 0.5f;
+    if ( m_Scheduler.IsExpired() )
+    { ILOG( "\nDeadline reached. Passes that could not finish in time were skipped." ); }
 
-    // 乱数初期化.
-    m_Random.SetSeed( 3141592 );
+    m_Scheduler.Term();
 
-    for ( auto sy=0; sy<m_Config.SubSampleCount && !m_WatcherEnd; ++sy )
-    for ( auto sx=0; sx<m_Config.SubSampleCount && !m_WatcherEnd; ++sx )
+#if S3D_TRAVERSAL_STATS
+    // 走査統計を出力.
+    if ( g_RayCount > 0 )
     {
-        const auto r1 = sx * rate + halfRate;
-        const auto r2 = sy * rate + halfRate;
+        ILOG( "\nRay Count   : %llu", static_cast<u64>( g_RayCount ) );
+        ILOG( "Node / Ray  : %.2f", static_cast<f64>( g_VisitCount ) / static_cast<f64>( g_RayCount ) );
+    }
+#endif
+
+    // 正常終了フラグを立てる.
+    g_Mutex.lock();
+    m_IsFinish = true;
+    g_Mutex.unlock();
+    g_FinishCond.notify_all();
+
+    ILOG( "\nPathTrace End.");
+}
+
+//-------------------------------------------------------------------------------------------------
+//      スケジューラから取得したタイルを処理します.
+//-------------------------------------------------------------------------------------------------
+void PathTracer::TraceTile( s32 threadId )
+{
+    const auto subSampleCount  = m_Config.SubSampleCount * m_Config.SubSampleCount;
+    const auto sampleCount     = m_Config.SampleCount * subSampleCount;
+    const auto tileSampleCount = Clamp( m_Config.TileSampleCount, 1, sampleCount );
+    const auto adaptive        = ( m_Config.AdaptiveThreshold > 0.0f );
+    const auto maxSampleCount  = ( adaptive ) ? Max( m_Config.MaxSampleCount, sampleCount ) : sampleCount;
+    const auto minSampleCount  = Min( AdaptiveMinSampleCount, sampleCount );
+
+    const auto spreadAngle = m_pScene->GetSpreadAngle( 1.0f / static_cast<f32>( m_Config.Height ) );
+
+    // ウェーブフロント方式の作業領域. タイルをまたいで使い回す.
+    Wavefront wavefront;
 
-        for( auto s=0; s<m_Config.SampleCount && !m_WatcherEnd; ++s )
+    u32 tileIndex = 0;
+    while( m_Scheduler.Pop( threadId, tileIndex ) )
+    {
+        // 時間切れの場合は全スレッドを止める.
+        if ( m_WatcherEnd )
         {
-            printf_s( "\r%5.2f%% Completed.", 100.f * ( sy * m_Config.SubSampleCount * m_Config.SampleCount + sx * m_Config.SampleCount + s ) / sampleCount );
+            m_Scheduler.Cancel();
+            break;
+        }
 
-        #if _OPENMP
-            #pragma omp parallel for schedule(dynamic, 1) num_threads(m_Config.CpuCoreCount)
-        #endif
-            for( auto y=0; y<m_Config.Height; ++y )
-            for( auto x=0; x<m_Config.Width ; ++x )
+        const auto& tile  = m_Scheduler.GetTile( tileIndex );
+        const auto  begin = tile.pass * tileSampleCount;
+        const auto  end   = Min( begin + tileSampleCount, maxSampleCount );
+
+        if ( m_Config.Wavefront )
+        { TraceWavefront( tile, begin, end, spreadAngle, wavefront ); }
+        else
+        {
+            for( auto y=tile.y; y<tile.y + tile.h; ++y )
+            for( auto x=tile.x; x<tile.x + tile.w; ++x )
             {
-                auto ray = m_pScene->GetRay(
-                    ( r1 + x ) / m_Config.Width  - 0.5f,
-                    ( r2 + y ) / m_Config.Height - 0.5f );
+                Color4 L( 0.0f, 0.0f, 0.0f, 0.0f );
+                f32    moment = 0.0f;
+
+            #if S3D_PACKET_TRAVERSAL
+                // 同じピクセルのサンプルはコヒーレントなので, カメラレイをパケットで走査する.
+                for( auto s=begin; s<end; s+=RAY_PACKET_SIZE )
+                {
+                    const auto count = static_cast<u32>( Min( end - s, static_cast<s32>( RAY_PACKET_SIZE ) ) );
+
+                    Random    random [RAY_PACKET_SIZE];
+                    Ray       rays   [RAY_PACKET_SIZE];
+                    RaySet    raySets[RAY_PACKET_SIZE];
+                    HitRecord records[RAY_PACKET_SIZE];
+
+                    for( auto i=0u; i<count; ++i )
+                    {
+                        rays[i]    = MakeCameraRay( x, y, s + i, random[i] );
+                        raySets[i] = MakeRaySet( rays[i].pos, rays[i].dir );
+                    }
+
+                    m_pScene->IntersectPacket( MakeRayPacket( raySets, count ), records );
+
+                    for( auto i=0u; i<count; ++i )
+                    {
+                        auto sample = Radiance( rays[i], spreadAngle, random[i], &records[i] );
+                        auto lum    = Luminance( sample );
+
+                        L      += sample;
+                        moment += lum * lum;
+                    }
+                }
+            #else
+                for( auto s=begin; s<end; ++s )
+                {
+                    Random random;
+                    auto ray    = MakeCameraRay( x, y, s, random );
+                    auto sample = Radiance( ray, spreadAngle, random );
+                    auto lum    = Luminance( sample );
+
+                    L      += sample;
+                    moment += lum * lum;
+                }
+            #endif
+
+                // 時間切れで経路が途中で打ち切られた可能性があるので加算しない.
+                if ( m_WatcherEnd )
+                { continue; }
 
                 const auto idx = y * m_Config.Width + x;
-                m_RenderTarget[ idx ] += Radiance( ray ) * invSampleCount;
+                m_RenderTarget[idx] += Color4( L.GetX(), L.GetY(), L.GetZ(), static_cast<f32>( end - begin ) );
+                m_Moment      [idx] += moment;
             }
         }
+
+        // 時間切れの場合はパスを完了扱いにせず全スレッドを止める.
+        if ( m_WatcherEnd )
+        {
+            m_Scheduler.Cancel();
+            break;
+        }
+
+        // 推定誤差が十分小さくなったタイルは残りのパスを打ち切る.
+        const auto converged = adaptive && end >= minSampleCount && IsConverged( tile );
+
+        // チェックポイントに反映. 収束したタイルは全パス処理済みとして扱う.
+        m_Checkpoint.Commit( tile, tileIndex, ( converged ) ? m_Scheduler.GetPassCount() : tile.pass + 1, m_RenderTarget, m_Moment );
+
+        m_Scheduler.Complete( threadId, tileIndex, converged );
+
+    #if S3D_TRAVERSAL_STATS
+        FlushTraversal();
+    #endif
+
+        if ( threadId == 0 )
+        { printf_s( "\r%5.2f%% Completed.", 100.0f * m_Scheduler.GetProgress() ); }
     }
+}
 
-    // 正常終了フラグを立てる.
-    g_Mutex.lock();
-    m_IsFinish = true;
-    g_Mutex.unlock();
+//-------------------------------------------------------------------------------------------------
+//      カメラレイを生成します.
+//-------------------------------------------------------------------------------------------------
+Ray PathTracer::MakeCameraRay( s32 x, s32 y, s32 sample, Random& random )
+{
+    const auto subSampleCount = m_Config.SubSampleCount * m_Config.SubSampleCount;
+    const auto rate           = 1.0f / static_cast<f32>( m_Config.SubSampleCount );
+    const auto halfRate       = rate * 0.5f;
+
+    // ピクセルとサンプル番号から乱数列を決定するため, スレッド数に依らず同じ結果になる.
+    const auto pixelKey = PcgHash( static_cast<u32>( y * m_Config.Width + x ) ^ RandomSeed );
+    random.SetSeed( pixelKey, static_cast<u32>( sample ) );
+
+    // サブサンプル位置はパスをまたいで巡回させる.
+    const auto sub = sample % subSampleCount;
+    const auto r1  = ( sub % m_Config.SubSampleCount ) * rate + halfRate;
+    const auto r2  = ( sub / m_Config.SubSampleCount ) * rate + halfRate;
+
+    return m_pScene->GetRay(
+        ( r1 + x ) / m_Config.Width  - 0.5f,
+        ( r2 + y ) / m_Config.Height - 0.5f,
+        random );
+}
 
-    ILOG( "\nPathTrace End.");
+//-------------------------------------------------------------------------------------------------
+//      タイル内の経路をウェーブフロント方式で追跡します.
+//-------------------------------------------------------------------------------------------------
+void PathTracer::TraceWavefront
+(
+    const Tile& tile,
+    s32         begin,
+    s32         end,
+    f32         spreadAngle,
+    Wavefront&  wavefront
+)
+{
+    const auto pixelSamples   = end - begin;
+    const auto pathCount      = static_cast<u32>( tile.w * tile.h * pixelSamples );
+
+    auto& paths = wavefront.paths;
+    paths.resize( pathCount );
+    wavefront.records.resize( pathCount );
+    wavefront.active.clear();
+
+    // カメラレイをまとめて生成. 1ピクセル分のサンプルが連続するように並べる.
+    auto index = 0u;
+    for( auto y=tile.y; y<tile.y + tile.h; ++y )
+    for( auto x=tile.x; x<tile.x + tile.w; ++x )
+    for( auto s=begin; s<end; ++s, ++index )
+    {
+        auto& path = paths[index];
+        auto  ray  = MakeCameraRay( x, y, s, path.random );
+
+        path.raySet    = MakeRaySet( ray.pos, ray.dir );
+        path.W         = Color4( 1.0f, 1.0f, 1.0f, 1.0f );
+        path.L         = Color4( 0.0f, 0.0f, 0.0f, 0.0f );
+        path.coneWidth = 0.0f;
+        path.bsdfPdf   = 0.0f;
+
+        wavefront.active.push_back( index );
+    }
+
+    for( auto depth=0; depth < m_Config.MaxBounceCount && !m_WatcherEnd && !wavefront.active.empty(); ++depth )
+    {
+        wavefront.missed .clear();
+        wavefront.next   .clear();
+        wavefront.shadows.clear();
+        for( auto& queue : wavefront.queues )
+        { queue.clear(); }
+
+        // 交差判定をまとめて行う.
+    #if S3D_PACKET_TRAVERSAL
+        if ( depth == 0 )
+        {
+            // カメラレイは同じピクセルのサンプルが連続して並んでいるので, パケットで走査する.
+            const auto activeCount = static_cast<u32>( wavefront.active.size() );
+            for( auto i=0u; i<activeCount; i+=RAY_PACKET_SIZE )
+            {
+                const auto count = Min( activeCount - i, RAY_PACKET_SIZE );
+
+                RaySet    raySets[RAY_PACKET_SIZE];
+                HitRecord records[RAY_PACKET_SIZE];
+                for( auto j=0u; j<count; ++j )
+                { raySets[j] = paths[ wavefront.active[i + j] ].raySet; }
+
+                m_pScene->IntersectPacket( MakeRayPacket( raySets, count ), records );
+
+                for( auto j=0u; j<count; ++j )
+                { wavefront.records[ wavefront.active[i + j] ] = records[j]; }
+            }
+        }
+        else
+    #endif
+        {
+            for( auto i : wavefront.active )
+            {
+                wavefront.records[i] = HitRecord();
+                m_pScene->Intersect( paths[i].raySet, wavefront.records[i] );
+            }
+        }
+
+        // 衝突したマテリアルの種類ごとに振り分ける.
+        for( auto i : wavefront.active )
+        {
+            const auto& record = wavefront.records[i];
+        #if S3D_TRAVERSAL_STATS
+            CountTraversal( record );
+        #endif
+
+            if ( record.pShape != nullptr )
+            {
+                assert( record.pShape    != nullptr );
+                assert( record.pMaterial != nullptr );
+                wavefront.queues[ record.pMaterial->GetType() ].push_back( i );
+            }
+            else
+            { wavefront.missed.push_back( i ); }
+        }
+
+        // 何にも当たらなかった経路はIBLをまとめてフェッチして終了.
+        if ( !wavefront.missed.empty() )
+        {
+            const auto count = static_cast<u32>( wavefront.missed.size() );
+            wavefront.dirs     .resize( count );
+            wavefront.radiances.resize( count );
+
+            for( auto i=0u; i<count; ++i )
+            { wavefront.dirs[i] = paths[ wavefront.missed[i] ].raySet.ray.dir; }
+
+            m_pScene->SampleIBLBatch( wavefront.dirs.data(), count, wavefront.radiances.data() );
+
+            for( auto i=0u; i<count; ++i )
+            {
+                auto& path = paths[ wavefront.missed[i] ];
+
+                // 直接光ライティングでも選ばれうる方向なので, 重みを付けて足し合わせる.
+                auto weight = 1.0f;
+                if ( path.bsdfPdf > 0.0f )
+                { weight = PowerHeuristic( path.bsdfPdf, m_pScene->GetIBLPdf( wavefront.dirs[i] ) ); }
+
+                path.L += Color4::Mul( path.W, wavefront.radiances[i] ) * weight;
+            }
+        }
+
+        // マテリアルの種類ごとにまとめてシェーディングし, シャドウレイと次のレイを発行する.
+        for( auto& queue : wavefront.queues )
+        {
+            for( auto i : queue )
+            {
+                auto&       path     = paths[i];
+                const auto& record   = wavefront.records[i];
+                const auto  material = record.pMaterial;
+
+                // 自己発光による放射輝度.
+                path.L += Color4::Mul( path.W, material->GetEmissive() );
+
+                // 衝突点でのコーン幅をテクスチャ座標上の幅に換算する.
+                path.coneWidth += spreadAngle * record.distance;
+                auto cosine = Max( abs( Vector3::Dot( path.raySet.ray.dir, record.normal ) ), 0.01f );
+
+                // シェーディング引数を設定.
+                auto arg = ShadingArg();
+                arg.input     = path.raySet.ray.dir;
+                arg.normal    = record.normal;
+                arg.texcoord  = record.texcoord;
+                arg.footprint = path.coneWidth * record.uvDensity / cosine;
+                arg.random    = path.random;
+
+                // 直接光のシャドウレイを発行.
+                if ( !material->HasDelta() )
+                {
+                    ShadowQuery query;
+                    if ( SampleLight( record.position, material, arg, query.raySet, query.weight ) )
+                    {
+                        query.weight = Color4::Mul( path.W, query.weight );
+                        query.path   = i;
+                        wavefront.shadows.push_back( query );
+                    }
+                }
+
+                // 色を求める.
+                path.W       = Color4::Mul( path.W, material->Shade( arg ) );
+                path.bsdfPdf = ( material->HasDelta() ) ? 0.0f : arg.pdf;
+                path.random  = arg.random;
+
+                // ロシアンルーレットで打ち切るかどうか?
+                if ( arg.dice )
+                { continue; }
+
+                // 重みがゼロになったら以降の更新は無駄なので打ち切りにする.
+                if ( (path.W.GetX() < FLT_EPSILON) &&
+                     (path.W.GetY() < FLT_EPSILON) &&
+                     (path.W.GetZ() < FLT_EPSILON) )
+                { continue; }
+
+                // レイを更新.
+                path.raySet = MakeRaySet( record.position, arg.output );
+                wavefront.next.push_back( i );
+            }
+        }
+
+        // シャドウレイをまとめて判定し, 遮られなかったものだけIBLをフェッチする.
+        if ( !wavefront.shadows.empty() )
+        {
+            auto count = 0u;
+            for( auto& query : wavefront.shadows )
+            {
+                if ( !m_pScene->IsOccluded( query.raySet, F_HIT_MAX ) )
+                { wavefront.shadows[count++] = query; }
+            }
+
+            wavefront.dirs     .resize( count );
+            wavefront.radiances.resize( count );
+
+            for( auto i=0u; i<count; ++i )
+            { wavefront.dirs[i] = wavefront.shadows[i].raySet.ray.dir; }
+
+            m_pScene->SampleIBLBatch( wavefront.dirs.data(), count, wavefront.radiances.data() );
+
+            for( auto i=0u; i<count; ++i )
+            {
+                const auto& query = wavefront.shadows[i];
+                paths[ query.path ].L += Color4::Mul( query.weight, wavefront.radiances[i] );
+            }
+        }
+
+        std::swap( wavefront.active, wavefront.next );
+    }
+
+    // 時間切れで経路が途中で打ち切られた可能性があるので加算しない.
+    if ( m_WatcherEnd )
+    { return; }
+
+    // ピクセルごとにサンプルを集計してレンダーターゲットに加算.
+    index = 0;
+    for( auto y=tile.y; y<tile.y + tile.h; ++y )
+    for( auto x=tile.x; x<tile.x + tile.w; ++x )
+    {
+        Color4 L( 0.0f, 0.0f, 0.0f, 0.0f );
+        f32    moment = 0.0f;
+        for( auto s=0; s<pixelSamples; ++s, ++index )
+        {
+            auto lum = Luminance( paths[index].L );
+
+            L      += paths[index].L;
+            moment += lum * lum;
+        }
+
+        const auto idx = y * m_Config.Width + x;
+        m_RenderTarget[idx] += Color4( L.GetX(), L.GetY(), L.GetZ(), static_cast<f32>( pixelSamples ) );
+        m_Moment      [idx] += moment;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+//      チェックポイントを準備します.
+//-------------------------------------------------------------------------------------------------
+void PathTracer::PrepareCheckpoint( Scene* pScene )
+{
+    m_Resumed         = false;
+    m_CheckpointReady = false;
+
+    if ( m_Config.CheckpointIntervalSec <= 0.0f && !m_Config.Resume )
+    { return; }
+
+    const auto sampleCount     = m_Config.SampleCount * m_Config.SubSampleCount * m_Config.SubSampleCount;
+    const auto tileSampleCount = Clamp( m_Config.TileSampleCount, 1, sampleCount );
+    const auto hash            = ComputeCheckpointHash( pScene );
+
+    if ( !m_Checkpoint.Init( m_Config.Width, m_Config.Height, m_Config.TileSize, tileSampleCount, m_Config.SubSampleCount, hash ) )
+    {
+        ELOG( "Error : Checkpoint::Init() Failed." );
+        return;
+    }
+
+    if ( m_Config.Resume )
+    {
+        m_Resumed = m_Checkpoint.Load( CheckpointFile, m_RenderTarget, m_Moment );
+        if ( m_Resumed )
+        { ILOG( "Resumed from checkpoint. filename = %s", CheckpointFile ); }
+    }
+
+    m_CheckpointReady = ( m_Config.CheckpointIntervalSec > 0.0f );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      チェックポイント照合用のハッシュ値を求めます.
+//-------------------------------------------------------------------------------------------------
+u64 PathTracer::ComputeCheckpointHash( Scene* pScene ) const
+{
+    auto hash = FnvOffsetBasis;
+
+    // 累積結果に影響する積分器の設定. サンプル数はタイルのパス数を決めるので含める.
+    hash = HashValue( hash, RandomSeed );
+    hash = HashValue( hash, m_Config.SampleCount );
+    hash = HashValue( hash, m_Config.MaxSampleCount );
+    hash = HashValue( hash, m_Config.MaxBounceCount );
+    hash = HashValue( hash, m_Config.AdaptiveThreshold );
+    hash = HashValue( hash, AdaptiveMinSampleCount );
+    hash = HashValue( hash, AdaptiveEpsilon );
+
+    // シーンの内容は直接比較できないので, 固定のプローブレイに対するカメラ, 形状, マテリアル, IBLの応答を調べる.
+    const auto invProbeCount = 1.0f / static_cast<f32>( CheckpointProbeCount );
+    for( auto j=0; j<CheckpointProbeCount; ++j )
+    for( auto i=0; i<CheckpointProbeCount; ++i )
+    {
+        Random random;
+        random.SetSeed( RandomSeed, static_cast<u32>( j * CheckpointProbeCount + i ) );
+
+        const auto u = ( i + 0.5f ) * invProbeCount;
+        const auto v = ( j + 0.5f ) * invProbeCount;
+
+        auto ray = pScene->GetRay( u - 0.5f, v - 0.5f, random );
+        hash = HashValue( hash, ray.pos );
+        hash = HashValue( hash, ray.dir );
+
+        // IBLの輝度分布.
+        auto pdf = 0.0f;
+        auto dir = pScene->SampleIBLDir( Vector2( u, v ), pdf );
+        hash = HashValue( hash, dir );
+        hash = HashValue( hash, pdf );
+        hash = HashValue( hash, pScene->SampleIBL( dir ) );
+
+        auto record = HitRecord();
+        if ( !pScene->Intersect( MakeRaySet( ray.pos, ray.dir ), record ) )
+        {
+            hash = HashValue( hash, pScene->SampleIBL( ray.dir ) );
+            continue;
+        }
+
+        hash = HashValue( hash, record.distance );
+        hash = HashValue( hash, record.normal );
+        hash = HashValue( hash, record.texcoord.x );
+        hash = HashValue( hash, record.texcoord.y );
+
+        // 固定の乱数で1回シェーディングして, マテリアルのパラメータの違いを拾う.
+        const auto material = record.pMaterial;
+        auto arg = ShadingArg();
+        arg.input     = ray.dir;
+        arg.normal    = record.normal;
+        arg.texcoord  = record.texcoord;
+        arg.footprint = 0.0f;
+        arg.random    = random;
+
+        hash = HashValue( hash, material->GetType() );
+        hash = HashValue( hash, material->GetEmissive() );
+        hash = HashValue( hash, material->Shade( arg ) );
+        hash = HashValue( hash, arg.output );
+        hash = HashValue( hash, arg.pdf );
+    }
+
+    return hash;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      タイルが収束したかどうかを判定します.
+//-------------------------------------------------------------------------------------------------
+bool PathTracer::IsConverged( const Tile& tile ) const
+{
+    for( auto y=tile.y; y<tile.y + tile.h; ++y )
+    for( auto x=tile.x; x<tile.x + tile.w; ++x )
+    {
+        const auto  idx   = y * m_Config.Width + x;
+        const auto& pixel = m_RenderTarget[idx];
+        const auto  count = pixel.GetW();
+        if ( count < 2.0f )
+        { return false; }
+
+        // 不偏分散から平均値の標準誤差を求め, 平均輝度に対する比で評価する.
+        const auto mean     = Luminance( pixel ) / count;
+        const auto variance = Max( m_Moment[idx] / count - mean * mean, 0.0f ) * count / ( count - 1.0f );
+        const auto error    = sqrtf( variance / count ) / ( mean + AdaptiveEpsilon );
+
+        if ( error > m_Config.AdaptiveThreshold )
+        { return false; }
+    }
+
+    return true;
 }
 
 } // namespace s3d
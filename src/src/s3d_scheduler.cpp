@@ -0,0 +1,368 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_scheduler.cpp
+// Desc : Tile Scheduler Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_scheduler.h>
+#include <s3d_math.h>
+#include <s3d_logger.h>
+#include <new>
+
+
+namespace /* anonymous */ {
+
+//-------------------------------------------------------------------------------------------------
+// Constant Values.
+//-------------------------------------------------------------------------------------------------
+const f64 CostMargin = 1.25;    // 処理時間の推定のばらつきを見込んだ係数.
+
+} // namespace /* anonymous */
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// TileScheduler class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------------------
+//      コンストラクタです.
+//-------------------------------------------------------------------------------------------------
+TileScheduler::TileScheduler()
+: m_Tiles       ()
+, m_pQueues     ( nullptr )
+, m_QueueCount  ( 0 )
+, m_PassCount   ( 0 )
+, m_TaskCount   ( 0 )
+, m_RemainCount ( 0 )
+, m_Cancel      ( false )
+, m_Expired     ( false )
+, m_CostSum     ( 0 )
+, m_CostCount   ( 0 )
+, m_Deadline    ( std::chrono::steady_clock::time_point::max() )
+, m_WaitMutex   ()
+, m_WaitCond    ()
+, m_Signal      ( 0 )
+{ /* DO_NOTHING */ }
+
+//-------------------------------------------------------------------------------------------------
+//      デストラクタです.
+//-------------------------------------------------------------------------------------------------
+TileScheduler::~TileScheduler()
+{ Term(); }
+
+//-------------------------------------------------------------------------------------------------
+//      初期化処理を行います.
+//-------------------------------------------------------------------------------------------------
+bool TileScheduler::Init( s32 width, s32 height, s32 tileSize, s32 passCount, s32 threadCount )
+{
+    Term();
+
+    if ( width <= 0 || height <= 0 || tileSize <= 0 || passCount <= 0 || threadCount <= 0 )
+    {
+        ELOG( "Error : Invalid Argument." );
+        return false;
+    }
+
+    m_pQueues = new(std::nothrow) WorkQueue [threadCount];
+    if ( m_pQueues == nullptr )
+    {
+        ELOG( "Error : Out of Memory." );
+        return false;
+    }
+
+    m_QueueCount = threadCount;
+    m_PassCount  = passCount;
+
+    // タイルに分割.
+    for( auto y=0; y<height; y+=tileSize )
+    for( auto x=0; x<width;  x+=tileSize )
+    {
+        Tile tile;
+        tile.x    = x;
+        tile.y    = y;
+        tile.w    = ( x + tileSize <= width  ) ? tileSize : width  - x;
+        tile.h    = ( y + tileSize <= height ) ? tileSize : height - y;
+        tile.pass = 0;
+        tile.cost = 0.0;
+        m_Tiles.push_back( tile );
+    }
+
+    // 連続したタイルを同じスレッドに割り当てて, キャッシュの局所性を保つ.
+    const auto tileCount = static_cast<u32>( m_Tiles.size() );
+    for( u32 i=0; i<tileCount; ++i )
+    {
+        auto queueIdx = static_cast<s32>( ( static_cast<u64>( i ) * threadCount ) / tileCount );
+        m_pQueues[queueIdx].items.push_back( i );
+    }
+
+    m_TaskCount   = static_cast<u64>( tileCount ) * passCount;
+    m_RemainCount = m_TaskCount;
+    m_Cancel      = false;
+    m_Expired     = false;
+    m_CostSum     = 0;
+    m_CostCount   = 0;
+    m_Deadline    = std::chrono::steady_clock::time_point::max();
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      終了処理を行います.
+//-------------------------------------------------------------------------------------------------
+void TileScheduler::Term()
+{
+    SafeDeleteArray( m_pQueues );
+    m_Tiles.clear();
+
+    m_QueueCount  = 0;
+    m_PassCount   = 0;
+    m_TaskCount   = 0;
+    m_RemainCount = 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      タイルごとの処理済みパス数を復元します.
+//-------------------------------------------------------------------------------------------------
+bool TileScheduler::Restore( const s32* pPasses, u32 tileCount )
+{
+    if ( pPasses == nullptr || tileCount != m_Tiles.size() )
+    {
+        ELOG( "Error : Invalid Argument." );
+        return false;
+    }
+
+    for( auto i=0; i<m_QueueCount; ++i )
+    { m_pQueues[i].items.clear(); }
+
+    // 処理済みのパスを差し引き, 残りがあるタイルだけを割り当て直す.
+    for( u32 i=0; i<tileCount; ++i )
+    {
+        auto& tile = m_Tiles[i];
+        tile.pass = Clamp( pPasses[i], 0, m_PassCount );
+        m_RemainCount -= static_cast<u64>( tile.pass );
+
+        if ( tile.pass < m_PassCount )
+        {
+            auto queueIdx = static_cast<s32>( ( static_cast<u64>( i ) * m_QueueCount ) / tileCount );
+            m_pQueues[queueIdx].items.push_back( i );
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      タイルを取得します.
+//-------------------------------------------------------------------------------------------------
+bool TileScheduler::Pop( s32 threadId, u32& tileIndex )
+{
+    while( !m_Cancel && m_RemainCount > 0 )
+    {
+        // 探索中に通知が来たことを検出できるよう, 先に値を控えておく.
+        u64 signal = 0;
+        {
+            std::lock_guard<std::mutex> locker( m_WaitMutex );
+            signal = m_Signal;
+        }
+
+        auto found = false;
+
+        // 自分のキューの先頭から取り出す.
+        {
+            auto& queue = m_pQueues[threadId];
+            std::lock_guard<std::mutex> locker( queue.mutex );
+            if ( !queue.items.empty() )
+            {
+                tileIndex = queue.items.front();
+                queue.items.pop_front();
+                found = true;
+            }
+        }
+
+        // 空なら他のスレッドから盗む.
+        if ( !found )
+        { found = Steal( threadId, tileIndex ); }
+
+        // 他スレッドが処理中のタイルが再投入されるか, 全て完了するまで待つ.
+        if ( !found )
+        {
+            std::unique_lock<std::mutex> locker( m_WaitMutex );
+            m_WaitCond.wait( locker, [&]()
+            { return m_Signal != signal || m_Cancel || m_RemainCount == 0; });
+            continue;
+        }
+
+        // 締め切りまでに終わらないパスは開始せずに打ち切る. 軽いタイルは引き続き処理する.
+        auto& tile = m_Tiles[tileIndex];
+        if ( !CanFinish( tile ) )
+        {
+            Retire( tile );
+            m_Expired = true;
+
+            // 最後のパスを打ち切った場合は待機中のスレッドを終了させる.
+            if ( m_RemainCount == 0 )
+            { Notify(); }
+            continue;
+        }
+
+        m_pQueues[threadId].start = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      他スレッドのキューからタイルを盗みます.
+//-------------------------------------------------------------------------------------------------
+bool TileScheduler::Steal( s32 threadId, u32& tileIndex )
+{
+    for( auto i=1; i<m_QueueCount; ++i )
+    {
+        auto& queue = m_pQueues[ (threadId + i) % m_QueueCount ];
+        std::lock_guard<std::mutex> locker( queue.mutex );
+        if ( !queue.items.empty() )
+        {
+            // 所有スレッドとの競合を避けるため末尾から取り出す.
+            tileIndex = queue.items.back();
+            queue.items.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      タイルの1パス分の処理完了を通知します.
+//-------------------------------------------------------------------------------------------------
+void TileScheduler::Complete( s32 threadId, u32 tileIndex, bool converged )
+{
+    auto& tile = m_Tiles[tileIndex];
+    tile.pass++;
+
+    // 処理時間を記録して, 次のパスの見積もりに使う.
+    tile.cost = std::chrono::duration<f64>( std::chrono::steady_clock::now() - m_pQueues[threadId].start ).count();
+    m_CostSum += static_cast<u64>( tile.cost * 1e6 );
+    m_CostCount++;
+
+    // 収束した場合は残りのパスもまとめて完了扱いにする.
+    if ( converged )
+    { Retire( tile ); }
+
+    // 残りのパスがあれば自分のキューの末尾に戻す.
+    if ( tile.pass < m_PassCount )
+    {
+        auto& queue = m_pQueues[threadId];
+        std::lock_guard<std::mutex> locker( queue.mutex );
+        queue.items.push_back( tileIndex );
+    }
+
+    m_RemainCount--;
+
+    // 再投入したタイルか完了を待っているスレッドを起こす.
+    Notify();
+}
+
+//-------------------------------------------------------------------------------------------------
+//      処理を中断します.
+//-------------------------------------------------------------------------------------------------
+void TileScheduler::Cancel()
+{
+    m_Cancel = true;
+    Notify();
+}
+
+//-------------------------------------------------------------------------------------------------
+//      締め切り時刻を設定します.
+//-------------------------------------------------------------------------------------------------
+void TileScheduler::SetDeadline( const std::chrono::steady_clock::time_point& deadline )
+{ m_Deadline = deadline; }
+
+//-------------------------------------------------------------------------------------------------
+//      締め切りによって打ち切ったパスがあるかどうかを取得します.
+//-------------------------------------------------------------------------------------------------
+bool TileScheduler::IsExpired() const
+{ return m_Expired; }
+
+//-------------------------------------------------------------------------------------------------
+//      タイルの次のパスが締め切りまでに終わるかどうかを推定します.
+//-------------------------------------------------------------------------------------------------
+bool TileScheduler::CanFinish( const Tile& tile ) const
+{
+    if ( m_Deadline == std::chrono::steady_clock::time_point::max() )
+    { return true; }
+
+    // 未計測のタイルは計測済みのパスの平均で見積もる.
+    auto cost = tile.cost;
+    if ( cost <= 0.0 )
+    {
+        const u64 count = m_CostCount;
+        cost = ( count > 0 ) ? static_cast<f64>( m_CostSum ) / static_cast<f64>( count ) * 1e-6 : 0.0;
+    }
+
+    const auto estimate = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<f64>( cost * CostMargin ) );
+
+    return std::chrono::steady_clock::now() + estimate <= m_Deadline;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      タイルの残りのパスをまとめて完了扱いにします.
+//-------------------------------------------------------------------------------------------------
+void TileScheduler::Retire( Tile& tile )
+{
+    if ( tile.pass >= m_PassCount )
+    { return; }
+
+    m_RemainCount -= static_cast<u64>( m_PassCount - tile.pass );
+    tile.pass = m_PassCount;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      待機中のスレッドに状態の変化を通知します.
+//-------------------------------------------------------------------------------------------------
+void TileScheduler::Notify()
+{
+    {
+        std::lock_guard<std::mutex> locker( m_WaitMutex );
+        m_Signal++;
+    }
+    m_WaitCond.notify_all();
+}
+
+//-------------------------------------------------------------------------------------------------
+//      タイルを取得します.
+//-------------------------------------------------------------------------------------------------
+Tile& TileScheduler::GetTile( u32 tileIndex )
+{ return m_Tiles[tileIndex]; }
+
+//-------------------------------------------------------------------------------------------------
+//      タイル数を取得します.
+//-------------------------------------------------------------------------------------------------
+u32 TileScheduler::GetTileCount() const
+{ return static_cast<u32>( m_Tiles.size() ); }
+
+//-------------------------------------------------------------------------------------------------
+//      パス数を取得します.
+//-------------------------------------------------------------------------------------------------
+s32 TileScheduler::GetPassCount() const
+{ return m_PassCount; }
+
+//-------------------------------------------------------------------------------------------------
+//      進捗率を取得します.
+//-------------------------------------------------------------------------------------------------
+f32 TileScheduler::GetProgress() const
+{
+    if ( m_TaskCount == 0 )
+    { return 1.0f; }
+
+    return static_cast<f32>( m_TaskCount - m_RemainCount ) / static_cast<f32>( m_TaskCount );
+}
+
+} // namespace s3d
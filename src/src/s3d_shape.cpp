@@ -0,0 +1,37 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_shape.cpp
+// Desc : Shape Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_shape.h>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// IShape interface
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------------------
+//      レイパケットの交差判定を行います.
+//-------------------------------------------------------------------------------------------------
+u32 IShape::IsHitPacket( const RayPacket& packet, u32 active, HitRecord* pRecords ) const
+{
+    u32 result = 0;
+    for( auto i=0u; i<packet.count; ++i )
+    {
+        auto bit = 0x1u << i;
+        if ( ( active & bit ) == 0 )
+        { continue; }
+
+        if ( IsHit( packet.rays[i], pRecords[i] ) )
+        { result |= bit; }
+    }
+    return result;
+}
+
+} // namespace s3d
@@ -0,0 +1,451 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_smd.cpp
+// Desc : SMD Mesh File Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <cstdio>
+#include <cstring>
+#include <s3d_smd.h>
+#include <s3d_shape.h>
+#include <s3d_logger.h>
+
+
+namespace /* anonymous */ {
+
+//-------------------------------------------------------------------------------------------------
+// Constant Values.
+//-------------------------------------------------------------------------------------------------
+static const u8  SMD_FILE_TAG[4] = { 'S', 'M', 'D', '\0' };
+
+// マップした配列をそのまま参照するため, ファイル上のレイアウトと一致している必要がある.
+static_assert( sizeof(s3d::Vector3) == sizeof(s3d::SMD_VECTOR3), "Vector3 layout mismatch." );
+static_assert( sizeof(s3d::Vector2) == sizeof(s3d::SMD_VECTOR2), "Vector2 layout mismatch." );
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// MemoryReader structure
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct MemoryReader
+{
+    const u8*   pCur;       //!< 現在の読み込み位置です.
+    const u8*   pEnd;       //!< 終端です.
+
+    //---------------------------------------------------------------------------------------------
+    //! @brief      指定サイズを読み込みます. 範囲外の場合は false を返却します.
+    //---------------------------------------------------------------------------------------------
+    bool Read( void* pDst, size_t size )
+    {
+        if ( static_cast<size_t>( pEnd - pCur ) < size )
+        { return false; }
+
+        memcpy( pDst, pCur, size );
+        pCur += size;
+        return true;
+    }
+};
+
+//-------------------------------------------------------------------------------------------------
+//      配列がファイル範囲内かつアライメントを満たしているかチェックします.
+//-------------------------------------------------------------------------------------------------
+bool IsValidArray( u64 offset, u64 count, u64 stride, u64 fileSize )
+{
+    if ( offset % s3d::SMD_ARRAY_ALIGN != 0 )
+    { return false; }
+
+    if ( offset > fileSize )
+    { return false; }
+
+    // 乗算で桁あふれしないよう除算で比較します.
+    return ( count <= ( fileSize - offset ) / stride );
+}
+
+} // namespace /* anonymous */
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// SmdFile class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------------------
+//      コンストラクタです.
+//-------------------------------------------------------------------------------------------------
+SmdFile::SmdFile()
+: m_VertexCount     ( 0 )
+, m_TriangleCount   ( 0 )
+, m_MaterialCount   ( 0 )
+, m_TextureCount    ( 0 )
+, m_pPositions      ( nullptr )
+, m_pNormals        ( nullptr )
+, m_pTexCoords      ( nullptr )
+, m_pIndices        ( nullptr )
+, m_pMaterialIds    ( nullptr )
+, m_pMaterials      ( nullptr )
+, m_pTextures       ( nullptr )
+{ /* DO_NOTHING */ }
+
+//-------------------------------------------------------------------------------------------------
+//      デストラクタです.
+//-------------------------------------------------------------------------------------------------
+SmdFile::~SmdFile()
+{ Term(); }
+
+//-------------------------------------------------------------------------------------------------
+//      ファイルから読み込みます.
+//-------------------------------------------------------------------------------------------------
+bool SmdFile::Load( const char* filename )
+{
+    Term();
+
+    // ファイル全体をマップします.
+    if ( !m_File.Open( filename ) )
+    { return false; }
+
+    auto pData = m_File.GetData();
+    auto size  = m_File.GetSize();
+
+    // ファイルマジックとバージョンを取得します.
+    u8  magic[4];
+    u32 version;
+    if ( size < sizeof(magic) + sizeof(version) )
+    {
+        ELOG( "Error : Invalid File Size. filename = %s", filename );
+        Term();
+        return false;
+    }
+
+    memcpy( magic,    pData,                 sizeof(magic) );
+    memcpy( &version, pData + sizeof(magic), sizeof(version) );
+
+    if ( memcmp( magic, SMD_FILE_TAG, sizeof(u8) * 4 ) != 0 )
+    {
+        ELOG( "Error : Invalid File Magic. filename = %s", filename );
+        Term();
+        return false;
+    }
+
+    bool result = false;
+    if ( version == SMD_VERSION_3 )
+    {
+        result = ParseV3( pData, size );
+    }
+    else if ( version == SMD_VERSION_2 )
+    {
+        // 旧形式は展開して保持するため, マップは不要になります.
+        result = ParseV2( pData, size );
+        m_File.Close();
+    }
+    else
+    {
+        ELOG( "Error : Unsupported File Version. filename = %s, version = %u", filename, version );
+    }
+
+    if ( !result )
+    {
+        ELOG( "Error : Invalid File Data. filename = %s", filename );
+        Term();
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      バージョン2のデータを展開します.
+//-------------------------------------------------------------------------------------------------
+bool SmdFile::ParseV2( const u8* pData, u64 size )
+{
+    MemoryReader reader = { pData, pData + size };
+
+    // ファイルヘッダーを読み込みます.
+    SMD_FILE_HEADER fileHeader;
+    if ( !reader.Read( &fileHeader, sizeof(fileHeader) ) )
+    { return false; }
+
+    // データヘッダーのサイズをチェックをします.
+    if ( fileHeader.DataHeaderSize != sizeof( SMD_DATA_HEADER ) )
+    { return false; }
+
+    const auto& header = fileHeader.DataHeader;
+    if ( header.NumTriangles == 0 || header.NumMaterials == 0 )
+    { return false; }
+
+    // テクスチャデータを読み込みます.
+    m_Textures.resize( header.NumTextures );
+    if ( !m_Textures.empty() )
+    {
+        if ( !reader.Read( m_Textures.data(), sizeof(SMD_TEXTURE) * m_Textures.size() ) )
+        { return false; }
+    }
+
+    // マテリアルデータを読み込みます.
+    m_Materials.resize( header.NumMaterials );
+    for ( size_t i = 0; i < m_Materials.size(); ++i )
+    {
+        auto& material = m_Materials[i];
+        memset( &material, 0, sizeof(material) );
+
+        if ( !reader.Read( &material.Type, sizeof(s32) ) )
+        { return false; }
+
+        size_t paramSize = 0;
+        switch( material.Type )
+        {
+        case SMD_MATERIAL_TYPE_MATTE:       paramSize = sizeof(SMD_MATTE);      break;
+        case SMD_MATERIAL_TYPE_MIRROR:      paramSize = sizeof(SMD_MIRROR);     break;
+        case SMD_MATERIAL_TYPE_DIELECTRIC:  paramSize = sizeof(SMD_DIELECTRIC); break;
+        case SMD_MATERIAL_TYPE_GLOSSY:      paramSize = sizeof(SMD_GLOSSY);     break;
+        case SMD_MATERIAL_TYPE_PLASTIC:     paramSize = sizeof(SMD_PLASTIC);    break;
+        default:
+            return false;
+        }
+
+        // 各パラメータ構造体は共用体の先頭に配置されます.
+        if ( !reader.Read( &material.Matte, paramSize ) )
+        { return false; }
+    }
+
+    // 三角形データを展開します.
+    const auto triangleCount = header.NumTriangles;
+    if ( static_cast<u64>( reader.pEnd - reader.pCur ) < u64( triangleCount ) * sizeof(SMD_TRIANGLE) )
+    { return false; }
+
+    m_Positions  .resize( triangleCount * 3 );
+    m_Normals    .resize( triangleCount * 3 );
+    m_TexCoords  .resize( triangleCount * 3 );
+    m_Indices    .resize( triangleCount * 3 );
+    m_MaterialIds.resize( triangleCount );
+
+    for ( u32 i = 0; i < triangleCount; ++i )
+    {
+        SMD_TRIANGLE triangle;
+        reader.Read( &triangle, sizeof(triangle) );
+
+        for( auto idx = 0; idx < 3; ++idx )
+        {
+            auto v = i * 3 + idx;
+            memcpy( &m_Positions[v], &triangle.Vertex[idx].Position, sizeof(SMD_VECTOR3) );
+            memcpy( &m_Normals  [v], &triangle.Vertex[idx].Normal,   sizeof(SMD_VECTOR3) );
+            memcpy( &m_TexCoords[v], &triangle.Vertex[idx].TexCoord, sizeof(SMD_VECTOR2) );
+            m_Indices[v] = v;
+        }
+
+        m_MaterialIds[i] = triangle.MaterialId;
+    }
+
+    BindOwnedArrays();
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      バージョン3のデータを検証して配列を参照します.
+//-------------------------------------------------------------------------------------------------
+bool SmdFile::ParseV3( const u8* pData, u64 size )
+{
+    SMD_FILE_HEADER_V3 fileHeader;
+    if ( size < sizeof(fileHeader) )
+    { return false; }
+
+    memcpy( &fileHeader, pData, sizeof(fileHeader) );
+
+    // データヘッダーのサイズをチェックをします.
+    if ( fileHeader.DataHeaderSize != sizeof( SMD_DATA_HEADER_V3 ) )
+    { return false; }
+
+    const auto& header = fileHeader.DataHeader;
+    if ( header.NumVertices == 0 || header.NumTriangles == 0 || header.NumMaterials == 0 )
+    { return false; }
+
+    // インデックス数は32bitで計算すると桁あふれするため64bitで求めます.
+    const auto indexCount = u64( header.NumTriangles ) * 3;
+    if ( indexCount * sizeof(u32) > size )
+    { return false; }
+
+    // 全ての配列がファイル範囲内にあることを確認します.
+    if ( !IsValidArray( header.PositionOffset,   header.NumVertices,      sizeof(Vector3),      size )
+      || !IsValidArray( header.NormalOffset,     header.NumVertices,      sizeof(Vector3),      size )
+      || !IsValidArray( header.TexCoordOffset,   header.NumVertices,      sizeof(Vector2),      size )
+      || !IsValidArray( header.IndexOffset,      indexCount,              sizeof(u32),          size )
+      || !IsValidArray( header.MaterialIdOffset, header.NumTriangles,     sizeof(s32),          size )
+      || !IsValidArray( header.MaterialOffset,   header.NumMaterials,     sizeof(SMD_MATERIAL), size )
+      || !IsValidArray( header.TextureOffset,    header.NumTextures,      sizeof(SMD_TEXTURE),  size ) )
+    { return false; }
+
+    auto pIndices     = reinterpret_cast<const u32*>( pData + header.IndexOffset );
+    auto pMaterialIds = reinterpret_cast<const s32*>( pData + header.MaterialIdOffset );
+
+    // 不正なインデックスで範囲外アクセスしないようにチェックします.
+    for( u64 i = 0; i < indexCount; ++i )
+    {
+        if ( pIndices[i] >= header.NumVertices )
+        { return false; }
+    }
+
+    for( u32 i = 0; i < header.NumTriangles; ++i )
+    {
+        if ( pMaterialIds[i] >= s32( header.NumMaterials ) )
+        { return false; }
+    }
+
+    // コピーせずにマップした領域を直接参照します.
+    m_VertexCount   = header.NumVertices;
+    m_TriangleCount = header.NumTriangles;
+    m_MaterialCount = header.NumMaterials;
+    m_TextureCount  = header.NumTextures;
+    m_pPositions    = reinterpret_cast<const Vector3*>     ( pData + header.PositionOffset );
+    m_pNormals      = reinterpret_cast<const Vector3*>     ( pData + header.NormalOffset );
+    m_pTexCoords    = reinterpret_cast<const Vector2*>     ( pData + header.TexCoordOffset );
+    m_pIndices      = pIndices;
+    m_pMaterialIds  = pMaterialIds;
+    m_pMaterials    = reinterpret_cast<const SMD_MATERIAL*>( pData + header.MaterialOffset );
+    m_pTextures     = reinterpret_cast<const SMD_TEXTURE*> ( pData + header.TextureOffset );
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      頂点配列から初期化します.
+//-------------------------------------------------------------------------------------------------
+bool SmdFile::Init( u32 vertexCount, const Vertex* pVertices )
+{
+    Term();
+
+    if ( vertexCount == 0 || vertexCount % 3 != 0 || pVertices == nullptr )
+    { return false; }
+
+    m_Positions  .resize( vertexCount );
+    m_Normals    .resize( vertexCount );
+    m_TexCoords  .resize( vertexCount );
+    m_Indices    .resize( vertexCount );
+    m_MaterialIds.resize( vertexCount / 3, 0 );
+
+    for( u32 i = 0; i < vertexCount; ++i )
+    {
+        m_Positions[i] = pVertices[i].Position;
+        m_Normals  [i] = pVertices[i].Normal;
+        m_TexCoords[i] = pVertices[i].TexCoord;
+        m_Indices  [i] = i;
+    }
+
+    BindOwnedArrays();
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      展開済みの配列を参照するようにポインタを設定します.
+//-------------------------------------------------------------------------------------------------
+void SmdFile::BindOwnedArrays()
+{
+    m_VertexCount   = static_cast<u32>( m_Positions.size() );
+    m_TriangleCount = static_cast<u32>( m_MaterialIds.size() );
+    m_MaterialCount = static_cast<u32>( m_Materials.size() );
+    m_TextureCount  = static_cast<u32>( m_Textures.size() );
+    m_pPositions    = m_Positions  .data();
+    m_pNormals      = m_Normals    .data();
+    m_pTexCoords    = m_TexCoords  .data();
+    m_pIndices      = m_Indices    .data();
+    m_pMaterialIds  = m_MaterialIds.data();
+    m_pMaterials    = m_Materials  .data();
+    m_pTextures     = m_Textures   .data();
+}
+
+//-------------------------------------------------------------------------------------------------
+//      終了処理を行います.
+//-------------------------------------------------------------------------------------------------
+void SmdFile::Term()
+{
+    m_File.Close();
+
+    m_Positions  .clear();
+    m_Normals    .clear();
+    m_TexCoords  .clear();
+    m_Indices    .clear();
+    m_MaterialIds.clear();
+    m_Materials  .clear();
+    m_Textures   .clear();
+
+    m_VertexCount   = 0;
+    m_TriangleCount = 0;
+    m_MaterialCount = 0;
+    m_TextureCount  = 0;
+    m_pPositions    = nullptr;
+    m_pNormals      = nullptr;
+    m_pTexCoords    = nullptr;
+    m_pIndices      = nullptr;
+    m_pMaterialIds  = nullptr;
+    m_pMaterials    = nullptr;
+    m_pTextures     = nullptr;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      頂点数を取得します.
+//-------------------------------------------------------------------------------------------------
+u32 SmdFile::GetVertexCount() const
+{ return m_VertexCount; }
+
+//-------------------------------------------------------------------------------------------------
+//      三角形数を取得します.
+//-------------------------------------------------------------------------------------------------
+u32 SmdFile::GetTriangleCount() const
+{ return m_TriangleCount; }
+
+//-------------------------------------------------------------------------------------------------
+//      マテリアル数を取得します.
+//-------------------------------------------------------------------------------------------------
+u32 SmdFile::GetMaterialCount() const
+{ return m_MaterialCount; }
+
+//-------------------------------------------------------------------------------------------------
+//      テクスチャ数を取得します.
+//-------------------------------------------------------------------------------------------------
+u32 SmdFile::GetTextureCount() const
+{ return m_TextureCount; }
+
+//-------------------------------------------------------------------------------------------------
+//      位置座標配列を取得します.
+//-------------------------------------------------------------------------------------------------
+const Vector3* SmdFile::GetPositions() const
+{ return m_pPositions; }
+
+//-------------------------------------------------------------------------------------------------
+//      法線ベクトル配列を取得します.
+//-------------------------------------------------------------------------------------------------
+const Vector3* SmdFile::GetNormals() const
+{ return m_pNormals; }
+
+//-------------------------------------------------------------------------------------------------
+//      テクスチャ座標配列を取得します.
+//-------------------------------------------------------------------------------------------------
+const Vector2* SmdFile::GetTexCoords() const
+{ return m_pTexCoords; }
+
+//-------------------------------------------------------------------------------------------------
+//      頂点インデックス配列を取得します.
+//-------------------------------------------------------------------------------------------------
+const u32* SmdFile::GetIndices() const
+{ return m_pIndices; }
+
+//-------------------------------------------------------------------------------------------------
+//      面ごとのマテリアル番号配列を取得します.
+//-------------------------------------------------------------------------------------------------
+const s32* SmdFile::GetMaterialIds() const
+{ return m_pMaterialIds; }
+
+//-------------------------------------------------------------------------------------------------
+//      マテリアル配列を取得します.
+//-------------------------------------------------------------------------------------------------
+const SMD_MATERIAL* SmdFile::GetMaterials() const
+{ return m_pMaterials; }
+
+//-------------------------------------------------------------------------------------------------
+//      テクスチャ配列を取得します.
+//-------------------------------------------------------------------------------------------------
+const SMD_TEXTURE* SmdFile::GetTextures() const
+{ return m_pTextures; }
+
+} // namespace s3d
@@ -95,6 +95,9 @@ bool Sphere::IsHit(const RaySet &raySet, HitRecord& record ) const
 
     record.texcoord = Vector2( phi * F_1DIV2PI, ( F_PI - theta ) * F_1DIVPI );
 
+    // 球面全体(4πr^2)がテクスチャ全体(1.0)に対応する.
+    record.uvDensity = 0.5f / ( m_Radius * sqrtf( F_PI ) );
+
     // フラットシェーディング.
     record.normal   = Vector3::UnitVector(record.position - m_Center);
 
@@ -102,6 +105,29 @@ bool Sphere::IsHit(const RaySet &raySet, HitRecord& record ) const
     return true;
 }
 
+//-------------------------------------------------------------------------------------------------
+//      遮蔽判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool Sphere::IsOccluded(const RaySet& raySet, f32 distance) const
+{
+    const auto po = m_Center - raySet.ray.pos;
+    const auto b  = Vector3::Dot(po, raySet.ray.dir);
+    const auto D4 = b * b - Vector3::Dot(po, po) + m_Radius * m_Radius;
+
+    if ( D4 < 0.0f )
+    { return false; }
+
+    const auto sqrt_D4 = sqrt(D4);
+    const auto t1 = b - sqrt_D4;
+    const auto t2 = b + sqrt_D4;
+
+    if (t1 < F_HIT_MIN && t2 < F_HIT_MIN)
+    { return false; }
+
+    auto dist = ( t1 > F_HIT_MIN ) ? t1 : t2;
+    return ( dist < distance );
+}
+
 //-------------------------------------------------------------------------------------------------
 //      バウンディングボックスを取得します.
 //-------------------------------------------------------------------------------------------------
@@ -15,6 +15,43 @@
 #include <cassert>
 #include <cstdio>
 #include <cstring>
+#include <cmath>
+
+
+namespace /* anonymous */ {
+
+////////////////////////////////////////////////////////////////////////////////////////
+// DecodeTable structure
+////////////////////////////////////////////////////////////////////////////////////////
+struct DecodeTable
+{
+    f32 SRGB[256];      //!< sRGB → リニア変換テーブルです.
+
+    //----------------------------------------------------------------------------------
+    //! @brief      コンストラクタです.
+    //----------------------------------------------------------------------------------
+    DecodeTable()
+    {
+        for( auto i=0; i<256; ++i )
+        {
+            auto c = static_cast<f32>( i ) / 255.0f;
+            SRGB[i] = ( c <= 0.04045f ) ? c / 12.92f : powf( ( c + 0.055f ) / 1.055f, 2.4f );
+        }
+    }
+};
+
+const DecodeTable g_DecodeTable;
+
+//--------------------------------------------------------------------------------------
+//      リニアな値をsRGBの8bit値に変換します.
+//--------------------------------------------------------------------------------------
+inline u8 EncodeSRGB( f32 value )
+{
+    auto c = ( value <= 0.0031308f ) ? value * 12.92f : 1.055f * powf( value, 1.0f / 2.4f ) - 0.055f;
+    return static_cast<u8>( s3d::Clamp( c * 255.0f + 0.5f, 0.0f, 255.0f ) );
+}
+
+} // namespace /* anonymous */
 
 
 namespace s3d {
@@ -27,20 +64,28 @@ namespace s3d {
 //      コンストラクタです.
 //--------------------------------------------------------------------------------------
 Texture2D::Texture2D()
-: m_Width       ( 0 )
-, m_Height      ( 0 )
-, m_Size        ( 0 )
-, m_pPixels     ( nullptr )
+: m_Width           ( 0 )
+, m_Height          ( 0 )
+, m_Size            ( 0 )
+, m_ComponentCount  ( 0 )
+, m_Format          ( TEXTURE_FORMAT_RGBA8 )
+, m_IsSRGB          ( false )
+, m_pPixels         ( nullptr )
+, m_MipCount        ( 0 )
 { /* DO_NOTHING */ }
 
 //--------------------------------------------------------------------------------------
 //      引数付きコンストラクタです.
 //--------------------------------------------------------------------------------------
 Texture2D::Texture2D( const char* filename )
-: m_Width       ( 0 )
-, m_Height      ( 0 )
-, m_Size        ( 0 )
-, m_pPixels     ( nullptr )
+: m_Width           ( 0 )
+, m_Height          ( 0 )
+, m_Size            ( 0 )
+, m_ComponentCount  ( 0 )
+, m_Format          ( TEXTURE_FORMAT_RGBA8 )
+, m_IsSRGB          ( false )
+, m_pPixels         ( nullptr )
+, m_MipCount        ( 0 )
 {
     if ( ( filename != nullptr )
       && ( filename[0] != 0 )
@@ -60,16 +105,24 @@ Texture2D::Texture2D( const char* filename )
 //      コピーコンストラクタです.
 //--------------------------------------------------------------------------------------
 Texture2D::Texture2D( const Texture2D& value )
-: m_Width       ( value.m_Width )
-, m_Height      ( value.m_Height )
-, m_Size        ( value.m_Size )
-, m_pPixels     ( nullptr )
+: m_Width           ( value.m_Width )
+, m_Height          ( value.m_Height )
+, m_Size            ( value.m_Size )
+, m_ComponentCount  ( value.m_ComponentCount )
+, m_Format          ( value.m_Format )
+, m_IsSRGB          ( value.m_IsSRGB )
+, m_pPixels         ( nullptr )
+, m_MipCount        ( value.m_MipCount )
 {
-    m_pPixels = new f32 [ m_Size ];
+    memcpy( m_Mips, value.m_Mips, sizeof(m_Mips) );
+
+    if ( value.m_pPixels == nullptr )
+    { return; }
+
+    m_pPixels = new u8 [ m_Size ];
     assert( m_pPixels != nullptr );
 
-    for( u32 i=0; i<m_Size; ++i )
-    { m_pPixels[i] = value.m_pPixels[i]; }
+    memcpy( m_pPixels, value.m_pPixels, m_Size );
 }
 
 //--------------------------------------------------------------------------------------
@@ -83,7 +136,7 @@ Texture2D::~Texture2D()
 //--------------------------------------------------------------------------------------
 //      ファイルからロードします.
 //--------------------------------------------------------------------------------------
-bool Texture2D::LoadFromFile( const char* filename )
+bool Texture2D::LoadFromFile( const char* filename, bool isSRGB )
 {
     // NULLチェック.
     if ( filename == nullptr )
@@ -92,6 +145,8 @@ bool Texture2D::LoadFromFile( const char* filename )
     int w = 0;
     int h = 0;
 
+    Release();
+
     FILE* pFile;
     errno_t err = fopen_s( &pFile, filename, "rb" );
     if ( err != 0 )
@@ -104,12 +159,10 @@ bool Texture2D::LoadFromFile( const char* filename )
         fclose( pFile );
 
         // BMP読み込み.
-        if ( LoadFromBMP( filename, w, h, &m_pPixels ) )
+        u8* pPixels = nullptr;
+        if ( LoadFromBMP( filename, w, h, &pPixels ) )
         {
-            m_Width  = static_cast<u32>( w ); 
-            m_Height = static_cast<u32>( h );
-            m_Size   = m_Width * m_Height * 4;
-            m_ComponentCount = 3;
+            SetPixels( static_cast<u32>( w ), static_cast<u32>( h ), 3, pPixels, isSRGB );
 
             // 正常終了.
             return true;
@@ -127,12 +180,10 @@ bool Texture2D::LoadFromFile( const char* filename )
              strcmp( fileTag, "TRUEVISION-TARGA.") == 0 )
         {
             s32 c = 0;
-            if ( LoadFromTGA( filename, w, h, c, &m_pPixels ) )
+            u8* pPixels = nullptr;
+            if ( LoadFromTGA( filename, w, h, c, &pPixels ) )
             {
-                m_Width  = static_cast<u32>( w );
-                m_Height = static_cast<u32>( h );
-                m_Size   = m_Width * m_Height * 4;
-                m_ComponentCount = c;
+                SetPixels( static_cast<u32>( w ), static_cast<u32>( h ), static_cast<u32>( c ), pPixels, isSRGB );
                 return true;
             }
         }
@@ -151,18 +202,138 @@ void Texture2D::Release()
     SafeDeleteArray( m_pPixels );
 
     // ゼロリセット.
-    m_Width  = 0;
-    m_Height = 0;
-    m_Size   = 0;
+    m_Width          = 0;
+    m_Height         = 0;
+    m_Size           = 0;
+    m_ComponentCount = 0;
+    m_MipCount       = 0;
+}
+
+//---------------------------------------------------------------------------------------
+//      ピクセルデータを設定し, フォーマットを決定してミップマップを生成します.
+//---------------------------------------------------------------------------------------
+void Texture2D::SetPixels( u32 width, u32 height, u32 componentCount, u8* pPixels, bool isSRGB )
+{
+    static const TEXTURE_FORMAT formats[] = {
+        TEXTURE_FORMAT_R8,
+        TEXTURE_FORMAT_RG8,
+        TEXTURE_FORMAT_RGB8,
+        TEXTURE_FORMAT_RGBA8
+    };
+    assert( 1 <= componentCount && componentCount <= 4 );
+
+    m_Width          = width;
+    m_Height         = height;
+    m_ComponentCount = componentCount;
+    m_Format         = formats[ componentCount - 1 ];
+    m_IsSRGB         = isSRGB;
+
+    // 1x1 になるまでのミップレベルのサイズとオフセットを求める.
+    auto w    = width;
+    auto h    = height;
+    auto size = 0u;
+    m_MipCount = 0;
+    while( m_MipCount < TEXTURE_MAX_MIP_COUNT )
+    {
+        m_Mips[ m_MipCount ].width  = w;
+        m_Mips[ m_MipCount ].height = h;
+        m_Mips[ m_MipCount ].offset = size;
+        m_MipCount++;
+
+        size += GetTexelCount( w, h ) * componentCount;
+
+        if ( w == 1 && h == 1 )
+        { break; }
+
+        w = Max( w / 2, 1u );
+        h = Max( h / 2, 1u );
+    }
+    m_Size = size;
+
+    // レベル0は読み込んだデータを並べ替えて使い, 残りを順に縮小して生成する.
+    m_pPixels = new u8 [ m_Size ];
+    assert( m_pPixels != nullptr );
+    memset( m_pPixels, 0, m_Size );
+
+    for( auto y=0u; y<height; ++y )
+    for( auto x=0u; x<width;  ++x )
+    {
+        memcpy(
+            m_pPixels + GetTexelIndex( x, y, width ) * componentCount,
+            pPixels   + ( y * width + x ) * componentCount,
+            componentCount );
+    }
+    SafeDeleteArray( pPixels );
+
+    for( auto i=1u; i<m_MipCount; ++i )
+    { Downsample( i ); }
+}
+
+//---------------------------------------------------------------------------------------
+//      1つ上のミップレベルを2x2のボックスフィルタで縮小して生成します.
+//---------------------------------------------------------------------------------------
+void Texture2D::Downsample( u32 level )
+{
+    assert( 0 < level && level < m_MipCount );
+
+    const auto& src = m_Mips[ level - 1 ];
+    const auto& dst = m_Mips[ level ];
+    const auto  cc  = m_ComponentCount;
+
+    // sRGBの場合はアルファ以外をリニアに戻してから平均する.
+    const auto alphaIndex = ( m_Format == TEXTURE_FORMAT_RG8 )    ? 1u
+                          : ( m_Format == TEXTURE_FORMAT_RGBA8 )  ? 3u : cc;
+
+    const u8* pSrc = m_pPixels + src.offset;
+          u8* pDst = m_pPixels + dst.offset;
+
+    for( auto y=0u; y<dst.height; ++y )
+    {
+        // 奇数サイズの端は同じテクセルを重ねて使う.
+        const auto y0 = Min( y * 2,     src.height - 1 );
+        const auto y1 = Min( y * 2 + 1, src.height - 1 );
+
+        for( auto x=0u; x<dst.width; ++x )
+        {
+            const auto x0 = Min( x * 2,     src.width - 1 );
+            const auto x1 = Min( x * 2 + 1, src.width - 1 );
+
+            const u8* p00 = pSrc + GetTexelIndex( x0, y0, src.width ) * cc;
+            const u8* p01 = pSrc + GetTexelIndex( x0, y1, src.width ) * cc;
+            const u8* p10 = pSrc + GetTexelIndex( x1, y0, src.width ) * cc;
+            const u8* p11 = pSrc + GetTexelIndex( x1, y1, src.width ) * cc;
+            u8*       pOut = pDst + GetTexelIndex( x,  y,  dst.width ) * cc;
+
+            for( auto c=0u; c<cc; ++c )
+            {
+                if ( m_IsSRGB && c != alphaIndex )
+                {
+                    auto sum = g_DecodeTable.SRGB[ p00[c] ]
+                             + g_DecodeTable.SRGB[ p01[c] ]
+                             + g_DecodeTable.SRGB[ p10[c] ]
+                             + g_DecodeTable.SRGB[ p11[c] ];
+                    pOut[c] = EncodeSRGB( sum * 0.25f );
+                }
+                else
+                {
+                    auto sum = static_cast<u32>( p00[c] ) + p01[c] + p10[c] + p11[c];
+                    pOut[c] = static_cast<u8>( ( sum + 2 ) / 4 );
+                }
+            }
+        }
+    }
 }
 
 //---------------------------------------------------------------------------------------
 //      指定されたピクセルを取得します.
 //---------------------------------------------------------------------------------------
-Color4 Texture2D::GetPixel(s32 x, s32 y, const TextureSampler& sampler ) const
+Color4 Texture2D::GetPixel(s32 x, s32 y, u32 level, const TextureSampler& sampler ) const
 { 
-    auto w = static_cast<s32>(m_Width);
-    auto h = static_cast<s32>(m_Height);
+    assert( level < m_MipCount );
+    const auto& mip = m_Mips[ level ];
+
+    auto w = static_cast<s32>(mip.width);
+    auto h = static_cast<s32>(mip.height);
 
     switch( sampler.address )
     {
@@ -189,36 +360,57 @@ Color4 Texture2D::GetPixel(s32 x, s32 y, const TextureSampler& sampler ) const
         break;
     }
 
-    auto idx = ( m_Width * 4 * y ) + ( x * 4 );
+    auto idx = mip.offset + GetTexelIndex( x, y, mip.width ) * m_ComponentCount;
     assert( idx < m_Size );
 
-    return Color4(
-        m_pPixels[idx + 0],
-        m_pPixels[idx + 1],
-        m_pPixels[idx + 2],
-        m_pPixels[idx + 3] );
+    // 読み込み元の形式から RGBA の4バイトにまとめる.
+    const u8* p = m_pPixels + idx;
+    u32 r, g, b, a;
+    switch( m_Format )
+    {
+    case TEXTURE_FORMAT_R8:     { r = g = b = p[0]; a = 255;  } break;
+    case TEXTURE_FORMAT_RG8:    { r = g = b = p[0]; a = p[1]; } break;
+    case TEXTURE_FORMAT_RGB8:   { r = p[0]; g = p[1]; b = p[2]; a = 255;  } break;
+    case TEXTURE_FORMAT_RGBA8:
+    default:                    { r = p[0]; g = p[1]; b = p[2]; a = p[3]; } break;
+    }
+
+    if ( m_IsSRGB )
+    {
+        return Color4(
+            g_DecodeTable.SRGB[r],
+            g_DecodeTable.SRGB[g],
+            g_DecodeTable.SRGB[b],
+            static_cast<f32>( a ) / 255.0f );
+    }
+
+    // 4バイトを32bit整数に広げて一括で浮動小数に変換.
+    auto zero   = _mm_setzero_si128();
+    auto packed = _mm_cvtsi32_si128( static_cast<s32>( r | ( g << 8 ) | ( b << 16 ) | ( a << 24 ) ) );
+    auto i32    = _mm_unpacklo_epi16( _mm_unpacklo_epi8( packed, zero ), zero );
+    return Color4( _mm_mul_ps( _mm_cvtepi32_ps( i32 ), _mm_set1_ps( 1.0f / 255.0f ) ) );
 }
 
 
 //---------------------------------------------------------------------------------------
 //      最近傍補間を適用してサンプリングします.
 //---------------------------------------------------------------------------------------
-Color4 Texture2D::NearestSample(const TextureSampler& sampler, const Vector2& texcoord) const
+Color4 Texture2D::NearestSample(const TextureSampler& sampler, const Vector2& texcoord, u32 level) const
 {
-    auto x = static_cast<s32>( texcoord.x * m_Width  + 0.5f );
-    auto y = static_cast<s32>( texcoord.y * m_Height + 0.5f );
+    auto x = static_cast<s32>( texcoord.x * m_Mips[level].width  + 0.5f );
+    auto y = static_cast<s32>( texcoord.y * m_Mips[level].height + 0.5f );
 
-    return GetPixel(x, y, sampler);
+    return GetPixel(x, y, level, sampler);
 }
 
 //---------------------------------------------------------------------------------------
 //      バイリニア補間を適用してサンプリングします.
 //---------------------------------------------------------------------------------------
-Color4 Texture2D::BilinearSample(const TextureSampler& sampler, const Vector2& texcoord) const
+Color4 Texture2D::BilinearSample(const TextureSampler& sampler, const Vector2& texcoord, u32 level) const
 {
     // 浮動小数点形式で画像サイズにスケーリング.
-    auto fx = texcoord.x * m_Width;
-    auto fy = texcoord.y * m_Height;
+    auto fx = texcoord.x * m_Mips[level].width;
+    auto fy = texcoord.y * m_Mips[level].height;
 
     // 小数点以下を切り捨て.
     auto x0 = static_cast<s32>( floor( fx ) );
@@ -227,23 +419,58 @@ Color4 Texture2D::BilinearSample(const TextureSampler& sampler, const Vector2& t
     auto x1 = x0 + 1;
     auto y1 = y0 + 1;
 
-    return ( x1 - fx ) * ( ( y1 - fy ) * GetPixel( x0, y0, sampler ) + ( fy - y0 ) * GetPixel( x0, y1, sampler ) )
-         + ( fx - x0 ) * ( ( y1 - fy ) * GetPixel( x1, y0, sampler ) + ( fy - y0 ) * GetPixel( x1, y1, sampler ) );    
+    // 4テクセルの重みを求めて, 4成分まとめて補間.
+    auto tx = fx - x0;
+    auto ty = fy - y0;
+    auto w00 = _mm_set1_ps( ( 1.0f - tx ) * ( 1.0f - ty ) );
+    auto w01 = _mm_set1_ps( ( 1.0f - tx ) * ty );
+    auto w10 = _mm_set1_ps( tx * ( 1.0f - ty ) );
+    auto w11 = _mm_set1_ps( tx * ty );
+
+    auto c0 = _mm_add_ps( _mm_mul_ps( w00, GetPixel( x0, y0, level, sampler ).v ), _mm_mul_ps( w01, GetPixel( x0, y1, level, sampler ).v ) );
+    auto c1 = _mm_add_ps( _mm_mul_ps( w10, GetPixel( x1, y0, level, sampler ).v ), _mm_mul_ps( w11, GetPixel( x1, y1, level, sampler ).v ) );
+    return Color4( _mm_add_ps( c0, c1 ) );
+}
+
+//---------------------------------------------------------------------------------------
+//      トライリニア補間を適用してサンプリングします.
+//---------------------------------------------------------------------------------------
+Color4 Texture2D::TrilinearSample(const TextureSampler& sampler, const Vector2& texcoord, f32 footprint) const
+{
+    // フットプリントをテクセル単位に直してミップレベルを求める.
+    auto texels = footprint * sqrtf( static_cast<f32>( m_Width ) * static_cast<f32>( m_Height ) );
+    if ( texels <= 1.0f )
+    { return BilinearSample( sampler, texcoord, 0 ); }
+
+    auto lod = log2f( texels );
+    auto maxLevel = static_cast<f32>( m_MipCount - 1 );
+    if ( lod >= maxLevel )
+    { return BilinearSample( sampler, texcoord, m_MipCount - 1 ); }
+
+    // 隣接する2レベルを補間.
+    auto level = static_cast<u32>( lod );
+    auto t     = _mm_set1_ps( lod - static_cast<f32>( level ) );
+    auto c0    = BilinearSample( sampler, texcoord, level     ).v;
+    auto c1    = BilinearSample( sampler, texcoord, level + 1 ).v;
+    return Color4( _mm_add_ps( c0, _mm_mul_ps( t, _mm_sub_ps( c1, c0 ) ) ) );
 }
 
 //--------------------------------------------------------------------------------------
 //      テクスチャフェッチします.
 //--------------------------------------------------------------------------------------
-Color4 Texture2D::Sample( const TextureSampler& sampler, const Vector2& location ) const
+Color4 Texture2D::Sample( const TextureSampler& sampler, const Vector2& texcoord, f32 footprint ) const
 {
     // テクスチャが無ければ(1.0, 1.0, 1.0)を返しておく.
     if ( m_pPixels == nullptr )
     { return Color4( 1.0f, 1.0f, 1.0f, 1.0f ); }
 
+    if ( sampler.filter == TEXTURE_FILTER_TRILINEAR )
+    { return TrilinearSample( sampler, texcoord, footprint ); }
+
     if ( sampler.filter == TEXTURE_FILTER_BILINEAR )
-    { return BilinearSample( sampler, location ); }
+    { return BilinearSample( sampler, texcoord, 0 ); }
 
-    return NearestSample( sampler, location );
+    return NearestSample( sampler, texcoord, 0 );
 }
 
 //---------------------------------------------------------------------------------------
@@ -251,19 +478,32 @@ Color4 Texture2D::Sample( const TextureSampler& sampler, const Vector2& location
 //---------------------------------------------------------------------------------------
 bool Texture2D::AlphaTest( const TextureSampler& sampler, const Vector2& texcoord, const f32 value ) const
 {
-    if ( m_ComponentCount != 4 )
+    if ( m_Format != TEXTURE_FORMAT_RGBA8 && m_Format != TEXTURE_FORMAT_RG8 )
     { return true; }
 
     if ( m_pPixels == nullptr )
     { return true; }
 
+    // 抜き判定はミップレベル0で行う.
     Color4 result;
-    if ( sampler.filter == TEXTURE_FILTER_BILINEAR )
-    { result = BilinearSample( sampler, texcoord ); }
+    if ( sampler.filter != TEXTURE_FILTER_NEAREST )
+    { result = BilinearSample( sampler, texcoord, 0 ); }
     else
-    { result = NearestSample( sampler, texcoord ); }
+    { result = NearestSample( sampler, texcoord, 0 ); }
 
     return ( result.GetW() >= value );
 }
 
+//---------------------------------------------------------------------------------------
+//      ピクセルフォーマットを取得します.
+//---------------------------------------------------------------------------------------
+TEXTURE_FORMAT Texture2D::GetFormat() const
+{ return m_Format; }
+
+//---------------------------------------------------------------------------------------
+//      ミップレベル数を取得します.
+//---------------------------------------------------------------------------------------
+u32 Texture2D::GetMipCount() const
+{ return m_MipCount; }
+
 } // namespace s3d
@@ -66,7 +66,17 @@ Color4 TexturedMaterial::Shade( ShadingArg& arg ) const
 {
     return Color4::Mul(
         m_pMaterial->Shade( arg ),
-        m_pTexture->Sample( *m_pSampler, arg.texcoord ) );
+        m_pTexture->Sample( *m_pSampler, arg.texcoord, arg.footprint ) );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      指定方向へのBSDFに余弦項を乗じた値と確率密度を求めます.
+//-------------------------------------------------------------------------------------------------
+Color4 TexturedMaterial::Evaluate( const ShadingArg& arg, const Vector3& dir, f32& pdf ) const
+{
+    return Color4::Mul(
+        m_pMaterial->Evaluate( arg, dir, pdf ),
+        m_pTexture->Sample( *m_pSampler, arg.texcoord, arg.footprint ) );
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -81,6 +91,12 @@ Color4 TexturedMaterial::GetEmissive() const
 bool TexturedMaterial::HasDelta() const
 { return m_pMaterial->HasDelta(); }
 
+//-------------------------------------------------------------------------------------------------
+//      マテリアルの種類を取得します.
+//-------------------------------------------------------------------------------------------------
+MATERIAL_TYPE TexturedMaterial::GetType() const
+{ return MATERIAL_TYPE_TEXTURED; }
+
 //-------------------------------------------------------------------------------------------------
 //      生成処理です.
 //-------------------------------------------------------------------------------------------------
@@ -138,10 +138,9 @@ void Parse24Bits( FILE* pFile, u32 size, u8* pPixels )
 {
     for( u32 i=0; i<size; ++i )
     {
-        pPixels[ i * 4 + 2 ] = (u8)fgetc( pFile );
-        pPixels[ i * 4 + 1 ] = (u8)fgetc( pFile );
-        pPixels[ i * 4 + 0 ] = (u8)fgetc( pFile );
-        pPixels[ i * 4 + 3 ] = 255;
+        pPixels[ i * 3 + 2 ] = (u8)fgetc( pFile );
+        pPixels[ i * 3 + 1 ] = (u8)fgetc( pFile );
+        pPixels[ i * 3 + 0 ] = (u8)fgetc( pFile );
     }
 }
 
@@ -424,7 +423,7 @@ bool LoadFromTGA
     s32&        width,
     s32&        height,
     s32&        component,
-    f32**       ppPixel
+    u8**        ppPixel
 )
 {
     if ( filename == nullptr || ppPixel == nullptr )
@@ -666,60 +665,73 @@ bool LoadFromTGA
     // t@C.
     fclose( pFile );
 
-    // Float ɕϊ.
-    auto pixelCount = width * height * component;
-    (*ppPixel) = new f32 [ width * height *4 ];
+    (*ppPixel) = pPixels;
+
+    // I.
+    return true;
+}
 
-    switch( component )
+//-------------------------------------------------------------------------------------------------
+//      TGAt@Cǂݍ, RGBA  f32 `ɕϊ܂.
+//-------------------------------------------------------------------------------------------------
+bool LoadFromTGA
+(
+    const char* filename,
+    s32&        width,
+    s32&        height,
+    s32&        component,
+    f32**       ppPixel
+)
+{
+    if ( ppPixel == nullptr )
+    { return false; }
+
+    u8* pPixels = nullptr;
+    if ( !LoadFromTGA( filename, width, height, component, &pPixels ) )
+    { return false; }
+
+    auto pixelCount = width * height;
+    (*ppPixel) = new f32 [ pixelCount * 4 ];
+
+    for( auto i=0; i<pixelCount; ++i )
     {
+        const u8* pSrc = pPixels + i * component;
+        f32*      pDst = (*ppPixel) + i * 4;
+
+        switch( component )
+        {
         case 1:
             {
-                for( auto i=0, j=0; i<pixelCount; i++, j+=4 )
-                {
-                    (*ppPixel)[j + 0] = static_cast<f32>( pPixels[i] ) / 255.0f;
-                    (*ppPixel)[j + 1] = static_cast<f32>( pPixels[i] ) / 255.0f;
-                    (*ppPixel)[j + 2] = static_cast<f32>( pPixels[i] ) / 255.0f;
-                    (*ppPixel)[j + 3] = 1.0f;
-                }
+                pDst[0] = pDst[1] = pDst[2] = static_cast<f32>( pSrc[0] ) / 255.0f;
+                pDst[3] = 1.0f;
             }
             break;
 
         case 2:
             {
-                for( auto i=0, j=0; i<pixelCount-2; i+=2, j+=4 )
-                {
-                    (*ppPixel)[j + 0] = static_cast<f32>( pPixels[i + 0] ) / 255.0f;
-                    (*ppPixel)[j + 1] = static_cast<f32>( pPixels[i + 0] ) / 255.0f;
-                    (*ppPixel)[j + 2] = static_cast<f32>( pPixels[i + 0] ) / 255.0f;
-                    (*ppPixel)[j + 3] = static_cast<f32>( pPixels[i + 1] ) / 255.0f;;
-                }
-
+                pDst[0] = pDst[1] = pDst[2] = static_cast<f32>( pSrc[0] ) / 255.0f;
+                pDst[3] = static_cast<f32>( pSrc[1] ) / 255.0f;
             }
             break;
 
         case 3:
             {
-                for( auto i=0, j=0; i<pixelCount-3; i+3, j+=4 )
-                {
-                    (*ppPixel)[j + 0] = static_cast<f32>( pPixels[i + 0] ) / 255.0f;
-                    (*ppPixel)[j + 1] = static_cast<f32>( pPixels[i + 1] ) / 255.0f;
-                    (*ppPixel)[j + 2] = static_cast<f32>( pPixels[i + 2] ) / 255.0f;
-                    (*ppPixel)[j + 3] = 1.0f;
-                }
+                pDst[0] = static_cast<f32>( pSrc[0] ) / 255.0f;
+                pDst[1] = static_cast<f32>( pSrc[1] ) / 255.0f;
+                pDst[2] = static_cast<f32>( pSrc[2] ) / 255.0f;
+                pDst[3] = 1.0f;
             }
             break;
 
-        case 4:
+        default:
             {
-                for( auto i=0, j=0; i<pixelCount-4; i+=4, j+=4 )
-                {
-                    (*ppPixel)[j + 0] = static_cast<f32>( pPixels[i + 0] ) / 255.0f;
-                    (*ppPixel)[j + 1] = static_cast<f32>( pPixels[i + 1] ) / 255.0f;
-                    (*ppPixel)[j + 2] = static_cast<f32>( pPixels[i + 2] ) / 255.0f;
-                    (*ppPixel)[j + 3] = static_cast<f32>( pPixels[i + 3] ) / 255.0f;
-                }
+                pDst[0] = static_cast<f32>( pSrc[0] ) / 255.0f;
+                pDst[1] = static_cast<f32>( pSrc[1] ) / 255.0f;
+                pDst[2] = static_cast<f32>( pSrc[2] ) / 255.0f;
+                pDst[3] = static_cast<f32>( pSrc[3] ) / 255.0f;
             }
             break;
+        }
     }
 
     // svȃ.
@@ -10,6 +10,8 @@
 #include <s3d_tonemapper.h>
 #include <s3d_math.h>
 #include <s3d_logger.h>
+#include <thread>
+#include <vector>
 
 
 namespace /* anonymous */ {
@@ -23,6 +25,8 @@ const s3d::Vector4 RGB2Cr (  0.50000f, -0.41869f, -0.08131f, 0.0f );
 const s3d::Vector4 YCbCr2R(  1.00000f,  0.00000f,  1.40200f, 0.0f );
 const s3d::Vector4 YCbCr2G(  1.00000f, -0.34414f, -0.71414f, 0.0f );
 const s3d::Vector4 YCbCr2B(  1.00000f,  1.77200f,  0.00000f, 0.0f );
+const s32         MinChunkPixelCount = 16384;       //!< 1スレッドあたりの最小ピクセル数です.
+const f32         MinGammaInput      = 1e-10f;      //!< ガンマ補正の入力の最小値です.
 
 
 //------------------------------------------------------------------------------------------------
@@ -32,6 +36,97 @@ S3D_INLINE
 f32 RGBToY( const s3d::Vector4& value )
 { return s3d::Vector4::Dot( RGB2Y, value ); }
 
+//------------------------------------------------------------------------------------------------
+//      並列処理に使用するスレッド数を取得します.
+//------------------------------------------------------------------------------------------------
+s32 GetChunkCount( const s32 width, const s32 height )
+{
+    static const s32 maxCount = s3d::Max( static_cast<s32>( std::thread::hardware_concurrency() ), 1 );
+
+    auto count = s3d::Min( maxCount, s3d::Max( ( width * height ) / MinChunkPixelCount, 1 ) );
+    return s3d::Clamp( count, 1, s3d::Max( height, 1 ) );
+}
+
+//------------------------------------------------------------------------------------------------
+//      画像を行単位で分割して並列に処理します.
+//------------------------------------------------------------------------------------------------
+template<typename Func>
+void ParallelRows( const s32 height, const s32 chunkCount, Func func )
+{
+    std::vector<std::thread> threads;
+    threads.reserve( chunkCount - 1 );
+
+    const auto rowCount = ( height + chunkCount - 1 ) / chunkCount;
+    for( auto i=1; i<chunkCount; ++i )
+    {
+        auto begin = s3d::Min( rowCount * i, height );
+        auto end   = s3d::Min( begin + rowCount, height );
+        threads.emplace_back( func, i, begin, end );
+    }
+
+    func( 0, 0, s3d::Min( rowCount, height ) );
+
+    for( auto& thread : threads )
+    { thread.join(); }
+}
+
+//------------------------------------------------------------------------------------------------
+//      log2 を多項式で近似します.
+//------------------------------------------------------------------------------------------------
+S3D_INLINE
+b128 FastLog2( const b128 x )
+{
+    // 指数部と仮数部 [1, 2) に分解.
+    auto i = _mm_castps_si128( x );
+    auto e = _mm_cvtepi32_ps( _mm_sub_epi32( _mm_srli_epi32( i, 23 ), _mm_set1_epi32( 127 ) ) );
+    auto m = _mm_or_ps( _mm_castsi128_ps( _mm_and_si128( i, _mm_set1_epi32( 0x007fffff ) ) ), _mm_set1_ps( 1.0f ) );
+
+    // 仮数部を5次多項式で近似.
+    auto p = _mm_set1_ps( -3.4436006e-2f );
+    p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps(  3.1821337e-1f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps( -1.2315303f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps(  2.5988452f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps( -3.3241990f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps(  3.1157899f ) );
+
+    return _mm_add_ps( _mm_mul_ps( p, _mm_sub_ps( m, _mm_set1_ps( 1.0f ) ) ), e );
+}
+
+//------------------------------------------------------------------------------------------------
+//      exp2 を多項式で近似します.
+//------------------------------------------------------------------------------------------------
+S3D_INLINE
+b128 FastExp2( const b128 x )
+{
+    auto t = _mm_min_ps( _mm_max_ps( x, _mm_set1_ps( -126.99999f ) ), _mm_set1_ps( 129.0f ) );
+
+    // 整数部と小数部 [0, 1) に分解.
+    auto ipart = _mm_cvtps_epi32( _mm_sub_ps( t, _mm_set1_ps( 0.5f ) ) );
+    auto fpart = _mm_sub_ps( t, _mm_cvtepi32_ps( ipart ) );
+    auto expi  = _mm_castsi128_ps( _mm_slli_epi32( _mm_add_epi32( ipart, _mm_set1_epi32( 127 ) ), 23 ) );
+
+    // 小数部を5次多項式で近似.
+    auto p = _mm_set1_ps( 1.8775767e-3f );
+    p = _mm_add_ps( _mm_mul_ps( p, fpart ), _mm_set1_ps( 8.9893397e-3f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, fpart ), _mm_set1_ps( 5.5826318e-2f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, fpart ), _mm_set1_ps( 2.4015361e-1f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, fpart ), _mm_set1_ps( 6.9315308e-1f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, fpart ), _mm_set1_ps( 9.9999994e-1f ) );
+
+    return _mm_mul_ps( expi, p );
+}
+
+//------------------------------------------------------------------------------------------------
+//      ガンマ補正を行います.
+//------------------------------------------------------------------------------------------------
+S3D_INLINE
+b128 ApplyGamma( const b128 color )
+{
+    // 負値と NaN は最小値に丸めておく.
+    auto c = _mm_max_ps( color, _mm_set1_ps( MinGammaInput ) );
+    return FastExp2( _mm_mul_ps( FastLog2( c ), _mm_set1_ps( 1.0f / 2.2f ) ) );
+}
+
 //------------------------------------------------------------------------------------------------
 //      対数平均と最大輝度値を求めます.
 //------------------------------------------------------------------------------------------------
@@ -45,53 +140,88 @@ void ComputeLogarithmicAverage
     f32&                maxLw
 )
 {
-    auto init = false;
-    for( auto i=0; i<height; ++i )
+    const auto chunkCount = GetChunkCount( width, height );
+
+    std::vector<f64> sums( chunkCount, 0.0 );
+    std::vector<f32> maxs( chunkCount, 0.0f );
+
+    // スレッドごとに部分和と部分最大値を求める.
+    ParallelRows( height, chunkCount, [&]( s32 chunk, s32 begin, s32 end )
     {
-        for( auto j=0; j<width; ++j )
-        {
-            // ピクセル番号.
-            auto idx = ( i * width ) + j;
+        const auto eps  = _mm_set1_ps( epsilon );
+        const auto lowY = _mm_set1_ps( FLT_EPSILON );
+        const auto kr   = _mm_set1_ps( RGB2Y.x );
+        const auto kg   = _mm_set1_ps( RGB2Y.y );
+        const auto kb   = _mm_set1_ps( RGB2Y.z );
 
-            // 輝度値に変換.
-            auto Lw = RGBToY( pPixels[idx] );
+        auto sum  = 0.0;
+        auto maxV = _mm_setzero_ps();
 
-            if (s3d::IsNan(Lw))
-            {
-                DLOG( "Nan!");
-                Lw = epsilon;
-            }
+        for( auto i=begin; i<end; ++i )
+        {
+            auto rowSum = _mm_setzero_ps();
+            auto pRow   = pPixels + i * width;
 
-            if (Lw < FLT_EPSILON)
+            // 4ピクセルずつ輝度値に変換.
+            auto j = 0;
+            for( ; j + 4 <= width; j += 4 )
             {
-                Lw = epsilon;
+                auto r = pRow[j + 0].v;
+                auto g = pRow[j + 1].v;
+                auto b = pRow[j + 2].v;
+                auto a = pRow[j + 3].v;
+                _MM_TRANSPOSE4_PS( r, g, b, a );
+
+                auto Lw = _mm_add_ps( _mm_add_ps( _mm_mul_ps( kr, r ), _mm_mul_ps( kg, g ) ), _mm_mul_ps( kb, b ) );
+
+                // NaN と極小値は epsilon に置き換える.
+                auto mask = _mm_cmpge_ps( Lw, lowY );
+                Lw = _mm_or_ps( _mm_and_ps( mask, Lw ), _mm_andnot_ps( mask, eps ) );
+
+                maxV   = _mm_max_ps( maxV, Lw );
+                rowSum = _mm_add_ps( rowSum, FastLog2( _mm_add_ps( eps, Lw ) ) );
             }
 
-            // 最大輝度値を求める.
-            if ( !init )
+            S3D_ALIGN(16) f32 lanes[4];
+            _mm_store_ps( lanes, rowSum );
+            sum += static_cast<f64>( lanes[0] ) + lanes[1] + lanes[2] + lanes[3];
+
+            // 端数は1ピクセルずつ処理.
+            for( ; j<width; ++j )
             {
-                maxLw = Lw;
-                init = true;
-            }
-            else
-            { maxLw = s3d::Max( maxLw, Lw ); }
+                auto Lw = RGBToY( pRow[j] );
+                if ( !( Lw >= FLT_EPSILON ) )
+                { Lw = epsilon; }
 
-            // 輝度値の対数総和を求める.
-            aveLw += logf( epsilon + Lw );
+                maxV = _mm_max_ps( maxV, _mm_set1_ps( Lw ) );
+                sum += log2( epsilon + Lw );
+            }
         }
+
+        S3D_ALIGN(16) f32 lanes[4];
+        _mm_store_ps( lanes, maxV );
+
+        sums[chunk] = sum;
+        maxs[chunk] = s3d::Max( s3d::Max( lanes[0], lanes[1] ), s3d::Max( lanes[2], lanes[3] ) );
+    });
+
+    // 部分和を集約.
+    auto sum = 0.0;
+    maxLw = 0.0f;
+    for( auto i=0; i<chunkCount; ++i )
+    {
+        sum  += sums[i];
+        maxLw = s3d::Max( maxLw, maxs[i] );
     }
 
-    if (s3d::IsNan(aveLw))
+    // ピクセル数で除算して指数をとる.
+    aveLw = static_cast<f32>( exp2( sum / ( static_cast<f64>( width ) * height ) ) );
+
+    if (s3d::IsNan(aveLw) || aveLw <= 0.0f)
     {
         DLOG( "Nan!");
         aveLw = epsilon;
     }
-
-    // ピクセル数で除算.
-    aveLw /= ( width * height );
-
-    // 指数をとる.
-    aveLw = expf( aveLw );
 }
 
 //------------------------------------------------------------------------------------------------
@@ -123,12 +253,182 @@ s3d::Vector4 ACESFilm( const s3d::Vector4& color )
     const auto e = 0.14f;
     const auto f = 0.665406f;
     const auto g = 12.0f;
-    return s3d::Vector4(
-        s3d::Saturate((color.GetX() * (a * color.GetX() * f / g + b)) / (color.GetX() * f / g * (c * color.GetX() * f + d) + e)),
-        s3d::Saturate((color.GetY() * (a * color.GetY() * f / g + b)) / (color.GetY() * f / g * (c * color.GetY() * f + d) + e)),
-        s3d::Saturate((color.GetZ() * (a * color.GetZ() * f / g + b)) / (color.GetZ() * f / g * (c * color.GetZ() * f + d) + e)),
-        color.GetW());
+
+    auto result = ( color * ( color * ( a * f / g ) + b ) ) / ( color * ( f / g ) * ( color * ( c * f ) + d ) + e );
+    return s3d::Vector4::Min( s3d::Vector4::Max( result, s3d::Vector4( 0.0f, 0.0f, 0.0f, 0.0f ) ), s3d::Vector4( 1.0f, 1.0f, 1.0f, 1.0f ) );
 }
+
+//------------------------------------------------------------------------------------------------
+//      Reinhard 方式のトーンマッピング演算子です.
+//------------------------------------------------------------------------------------------------
+struct ReinhardOperator
+{
+    f32 coeff;          //!< 露光係数です.
+    f32 invMaxLw2;      //!< 白色点の2乗の逆数です.
+
+    ReinhardOperator( const f32 aveLw, const f32 maxLw )
+    {
+        const auto a = 0.18f;
+        coeff = a / aveLw;
+
+        auto maxLw2 = maxLw * coeff;
+        maxLw2 *= maxLw2;
+        invMaxLw2 = 1.0f / maxLw2;
+    }
+
+    s3d::Vector4 operator () ( const s3d::Color4& color ) const
+    {
+        // "Realistic Ray Tracing" p.180 式(12.9)より
+        auto L = color * coeff;
+
+        // "Realistic Ray Tracing" p.181 式(12.11)より
+        return L * ( L * invMaxLw2 + 1.0f ) / ( L + 1.0f );
+    }
+};
+
+//------------------------------------------------------------------------------------------------
+//      Uncharted2 Filmic 方式のトーンマッピング演算子です.
+//------------------------------------------------------------------------------------------------
+struct Uncharted2Operator
+{
+    f32 coeff;          //!< 露光係数です.
+    f32 invWhite;       //!< 白色点の逆数です.
+
+    Uncharted2Operator( const f32 aveLw, const f32 )
+    {
+        const auto a = 0.18f;
+        const auto LinearWhite = 11.2f;     // "Uncharted 2 : HDR Lighting" に記載の値を使用.
+
+        coeff    = a / aveLw * 2.0f;
+        invWhite = 1.0f / Uncharted2Tonemap( LinearWhite );
+    }
+
+    s3d::Vector4 operator () ( const s3d::Color4& color ) const
+    { return Uncharted2Tonemap( color * coeff ) * invWhite; }
+};
+
+//------------------------------------------------------------------------------------------------
+//      ACES Filmic 方式のトーンマッピング演算子です.
+//------------------------------------------------------------------------------------------------
+struct ACESOperator
+{
+    f32 coeff;          //!< 露光係数です.
+
+    ACESOperator( const f32 aveLw, const f32 )
+    {
+        const auto a = 0.27f;
+        coeff = a / aveLw;
+    }
+
+    s3d::Vector4 operator () ( const s3d::Color4& color ) const
+    { return ACESFilm( color * coeff ); }
+};
+
+//------------------------------------------------------------------------------------------------
+//      浮動小数点数のカラーとして格納します.
+//------------------------------------------------------------------------------------------------
+S3D_INLINE
+void Store( const b128 color, const s3d::Color4& source, const s32 index, s3d::Color4* pResult )
+{
+    pResult[index] = s3d::Color4( color );
+    pResult[index].w = source.w;
+}
+
+//------------------------------------------------------------------------------------------------
+//      8bit に量子化して RGB の順で格納します.
+//------------------------------------------------------------------------------------------------
+S3D_INLINE
+void Store( const b128 color, const s3d::Color4&, const s32 index, u8* pResult )
+{
+    // NaN は 0 に丸める.
+    auto c = _mm_min_ps( _mm_max_ps( color, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+    c = _mm_add_ps( _mm_mul_ps( c, _mm_set1_ps( 255.0f ) ), _mm_set1_ps( 0.5f ) );
+
+    auto i = _mm_cvttps_epi32( c );
+    i = _mm_packs_epi32( i, i );
+    i = _mm_packus_epi16( i, i );
+
+    auto rgba = static_cast<u32>( _mm_cvtsi128_si32( i ) );
+    pResult[index * 3 + 0] = static_cast<u8>( rgba );
+    pResult[index * 3 + 1] = static_cast<u8>( rgba >> 8 );
+    pResult[index * 3 + 2] = static_cast<u8>( rgba >> 16 );
+}
+
+//------------------------------------------------------------------------------------------------
+//      トーンマッピング演算子とガンマ補正を適用します.
+//------------------------------------------------------------------------------------------------
+template<typename Operator, typename T>
+void ApplyOperator
+(
+    const s32           width,
+    const s32           height,
+    const s3d::Color4*  pPixels,
+    const Operator&     op,
+    T*                  pResult
+)
+{
+    ParallelRows( height, GetChunkCount( width, height ), [&]( s32, s32 begin, s32 end )
+    {
+        for( auto i=begin; i<end; ++i )
+        {
+            for( auto j=0; j<width; ++j )
+            {
+                // ピクセル番号.
+                auto idx = ( i * width ) + j;
+
+                auto color = ApplyGamma( op( pPixels[idx] ).v );
+
+                // トーンマッピングした結果を格納.
+                Store( color, pPixels[idx], idx, pResult );
+            }
+        }
+    });
+}
+
+//------------------------------------------------------------------------------------------------
+//      トーンマッピングを行います.
+//------------------------------------------------------------------------------------------------
+template<typename T>
+void ToneMap
+(
+    s3d::TONE_MAPPING_TYPE  type,
+    const s32               width,
+    const s32               height,
+    const s3d::Color4*      pPixels,
+    T*                      pResult
+)
+{
+    assert( pPixels != nullptr );
+    assert( pResult != nullptr );
+
+    if ( width <= 0 || height <= 0 )
+    { return; }
+
+    auto aveLw = 0.0f;
+    auto maxLw = 0.0f;
+
+    // 対数平均と最大輝度値を求める.
+    ComputeLogarithmicAverage( width, height, pPixels, 0.00001f, aveLw, maxLw );
+
+    //MedianFilter( width, height, pPixels, pResult );
+
+    switch( type )
+    {
+        case s3d::TONE_MAPPING_REINHARD:
+        default:
+            ApplyOperator( width, height, pPixels, ReinhardOperator( aveLw, maxLw ), pResult );
+            break;
+
+        case s3d::TONE_MAPPING_UNCHARTED2_FILMIC:
+            ApplyOperator( width, height, pPixels, Uncharted2Operator( aveLw, maxLw ), pResult );
+            break;
+
+        case s3d::TONE_MAPPING_ACES_FILMIC:
+            ApplyOperator( width, height, pPixels, ACESOperator( aveLw, maxLw ), pResult );
+            break;
+    }
+}
+
 s3d::Color4 median_value(s3d::Color4 c[9])
 {
     s3d::Color4 buf;
@@ -212,157 +512,19 @@ void ToneMapper::Map
     const Color4*     pPixels,
     Color4*           pResult
 )
-{
-    //MedianFilter( width, height, pPixels, pResult );
-
-    switch( type )
-    {
-        case TONE_MAPPING_REINHARD:
-        default:
-            ReinhardToneMapping( width, height, pPixels, pResult );
-            break;
-
-        case TONE_MAPPING_UNCHARTED2_FILMIC:
-            Uncharted2FilmicToneMapping( width, height, pPixels, pResult );
-            break;
-
-        case TONE_MAPPING_ACES_FILMIC:
-            ACESFilmicToneMapping( width, height, pPixels, pResult );
-            break;
-    }
-}
-
-//------------------------------------------------------------------------------------------------
-//      Reinhardトーンマッピングを行います.
-//------------------------------------------------------------------------------------------------
-void ToneMapper::ReinhardToneMapping
-(
-    const s32     width, 
-    const s32     height,
-    const Color4* pPixels,
-    Color4*        pResult
-)
-{
-    assert( pPixels != nullptr );
-
-    auto a     = 0.18f;
-    auto aveLw = 0.0f;
-    auto maxLw = 0.0f;
-
-    // 対数平均と最大輝度値を求める.
-    ComputeLogarithmicAverage( width, height, pPixels, 0.00001f, aveLw, maxLw );
-
-    auto coeff = a / aveLw;
-    auto maxLw2 = maxLw * coeff;
-    maxLw2 *= maxLw2;
-
-    for( auto i=0; i<height; ++i )
-    {
-        for( auto j=0; j<width; ++j )
-        {
-            // ピクセル番号.
-            auto idx = ( i * width ) + j;
-
-            // "Realistic Ray Tracing" p.180 式(12.9)より
-            auto L   = ( pPixels[idx] * coeff );
-
-            // "Realistic Ray Tracing" p.181 式(12.11)より
-            auto Ld  = L * ( 1.0f + ( L / maxLw2 ) ) / ( 1.0f + L );
-
-            // トーンマッピングした結果を格納.
-            pResult[idx] = Color4(
-                pow( Ld.GetX(), 1.0f / 2.2f ),
-                pow( Ld.GetY(), 1.0f / 2.2f ),
-                pow( Ld.GetZ(), 1.0f / 2.2f ),
-                pPixels[idx].GetW() );
-        }
-    }
-}
-
-//------------------------------------------------------------------------------------------------
-//      Uncharted2 Filmic トーンマッピング.
-//------------------------------------------------------------------------------------------------
-void ToneMapper::Uncharted2FilmicToneMapping
-(
-    const s32     width,
-    const s32     height,
-    const Color4* pPixels,
-    Color4*       pResult
-)
-{
-    assert( pPixels != nullptr );
-    auto a     = 0.18f;
-    auto aveLw = 0.0f;
-    auto maxLw = 0.0f;
-
-    // 対数平均と最大輝度値を求める.
-    ComputeLogarithmicAverage( width, height, pPixels, 0.00001f, aveLw, maxLw );
-
-    auto coeff = a / aveLw;
-
-    const auto LinearWhite = 11.2f;     // "Uncharted 2 : HDR Lighting" に記載の値を使用.
-
-    for( auto i=0; i<height; ++i )
-    {
-        for( auto j=0; j<width; ++j )
-        {
-            // ピクセル番号.
-            auto idx = ( i * width ) + j;
-
-            auto texelColor = pPixels[idx] * coeff;
-
-            auto color = Uncharted2Tonemap( 2.0f * texelColor ) / Uncharted2Tonemap( LinearWhite );
+{ ToneMap( type, width, height, pPixels, pResult ); }
 
-            // トーンマッピングした結果を格納.
-            pResult[idx] = Color4(
-                pow( color.GetX(), 1.0f / 2.2f ),
-                pow( color.GetY(), 1.0f / 2.2f ),
-                pow( color.GetZ(), 1.0f / 2.2f ),
-                pPixels[idx].GetW() );
-        }
-    }
-}
-
-//------------------------------------------------------------------------------------------------
-//      ACES Filmic トーンマッピング.
-//------------------------------------------------------------------------------------------------
-void ToneMapper::ACESFilmicToneMapping
+//-------------------------------------------------------------------------------------------------
+//      トーンマッピングを行い, 8bit に量子化します.
+//-------------------------------------------------------------------------------------------------
+void ToneMapper::Map
 (
-    const s32     width,
-    const s32     height,
-    const Color4* pPixels,
-    Color4*       pResult
+    TONE_MAPPING_TYPE type,
+    const s32         width, 
+    const s32         height,
+    const Color4*     pPixels,
+    u8*               pResult
 )
-{
-    assert(pPixels != nullptr);
-    auto a = 0.27f;
-    auto aveLw = 0.0f;
-    auto maxLw = 0.0f;
-
-    // 対数平均と最大輝度値を求める.
-    ComputeLogarithmicAverage(width, height, pPixels, 0.00001f, aveLw, maxLw);
-
-    auto coeff = a / aveLw;
-
-    for (auto i = 0; i<height; ++i)
-    {
-        for (auto j = 0; j<width; ++j)
-        {
-            // ピクセル番号.
-            auto idx = (i * width) + j;
-
-            auto texelColor = pPixels[idx] * coeff;
-
-            auto color = ACESFilm(texelColor);
-
-            // トーンマッピングした結果を格納.
-            pResult[idx] = Color4(
-                pow(color.GetX(), 1.0f / 2.2f),
-                pow(color.GetY(), 1.0f / 2.2f),
-                pow(color.GetZ(), 1.0f / 2.2f),
-                pPixels[idx].GetW());
-        }
-    }
-}
+{ ToneMap( type, width, height, pPixels, pResult ); }
 
 } // namespace s3d
@@ -37,6 +37,12 @@ Triangle::Triangle(Vertex* pVertice, IMaterial* pMaterial)
 
     m_Edge[0] = m_Vertex[1].Position - m_Vertex[0].Position;
     m_Edge[1] = m_Vertex[2].Position - m_Vertex[0].Position;
+
+    m_UVDensity = ComputeUVDensity(
+        m_Edge[0],
+        m_Edge[1],
+        m_Vertex[1].TexCoord - m_Vertex[0].TexCoord,
+        m_Vertex[2].TexCoord - m_Vertex[0].TexCoord );
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -95,23 +101,35 @@ bool Triangle::IsHit(const RaySet& raySet, HitRecord& record) const
     if ( dist >= record.distance )
     { return false; }
 
-    record.position  = raySet.ray.pos + raySet.ray.dir * dist;
-    record.distance  = dist;
-    record.pShape    = this;
-    record.pMaterial = m_pMaterial;
+    SetHitRecord( raySet, dist, beta, gamma, record );
 
-    auto alpha = 1.0f - beta - gamma;
-    record.normal = Vector3(
-        m_Vertex[0].Normal.x * alpha + m_Vertex[1].Normal.x * beta + m_Vertex[2].Normal.x * gamma,
-        m_Vertex[0].Normal.y * alpha + m_Vertex[1].Normal.y * beta + m_Vertex[2].Normal.y * gamma,
-        m_Vertex[0].Normal.z * alpha + m_Vertex[1].Normal.z * beta + m_Vertex[2].Normal.z * gamma );
-    record.normal.SafeNormalize();
+    return true;
+}
 
-    record.texcoord = Vector2(
-        m_Vertex[0].TexCoord.x * alpha + m_Vertex[1].TexCoord.x * beta + m_Vertex[2].TexCoord.x * gamma,
-        m_Vertex[0].TexCoord.y * alpha + m_Vertex[1].TexCoord.y * beta + m_Vertex[2].TexCoord.y * gamma );
+//-------------------------------------------------------------------------------------------------
+//      遮蔽判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool Triangle::IsOccluded(const RaySet& raySet, f32 distance) const
+{
+    auto s1  = Vector3::Cross( raySet.ray.dir, m_Edge[1] );
+    auto div = Vector3::Dot( s1, m_Edge[0] );
 
-    return true;
+    if ( abs(div) <= FLT_EPSILON )
+    { return false; }
+
+    auto d = raySet.ray.pos - m_Vertex[0].Position;
+    auto beta = Vector3::Dot( d, s1 ) / div;
+    if ( beta <= 0.0 || beta >= 1.0 )
+    { return false; }
+
+    auto s2 = Vector3::Cross( d, m_Edge[0] );
+    auto gamma = Vector3::Dot( raySet.ray.dir, s2 ) / div;
+    if ( gamma <= 0.0 || ( beta + gamma ) >= 1.0 )
+    { return false; }
+
+    // 属性の補間は不要.
+    auto dist = Vector3::Dot( m_Edge[1], s2 ) / div;
+    return ( F_HIT_MIN <= dist && dist < distance );
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -132,4 +150,36 @@ Vector3 Triangle::GetCenter() const
 IShape* Triangle::Create(Vertex* pVertices, IMaterial* pMaterial)
 {  return new(std::nothrow) Triangle(pVertices, pMaterial); }
 
+//-------------------------------------------------------------------------------------------------
+//      頂点の位置座標を取得します.
+//-------------------------------------------------------------------------------------------------
+Vector3 Triangle::GetPosition(u32 index) const
+{
+    assert( index < 3 );
+    return m_Vertex[index].Position;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      交差位置の重心座標から属性を補間して交差記録を設定します.
+//-------------------------------------------------------------------------------------------------
+void Triangle::SetHitRecord(const RaySet& raySet, f32 dist, f32 beta, f32 gamma, HitRecord& record) const
+{
+    record.position  = raySet.ray.pos + raySet.ray.dir * dist;
+    record.distance  = dist;
+    record.pShape    = this;
+    record.pMaterial = m_pMaterial;
+
+    auto alpha = 1.0f - beta - gamma;
+    record.normal = Vector3(
+        m_Vertex[0].Normal.x * alpha + m_Vertex[1].Normal.x * beta + m_Vertex[2].Normal.x * gamma,
+        m_Vertex[0].Normal.y * alpha + m_Vertex[1].Normal.y * beta + m_Vertex[2].Normal.y * gamma,
+        m_Vertex[0].Normal.z * alpha + m_Vertex[1].Normal.z * beta + m_Vertex[2].Normal.z * gamma );
+    record.normal.SafeNormalize();
+
+    record.texcoord = Vector2(
+        m_Vertex[0].TexCoord.x * alpha + m_Vertex[1].TexCoord.x * beta + m_Vertex[2].TexCoord.x * gamma,
+        m_Vertex[0].TexCoord.y * alpha + m_Vertex[1].TexCoord.y * beta + m_Vertex[2].TexCoord.y * gamma );
+    record.uvDensity = m_UVDensity;
+}
+
 } // namespace s3d
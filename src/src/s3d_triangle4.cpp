@@ -0,0 +1,247 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_triangle4.cpp
+// Desc : Packed Triangle x4 Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_triangle4.h>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Triangle4 class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------------------
+//      コンストラクタです.
+//-------------------------------------------------------------------------------------------------
+Triangle4::Triangle4(size_t count, ITriangle** ppTriangles)
+: m_Count        (1)
+, m_TriangleCount(static_cast<u32>(count))
+{
+    // 空きレーンは面積0の三角形として判定で必ず棄却されるようにする.
+    S3D_ALIGN(16) f32 v [3][4] = {};
+    S3D_ALIGN(16) f32 e0[3][4] = {};
+    S3D_ALIGN(16) f32 e1[3][4] = {};
+
+    m_Box = ppTriangles[0]->GetBox();
+
+    for(size_t i=0; i<4; ++i)
+    {
+        m_pTriangles[i] = nullptr;
+        if ( i >= count )
+        { continue; }
+
+        m_pTriangles[i] = ppTriangles[i];
+        m_pTriangles[i]->AddRef();
+        m_Box = BoundingBox::Merge( m_Box, ppTriangles[i]->GetBox() );
+
+        const auto pos   = ppTriangles[i]->GetPosition(0);
+        const auto edge0 = ppTriangles[i]->GetPosition(1) - pos;
+        const auto edge1 = ppTriangles[i]->GetPosition(2) - pos;
+        for(auto j=0; j<3; ++j)
+        {
+            v [j][i] = pos.a[j];
+            e0[j][i] = edge0.a[j];
+            e1[j][i] = edge1.a[j];
+        }
+    }
+
+    for(auto j=0; j<3; ++j)
+    {
+        m_Vertex[j] = _mm_load_ps( v [j] );
+        m_Edge0 [j] = _mm_load_ps( e0[j] );
+        m_Edge1 [j] = _mm_load_ps( e1[j] );
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+//      デストラクタです.
+//-------------------------------------------------------------------------------------------------
+Triangle4::~Triangle4()
+{
+    for(auto i=0; i<4; ++i)
+    { SafeRelease( m_pTriangles[i] ); }
+}
+
+//-------------------------------------------------------------------------------------------------
+//      参照カウントを増やします.
+//-------------------------------------------------------------------------------------------------
+void Triangle4::AddRef()
+{ m_Count++; }
+
+//-------------------------------------------------------------------------------------------------
+//      解放処理を行います.
+//-------------------------------------------------------------------------------------------------
+void Triangle4::Release()
+{
+    m_Count--;
+    if ( m_Count == 0 )
+    { delete this; }
+}
+
+//-------------------------------------------------------------------------------------------------
+//      参照カウントを取得します.
+//-------------------------------------------------------------------------------------------------
+u32 Triangle4::GetCount() const
+{ return m_Count; }
+
+//-------------------------------------------------------------------------------------------------
+//      4つの三角形との交差判定をまとめて行います.
+//-------------------------------------------------------------------------------------------------
+s32 Triangle4::Intersect(const RaySet& raySet, f32 distance, b128& dist, b128& beta, b128& gamma) const
+{
+    const auto& ray = raySet.ray;
+
+    const b128 dir[3] = {
+        _mm_set1_ps( ray.dir.x ),
+        _mm_set1_ps( ray.dir.y ),
+        _mm_set1_ps( ray.dir.z ),
+    };
+
+    // s1 = cross( dir, edge1 ).
+    const b128 s1[3] = {
+        MulSub( dir[1], m_Edge1[2], _mm_mul_ps( dir[2], m_Edge1[1] ) ),
+        MulSub( dir[2], m_Edge1[0], _mm_mul_ps( dir[0], m_Edge1[2] ) ),
+        MulSub( dir[0], m_Edge1[1], _mm_mul_ps( dir[1], m_Edge1[0] ) ),
+    };
+
+    auto div = _mm_add_ps( _mm_add_ps(
+        _mm_mul_ps( s1[0], m_Edge0[0] ),
+        _mm_mul_ps( s1[1], m_Edge0[1] ) ),
+        _mm_mul_ps( s1[2], m_Edge0[2] ) );
+    auto invDiv = _mm_div_ps( _mm_set1_ps( 1.0f ), div );
+
+    const b128 d[3] = {
+        _mm_sub_ps( _mm_set1_ps( ray.pos.x ), m_Vertex[0] ),
+        _mm_sub_ps( _mm_set1_ps( ray.pos.y ), m_Vertex[1] ),
+        _mm_sub_ps( _mm_set1_ps( ray.pos.z ), m_Vertex[2] ),
+    };
+
+    beta = _mm_mul_ps( _mm_add_ps( _mm_add_ps(
+        _mm_mul_ps( d[0], s1[0] ),
+        _mm_mul_ps( d[1], s1[1] ) ),
+        _mm_mul_ps( d[2], s1[2] ) ), invDiv );
+
+    // s2 = cross( d, edge0 ).
+    const b128 s2[3] = {
+        MulSub( d[1], m_Edge0[2], _mm_mul_ps( d[2], m_Edge0[1] ) ),
+        MulSub( d[2], m_Edge0[0], _mm_mul_ps( d[0], m_Edge0[2] ) ),
+        MulSub( d[0], m_Edge0[1], _mm_mul_ps( d[1], m_Edge0[0] ) ),
+    };
+
+    gamma = _mm_mul_ps( _mm_add_ps( _mm_add_ps(
+        _mm_mul_ps( dir[0], s2[0] ),
+        _mm_mul_ps( dir[1], s2[1] ) ),
+        _mm_mul_ps( dir[2], s2[2] ) ), invDiv );
+
+    dist = _mm_mul_ps( _mm_add_ps( _mm_add_ps(
+        _mm_mul_ps( m_Edge1[0], s2[0] ),
+        _mm_mul_ps( m_Edge1[1], s2[1] ) ),
+        _mm_mul_ps( m_Edge1[2], s2[2] ) ), invDiv );
+
+    const auto zero = _mm_setzero_ps();
+    const auto one  = _mm_set1_ps( 1.0f );
+    const auto absDiv = _mm_andnot_ps( _mm_set1_ps( -0.0f ), div );
+
+    auto mask = _mm_cmpgt_ps( absDiv, _mm_set1_ps( FLT_EPSILON ) );
+    mask = _mm_and_ps( mask, _mm_cmpgt_ps( beta,  zero ) );
+    mask = _mm_and_ps( mask, _mm_cmplt_ps( beta,  one  ) );
+    mask = _mm_and_ps( mask, _mm_cmpgt_ps( gamma, zero ) );
+    mask = _mm_and_ps( mask, _mm_cmplt_ps( _mm_add_ps( beta, gamma ), one ) );
+    mask = _mm_and_ps( mask, _mm_cmpge_ps( dist, _mm_set1_ps( F_HIT_MIN ) ) );
+    mask = _mm_and_ps( mask, _mm_cmplt_ps( dist, _mm_set1_ps( Min( distance, F_HIT_MAX ) ) ) );
+
+    return _mm_movemask_ps( mask );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      交差判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool Triangle4::IsHit(const RaySet& raySet, HitRecord& record) const
+{
+    b128 dist, beta, gamma;
+    auto mask = Intersect( raySet, record.distance, dist, beta, gamma );
+    if ( mask == 0 )
+    { return false; }
+
+    S3D_ALIGN(16) f32 t[4];
+    S3D_ALIGN(16) f32 b[4];
+    S3D_ALIGN(16) f32 g[4];
+    _mm_store_ps( t, dist );
+    _mm_store_ps( b, beta );
+    _mm_store_ps( g, gamma );
+
+    // 最近接のレーンを求める.
+    auto lane = -1;
+    for(auto i=0; i<4; ++i)
+    {
+        if ( ( mask & ( 0x1 << i ) ) == 0 )
+        { continue; }
+
+        if ( lane < 0 || t[i] < t[lane] )
+        { lane = i; }
+    }
+
+    // 属性の補間は最近接の三角形のみ行う.
+    m_pTriangles[lane]->SetHitRecord( raySet, t[lane], b[lane], g[lane], record );
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      遮蔽判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool Triangle4::IsOccluded(const RaySet& raySet, f32 distance) const
+{
+    b128 dist, beta, gamma;
+    return Intersect( raySet, distance, dist, beta, gamma ) != 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      バウンディングボックスを取得します.
+//-------------------------------------------------------------------------------------------------
+BoundingBox Triangle4::GetBox() const
+{ return m_Box; }
+
+//-------------------------------------------------------------------------------------------------
+//      中心座標を取得します.
+//-------------------------------------------------------------------------------------------------
+Vector3 Triangle4::GetCenter() const
+{ return m_Box.center; }
+
+//-------------------------------------------------------------------------------------------------
+//      new 演算子のオーバーロードです.
+//-------------------------------------------------------------------------------------------------
+void* Triangle4::operator new (size_t size)
+{ return _aligned_malloc(size, 16); }
+
+//-------------------------------------------------------------------------------------------------
+//      delete 演算子のオーバーロードです.
+//-------------------------------------------------------------------------------------------------
+void Triangle4::operator delete (void* ptr)
+{ _aligned_free(ptr); }
+
+//-------------------------------------------------------------------------------------------------
+//      生成処理を行います.
+//-------------------------------------------------------------------------------------------------
+IShape* Triangle4::Create(size_t count, IShape** ppShapes)
+{
+    if ( count == 0 || count > 4 || ppShapes == nullptr )
+    { return nullptr; }
+
+    ITriangle* pTriangles[4];
+    for(size_t i=0; i<count; ++i)
+    {
+        pTriangles[i] = dynamic_cast<ITriangle*>( ppShapes[i] );
+        if ( pTriangles[i] == nullptr )
+        { return nullptr; }
+    }
+
+    return new Triangle4( count, pTriangles );
+}
+
+} // namespace s3d
@@ -0,0 +1,247 @@
+﻿//-------------------------------------------------------------------------------------------------
+// File : s3d_triangle8.cpp
+// Desc : Packed Triangle x8 Module.
+// Copyright(c) Project Asura. All right reserved.
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------
+#include <s3d_triangle8.h>
+
+
+namespace s3d {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Triangle8 class
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------------------
+//      コンストラクタです.
+//-------------------------------------------------------------------------------------------------
+Triangle8::Triangle8(size_t count, ITriangle** ppTriangles)
+: m_Count        (1)
+, m_TriangleCount(static_cast<u32>(count))
+{
+    // 空きレーンは面積0の三角形として判定で必ず棄却されるようにする.
+    S3D_ALIGN(32) f32 v [3][8] = {};
+    S3D_ALIGN(32) f32 e0[3][8] = {};
+    S3D_ALIGN(32) f32 e1[3][8] = {};
+
+    m_Box = ppTriangles[0]->GetBox();
+
+    for(size_t i=0; i<8; ++i)
+    {
+        m_pTriangles[i] = nullptr;
+        if ( i >= count )
+        { continue; }
+
+        m_pTriangles[i] = ppTriangles[i];
+        m_pTriangles[i]->AddRef();
+        m_Box = BoundingBox::Merge( m_Box, ppTriangles[i]->GetBox() );
+
+        const auto pos   = ppTriangles[i]->GetPosition(0);
+        const auto edge0 = ppTriangles[i]->GetPosition(1) - pos;
+        const auto edge1 = ppTriangles[i]->GetPosition(2) - pos;
+        for(auto j=0; j<3; ++j)
+        {
+            v [j][i] = pos.a[j];
+            e0[j][i] = edge0.a[j];
+            e1[j][i] = edge1.a[j];
+        }
+    }
+
+    for(auto j=0; j<3; ++j)
+    {
+        m_Vertex[j] = _mm256_load_ps( v [j] );
+        m_Edge0 [j] = _mm256_load_ps( e0[j] );
+        m_Edge1 [j] = _mm256_load_ps( e1[j] );
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+//      デストラクタです.
+//-------------------------------------------------------------------------------------------------
+Triangle8::~Triangle8()
+{
+    for(auto i=0; i<8; ++i)
+    { SafeRelease( m_pTriangles[i] ); }
+}
+
+//-------------------------------------------------------------------------------------------------
+//      参照カウントを増やします.
+//-------------------------------------------------------------------------------------------------
+void Triangle8::AddRef()
+{ m_Count++; }
+
+//-------------------------------------------------------------------------------------------------
+//      解放処理を行います.
+//-------------------------------------------------------------------------------------------------
+void Triangle8::Release()
+{
+    m_Count--;
+    if ( m_Count == 0 )
+    { delete this; }
+}
+
+//-------------------------------------------------------------------------------------------------
+//      参照カウントを取得します.
+//-------------------------------------------------------------------------------------------------
+u32 Triangle8::GetCount() const
+{ return m_Count; }
+
+//-------------------------------------------------------------------------------------------------
+//      8つの三角形との交差判定をまとめて行います.
+//-------------------------------------------------------------------------------------------------
+s32 Triangle8::Intersect(const RaySet& raySet, f32 distance, b256& dist, b256& beta, b256& gamma) const
+{
+    const auto& ray = raySet.ray;
+
+    const b256 dir[3] = {
+        _mm256_set1_ps( ray.dir.x ),
+        _mm256_set1_ps( ray.dir.y ),
+        _mm256_set1_ps( ray.dir.z ),
+    };
+
+    // s1 = cross( dir, edge1 ).
+    const b256 s1[3] = {
+        MulSub( dir[1], m_Edge1[2], _mm256_mul_ps( dir[2], m_Edge1[1] ) ),
+        MulSub( dir[2], m_Edge1[0], _mm256_mul_ps( dir[0], m_Edge1[2] ) ),
+        MulSub( dir[0], m_Edge1[1], _mm256_mul_ps( dir[1], m_Edge1[0] ) ),
+    };
+
+    auto div = _mm256_add_ps( _mm256_add_ps(
+        _mm256_mul_ps( s1[0], m_Edge0[0] ),
+        _mm256_mul_ps( s1[1], m_Edge0[1] ) ),
+        _mm256_mul_ps( s1[2], m_Edge0[2] ) );
+    auto invDiv = _mm256_div_ps( _mm256_set1_ps( 1.0f ), div );
+
+    const b256 d[3] = {
+        _mm256_sub_ps( _mm256_set1_ps( ray.pos.x ), m_Vertex[0] ),
+        _mm256_sub_ps( _mm256_set1_ps( ray.pos.y ), m_Vertex[1] ),
+        _mm256_sub_ps( _mm256_set1_ps( ray.pos.z ), m_Vertex[2] ),
+    };
+
+    beta = _mm256_mul_ps( _mm256_add_ps( _mm256_add_ps(
+        _mm256_mul_ps( d[0], s1[0] ),
+        _mm256_mul_ps( d[1], s1[1] ) ),
+        _mm256_mul_ps( d[2], s1[2] ) ), invDiv );
+
+    // s2 = cross( d, edge0 ).
+    const b256 s2[3] = {
+        MulSub( d[1], m_Edge0[2], _mm256_mul_ps( d[2], m_Edge0[1] ) ),
+        MulSub( d[2], m_Edge0[0], _mm256_mul_ps( d[0], m_Edge0[2] ) ),
+        MulSub( d[0], m_Edge0[1], _mm256_mul_ps( d[1], m_Edge0[0] ) ),
+    };
+
+    gamma = _mm256_mul_ps( _mm256_add_ps( _mm256_add_ps(
+        _mm256_mul_ps( dir[0], s2[0] ),
+        _mm256_mul_ps( dir[1], s2[1] ) ),
+        _mm256_mul_ps( dir[2], s2[2] ) ), invDiv );
+
+    dist = _mm256_mul_ps( _mm256_add_ps( _mm256_add_ps(
+        _mm256_mul_ps( m_Edge1[0], s2[0] ),
+        _mm256_mul_ps( m_Edge1[1], s2[1] ) ),
+        _mm256_mul_ps( m_Edge1[2], s2[2] ) ), invDiv );
+
+    const auto zero = _mm256_setzero_ps();
+    const auto one  = _mm256_set1_ps( 1.0f );
+    const auto absDiv = _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), div );
+
+    auto mask = _mm256_cmp_ps( absDiv, _mm256_set1_ps( FLT_EPSILON ), _CMP_GT_OQ );
+    mask = _mm256_and_ps( mask, _mm256_cmp_ps( beta,  zero, _CMP_GT_OQ ) );
+    mask = _mm256_and_ps( mask, _mm256_cmp_ps( beta,  one,  _CMP_LT_OQ ) );
+    mask = _mm256_and_ps( mask, _mm256_cmp_ps( gamma, zero, _CMP_GT_OQ ) );
+    mask = _mm256_and_ps( mask, _mm256_cmp_ps( _mm256_add_ps( beta, gamma ), one, _CMP_LT_OQ ) );
+    mask = _mm256_and_ps( mask, _mm256_cmp_ps( dist, _mm256_set1_ps( F_HIT_MIN ), _CMP_GE_OQ ) );
+    mask = _mm256_and_ps( mask, _mm256_cmp_ps( dist, _mm256_set1_ps( Min( distance, F_HIT_MAX ) ), _CMP_LT_OQ ) );
+
+    return _mm256_movemask_ps( mask );
+}
+
+//-------------------------------------------------------------------------------------------------
+//      交差判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool Triangle8::IsHit(const RaySet& raySet, HitRecord& record) const
+{
+    b256 dist, beta, gamma;
+    auto mask = Intersect( raySet, record.distance, dist, beta, gamma );
+    if ( mask == 0 )
+    { return false; }
+
+    S3D_ALIGN(32) f32 t[8];
+    S3D_ALIGN(32) f32 b[8];
+    S3D_ALIGN(32) f32 g[8];
+    _mm256_store_ps( t, dist );
+    _mm256_store_ps( b, beta );
+    _mm256_store_ps( g, gamma );
+
+    // 最近接のレーンを求める.
+    auto lane = -1;
+    for(auto i=0; i<8; ++i)
+    {
+        if ( ( mask & ( 0x1 << i ) ) == 0 )
+        { continue; }
+
+        if ( lane < 0 || t[i] < t[lane] )
+        { lane = i; }
+    }
+
+    // 属性の補間は最近接の三角形のみ行う.
+    m_pTriangles[lane]->SetHitRecord( raySet, t[lane], b[lane], g[lane], record );
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      遮蔽判定を行います.
+//-------------------------------------------------------------------------------------------------
+bool Triangle8::IsOccluded(const RaySet& raySet, f32 distance) const
+{
+    b256 dist, beta, gamma;
+    return Intersect( raySet, distance, dist, beta, gamma ) != 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+//      バウンディングボックスを取得します.
+//-------------------------------------------------------------------------------------------------
+BoundingBox Triangle8::GetBox() const
+{ return m_Box; }
+
+//-------------------------------------------------------------------------------------------------
+//      中心座標を取得します.
+//-------------------------------------------------------------------------------------------------
+Vector3 Triangle8::GetCenter() const
+{ return m_Box.center; }
+
+//-------------------------------------------------------------------------------------------------
+//      new 演算子のオーバーロードです.
+//-------------------------------------------------------------------------------------------------
+void* Triangle8::operator new (size_t size)
+{ return _aligned_malloc(size, 32); }
+
+//-------------------------------------------------------------------------------------------------
+//      delete 演算子のオーバーロードです.
+//-------------------------------------------------------------------------------------------------
+void Triangle8::operator delete (void* ptr)
+{ _aligned_free(ptr); }
+
+//-------------------------------------------------------------------------------------------------
+//      生成処理を行います.
+//-------------------------------------------------------------------------------------------------
+IShape* Triangle8::Create(size_t count, IShape** ppShapes)
+{
+    if ( count == 0 || count > 8 || ppShapes == nullptr )
+    { return nullptr; }
+
+    ITriangle* pTriangles[8];
+    for(size_t i=0; i<count; ++i)
+    {
+        pTriangles[i] = dynamic_cast<ITriangle*>( ppShapes[i] );
+        if ( pTriangles[i] == nullptr )
+        { return nullptr; }
+    }
+
+    return new Triangle8( count, pTriangles );
+}
+
+} // namespace s3d
@@ -5,6 +5,7 @@
 //------------------------------------------------------------------------------------------
 
 #define _CRT_SECURE_NO_WARNINGS 1
+#define NOMINMAX
 
 //------------------------------------------------------------------------------------------
 // Includes
@@ -13,9 +14,15 @@
 #include <fstream>
 #include <cmath>
 #include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
 #include "OBJLoader.h"
 #include "SmdData.h"
 #include <cassert>
+#include <Windows.h>
 
 
 //------------------------------------------------------------------------------------------
@@ -268,6 +275,396 @@ OBJVEC3 OBJVEC3Min( OBJVEC3 v, OBJVEC3 _min )
     return result;
 }
 
+//------------------------------------------------------------------------
+// Name : ParallelFor()
+// Desc : [0, count) を分割して複数スレッドで処理します.
+//------------------------------------------------------------------------
+template<typename Func>
+void ParallelFor( size_t count, size_t minBlock, Func func )
+{
+    size_t threadCount = thread::hardware_concurrency();
+    if ( threadCount == 0 )
+    { threadCount = 1; }
+
+    //　少量の場合はスレッドを起動しない
+    size_t blockCount = ( count + minBlock - 1 ) / minBlock;
+    if ( blockCount < threadCount )
+    { threadCount = blockCount; }
+
+    if ( threadCount <= 1 )
+    {
+        func( 0, count );
+        return;
+    }
+
+    size_t step = ( count + threadCount - 1 ) / threadCount;
+
+    vector<thread> threads;
+    for( size_t i=1; i<threadCount; ++i )
+    {
+        size_t begin = i * step;
+        size_t end   = ( begin + step < count ) ? begin + step : count;
+        if ( begin >= end )
+        { break; }
+
+        threads.push_back( thread( func, begin, end ) );
+    }
+
+    func( 0, step );
+
+    for( size_t i=0; i<threads.size(); ++i )
+    { threads[i].join(); }
+}
+
+//------------------------------------------------------------------------
+// Name : SkipSpace()
+// Desc : 空白を読み飛ばします.
+//------------------------------------------------------------------------
+inline
+const char* SkipSpace( const char* p, const char* end )
+{
+    while( p < end && ( *p == ' ' || *p == '\t' ) )
+    { ++p; }
+    return p;
+}
+
+//------------------------------------------------------------------------
+// Name : SkipToken()
+// Desc : 空白または改行までを読み飛ばします.
+//------------------------------------------------------------------------
+inline
+const char* SkipToken( const char* p, const char* end )
+{
+    while( p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' )
+    { ++p; }
+    return p;
+}
+
+//------------------------------------------------------------------------
+// Name : ParseInt()
+// Desc : 整数を解析します. 数字が無い場合は false を返します.
+//------------------------------------------------------------------------
+inline
+bool ParseInt( const char*& p, const char* end, int& value )
+{
+    bool negative = false;
+    if ( p < end && ( *p == '-' || *p == '+' ) )
+    {
+        negative = ( *p == '-' );
+        ++p;
+    }
+
+    if ( p >= end || *p < '0' || *p > '9' )
+    { return false; }
+
+    long long result = 0;
+    while( p < end && '0' <= *p && *p <= '9' )
+    {
+        result = result * 10 + ( *p - '0' );
+        ++p;
+    }
+
+    value = static_cast<int>( negative ? -result : result );
+    return true;
+}
+
+//------------------------------------------------------------------------
+// Name : ParseFloat()
+// Desc : 浮動小数を解析します. strtod() よりも高速ですが, 指数表記を含む
+//        通常の10進表記のみに対応します.
+//------------------------------------------------------------------------
+inline
+float ParseFloat( const char*& p, const char* end )
+{
+    static const double POW10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p = SkipSpace( p, end );
+
+    bool negative = false;
+    if ( p < end && ( *p == '-' || *p == '+' ) )
+    {
+        negative = ( *p == '-' );
+        ++p;
+    }
+
+    //　仮数部を整数として読み込む (19桁を超えた分は指数で補正)
+    unsigned long long mantissa = 0;
+    int digits   = 0;
+    int exponent = 0;
+    while( p < end && '0' <= *p && *p <= '9' )
+    {
+        if ( digits < 19 ) { mantissa = mantissa * 10 + ( *p - '0' ); digits++; }
+        else               { exponent++; }
+        ++p;
+    }
+
+    if ( p < end && *p == '.' )
+    {
+        ++p;
+        while( p < end && '0' <= *p && *p <= '9' )
+        {
+            if ( digits < 19 ) { mantissa = mantissa * 10 + ( *p - '0' ); digits++; exponent--; }
+            ++p;
+        }
+    }
+
+    if ( p < end && ( *p == 'e' || *p == 'E' ) )
+    {
+        ++p;
+        int e = 0;
+        if ( ParseInt( p, end, e ) )
+        { exponent += e; }
+    }
+
+    double result = static_cast<double>( mantissa );
+    if      ( exponent < 0 && exponent >= -22 ) { result /= POW10[ -exponent ]; }
+    else if ( exponent > 0 && exponent <=  22 ) { result *= POW10[  exponent ]; }
+    else if ( exponent != 0 )                   { result *= pow( 10.0, exponent ); }
+
+    //　"nan" などの未対応の表記は読み飛ばす
+    p = SkipToken( p, end );
+
+    return static_cast<float>( negative ? -result : result );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// MAPPED_FILE structure
+//////////////////////////////////////////////////////////////////////////
+struct MAPPED_FILE
+{
+    HANDLE      hFile;          //!< ファイルハンドルです.
+    HANDLE      hMapping;       //!< ファイルマッピングハンドルです.
+    const char* pData;          //!< マップした先頭アドレスです.
+    size_t      size;           //!< ファイルサイズです.
+
+    MAPPED_FILE()
+    : hFile   ( INVALID_HANDLE_VALUE )
+    , hMapping( NULL )
+    , pData   ( NULL )
+    , size    ( 0 )
+    { /* DO_NOTHING */ }
+
+    ~MAPPED_FILE()
+    { Close(); }
+
+    bool Open( const char* filename )
+    {
+        hFile = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+        if ( hFile == INVALID_HANDLE_VALUE )
+        { return false; }
+
+        LARGE_INTEGER fileSize;
+        if ( !GetFileSizeEx( hFile, &fileSize ) || fileSize.QuadPart == 0 )
+        { return false; }
+        size = static_cast<size_t>( fileSize.QuadPart );
+
+        hMapping = CreateFileMappingA( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+        if ( hMapping == NULL )
+        { return false; }
+
+        pData = static_cast<const char*>( MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 ) );
+        return ( pData != NULL );
+    }
+
+    void Close()
+    {
+        if ( pData != NULL )                { UnmapViewOfFile( pData ); pData = NULL; }
+        if ( hMapping != NULL )             { CloseHandle( hMapping ); hMapping = NULL; }
+        if ( hFile != INVALID_HANDLE_VALUE ) { CloseHandle( hFile ); hFile = INVALID_HANDLE_VALUE; }
+        size = 0;
+    }
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// OBJCORNER structure
+//////////////////////////////////////////////////////////////////////////
+struct OBJCORNER
+{
+    int             position;   //!< 位置座標インデックスです(0基準, -1は指定なし).
+    int             texcoord;   //!< テクスチャ座標インデックスです(0基準, -1は指定なし).
+    int             normal;     //!< 法線ベクトルインデックスです(0基準, -1は指定なし).
+    unsigned char   relative;   //!< チャンク先頭からの相対インデックスかどうかのビットフラグです.
+};
+
+//////////////////////////////////////////////////////////////////////////
+// OBJUSEMTL structure
+//////////////////////////////////////////////////////////////////////////
+struct OBJUSEMTL
+{
+    unsigned int    faceIndex;  //!< チャンク内の三角形番号です.
+    string          name;       //!< マテリアル名です.
+};
+
+//////////////////////////////////////////////////////////////////////////
+// OBJCHUNK structure
+//////////////////////////////////////////////////////////////////////////
+struct OBJCHUNK
+{
+    const char*         begin;      //!< 解析範囲の先頭です.
+    const char*         end;        //!< 解析範囲の終端です.
+    vector<OBJVEC3>     positions;  //!< 位置座標です.
+    vector<OBJVEC3>     normals;    //!< 法線ベクトルです.
+    vector<OBJVEC2>     texcoords;  //!< テクスチャ座標です.
+    vector<OBJCORNER>   corners;    //!< 三角形分割済みの頂点です(3つで1面).
+    vector<OBJUSEMTL>   usemtls;    //!< マテリアル切り替えです.
+    vector<string>      mtllibs;    //!< マテリアルファイル名です.
+    OBJBOUNDINGBOX      box;        //!< バウンディングボックスです.
+    bool                initBox;    //!< バウンディングボックスの初期化フラグです.
+};
+
+//------------------------------------------------------------------------
+// Name : ParseCornerIndex()
+// Desc : 面の頂点インデックスを0基準に変換します. 負の値はチャンク内の
+//        要素数からの相対インデックスとして記録します.
+//------------------------------------------------------------------------
+inline
+int ParseCornerIndex( int value, size_t count, unsigned char bit, unsigned char& relative )
+{
+    if ( value > 0 )
+    { return value - 1; }
+
+    relative |= bit;
+    return static_cast<int>( count ) + value;
+}
+
+//------------------------------------------------------------------------
+// Name : ParseChunk()
+// Desc : チャンク内の行を解析します.
+//------------------------------------------------------------------------
+void ParseChunk( OBJCHUNK& chunk )
+{
+    const char* p   = chunk.begin;
+    const char* end = chunk.end;
+
+    chunk.initBox = false;
+
+    vector<OBJCORNER> polygon;
+
+    while( p < end )
+    {
+        const char* lineEnd = static_cast<const char*>( memchr( p, '\n', end - p ) );
+        if ( lineEnd == NULL )
+        { lineEnd = end; }
+
+        p = SkipSpace( p, lineEnd );
+        const char* token    = p;
+        p = SkipToken( p, lineEnd );
+        size_t      tokenLen = p - token;
+
+        //　頂点座標
+        if ( tokenLen == 1 && token[0] == 'v' )
+        {
+            OBJVEC3 v;
+            v.x = ParseFloat( p, lineEnd );
+            v.y = ParseFloat( p, lineEnd );
+            v.z = ParseFloat( p, lineEnd );
+            chunk.positions.push_back( v );
+
+            //　バウンディングボックスの算出
+            if ( !chunk.initBox )
+            {
+                chunk.box     = OBJBOUNDINGBOX( v );
+                chunk.initBox = true;
+            }
+            chunk.box.Merge( v );
+        }
+
+        //　テクスチャ座標
+        else if ( tokenLen == 2 && token[0] == 'v' && token[1] == 't' )
+        {
+            OBJVEC2 t;
+            t.x = ParseFloat( p, lineEnd );
+            t.y = ParseFloat( p, lineEnd );
+            chunk.texcoords.push_back( t );
+        }
+
+        //　法線ベクトル
+        else if ( tokenLen == 2 && token[0] == 'v' && token[1] == 'n' )
+        {
+            OBJVEC3 n;
+            n.x = ParseFloat( p, lineEnd );
+            n.y = ParseFloat( p, lineEnd );
+            n.z = ParseFloat( p, lineEnd );
+            chunk.normals.push_back( n );
+        }
+
+        //　面
+        else if ( tokenLen == 1 && token[0] == 'f' )
+        {
+            polygon.clear();
+
+            for( ;; )
+            {
+                p = SkipSpace( p, lineEnd );
+
+                int value = 0;
+                if ( !ParseInt( p, lineEnd, value ) )
+                { break; }
+
+                OBJCORNER corner;
+                corner.relative = 0;
+                corner.position = ParseCornerIndex( value, chunk.positions.size(), 0x1, corner.relative );
+                corner.texcoord = -1;
+                corner.normal   = -1;
+
+                if ( p < lineEnd && *p == '/' )
+                {
+                    ++p;
+
+                    //　テクスチャ座標インデックス
+                    if ( ParseInt( p, lineEnd, value ) )
+                    { corner.texcoord = ParseCornerIndex( value, chunk.texcoords.size(), 0x2, corner.relative ); }
+
+                    //　法線ベクトルインデックス
+                    if ( p < lineEnd && *p == '/' )
+                    {
+                        ++p;
+                        if ( ParseInt( p, lineEnd, value ) )
+                        { corner.normal = ParseCornerIndex( value, chunk.normals.size(), 0x4, corner.relative ); }
+                    }
+                }
+
+                polygon.push_back( corner );
+                p = SkipToken( p, lineEnd );
+            }
+
+            //　多角形は扇状に三角形分割する
+            for( size_t i=2; i<polygon.size(); ++i )
+            {
+                chunk.corners.push_back( polygon[ 0 ] );
+                chunk.corners.push_back( polygon[ i - 1 ] );
+                chunk.corners.push_back( polygon[ i ] );
+            }
+        }
+
+        //　マテリアルファイル
+        else if ( tokenLen == 6 && memcmp( token, "mtllib", 6 ) == 0 )
+        {
+            p = SkipSpace( p, lineEnd );
+            chunk.mtllibs.push_back( string( p, SkipToken( p, lineEnd ) ) );
+        }
+
+        //　マテリアル
+        else if ( tokenLen == 6 && memcmp( token, "usemtl", 6 ) == 0 )
+        {
+            p = SkipSpace( p, lineEnd );
+
+            OBJUSEMTL usemtl;
+            usemtl.faceIndex = static_cast<unsigned int>( chunk.corners.size() / 3 );
+            usemtl.name      = string( p, SkipToken( p, lineEnd ) );
+            chunk.usemtls.push_back( usemtl );
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 // OBJVEC2
 //////////////////////////////////////////////////////////////////////////
@@ -421,287 +818,258 @@ void OBJMESH::Release()
 //-----------------------------------------------------------------------
 bool OBJMESH::LoadOBJFile(const char *filename)
 {
-    ifstream file;
-
     m_IsExistNormal   = false;
     m_IsExistTexCoord = false;
 
-    char mtlFileName[OBJ_NAME_LENGTH] = {0};
-    char buf[OBJ_BUFFER_LENGTH] = {0};
-    vector<OBJVEC3>      positions;
-    vector<OBJVEC3>      normals;
-    vector<OBJVEC2>      texcoords;
-    vector<OBJVERTEX>    t_vertices;
-    vector<OBJSUBSET>    t_subsets;
-    vector<unsigned int> t_indices;
-    bool initBox = false;
-    int prevSize = 0;
-
-    unsigned long total = 0;
-
-    OBJMATERIAL  material;
-    unsigned int dwFaceIndex = 0;
-    unsigned int dwFaceCount = 0;
-    unsigned int dwCurSubset = 0;
-
     //　ディレクトリを切り取り
     strcpy_s( m_directoryPath, GetDirectoryPath( filename ) );
 
-    //　ファイルを開く
-    file.open( filename, ios::in );
-
-    //　チェック
-    if ( !file.is_open() )
+    //　ファイルをメモリにマップする
+    MAPPED_FILE file;
+    if ( !file.Open( filename ) )
     {
         cerr << "Error : ファイルオープンに失敗\n";
         cerr << "File Name : " << filename << endl;
         return false;
     }
 
-    bool isOptimize = false;
+    //　行単位でチャンクに分割する
+    size_t threadCount = thread::hardware_concurrency();
+    if ( threadCount == 0 )
+    { threadCount = 1; }
 
-    //　ループ
-    for( ;; )
-    {
-        file >> buf;
-        if ( !file )
-            break;
+    const size_t MIN_CHUNK_SIZE = 1024 * 1024;
+    size_t chunkCount = threadCount * 4;
+    if ( file.size / chunkCount < MIN_CHUNK_SIZE )
+    { chunkCount = ( file.size + MIN_CHUNK_SIZE - 1 ) / MIN_CHUNK_SIZE; }
 
-        //　コメント
-        if ( 0 == strcmp( buf, "#" ) )
+    vector<OBJCHUNK> chunks( chunkCount );
+    {
+        const char* fileEnd = file.pData + file.size;
+        const char* cursor  = file.pData;
+        for( size_t i=0; i<chunkCount; ++i )
         {
+            const char* end = file.pData + ( file.size * ( i + 1 ) ) / chunkCount;
+            if ( end < cursor )
+            { end = cursor; }
+
+            //　行の途中で分割しないように改行まで進める
+            const char* lineEnd = static_cast<const char*>( memchr( end, '\n', fileEnd - end ) );
+            end = ( lineEnd != NULL ) ? lineEnd + 1 : fileEnd;
+
+            chunks[i].begin = cursor;
+            chunks[i].end   = end;
+            cursor = end;
         }
+    }
 
-        //　頂点座標
-        else if ( 0 == strcmp( buf, "v" ) )
+    //　チャンクを並列に解析
+    ParallelFor( chunkCount, 1, [&]( size_t begin, size_t end )
+    {
+        for( size_t i=begin; i<end; ++i )
+        { ParseChunk( chunks[i] ); }
+    });
+
+    //　チャンクごとの先頭番号を求める
+    vector<size_t> positionBase( chunkCount );
+    vector<size_t> normalBase  ( chunkCount );
+    vector<size_t> texcoordBase( chunkCount );
+    vector<size_t> cornerBase  ( chunkCount );
+    size_t numPositions = 0;
+    size_t numNormals   = 0;
+    size_t numTexCoords = 0;
+    size_t numCorners   = 0;
+    bool   initBox      = false;
+    for( size_t i=0; i<chunkCount; ++i )
+    {
+        positionBase[i] = numPositions;
+        normalBase  [i] = numNormals;
+        texcoordBase[i] = numTexCoords;
+        cornerBase  [i] = numCorners;
+
+        numPositions += chunks[i].positions.size();
+        numNormals   += chunks[i].normals  .size();
+        numTexCoords += chunks[i].texcoords.size();
+        numCorners   += chunks[i].corners  .size();
+
+        //　バウンディングボックスの算出
+        if ( chunks[i].initBox )
         {
-            float x, y, z;
-            file >> x >> y >> z;
-            OBJVEC3 v( x, y, z );
-            positions.push_back( v );
-
-            //　バウンディングボックスの初期化
             if ( !initBox )
             {
-                m_Box = OBJBOUNDINGBOX( v );
+                m_Box   = chunks[i].box;
                 initBox = true;
             }
-
-            //　バウンディングボックスの算出
-            m_Box.Merge( v );
-        }
-
-        //　テクスチャ座標
-        else if ( 0 == strcmp( buf, "vt" ) )
-        {
-            float u, v;
-            file >> u >> v;
-            texcoords.push_back( OBJVEC2( u, v ) );
-        }
-
-        //　法線ベクトル
-        else if ( 0 == strcmp( buf, "vn" ) )
-        {
-            float x, y, z;
-            file >> x >> y >> z;
-            normals.push_back( OBJVEC3( x, y, z) );
+            m_Box.Merge( chunks[i].box.minimum );
+            m_Box.Merge( chunks[i].box.maximum );
         }
+    }
 
-        //　面
-        else if ( 0 == strcmp( buf, "f" ) )
+    //　マテリアルファイルの読み込み
+    for( size_t i=0; i<chunkCount; ++i )
+    {
+        for( size_t j=0; j<chunks[i].mtllibs.size(); ++j )
         {
-            if ( !isOptimize )
-            {
-                size_t size = positions.size();
-                positions.resize( size );
-
-                size = texcoords.size();
-                texcoords.resize( size );
-
-                size = normals.size();
-                normals.resize( size );
-
-                isOptimize = true;
-            }
-
-            unsigned int iPosition, iTexCoord, iNormal;
-            unsigned int p[4] = {-1}, t[4] = {-1}, n[4] = {-1};
-            OBJVERTEX vertex;
-            dwFaceIndex++;
-            dwFaceCount++;
-            int count = 0;
-            unsigned int index = 0;
-        
-            //　三角形・四角形のみ対応
-            for ( int iFace = 0; iFace < 4; iFace++ )
-            {
-                count++;    //　頂点数を数える
-                ZeroMemory( &vertex, sizeof( OBJVERTEX ) );
-
-                file >> iPosition;
-                vertex.position = positions[ iPosition - 1 ];
-                p[iFace] = iPosition -1;
-                
-                if ( '/' == file.peek() )
-                {
-                    file.ignore();
-
-                    //　テクスチャ座標インデックス
-                    if ( '/' != file.peek() )
-                    {
-                        file >> iTexCoord;
-                        vertex.texcoord = texcoords[ iTexCoord - 1 ];
-                        t[iFace] = iTexCoord -1;
-                    }
-
-                    //　法線ベクトルインデックス
-                    if ( '/' == file.peek() )
-                    {
-                        file.ignore();
-
-                        file >> iNormal;
-                        vertex.normal = normals[ iNormal - 1 ];
-                        n[iFace] = iNormal -1;
-                    }
-                }
-
-                //　カウントが3未満
-                if ( iFace < 3 )
-                {
-                    t_vertices.push_back( vertex );
-                    index = t_vertices.size()-1;
-                    t_indices.push_back( index );
-                }
-
-                //　次が改行だったら終了
-                if ( ( '\n' == file.peek() )
-                  || ( '\r' == file.peek() ) )
-                {
-                    break;
-                }
+            char mtlFileName[OBJ_NAME_LENGTH] = {0};
+            strncpy( mtlFileName, chunks[i].mtllibs[j].c_str(), OBJ_NAME_LENGTH - 1 );
+            if ( !mtlFileName[0] )
+            { continue; }
 
-            }
+            SAFE_DELETE_ARRAY( m_Materials );
+            m_NumMaterials = 0;
 
-            //　四角形ポリゴンの場合，三角形を追加する
-            if ( count > 3 )
+            if ( !LoadMTLFile( SetDirectoryPath(mtlFileName, m_directoryPath) ) )
             {
-                //　カウント
-                dwFaceIndex++;
-                dwFaceCount++;
-
-                //　頂点とインデックスを追加
-                for ( int iFace = 1; iFace < 4; iFace++ )
-                {
-                    int j = (iFace+1)%4;
-                    ZeroMemory( &vertex, sizeof( OBJVERTEX ) );
-
-                    if ( p[j] != -1 ) vertex.position = positions[ p[j] ];
-                    if ( t[j] != -1 ) vertex.texcoord = texcoords[ t[j] ];
-                    if ( n[j] != -1 ) vertex.normal   = normals[ n[j] ];
-
-                    t_vertices.push_back( vertex );
-                    index = t_vertices.size() - 1;
-                    t_indices.push_back( index );
-                }
-
+                cerr << "Error : マテリアルのロードに失敗\n";
+                return false;
             }
         }
+    }
 
-        //　マテリアルファイル
-        else if ( 0 == strcmp( buf, "mtllib" ) )
+    //　サブセットを構築 (最初の usemtl より前の面はマテリアル0 とする)
+    vector<OBJSUBSET> t_subsets;
+    unsigned int dwCurSubset = 0;
+    for( size_t i=0; i<chunkCount; ++i )
+    {
+        for( size_t j=0; j<chunks[i].usemtls.size(); ++j )
         {
-            file >> mtlFileName;
-            //　マテリアルファイルの読み込み
-            if ( mtlFileName[0] )
+            const OBJUSEMTL& usemtl = chunks[i].usemtls[j];
+
+            for ( unsigned int k = 0; k < m_NumMaterials; k++ )
             {
-                if ( !LoadMTLFile( SetDirectoryPath(mtlFileName, m_directoryPath) ) )
+                if ( 0 == strcmp( m_Materials[k].name, usemtl.name.c_str() ) )
                 {
-                    cerr << "Error : マテリアルのロードに失敗\n";
-                    return false;
+                    dwCurSubset = k;
+                    break;
                 }
             }
-        }
 
-        //　マテリアル
-        else if ( 0 == strcmp( buf, "usemtl" ) )
-        {
-            char strName[OBJ_NAME_LENGTH] = {0};
-            file >> strName;
             OBJSUBSET subset;
-            subset.faceCount = 1;
+            subset.materialIndex = dwCurSubset;
+            subset.faceStart     = static_cast<unsigned int>( cornerBase[i] + usemtl.faceIndex * 3 );
+            subset.faceCount     = 0;
 
-            for ( unsigned int i = 0; i < m_NumMaterials; i++ )
+            if ( t_subsets.empty() && subset.faceStart > 0 )
             {
-                if ( 0 == strcmp( m_Materials[i].name, strName ) )
-                {
-                    dwCurSubset = i;
-                    break;
-                }
+                OBJSUBSET first;
+                first.materialIndex = 0;
+                first.faceStart     = 0;
+                first.faceCount     = 0;
+                t_subsets.push_back( first );
             }
 
-            subset.materialIndex = dwCurSubset;
-            subset.faceStart     = dwFaceIndex*3;
-            prevSize             = t_subsets.size();
             t_subsets.push_back( subset );
-            if ( t_subsets.size() > 1 )
-            {
-                t_subsets[prevSize-1].faceCount = dwFaceCount*3;
-                dwFaceCount = 0;
-            }
         }
-
-        file.ignore( OBJ_BUFFER_LENGTH, '\n' );
     }
 
-    //　サブセット
-    if ( t_subsets.size() > 0 )
+    if ( t_subsets.empty() && numCorners > 0 )
     {
-        int maxSize = t_subsets.size();
-        t_subsets[maxSize-1].faceCount = dwFaceCount*3;
+        OBJSUBSET subset;
+        subset.materialIndex = 0;
+        subset.faceStart     = 0;
+        subset.faceCount     = 0;
+        t_subsets.push_back( subset );
     }
 
-    //　ファイルを閉じる
-    file.close();
-
-    m_NumVertices = t_vertices.size();
-    t_vertices.resize( m_NumVertices );
-
-    m_NumSubsets = t_subsets.size();
-    t_subsets.resize( m_NumSubsets );
+    for( size_t i=0; i<t_subsets.size(); ++i )
+    {
+        unsigned int next = ( i + 1 < t_subsets.size() )
+                          ? t_subsets[i + 1].faceStart
+                          : static_cast<unsigned int>( numCorners );
+        t_subsets[i].faceCount = next - t_subsets[i].faceStart;
+    }
 
-    m_NumIndices = t_indices.size();
-    t_indices.resize( m_NumIndices );
+    //　頂点・インデックスデータを確保
+    m_NumVertices = static_cast<unsigned int>( numCorners );
+    m_NumIndices  = static_cast<unsigned int>( numCorners );
+    m_NumSubsets  = static_cast<unsigned int>( t_subsets.size() );
 
-    //　頂点データをコピー
-    m_Vertices = new OBJVERTEX[ m_NumVertices ];
-    for ( unsigned int i = 0; i<m_NumVertices; i++ )
-    { m_Vertices[i] = t_vertices[i]; }
+    m_Vertices = new OBJVERTEX   [ m_NumVertices ];
+    m_Indices  = new unsigned int[ m_NumIndices ];
+    m_Subsets  = new OBJSUBSET   [ m_NumSubsets ];
 
     //　サブセットデータをコピー
-    m_Subsets = new OBJSUBSET[ m_NumSubsets ];
     for ( unsigned int i =0; i<m_NumSubsets; i++ )
     { m_Subsets[i] = t_subsets[i]; }
 
-    //　インデックスデータをコピー
-    m_Indices = new unsigned int [ m_NumIndices ];
-    for ( unsigned int i = 0; i<m_NumIndices; i++ )
-    { m_Indices[i] = t_indices[i]; }
+    //　チャンクの頂点属性をファイル全体の配列にまとめる
+    vector<OBJVEC3> positions( numPositions );
+    vector<OBJVEC3> normals  ( numNormals );
+    vector<OBJVEC2> texcoords( numTexCoords );
+    ParallelFor( chunkCount, 1, [&]( size_t begin, size_t end )
+    {
+        for( size_t i=begin; i<end; ++i )
+        {
+            copy( chunks[i].positions.begin(), chunks[i].positions.end(), positions.begin() + positionBase[i] );
+            copy( chunks[i].normals  .begin(), chunks[i].normals  .end(), normals  .begin() + normalBase  [i] );
+            copy( chunks[i].texcoords.begin(), chunks[i].texcoords.end(), texcoords.begin() + texcoordBase[i] );
+        }
+    });
+
+    //　インデックスを解決して頂点データを並列に設定
+    atomic<bool> isValid( true );
+    ParallelFor( chunkCount, 1, [&]( size_t begin, size_t end )
+    {
+        for( size_t i=begin; i<end; ++i )
+        {
+            const OBJCHUNK& chunk = chunks[i];
+            for( size_t j=0; j<chunk.corners.size(); ++j )
+            {
+                const OBJCORNER& corner = chunk.corners[j];
+                size_t    index  = cornerBase[i] + j;
+                OBJVERTEX vertex;
+                ZeroMemory( &vertex, sizeof( OBJVERTEX ) );
+
+                //　負のインデックスはチャンク先頭を基準にファイル全体の番号に変換
+                long long p = corner.position + ( ( corner.relative & 0x1 ) ? static_cast<long long>( positionBase[i] ) : 0 );
+                long long t = corner.texcoord + ( ( corner.relative & 0x2 ) ? static_cast<long long>( texcoordBase[i] ) : 0 );
+                long long n = corner.normal   + ( ( corner.relative & 0x4 ) ? static_cast<long long>( normalBase  [i] ) : 0 );
+
+                if ( 0 <= p && p < static_cast<long long>( numPositions ) )
+                { vertex.position = positions[ static_cast<size_t>( p ) ]; }
+                else
+                { isValid = false; }
+
+                if ( 0 <= t && t < static_cast<long long>( numTexCoords ) )
+                { vertex.texcoord = texcoords[ static_cast<size_t>( t ) ]; }
+                else if ( corner.texcoord != -1 || ( corner.relative & 0x2 ) )
+                { isValid = false; }
+
+                if ( 0 <= n && n < static_cast<long long>( numNormals ) )
+                { vertex.normal = normals[ static_cast<size_t>( n ) ]; }
+                else if ( corner.normal != -1 || ( corner.relative & 0x4 ) )
+                { isValid = false; }
+
+                m_Vertices[ index ] = vertex;
+                m_Indices [ index ] = static_cast<unsigned int>( index );
+            }
+        }
+    });
+
+    //　ファイルを閉じる
+    file.Close();
+    chunks.clear();
+
+    if ( !isValid )
+    {
+        cerr << "Error : 不正な頂点インデックスが含まれています\n";
+        cerr << "File Name : " << filename << endl;
+        return false;
+    }
 
     //　バウンディングスフィアの作成
     m_Sphere.Create( m_Box );
 
-    if ( normals.size() != 0 )
+    if ( numNormals != 0 )
     { m_IsExistNormal = true; }
-    if ( texcoords.size() != 0 )
+    if ( numTexCoords != 0 )
     { m_IsExistTexCoord = true; }
 
     //　メモリ破棄
     positions .clear();
     normals   .clear();
     texcoords .clear();
-    t_vertices.clear();
     t_subsets .clear();
-    t_indices .clear();
 
     if ( !m_IsExistNormal )
     {
@@ -918,103 +1286,106 @@ bool OBJMESH::ComputeNormal()
     if ( m_IsExistNormal )
     { return true; }
 
+    unsigned int numFaces = m_NumIndices / 3;
+
     OBJVEC3* pVertexNormal = new OBJVEC3 [ m_NumVertices ];
-    if ( pVertexNormal == nullptr )
+    OBJVEC3* pFaceNormal   = new OBJVEC3 [ numFaces ];
+    if ( pVertexNormal == nullptr || pFaceNormal == nullptr )
     {
         printf_s( "Error : Memory Allocate Failed.\n" );
+        delete [] pVertexNormal;
+        delete [] pFaceNormal;
         return false;
     }
 
+    const size_t BLOCK_SIZE = 4096;
+
     // 法線データを初期化.
-    for( unsigned int i=0; i<m_NumVertices; ++i )
+    ParallelFor( m_NumVertices, BLOCK_SIZE, [&]( size_t begin, size_t end )
     {
-        m_Vertices[ i ].normal.x = 0.0f;
-        m_Vertices[ i ].normal.y = 0.0f;
-        m_Vertices[ i ].normal.z = 0.0f;
+        for( size_t i=begin; i<end; ++i )
+        {
+            m_Vertices[ i ].normal.x = 0.0f;
+            m_Vertices[ i ].normal.y = 0.0f;
+            m_Vertices[ i ].normal.z = 0.0f;
 
-        pVertexNormal[ i ].x = 0.0f;
-        pVertexNormal[ i ].y = 0.0f;
-        pVertexNormal[ i ].z = 0.0f;
-    }
+            pVertexNormal[ i ].x = 0.0f;
+            pVertexNormal[ i ].y = 0.0f;
+            pVertexNormal[ i ].z = 0.0f;
+        }
+    });
 
-    for( unsigned int i=0; i<m_NumIndices; i+=3 )
+    // 面法線を算出.
+    ParallelFor( numFaces, BLOCK_SIZE, [&]( size_t begin, size_t end )
     {
-        unsigned int i0 = m_Indices[ i + 0 ];
-        unsigned int i1 = m_Indices[ i + 1 ];
-        unsigned int i2 = m_Indices[ i + 2 ];
-
-        OBJVEC3 p0 = m_Vertices[ i0 ].position;
-        OBJVEC3 p1 = m_Vertices[ i1 ].position;
-        OBJVEC3 p2 = m_Vertices[ i2 ].position;
-
-        OBJVEC3 e0 = Vec3Sub( p1, p0 );
-        OBJVEC3 e1 = Vec3Sub( p2, p0 );
+        for( size_t i=begin; i<end; ++i )
+        {
+            OBJVEC3 p0 = m_Vertices[ m_Indices[ i * 3 + 0 ] ].position;
+            OBJVEC3 p1 = m_Vertices[ m_Indices[ i * 3 + 1 ] ].position;
+            OBJVEC3 p2 = m_Vertices[ m_Indices[ i * 3 + 2 ] ].position;
 
-        // 面法線を算出.
-        OBJVEC3 n = Vec3Cross( e0, e1 );
-        OBJVEC3 normal = Vec3SafeNormalize( n );
+            OBJVEC3 e0 = Vec3Sub( p1, p0 );
+            OBJVEC3 e1 = Vec3Sub( p2, p0 );
 
-        // 面法線を加算.
-        pVertexNormal[ i0 ].x += normal.x;
-        pVertexNormal[ i0 ].y += normal.y;
-        pVertexNormal[ i0 ].z += normal.z;
+            OBJVEC3 n = Vec3Cross( e0, e1 );
+            pFaceNormal[ i ] = Vec3SafeNormalize( n );
+        }
+    });
 
-        pVertexNormal[ i1 ].x += normal.x;
-        pVertexNormal[ i1 ].y += normal.y;
-        pVertexNormal[ i1 ].z += normal.z;
+    // 面法線を加算 (頂点を共有する面があるため逐次処理).
+    for( unsigned int i=0; i<numFaces; ++i )
+    {
+        const OBJVEC3& normal = pFaceNormal[ i ];
 
-        pVertexNormal[ i2 ].x += normal.x;
-        pVertexNormal[ i2 ].y += normal.y;
-        pVertexNormal[ i2 ].z += normal.z;
+        for( unsigned int j=0; j<3; ++j )
+        {
+            unsigned int idx = m_Indices[ i * 3 + j ];
+            pVertexNormal[ idx ].x += normal.x;
+            pVertexNormal[ idx ].y += normal.y;
+            pVertexNormal[ idx ].z += normal.z;
+        }
     }
 
     // 加算した法線を正規化し，頂点法線を求める.
-    for( unsigned int i=0; i<m_NumVertices; ++i )
+    ParallelFor( m_NumVertices, BLOCK_SIZE, [&]( size_t begin, size_t end )
     {
-        OBJVEC3 n = Vec3SafeNormalize( pVertexNormal[ i ] );
-        pVertexNormal[ i ] = n;
-    }
+        for( size_t i=begin; i<end; ++i )
+        {
+            OBJVEC3 n = Vec3SafeNormalize( pVertexNormal[ i ] );
+            pVertexNormal[ i ] = n;
+        }
+    });
 
     const float SMOOTHING_ANGLE = 59.7f;
-    float cosSmooth = cosf( DegToRad( SMOOTHING_ANGLE ) );
-
-    // スムージング処理
-    for( unsigned int i=0; i<m_NumIndices; i+=3 )
-    {
-        unsigned int i0 = m_Indices[ i + 0 ];
-        unsigned int i1 = m_Indices[ i + 1 ];
-        unsigned int i2 = m_Indices[ i + 2 ];
-
-        OBJVEC3 p0 = m_Vertices[ i0 ].position;
-        OBJVEC3 p1 = m_Vertices[ i1 ].position;
-        OBJVEC3 p2 = m_Vertices[ i2 ].position;
-
-        OBJVEC3 e0 = Vec3Sub( p1, p0 );
-        OBJVEC3 e1 = Vec3Sub( p2, p0 );
-
-        // 面法線を算出.
-        OBJVEC3 n = Vec3Cross( e0, e1 );
-        OBJVEC3 faceNormal = Vec3SafeNormalize( n );
+    float cosSmooth = cosf( DegToRad( SMOOTHING_ANGLE ) );
 
-        // 頂点法線と面法線のなす角度を算出.
-        float cosAngle0 = Vec3Dot( pVertexNormal[ i0 ], faceNormal );
-        float cosAngle1 = Vec3Dot( pVertexNormal[ i1 ], faceNormal );
-        float cosAngle2 = Vec3Dot( pVertexNormal[ i2 ], faceNormal );
+    // スムージング処理.
+    // LoadOBJFile() は面の角ごとに頂点を生成するため, 書き込み先の頂点は面間で重複しない.
+    ParallelFor( numFaces, BLOCK_SIZE, [&]( size_t begin, size_t end )
+    {
+        for( size_t i=begin; i<end; ++i )
+        {
+            const OBJVEC3& faceNormal = pFaceNormal[ i ];
 
-        // スムージング処理.
-        if ( cosAngle0 >= cosSmooth ) { m_Vertices[ i0 ].normal = pVertexNormal[ i0 ]; }
-        else                          { m_Vertices[ i0 ].normal = faceNormal; }
+            for( unsigned int j=0; j<3; ++j )
+            {
+                unsigned int idx = m_Indices[ i * 3 + j ];
 
-        if( cosAngle1 >= cosSmooth )  { m_Vertices[ i1 ].normal = pVertexNormal[ i1 ]; }
-        else                          { m_Vertices[ i1 ].normal = faceNormal; }
+                // 頂点法線と面法線のなす角度を算出.
+                float cosAngle = Vec3Dot( pVertexNormal[ idx ], faceNormal );
 
-        if ( cosAngle2 >= cosSmooth ) { m_Vertices[ i2 ].normal = pVertexNormal[ i2 ]; }
-        else                          { m_Vertices[ i2 ].normal = faceNormal; }
-    }
+                if ( cosAngle >= cosSmooth ) { m_Vertices[ idx ].normal = pVertexNormal[ idx ]; }
+                else                         { m_Vertices[ idx ].normal = faceNormal; }
+            }
+        }
+    });
 
     delete [] pVertexNormal;
     pVertexNormal = nullptr;
 
+    delete [] pFaceNormal;
+    pFaceNormal = nullptr;
+
     // 法線存在フラグを立てる.
     m_IsExistNormal = true;
 
@@ -1290,16 +1661,15 @@ OBJBOUNDINGSPHERE OBJMESH::GetSphere()
 
 
 //-----------------------------------------------------------------------
-// Name : WriteDirect()
-// Desc : 最適化せず直接バイナリ書き込みをします.
+// Name : BuildTextureList()
+// Desc : マテリアルが参照するテクスチャファイル名リストを生成します.
 //-----------------------------------------------------------------------
-void OBJMESH::WriteDirect( FILE* pFile )
+void BuildTextureList( const OBJMATERIAL* pMaterials, unsigned int numMaterials, vector<SMD_TEXTURE>& textureList )
 {
-    // テクスチャファイル名リストを生成します.
-    std::vector<SMD_TEXTURE> textureList;
+    textureList.clear();
 
     // マテリアル数だけループします.
-    for (size_t i = 0; i<m_NumMaterials; ++i)
+    for (size_t i = 0; i<numMaterials; ++i)
     {
         // 発見フラグをOFF.
         bool isFind = false;
@@ -1308,7 +1678,7 @@ void OBJMESH::WriteDirect( FILE* pFile )
         for (size_t j = 0; j<textureList.size(); ++j)
         {
             // 格納済みかチェック.
-            if (strcmp(textureList[j].filename, m_Materials[i].diffuseMapName) == 0)
+            if (strcmp(textureList[j].filename, pMaterials[i].diffuseMapName) == 0)
             {
                 // 発見フラグON.
                 isFind = true;
@@ -1319,262 +1689,443 @@ void OBJMESH::WriteDirect( FILE* pFile )
         }
 
         // 発見されていなければ追加する.
-        if (!isFind && (strcmp(m_Materials[i].diffuseMapName, "\0") != 0) )
+        if (!isFind && (strcmp(pMaterials[i].diffuseMapName, "\0") != 0) )
         {
             // データ設定.
             SMD_TEXTURE texture;
-            strcpy(texture.filename, m_Materials[i].diffuseMapName);
+            strcpy(texture.filename, pMaterials[i].diffuseMapName);
 
             // 末尾に格納.
             textureList.push_back(texture);
         }
     }
+}
 
-    // メモリサイズを最適化する.
-    if (textureList.size() > 0)
+//-----------------------------------------------------------------------
+// Name : FindTexture()
+// Desc : テクスチャファイル名リストからインデックスを求めます.
+//-----------------------------------------------------------------------
+int FindTexture( const vector<SMD_TEXTURE>& textureList, const char* filename )
+{
+    for( size_t j=0; j<textureList.size(); ++j )
     {
-        size_t size = textureList.size();
-        textureList.resize(size);
+        // リストに登録されているかチェック.
+        if ( strcmp( textureList[j].filename, filename ) == 0 )
+        { return static_cast<int>( j ); }
     }
 
-    // データヘッダーを設定.
-    SMD_DATA_HEADER dataHeader;
-    dataHeader.numTriangles = m_NumIndices / 3;
-    dataHeader.numMaterials = m_NumMaterials;
-    dataHeader.numTextures = (unsigned int)textureList.size();
-    dataHeader.triangleStructureSize = SMD_TRIANGLE_STRUCT_SIZE;
-    dataHeader.materialStructureSize = SMD_MATERIAL_STRUCT_SIZE;
-    dataHeader.textureStructureSize  = SMD_TEXTURE_STRUCT_SIZE;
+    return -1;
+}
 
-    // ファイルヘッダーを設定.
-    SMD_FILE_HEADER fileHeader;
-    memcpy( &fileHeader.magic, SMD_MAGIC, sizeof( unsigned char ) * 4 );
-    fileHeader.version        = SMD_VERSION;
-    fileHeader.dataHeaderSize = SMD_DATA_HEADER_SIZE;
-    fileHeader.dataHeader     = dataHeader;
+//-----------------------------------------------------------------------
+// Name : SetupMaterial()
+// Desc : OBJマテリアルからSMDマテリアルを設定します.
+//-----------------------------------------------------------------------
+void SetupMaterial( const OBJMATERIAL& material, const vector<SMD_TEXTURE>& textureList, SMD_MATERIAL& value )
+{
+    memset( &value, 0, sizeof( value ) );
+    value.type = material.materialType;
 
-#if 0
-    //printf_s( "File Version  = 0x%08x\n", fileHeader.version );
-    //printf_s( "Num Vertices  = %d\n", dataHeader.numVertices );
-    //printf_s( "Num Indices   = %d\n", dataHeader.numIndices );
-    //printf_s( "Num Materials = %d\n", dataHeader.numMaterials );
-    //printf_s( "Num Subsets   = %d\n", dataHeader.numSubsets );
-#endif
+    switch( material.materialType )
+    {
+    // Lambert
+    case SMD_MATERIAL_TYPE_MATTE:
+        {
+            value.matte.color.x = material.diffuse.x;
+            value.matte.color.y = material.diffuse.y;
+            value.matte.color.z = material.diffuse.z;
 
-    // ヘッダーを書き込み.
-    fwrite( &fileHeader, sizeof( SMD_FILE_HEADER ), 1, pFile );
+            value.matte.emissive.x = material.emissive.x;
+            value.matte.emissive.y = material.emissive.y;
+            value.matte.emissive.z = material.emissive.z;
 
-    // テクスチャファイル名を書き込む.
-    for( size_t j=0; j<textureList.size(); ++j )
+            value.matte.colorMap = FindTexture( textureList, material.diffuseMapName );
+        }
+        break;
+
+    // Perfect Specular
+    case SMD_MATERIAL_TYPE_MIRROR:
+        {
+            value.mirror.color.x = material.diffuse.x;
+            value.mirror.color.y = material.diffuse.y;
+            value.mirror.color.z = material.diffuse.z;
+
+            value.mirror.emissive.x = material.emissive.x;
+            value.mirror.emissive.y = material.emissive.y;
+            value.mirror.emissive.z = material.emissive.z;
+
+            value.mirror.colorMap = FindTexture( textureList, material.diffuseMapName );
+        }
+        break;
+
+    // Dielectric
+    case SMD_MATERIAL_TYPE_DIELECTRIC:
+        {
+            value.dielectric.color.x = material.specular.x;
+            value.dielectric.color.y = material.specular.y;
+            value.dielectric.color.z = material.specular.z;
+
+            value.dielectric.emissive.x = material.emissive.x;
+            value.dielectric.emissive.y = material.emissive.y;
+            value.dielectric.emissive.z = material.emissive.z;
+
+            value.dielectric.ior = material.ior;
+
+            value.dielectric.colorMap = FindTexture( textureList, material.specularMapName );
+        }
+        break;
+
+    // Phong
+    case SMD_MATERIAL_TYPE_GLOSSY:
+        {
+            value.glossy.color.x = material.specular.x;
+            value.glossy.color.y = material.specular.y;
+            value.glossy.color.z = material.specular.z;
+
+            value.glossy.power = material.shininess;
+
+            value.glossy.emissive.x = material.emissive.x;
+            value.glossy.emissive.y = material.emissive.y;
+            value.glossy.emissive.z = material.emissive.z;
+
+            value.glossy.colorMap = FindTexture( textureList, material.specularMapName );
+        }
+        break;
+
+    // Lambert + Diffuse
+    case SMD_MATERILA_TYPE_PLASTIC:
+        {
+            value.plastic.diffuse.x = material.diffuse.x;
+            value.plastic.diffuse.y = material.diffuse.y;
+            value.plastic.diffuse.z = material.diffuse.z;
+
+            value.plastic.specular.x = material.specular.x;
+            value.plastic.specular.y = material.specular.y;
+            value.plastic.specular.z = material.specular.z;
+
+            value.plastic.power = material.shininess;
+
+            value.plastic.emissive.x = material.emissive.x;
+            value.plastic.emissive.y = material.emissive.y;
+            value.plastic.emissive.z = material.emissive.z;
+
+            value.plastic.diffuseMap  = FindTexture( textureList, material.diffuseMapName );
+            value.plastic.specularMap = FindTexture( textureList, material.specularMapName );
+        }
+        break;
+    }
+}
+
+//-----------------------------------------------------------------------
+// Name : GetMaterialParamSize()
+// Desc : マテリアルタイプごとのパラメータサイズを取得します.
+//-----------------------------------------------------------------------
+size_t GetMaterialParamSize( int type )
+{
+    switch( type )
     {
-        SMD_TEXTURE texture = textureList[j];
-        fwrite( &texture, sizeof( SMD_TEXTURE ), 1, pFile );
+    case SMD_MATERIAL_TYPE_MATTE:       return sizeof( SMD_MATTE );
+    case SMD_MATERIAL_TYPE_MIRROR:      return sizeof( SMD_MIRROR );
+    case SMD_MATERIAL_TYPE_DIELECTRIC:  return sizeof( SMD_DIELECTRIC );
+    case SMD_MATERIAL_TYPE_GLOSSY:      return sizeof( SMD_GLOSSY );
+    case SMD_MATERILA_TYPE_PLASTIC:     return sizeof( SMD_PLASTIC );
     }
 
-    // マテリアルデータを書き込み.
-    for( size_t i=0; i<m_NumMaterials; ++i )
+    return 0;
+}
+
+//-----------------------------------------------------------------------
+// Name : AlignOffset()
+// Desc : 配列アライメントに合わせてオフセットを切り上げます.
+//-----------------------------------------------------------------------
+unsigned long long AlignOffset( unsigned long long offset )
+{ return ( offset + SMD_ARRAY_ALIGN - 1 ) & ~static_cast<unsigned long long>( SMD_ARRAY_ALIGN - 1 ); }
+
+//-----------------------------------------------------------------------
+// Name : WriteArray()
+// Desc : オフセットまでパディングを書き込み, 配列を書き込みます.
+//-----------------------------------------------------------------------
+void WriteArray( FILE* pFile, unsigned long long& cursor, unsigned long long offset, const void* pData, size_t size )
+{
+    static const unsigned char padding[ SMD_ARRAY_ALIGN ] = { 0 };
+    if ( offset > cursor )
     {
-        // マテリアルタイプを書き込み.
-        fwrite( &m_Materials[i].materialType, sizeof(int), 1, pFile );
+        fwrite( padding, static_cast<size_t>( offset - cursor ), 1, pFile );
+        cursor = offset;
+    }
 
-        switch( m_Materials[i].materialType )
-        {
-        // Lambert
-        case SMD_MATERIAL_TYPE_MATTE:
-            {
-                SMD_MATTE value;
-                value.color.x = m_Materials[i].diffuse.x;
-                value.color.y = m_Materials[i].diffuse.y;
-                value.color.z = m_Materials[i].diffuse.z;
-
-                value.emissive.x = m_Materials[i].emissive.x;
-                value.emissive.y = m_Materials[i].emissive.y;
-                value.emissive.z = m_Materials[i].emissive.z;
-
-                // テクスチャインデックスを求める.
-                int textureIndex = -1;
-                for( size_t j=0; j<textureList.size(); ++j )
-                {
-                    // リストに登録されているかチェック.
-                    if ( strcmp( textureList[j].filename, m_Materials[i].diffuseMapName ) == 0 )
-                    {
-                        // 発見したインデックスを設定.
-                        textureIndex = j;
+    if ( size > 0 )
+    {
+        fwrite( pData, size, 1, pFile );
+        cursor += size;
+    }
+}
 
-                        // ループ脱出.
-                        break;
-                    }
-                }
+//-----------------------------------------------------------------------
+// Name : ExpandBits()
+// Desc : 下位21bitを3bitおきに配置します.
+//-----------------------------------------------------------------------
+inline
+unsigned long long ExpandBits( unsigned long long v )
+{
+    v &= 0x1fffff;
+    v = ( v | ( v << 32 ) ) & 0x001f00000000ffffull;
+    v = ( v | ( v << 16 ) ) & 0x001f0000ff0000ffull;
+    v = ( v | ( v <<  8 ) ) & 0x100f00f00f00f00full;
+    v = ( v | ( v <<  4 ) ) & 0x10c30c30c30c30c3ull;
+    v = ( v | ( v <<  2 ) ) & 0x1249249249249249ull;
+    return v;
+}
 
-                value.colorMap = textureIndex;
+//-----------------------------------------------------------------------
+// Name : CalcMortonCode()
+// Desc : [0, 1] に正規化した座標から63bitのモートンコードを求めます.
+//-----------------------------------------------------------------------
+inline
+unsigned long long CalcMortonCode( float x, float y, float z )
+{
+    const float SCALE = static_cast<float>( 0x1fffff );
+    x = ( x < 0.0f ) ? 0.0f : ( x > 1.0f ) ? 1.0f : x;
+    y = ( y < 0.0f ) ? 0.0f : ( y > 1.0f ) ? 1.0f : y;
+    z = ( z < 0.0f ) ? 0.0f : ( z > 1.0f ) ? 1.0f : z;
 
-                // マテリアル書き込み.
-                fwrite( &value, sizeof(value), 1, pFile );
-            }
-            break;
+    unsigned long long ix = static_cast<unsigned long long>( x * SCALE );
+    unsigned long long iy = static_cast<unsigned long long>( y * SCALE );
+    unsigned long long iz = static_cast<unsigned long long>( z * SCALE );
 
-        // Perfect Specular
-        case SMD_MATERIAL_TYPE_MIRROR:
-            {
-                SMD_MIRROR value;
-                value.color.x = m_Materials[i].diffuse.x;
-                value.color.y = m_Materials[i].diffuse.y;
-                value.color.z = m_Materials[i].diffuse.z;
-
-                value.emissive.x = m_Materials[i].emissive.x;
-                value.emissive.y = m_Materials[i].emissive.y;
-                value.emissive.z = m_Materials[i].emissive.z;
-
-                // テクスチャインデックスを求める.
-                int textureIndex = -1;
-                for( size_t j=0; j<textureList.size(); ++j )
-                {
-                    // リストに登録されているかチェック.
-                    if ( strcmp( textureList[j].filename, m_Materials[i].diffuseMapName ) == 0 )
-                    {
-                        // 発見したインデックスを設定.
-                        textureIndex = j;
+    return ( ExpandBits( ix ) << 2 ) | ( ExpandBits( iy ) << 1 ) | ExpandBits( iz );
+}
 
-                        // ループ脱出.
-                        break;
-                    }
-                }
 
-                value.colorMap = textureIndex;
+//////////////////////////////////////////////////////////////////////////
+// OBJVERTEXKEY structure
+//////////////////////////////////////////////////////////////////////////
+struct OBJVERTEXKEY
+{
+    unsigned int    bits[ 8 ];      //!< 位置座標・法線ベクトル・テクスチャ座標のビット表現です.
 
-                // マテリアル書き込み.
-                fwrite( &value, sizeof(value), 1, pFile );
-            }
-            break;
+    //-------------------------------------------------------------------
+    //! @brief      頂点からキーを生成します.
+    //-------------------------------------------------------------------
+    explicit OBJVERTEXKEY( const OBJVERTEX& vertex )
+    {
+        const float values[ 8 ] = {
+            vertex.position.x, vertex.position.y, vertex.position.z,
+            vertex.normal.x,   vertex.normal.y,   vertex.normal.z,
+            vertex.texcoord.x, vertex.texcoord.y
+        };
 
-        // Dielectric
-        case SMD_MATERIAL_TYPE_DIELECTRIC:
-            {
-                SMD_DIELECTRIC value;
-                value.color.x = m_Materials[i].specular.x;
-                value.color.y = m_Materials[i].specular.y;
-                value.color.z = m_Materials[i].specular.z;
+        for( int i=0; i<8; ++i )
+        {
+            //　-0.0 と 0.0 を同一視する
+            float value = values[ i ] + 0.0f;
+            memcpy( &bits[ i ], &value, sizeof( float ) );
+        }
+    }
+
+    bool operator == ( const OBJVERTEXKEY& value ) const
+    { return memcmp( bits, value.bits, sizeof( bits ) ) == 0; }
+};
+
+//////////////////////////////////////////////////////////////////////////
+// OBJVERTEXKEYHASH structure
+//////////////////////////////////////////////////////////////////////////
+struct OBJVERTEXKEYHASH
+{
+    size_t operator () ( const OBJVERTEXKEY& key ) const
+    {
+        //　FNV-1a
+        unsigned long long hash = 14695981039346656037ull;
+        for( int i=0; i<8; ++i )
+        {
+            hash ^= key.bits[ i ];
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>( hash );
+    }
+};
 
-                value.emissive.x = m_Materials[i].emissive.x;
-                value.emissive.y = m_Materials[i].emissive.y;
-                value.emissive.z = m_Materials[i].emissive.z;
+//-----------------------------------------------------------------------
+// Name : Optimize()
+// Desc : 同一頂点を統合し, 三角形を空間充填曲線順に並び替えます.
+//-----------------------------------------------------------------------
+bool OBJMESH::Optimize()
+{
+    if ( m_NumIndices == 0 || m_NumIndices % 3 != 0 )
+    { return false; }
 
-                value.ior = m_Materials[i].ior;
+    unsigned int numFaces = m_NumIndices / 3;
 
-                // テクスチャインデックスを求める.
-                int textureIndex = -1;
-                for( size_t j=0; j<textureList.size(); ++j )
-                {
-                    // リストに登録されているかチェック.
-                    if ( strcmp( textureList[j].filename, m_Materials[i].specularMapName ) == 0 )
-                    {
-                        // 発見したインデックスを設定.
-                        textureIndex = j;
+    // 面ごとのマテリアル番号を求める.
+    vector<unsigned int> faceMaterials( numFaces, 0 );
+    for( unsigned int i=0; i<m_NumSubsets; ++i )
+    {
+        unsigned int begin = m_Subsets[i].faceStart / 3;
+        unsigned int end   = ( m_Subsets[i].faceStart + m_Subsets[i].faceCount ) / 3;
+        for( unsigned int j=begin; j<end && j<numFaces; ++j )
+        { faceMaterials[j] = m_Subsets[i].materialIndex; }
+    }
 
-                        // ループ脱出.
-                        break;
-                    }
-                }
+    // 同一頂点を統合する.
+    vector<unsigned int> remap( m_NumVertices );
+    vector<OBJVERTEX>    welded;
+    welded.reserve( m_NumVertices );
+    {
+        unordered_map<OBJVERTEXKEY, unsigned int, OBJVERTEXKEYHASH> table;
+        table.reserve( m_NumVertices );
 
-                value.colorMap = textureIndex;
+        for( unsigned int i=0; i<m_NumVertices; ++i )
+        {
+            unsigned int index = static_cast<unsigned int>( welded.size() );
+            auto result = table.insert( make_pair( OBJVERTEXKEY( m_Vertices[i] ), index ) );
+            if ( result.second )
+            { welded.push_back( m_Vertices[i] ); }
 
-                // マテリアル書き込み.
-                fwrite( &value, sizeof(value), 1, pFile );
-            }
-            break;
+            remap[i] = result.first->second;
+        }
+    }
 
-        // Phong
-        case SMD_MATERIAL_TYPE_GLOSSY:
-            {
-                SMD_GLOSSY value;
-                value.color.x = m_Materials[i].specular.x;
-                value.color.y = m_Materials[i].specular.y;
-                value.color.z = m_Materials[i].specular.z;
+    // 重心のモートンコードを求める.
+    OBJVEC3 boxMin  = m_Box.minimum;
+    OBJVEC3 boxSize = OBJVEC3Substract( m_Box.maximum, m_Box.minimum );
+    OBJVEC3 invSize(
+        ( boxSize.x > 0.0f ) ? 1.0f / boxSize.x : 0.0f,
+        ( boxSize.y > 0.0f ) ? 1.0f / boxSize.y : 0.0f,
+        ( boxSize.z > 0.0f ) ? 1.0f / boxSize.z : 0.0f );
 
-                value.power = m_Materials[i].shininess;
+    vector< pair<unsigned long long, unsigned int> > order( numFaces );
+    ParallelFor( numFaces, 4096, [&]( size_t begin, size_t end )
+    {
+        for( size_t i=begin; i<end; ++i )
+        {
+            OBJVEC3 p0 = welded[ remap[ m_Indices[ i * 3 + 0 ] ] ].position;
+            OBJVEC3 p1 = welded[ remap[ m_Indices[ i * 3 + 1 ] ] ].position;
+            OBJVEC3 p2 = welded[ remap[ m_Indices[ i * 3 + 2 ] ] ].position;
 
-                value.emissive.x = m_Materials[i].emissive.x;
-                value.emissive.y = m_Materials[i].emissive.y;
-                value.emissive.z = m_Materials[i].emissive.z;
+            float x = ( ( p0.x + p1.x + p2.x ) / 3.0f - boxMin.x ) * invSize.x;
+            float y = ( ( p0.y + p1.y + p2.y ) / 3.0f - boxMin.y ) * invSize.y;
+            float z = ( ( p0.z + p1.z + p2.z ) / 3.0f - boxMin.z ) * invSize.z;
 
-                // テクスチャインデックスを求める.
-                int textureIndex = -1;
-                for( size_t j=0; j<textureList.size(); ++j )
-                {
-                    // リストに登録されているかチェック.
-                    if ( strcmp( textureList[j].filename, m_Materials[i].specularMapName ) == 0 )
-                    {
-                        // 発見したインデックスを設定.
-                        textureIndex = j;
+            order[i].first  = CalcMortonCode( x, y, z );
+            order[i].second = static_cast<unsigned int>( i );
+        }
+    });
 
-                        // ループ脱出.
-                        break;
-                    }
-                }
+    sort( order.begin(), order.end() );
 
-                value.colorMap = textureIndex;
+    // 並び替えた三角形が最初に参照した順に頂点を配置する.
+    const unsigned int INVALID_INDEX = 0xffffffff;
+    vector<unsigned int> vertexOrder( welded.size(), INVALID_INDEX );
+    vector<OBJVERTEX>    vertices;
+    vector<unsigned int> indices;
+    vector<OBJSUBSET>    subsets;
+    vertices.reserve( welded.size() );
+    indices .reserve( m_NumIndices );
 
-                // マテリアル書き込み.
-                fwrite( &value, sizeof(value), 1, pFile );
-            }
-            break;
+    for( unsigned int i=0; i<numFaces; ++i )
+    {
+        unsigned int face = order[i].second;
 
-        // Lambert + Diffuse
-        case SMD_MATERILA_TYPE_PLASTIC:
+        for( unsigned int j=0; j<3; ++j )
+        {
+            unsigned int index = remap[ m_Indices[ face * 3 + j ] ];
+            if ( vertexOrder[ index ] == INVALID_INDEX )
             {
-                SMD_PLASTIC value;
-                value.diffuse.x = m_Materials[i].diffuse.x;
-                value.diffuse.y = m_Materials[i].diffuse.y;
-                value.diffuse.z = m_Materials[i].diffuse.z;
+                vertexOrder[ index ] = static_cast<unsigned int>( vertices.size() );
+                vertices.push_back( welded[ index ] );
+            }
 
-                value.specular.x = m_Materials[i].specular.x;
-                value.specular.y = m_Materials[i].specular.y;
-                value.specular.z = m_Materials[i].specular.z;
+            indices.push_back( vertexOrder[ index ] );
+        }
 
-                value.power = m_Materials[i].shininess;
+        // 同じマテリアルが続く範囲をサブセットとする.
+        unsigned int materialIndex = faceMaterials[ face ];
+        if ( subsets.empty() || subsets.back().materialIndex != materialIndex )
+        {
+            OBJSUBSET subset;
+            subset.materialIndex = materialIndex;
+            subset.faceStart     = i * 3;
+            subset.faceCount     = 0;
+            subsets.push_back( subset );
+        }
+        subsets.back().faceCount += 3;
+    }
 
-                value.emissive.x = m_Materials[i].emissive.x;
-                value.emissive.y = m_Materials[i].emissive.y;
-                value.emissive.z = m_Materials[i].emissive.z;
+    printf_s( "Info : Optimize() vertices %u -> %u, subsets %u -> %u\n",
+        m_NumVertices, static_cast<unsigned int>( vertices.size() ),
+        m_NumSubsets,  static_cast<unsigned int>( subsets.size() ) );
 
-                // テクスチャインデックスを求める.
-                int diffuseMap = -1;
-                int specularMap = -1;
-                for( size_t j=0; j<textureList.size(); ++j )
-                {
-                    // リストに登録されているかチェック.
-                    if ( strcmp( textureList[j].filename, m_Materials[i].diffuseMapName ) == 0 )
-                    {
-                        // 発見したインデックスを設定.
-                        diffuseMap = j;
+    // データを差し替える.
+    SAFE_DELETE_ARRAY( m_Vertices );
+    SAFE_DELETE_ARRAY( m_Indices );
+    SAFE_DELETE_ARRAY( m_Subsets );
 
-                        // ループ脱出.
-                        break;
-                    }
-                }
+    m_NumVertices = static_cast<unsigned int>( vertices.size() );
+    m_NumSubsets  = static_cast<unsigned int>( subsets.size() );
 
-                for( size_t j=0; j<textureList.size(); ++j )
-                {
-                    // リストに登録されているかチェック.
-                    if ( strcmp( textureList[j].filename, m_Materials[i].specularMapName ) == 0 )
-                    {
-                        // 発見したインデックスを設定.
-                        specularMap = j;
+    m_Vertices = new OBJVERTEX   [ m_NumVertices ];
+    m_Indices  = new unsigned int[ m_NumIndices ];
+    m_Subsets  = new OBJSUBSET   [ m_NumSubsets ];
 
-                        // ループ脱出.
-                        break;
-                    }
-                }
+    copy( vertices.begin(), vertices.end(), m_Vertices );
+    copy( indices .begin(), indices .end(), m_Indices );
+    copy( subsets .begin(), subsets .end(), m_Subsets );
 
-                value.diffuseMap = diffuseMap;
-                value.specularMap = specularMap;
+    return true;
+}
 
-                fwrite( &value, sizeof(value), 1, pFile );
-            }
-            break;
-        }
+//-----------------------------------------------------------------------
+// Name : WriteDirect()
+// Desc : 最適化せず直接バイナリ書き込みをします.
+//-----------------------------------------------------------------------
+void OBJMESH::WriteDirect( FILE* pFile )
+{
+    // テクスチャファイル名リストを生成します.
+    std::vector<SMD_TEXTURE> textureList;
+    BuildTextureList( m_Materials, m_NumMaterials, textureList );
+
+    // データヘッダーを設定.
+    SMD_DATA_HEADER dataHeader;
+    dataHeader.numTriangles = m_NumIndices / 3;
+    dataHeader.numMaterials = m_NumMaterials;
+    dataHeader.numTextures = (unsigned int)textureList.size();
+    dataHeader.triangleStructureSize = SMD_TRIANGLE_STRUCT_SIZE;
+    dataHeader.materialStructureSize = SMD_MATERIAL_STRUCT_SIZE;
+    dataHeader.textureStructureSize  = SMD_TEXTURE_STRUCT_SIZE;
+
+    // ファイルヘッダーを設定.
+    SMD_FILE_HEADER fileHeader;
+    memcpy( &fileHeader.magic, SMD_MAGIC, sizeof( unsigned char ) * 4 );
+    fileHeader.version        = SMD_VERSION_2;
+    fileHeader.dataHeaderSize = SMD_DATA_HEADER_SIZE;
+    fileHeader.dataHeader     = dataHeader;
+
+    // ヘッダーを書き込み.
+    fwrite( &fileHeader, sizeof( SMD_FILE_HEADER ), 1, pFile );
+
+    // テクスチャファイル名を書き込む.
+    for( size_t j=0; j<textureList.size(); ++j )
+    {
+        SMD_TEXTURE texture = textureList[j];
+        fwrite( &texture, sizeof( SMD_TEXTURE ), 1, pFile );
+    }
+
+    // マテリアルデータを書き込み.
+    for( size_t i=0; i<m_NumMaterials; ++i )
+    {
+        SMD_MATERIAL value;
+        SetupMaterial( m_Materials[i], textureList, value );
+
+        // マテリアルタイプとタイプごとのパラメータを書き込み.
+        fwrite( &value.type, sizeof(int), 1, pFile );
+        fwrite( &value.matte, GetMaterialParamSize( value.type ), 1, pFile );
     }
 
+    // 三角形データはまとめて書き込む.
+    const size_t WRITE_BLOCK_SIZE = 65536;
+    std::vector<SMD_TRIANGLE> triangles;
+    triangles.reserve( WRITE_BLOCK_SIZE );
+
     // サブセットをデータを書き込み.
     for (size_t i = 0; i<m_NumSubsets; ++i)
     {
@@ -1589,39 +2140,153 @@ void OBJMESH::WriteDirect( FILE* pFile )
             // 頂点データを設定します.
             for (size_t k = 0; k < 3; ++k)
             {
+                const OBJVERTEX& vertex = m_Vertices[ m_Indices[idx + k] ];
+
                 // 位置座標を設定.
-                triangle.vertex[k].position.x = m_Vertices[idx + k].position.x;
-                triangle.vertex[k].position.y = m_Vertices[idx + k].position.y;
-                triangle.vertex[k].position.z = m_Vertices[idx + k].position.z;
+                triangle.vertex[k].position.x = vertex.position.x;
+                triangle.vertex[k].position.y = vertex.position.y;
+                triangle.vertex[k].position.z = vertex.position.z;
 
                 // 法線ベクトルを設定.
-                triangle.vertex[k].normal.x = m_Vertices[idx + k].normal.x;
-                triangle.vertex[k].normal.y = m_Vertices[idx + k].normal.y;
-                triangle.vertex[k].normal.z = m_Vertices[idx + k].normal.z;
+                triangle.vertex[k].normal.x = vertex.normal.x;
+                triangle.vertex[k].normal.y = vertex.normal.y;
+                triangle.vertex[k].normal.z = vertex.normal.z;
 
                 // テクスチャ座標を設定.
-                triangle.vertex[k].texcoord.x = m_Vertices[idx + k].texcoord.x;
-                triangle.vertex[k].texcoord.y = m_Vertices[idx + k].texcoord.y;
+                triangle.vertex[k].texcoord.x = vertex.texcoord.x;
+                triangle.vertex[k].texcoord.y = vertex.texcoord.y;
             }
 
             // マテリアル番号を設定.
             triangle.materialId = m_Subsets[i].materialIndex;
 
-            // 三角形データを書き込み.
-            fwrite(&triangle, sizeof(SMD_TRIANGLE), 1, pFile);
+            // 三角形データを追加し, ブロックが埋まったら書き込み.
+            triangles.push_back(triangle);
+            if (triangles.size() == WRITE_BLOCK_SIZE)
+            {
+                fwrite(&triangles[0], sizeof(SMD_TRIANGLE), triangles.size(), pFile);
+                triangles.clear();
+            }
         }
     }
 
+    // 残りの三角形データを書き込み.
+    if (!triangles.empty())
+    { fwrite(&triangles[0], sizeof(SMD_TRIANGLE), triangles.size(), pFile); }
+
     // 不要なメモリを破棄.
     textureList.clear();
 }
 
+//-----------------------------------------------------------------------
+// Name : WriteIndexed()
+// Desc : インデックス形式(バージョン3)でバイナリ書き込みをします.
+//-----------------------------------------------------------------------
+void OBJMESH::WriteIndexed( FILE* pFile )
+{
+    // テクスチャファイル名リストを生成します.
+    vector<SMD_TEXTURE> textureList;
+    BuildTextureList( m_Materials, m_NumMaterials, textureList );
+
+    // マテリアルを設定. 読み込み側は1つ以上を必要とするため, 無い場合は既定値を追加.
+    vector<SMD_MATERIAL> materials;
+    for( unsigned int i=0; i<m_NumMaterials; ++i )
+    {
+        SMD_MATERIAL value;
+        SetupMaterial( m_Materials[i], textureList, value );
+        materials.push_back( value );
+    }
+
+    if ( materials.empty() )
+    {
+        OBJMATERIAL material;
+        InitMaterial( &material );
+
+        SMD_MATERIAL value;
+        SetupMaterial( material, textureList, value );
+        materials.push_back( value );
+    }
+
+    // 頂点属性を配列ごとに分ける.
+    unsigned int numFaces = m_NumIndices / 3;
+    vector<SMD_FVEC3> positions( m_NumVertices );
+    vector<SMD_FVEC3> normals  ( m_NumVertices );
+    vector<SMD_FVEC2> texcoords( m_NumVertices );
+    vector<int>       materialIds( numFaces, 0 );
+
+    for( unsigned int i=0; i<m_NumVertices; ++i )
+    {
+        positions[i].x = m_Vertices[i].position.x;
+        positions[i].y = m_Vertices[i].position.y;
+        positions[i].z = m_Vertices[i].position.z;
+
+        normals[i].x = m_Vertices[i].normal.x;
+        normals[i].y = m_Vertices[i].normal.y;
+        normals[i].z = m_Vertices[i].normal.z;
+
+        texcoords[i].x = m_Vertices[i].texcoord.x;
+        texcoords[i].y = m_Vertices[i].texcoord.y;
+    }
+
+    for( unsigned int i=0; i<m_NumSubsets; ++i )
+    {
+        int materialId = static_cast<int>( m_Subsets[i].materialIndex );
+        if ( materialId >= static_cast<int>( materials.size() ) )
+        { materialId = 0; }
+
+        unsigned int begin = m_Subsets[i].faceStart / 3;
+        unsigned int end   = ( m_Subsets[i].faceStart + m_Subsets[i].faceCount ) / 3;
+        for( unsigned int j=begin; j<end && j<numFaces; ++j )
+        { materialIds[j] = materialId; }
+    }
+
+    const size_t positionSize   = sizeof( SMD_FVEC3 )    * positions.size();
+    const size_t normalSize     = sizeof( SMD_FVEC3 )    * normals.size();
+    const size_t texcoordSize   = sizeof( SMD_FVEC2 )    * texcoords.size();
+    const size_t indexSize      = sizeof( unsigned int ) * m_NumIndices;
+    const size_t materialIdSize = sizeof( int )          * materialIds.size();
+    const size_t materialSize   = sizeof( SMD_MATERIAL ) * materials.size();
+    const size_t textureSize    = sizeof( SMD_TEXTURE )  * textureList.size();
+
+    // ファイルヘッダーを設定.
+    SMD_FILE_HEADER_V3 fileHeader;
+    memset( &fileHeader, 0, sizeof( fileHeader ) );
+    memcpy( &fileHeader.magic, SMD_MAGIC, sizeof( unsigned char ) * 4 );
+    fileHeader.version        = SMD_VERSION_3;
+    fileHeader.dataHeaderSize = SMD_DATA_HEADER_V3_SIZE;
+
+    // 各配列をアライメントを揃えて連続して配置.
+    SMD_DATA_HEADER_V3& dataHeader = fileHeader.dataHeader;
+    dataHeader.numVertices      = m_NumVertices;
+    dataHeader.numTriangles     = numFaces;
+    dataHeader.numMaterials     = static_cast<unsigned int>( materials.size() );
+    dataHeader.numTextures      = static_cast<unsigned int>( textureList.size() );
+    dataHeader.positionOffset   = AlignOffset( sizeof( fileHeader ) );
+    dataHeader.normalOffset     = AlignOffset( dataHeader.positionOffset   + positionSize );
+    dataHeader.texcoordOffset   = AlignOffset( dataHeader.normalOffset     + normalSize );
+    dataHeader.indexOffset      = AlignOffset( dataHeader.texcoordOffset   + texcoordSize );
+    dataHeader.materialIdOffset = AlignOffset( dataHeader.indexOffset      + indexSize );
+    dataHeader.materialOffset   = AlignOffset( dataHeader.materialIdOffset + materialIdSize );
+    dataHeader.textureOffset    = AlignOffset( dataHeader.materialOffset   + materialSize );
+
+    // 配列ごとにまとめて書き込み.
+    unsigned long long cursor = 0;
+    WriteArray( pFile, cursor, 0,                           &fileHeader,        sizeof( fileHeader ) );
+    WriteArray( pFile, cursor, dataHeader.positionOffset,   positions  .data(), positionSize );
+    WriteArray( pFile, cursor, dataHeader.normalOffset,     normals    .data(), normalSize );
+    WriteArray( pFile, cursor, dataHeader.texcoordOffset,   texcoords  .data(), texcoordSize );
+    WriteArray( pFile, cursor, dataHeader.indexOffset,      m_Indices,          indexSize );
+    WriteArray( pFile, cursor, dataHeader.materialIdOffset, materialIds.data(), materialIdSize );
+    WriteArray( pFile, cursor, dataHeader.materialOffset,   materials  .data(), materialSize );
+    WriteArray( pFile, cursor, dataHeader.textureOffset,    textureList.data(), textureSize );
+}
+
 
 //-----------------------------------------------------------------------
 // Name : SaveToBinary()
 // Desc : バイナリ保存します.
 //-----------------------------------------------------------------------
-bool OBJMESH::SaveToBinary( const char* filename )
+bool OBJMESH::SaveToBinary( const char* filename, bool isIndexed )
 {
     FILE* pFile;
 
@@ -1633,7 +2298,10 @@ bool OBJMESH::SaveToBinary( const char* filename )
         return false;
     }
 
-    WriteDirect( pFile );
+    if ( isIndexed )
+    { WriteIndexed( pFile ); }
+    else
+    { WriteDirect( pFile ); }
 
     // ファイルを閉じる.
     fclose( pFile );
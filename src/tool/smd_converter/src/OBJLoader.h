@@ -277,6 +277,13 @@ private:
     //------------------------------------------------------------------------------------
     void WriteDirect  ( FILE* pFile );
 
+    //------------------------------------------------------------------------------------
+    //! @brief      インデックス形式(バージョン3)でバイナリ書き込みします.
+    //!
+    //! @param [in]     pFile       ファイルポインタ.
+    //------------------------------------------------------------------------------------
+    void WriteIndexed ( FILE* pFile );
+
 protected:
     //====================================================================================
     // protected variables.
@@ -317,14 +324,23 @@ public:
     //------------------------------------------------------------------------------------
     bool LoadFile    ( const char* filename );
 
+    //------------------------------------------------------------------------------------
+    //! @brief      同一頂点を統合し, 三角形をモートン順に並び替えます.
+    //!
+    //! @retval true    最適化に成功.
+    //! @retval false   最適化に失敗.
+    //------------------------------------------------------------------------------------
+    bool Optimize    ();
+
     //------------------------------------------------------------------------------------
     //! @brief      バイナリ保存します.
     //!
     //! @param [in]     filename        バイナリファイル名.
+    //! @param [in]     isIndexed       インデックス形式(バージョン3)で保存する場合は true.
     //! @retval true    バイナリ保存に成功.
     //! @retval false   バイナリ保存に失敗.
     //------------------------------------------------------------------------------------
-    bool SaveToBinary( const char* filename );
+    bool SaveToBinary( const char* filename, bool isIndexed = true );
 
     //------------------------------------------------------------------------------------
     //! @brief      メモリを解放します.
@@ -32,6 +32,36 @@ struct SMD_FILE_HEADER
     SMD_DATA_HEADER dataHeader;             //!< データヘッダです.
 };
 
+/////////////////////////////////////////////////////////////////////////////////
+// SMD_DATA_HEADER_V3 structure
+/////////////////////////////////////////////////////////////////////////////////
+struct SMD_DATA_HEADER_V3
+{
+    unsigned int        numVertices;        //!< 頂点数です.
+    unsigned int        numTriangles;       //!< 三角形数です.
+    unsigned int        numMaterials;       //!< マテリアル数です.
+    unsigned int        numTextures;        //!< テクスチャ数です.
+    unsigned long long  positionOffset;     //!< 位置座標配列のファイル先頭からのオフセットです.
+    unsigned long long  normalOffset;       //!< 法線ベクトル配列のオフセットです.
+    unsigned long long  texcoordOffset;     //!< テクスチャ座標配列のオフセットです.
+    unsigned long long  indexOffset;        //!< 頂点インデックス配列のオフセットです.
+    unsigned long long  materialIdOffset;   //!< マテリアル番号配列のオフセットです.
+    unsigned long long  materialOffset;     //!< マテリアル配列のオフセットです.
+    unsigned long long  textureOffset;      //!< テクスチャ配列のオフセットです.
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// SMD_FILE_HEADER_V3 structure
+/////////////////////////////////////////////////////////////////////////////////
+struct SMD_FILE_HEADER_V3
+{
+    unsigned char       magic[ 4 ];         //!< マジックです.
+    unsigned int        version;            //!< ファイルバージョンです.
+    unsigned int        dataHeaderSize;     //!< データヘッダのサイズです.
+    unsigned int        reserved;           //!< 予約領域です.
+    SMD_DATA_HEADER_V3  dataHeader;         //!< データヘッダです.
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // SMD_DVEC2 structure
 ////////////////////////////////////////////////////////////////////////////////
@@ -230,6 +260,22 @@ struct SMD_PLASTIC
     int         specularMap;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// SMD_MATERIAL structure
+///////////////////////////////////////////////////////////////////////////////
+struct SMD_MATERIAL
+{
+    int                 type;           //!< マテリアルタイプです.
+    union
+    {
+        SMD_MATTE       matte;          //!< SMD_MATERIAL_TYPE_MATTE のパラメータです.
+        SMD_MIRROR      mirror;         //!< SMD_MATERIAL_TYPE_MIRROR のパラメータです.
+        SMD_DIELECTRIC  dielectric;     //!< SMD_MATERIAL_TYPE_DIELECTRIC のパラメータです.
+        SMD_GLOSSY      glossy;         //!< SMD_MATERIAL_TYPE_GLOSSY のパラメータです.
+        SMD_PLASTIC     plastic;        //!< SMD_MATERILA_TYPE_PLASTIC のパラメータです.
+    };
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 ///////////////////////////////////////////////////////////////////////////////
@@ -251,8 +297,20 @@ struct SMD_SUBSET
 //!< マジックです.
 static const unsigned char SMD_MAGIC[ 4 ]           = { 'S', 'M', 'D', '\0' };
 
+//!< 三角形ごとに頂点を持つ旧形式のファイルバージョンです.
+static const unsigned int  SMD_VERSION_2            = 0x00000002;
+
+//!< 配列をまとめて持つインデックス形式のファイルバージョンです.
+static const unsigned int  SMD_VERSION_3            = 0x00000003;
+
 //!< ファイルバージョンです.
-static const unsigned int  SMD_VERSION              = 0x00000002;
+static const unsigned int  SMD_VERSION              = SMD_VERSION_3;
+
+//!< バージョン3の配列アライメントです.
+static const unsigned int  SMD_ARRAY_ALIGN          = 16;
+
+//!< バージョン3のデータヘッダのサイズです.
+static const unsigned int  SMD_DATA_HEADER_V3_SIZE  = sizeof( SMD_DATA_HEADER_V3 );
 
 //!< データヘッダのサイズです.
 static const unsigned int  SMD_DATA_HEADER_SIZE     = sizeof( SMD_DATA_HEADER );
@@ -27,7 +27,8 @@ void ShowHelp()
     ILOG( "// smd_converter.exe" );
     ILOG( "// Copyright(c) Project Asura. All right reserved." );
     ILOG( "//-------------------------------------------------------------------" );
-    ILOG( "[使い方] smd_converter.exe -i 入力ファイル名 -o 出力ファイル名" );
+    ILOG( "[使い方] smd_converter.exe -i 入力ファイル名 -o 出力ファイル名 [-v2]" );
+    ILOG( "    -v2 : 頂点の統合・並び替えを行わず, 旧形式(バージョン2)で出力します." );
     ILOG( "" );
 
 }
@@ -41,6 +42,7 @@ int main( int argc, char** argv )
     {
         std::string inputFileName;
         std::string outputFileName;
+        bool        isLegacy = false;
 
         for( int i=0; i<argc; i++ )
         {
@@ -56,6 +58,10 @@ int main( int argc, char** argv )
                 if ( i < argc )
                 { outputFileName = std::string( argv[ i ] ); }
             }
+            else if ( strcmp( argv[ i ], "-v2" ) == 0 )
+            {
+                isLegacy = true;
+            }
             else if ( strcmp( argv[ i ], "-io" ) == 0 )
             {
                 i++;
@@ -83,7 +89,15 @@ int main( int argc, char** argv )
             OBJMESH mesh;
             if ( mesh.LoadFile( inputFileName.c_str() ) ) 
             {
-                if ( mesh.SaveToBinary( outputFileName.c_str() ) )
+                // 失敗時は再構築途中のデータが残っているので出力しない.
+                if ( !isLegacy && !mesh.Optimize() )
+                {
+                    printf_s( "Error : Optimize Failed. filename = %s\n", inputFileName.c_str() );
+                    mesh.Release();
+                    return 1;
+                }
+
+                if ( mesh.SaveToBinary( outputFileName.c_str(), !isLegacy ) )
                 { printf_s( "Info : Binary Convert Success. filename = %s\n", outputFileName.c_str() ); }
                 else
                 { printf_s( "Error : Save File Failed. filename = %s\n", outputFileName.c_str() ); }